@@ -0,0 +1,148 @@
+// Checks the IMA-ADPCM uplink codec (audio_adpcm.h) on the voice-agent WAV
+// fixtures: each file is encoded in 32ms frames as the sender does and
+// decoded again with audio_adpcm_decode_frame, the server's stand-in. The
+// speech has to come back above a minimum SNR at about a quarter of the
+// pcm16 bitrate, every frame has to decode on its own so a lost one costs
+// only itself, and malformed frames are refused. The encode cost per
+// frame is dsp_bench's stage.adpcm.
+//
+//   adpcm_test FIXTURE.wav...
+
+#include "audio_adpcm.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_SAMPLES 512 // One capture block, 32ms at 16kHz
+#define MIN_SNR_DB 20.0
+#define MIN_REDUCTION 3.8 // pcm16 bytes per ADPCM byte, headers included
+
+static void fixture(const char *path) {
+  wav_t wav;
+  if (wav_load(path, &wav) != 0) {
+    failures++;
+    return;
+  }
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  printf("%s: %zu frames at %u Hz\n", name, wav.frames,
+         (unsigned int)wav.rate);
+
+  size_t frames = (wav.frames + FRAME_SAMPLES - 1) / FRAME_SAMPLES;
+  uint8_t *encoded = malloc(frames * AUDIO_ADPCM_FRAME_BYTES(FRAME_SAMPLES));
+  size_t *offsets = calloc(frames + 1, sizeof(size_t));
+  int16_t *decoded = calloc(wav.frames, sizeof(int16_t));
+  if (!encoded || !offsets || !decoded) {
+    printf("  out of memory\n");
+    exit(1);
+  }
+
+  audio_adpcm_state_t state;
+  audio_adpcm_reset(&state);
+  for (size_t f = 0; f < frames; f++) {
+    size_t at = f * FRAME_SAMPLES;
+    size_t n = wav.frames - at < FRAME_SAMPLES ? wav.frames - at
+                                               : FRAME_SAMPLES;
+    offsets[f + 1] = offsets[f] + audio_adpcm_encode_frame(
+                                      &state, wav.samples + at, n,
+                                      encoded + offsets[f]);
+  }
+
+  // Decode every frame on its own, as the server would
+  size_t decoded_samples = 0;
+  bool continuous = true;
+  for (size_t f = 0; f < frames; f++) {
+    size_t len = offsets[f + 1] - offsets[f];
+    size_t n = audio_adpcm_decode_frame(encoded + offsets[f], len,
+                                        decoded + decoded_samples,
+                                        wav.frames - decoded_samples);
+    decoded_samples += n;
+    // The encoder carries its state over: the header of the next frame is
+    // where this one's reconstruction ended
+    if (f + 1 < frames && n > 0) {
+      const uint8_t *next = encoded + offsets[f + 1];
+      continuous = continuous && decoded[decoded_samples - 1] ==
+                                     (int16_t)(next[0] | next[1] << 8);
+    }
+  }
+  check(decoded_samples == wav.frames, "every sample decodes");
+  check(continuous, "frame headers carry the encoder state over");
+
+  double signal = 0, noise = 0;
+  for (size_t i = 0; i < wav.frames; i++) {
+    double error = (double)decoded[i] - wav.samples[i];
+    signal += (double)wav.samples[i] * wav.samples[i];
+    noise += error * error;
+  }
+  double snr = 10 * log10(signal / (noise > 0 ? noise : 1e-9));
+  double seconds = (double)wav.frames / wav.rate;
+  double pcm_bytes = wav.frames * sizeof(int16_t);
+  double reduction = pcm_bytes / offsets[frames];
+  printf("  SNR %.1f dB; pcm16 %.0f kbit/s, adpcm %.0f kbit/s (%.2fx)\n", snr,
+         pcm_bytes * 8 / seconds / 1000, offsets[frames] * 8 / seconds / 1000,
+         reduction);
+  char what[64];
+  snprintf(what, sizeof(what), "round trip SNR above %.0f dB", MIN_SNR_DB);
+  check(snr > MIN_SNR_DB, what);
+  snprintf(what, sizeof(what), "bitrate cut by more than %.1fx",
+           MIN_REDUCTION);
+  check(reduction > MIN_REDUCTION, what);
+
+  // Lose one frame in the middle: the next one still decodes exactly as
+  // it did with the whole stream
+  size_t lost = frames / 2;
+  int16_t alone[FRAME_SAMPLES];
+  size_t n = audio_adpcm_decode_frame(encoded + offsets[lost + 1],
+                                      offsets[lost + 2] - offsets[lost + 1],
+                                      alone, FRAME_SAMPLES);
+  check(n == FRAME_SAMPLES &&
+            memcmp(alone, decoded + (lost + 1) * FRAME_SAMPLES,
+                   sizeof(alone)) == 0,
+        "frame after a lost one decodes unchanged");
+
+  free(encoded);
+  free(offsets);
+  free(decoded);
+  wav_free(&wav);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  for (int i = 1; i < argc; i++) {
+    fixture(argv[i]);
+  }
+
+  printf("Malformed frames\n");
+  int16_t pcm[16] = {0, 1000, -1000, 32767, -32768};
+  uint8_t frame[AUDIO_ADPCM_FRAME_BYTES(16)];
+  int16_t out[16];
+  audio_adpcm_state_t state;
+  audio_adpcm_reset(&state);
+  size_t len = audio_adpcm_encode_frame(&state, pcm, 16, frame);
+  check(len == sizeof(frame) && audio_adpcm_decode_frame(frame, len, out,
+                                                         16) == 16,
+        "well-formed frame decodes");
+  check(audio_adpcm_decode_frame(frame, AUDIO_ADPCM_HEADER_BYTES - 1, out,
+                                 16) == 0,
+        "short header refused");
+  check(audio_adpcm_decode_frame(frame, len - 1, out, 16) == 0,
+        "truncated payload refused");
+  check(audio_adpcm_decode_frame(frame, len, out, 15) == 0,
+        "more samples than the caller has room for refused");
+  frame[2] = 89;
+  check(audio_adpcm_decode_frame(frame, len, out, 16) == 0,
+        "step index past the table refused");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+// Checks the echo canceller (audio_aec.h) on the voice-agent WAV fixtures:
+// the fixtures play as the far end, reach the mic through a synthetic room
+// (a direct path and a decaying reverberant tail) after a bulk playback
+// delay, and the mic picks up a little noise of its own. The sender's
+// 512-sample blocks go through the canceller. The bulk delay estimate has
+// to lock onto the playback delay, the echo has to come down by the ERLE
+// below, and the canceller has to follow when the playback delay jumps.
+// Prints the cost per 128-sample block on this host; dsp_bench has the
+// device cycles (stage.aec).
+//
+//   aec_test FIXTURE.wav...
+
+#include "audio_aec.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RATE 16000
+#define BLOCK_SAMPLES 512 // One capture block
+#define SECONDS 12
+#define SAMPLES (SECONDS * RATE)
+#define BULK_DELAY_MS 80  // Playback pipeline, before the room
+#define MOVED_DELAY_MS 140 // And after it jumps, halfway through
+#define ROOM_MS 12         // Reverberant tail, inside the filter's 32ms
+#define ECHO_GAIN 0.5      // Direct path, speaker to mic
+#define MIC_NOISE_RMS 10   // -70 dBFS
+#define MIN_ERLE_DB 20.0
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define ROOM_TAPS (RATE * ROOM_MS / 1000)
+
+static double room[ROOM_TAPS];
+static int16_t far[SAMPLES], echo[SAMPLES];
+static int16_t mic[SAMPLES], out[SAMPLES];
+
+// The direct path, then reflections decaying by 60dB over the tail
+static void room_init(void) {
+  room[0] = ECHO_GAIN;
+  for (int n = 1; n < ROOM_TAPS; n++) {
+    room[n] = 0.3 * ECHO_GAIN * white() * pow(10, -3.0 * n / ROOM_TAPS);
+  }
+}
+
+// The fixtures back to back, over and over
+static void loop_fixtures(int16_t *dst, const wav_t *wavs, int count) {
+  size_t at = 0;
+  for (int i = 0; at < SAMPLES; i = (i + 1) % count) {
+    for (size_t n = 0; n < wavs[i].frames && at < SAMPLES; n++) {
+      dst[at++] = wavs[i].samples[n];
+    }
+  }
+}
+
+// Echo of the far end as the mic hears it, the bulk delay jumping to
+// MOVED_DELAY_MS at `moved`
+static void make_echo(size_t moved) {
+  for (size_t i = 0; i < SAMPLES; i++) {
+    size_t delay = RATE * (i < moved ? BULK_DELAY_MS : MOVED_DELAY_MS) / 1000;
+    double y = 0;
+    for (int n = 0; n < ROOM_TAPS && n + delay <= i; n++) {
+      y += room[n] * far[i - delay - n];
+    }
+    echo[i] = clip(y);
+  }
+}
+
+static double power(const int16_t *x, size_t from, size_t to) {
+  double sum = 0;
+  for (size_t i = from; i < to; i++) {
+    sum += (double)x[i] * x[i];
+  }
+  return sum / (to - from) + 1e-9;
+}
+
+// ERLE from the signals themselves over [from, to)
+static double erle_db(size_t from, size_t to) {
+  return 10 * log10(power(echo, from, to) / power(out, from, to));
+}
+
+static void playback(audio_aec_t *aec) {
+  printf("Playback through the room: %dms bulk delay, then %dms\n",
+         BULK_DELAY_MS, MOVED_DELAY_MS);
+  size_t moved = SAMPLES / 2 / BLOCK_SAMPLES * BLOCK_SAMPLES;
+  make_echo(moved);
+  for (size_t i = 0; i < SAMPLES; i++) {
+    mic[i] = clip(echo[i] + MIC_NOISE_RMS * sqrt(3) * white());
+  }
+
+  audio_aec_init(aec, RATE);
+  // Stop halfway, before the jump, to read the first lock
+  for (size_t at = 0; at < moved; at += BLOCK_SAMPLES) {
+    audio_aec_process(aec, mic + at, far + at, out + at, BLOCK_SAMPLES);
+  }
+  uint32_t first = audio_aec_delay_ms(aec, RATE);
+  double first_erle = erle_db(moved - 2 * RATE, moved);
+  float reported = aec->erle_db;
+  double start = now_s();
+  for (size_t at = moved; at < SAMPLES; at += BLOCK_SAMPLES) {
+    audio_aec_process(aec, mic + at, far + at, out + at, BLOCK_SAMPLES);
+  }
+  double ns = (now_s() - start) * 1e9 / ((SAMPLES - moved) / AUDIO_AEC_BLOCK);
+  uint32_t second = audio_aec_delay_ms(aec, RATE);
+  double second_erle = erle_db(SAMPLES - 2 * RATE, SAMPLES);
+
+  printf("  delay %u ms, ERLE %.1f dB (reported %.1f) over the last 2s\n",
+         (unsigned int)first, first_erle, reported);
+  printf("  after the jump: delay %u ms, ERLE %.1f dB; %u resets\n",
+         (unsigned int)second, second_erle, (unsigned int)aec->resets);
+  printf("  %.0f ns per %d-sample block on this host\n", ns,
+         AUDIO_AEC_BLOCK);
+  // The estimate keeps up to one block of headroom below the true delay,
+  // and rounds to blocks
+  uint32_t slack = 2 * AUDIO_AEC_BLOCK * 1000 / RATE;
+  check(first <= BULK_DELAY_MS && first + slack >= BULK_DELAY_MS,
+        "bulk delay locks onto the playback delay");
+  char what[64];
+  snprintf(what, sizeof(what), "echo cancelled by more than %.0f dB",
+           MIN_ERLE_DB);
+  check(first_erle > MIN_ERLE_DB, what);
+  check(fabs(reported - first_erle) < 3, "reported ERLE matches");
+  check(second <= MOVED_DELAY_MS && second + slack >= MOVED_DELAY_MS,
+        "a jump in the playback delay is followed");
+  check(second_erle > MIN_ERLE_DB, "and the echo cancelled again");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  int count = argc - 1;
+  wav_t *wavs = calloc(count, sizeof(wav_t));
+  audio_aec_t *aec = malloc(sizeof(audio_aec_t));
+  if (!wavs || !aec) {
+    printf("out of memory\n");
+    return 1;
+  }
+  for (int i = 0; i < count; i++) {
+    if (wav_load(argv[i + 1], &wavs[i]) != 0 || wavs[i].rate != RATE) {
+      printf("%s: needs %d Hz\n", argv[i + 1], RATE);
+      return 1;
+    }
+  }
+  room_init();
+  loop_fixtures(far, wavs, count);
+
+  playback(aec);
+
+  for (int i = 0; i < count; i++) {
+    wav_free(&wavs[i]);
+  }
+  free(wavs);
+  free(aec);
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,200 @@
+// Checks how fast the AGC (audio_agc.h) settles on the voice-agent WAV
+// fixtures, looped and played at the levels of a quiet and a loud talker.
+// Starting from unity gain, it has to bring the active speech level to the
+// uplink's -20dBFS target within the times below (the attack is 50ms, the
+// release 800ms, counted only over frames above the gate), and the limiter
+// has to keep every sample under its ceiling while it does. A talker who
+// gets louder mid-sentence is followed at attack speed, and the gain has
+// to hold through a pause instead of pumping the room noise up.
+//
+//   agc_test FIXTURE.wav...
+//
+// dsp_bench has the cycle count (stage.agc).
+
+#include "audio_agc.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATE 16000
+#define BLOCK_SAMPLES 512 // One capture block
+#define TARGET_DBFS -20.0 // AGC_TARGET_DBFS in the firmware
+#define SECONDS 8
+#define SAMPLES (SECONDS * RATE)
+#define QUIET_DBFS -40.0
+#define LOUD_DBFS -16.0
+#define ROOM_DBFS -65.0
+#define SETTLED_DB 3.0 // Gain within this of its average at the end
+#define MAX_RISE_S 3.0 // Quiet talker: the release brings the gain up
+#define MAX_FALL_S 0.3 // Loud talker: the attack brings it down
+// The envelope rises on syllables at the attack rate and falls between
+// them at the release rate, so it sits above the speech level and the
+// speech lands a few dB under the target
+#define MAX_LEVEL_ERROR_DB 4.0
+#define MAX_PAUSE_DRIFT_DB 1.0
+
+static double speech[SAMPLES]; // The fixtures looped, RMS at 0 dBFS
+static int16_t in[SAMPLES], out[SAMPLES];
+static double gain_db[SAMPLES / BLOCK_SAMPLES];
+
+static void loop_fixtures(const wav_t *wavs, int count) {
+  size_t at = 0;
+  double sum = 0;
+  for (int i = 0; at < SAMPLES; i = (i + 1) % count) {
+    for (size_t n = 0; n < wavs[i].frames && at < SAMPLES; n++) {
+      speech[at] = wavs[i].samples[n];
+      sum += speech[at] * speech[at];
+      at++;
+    }
+  }
+  double scale = 32768.0 / sqrt(sum / SAMPLES);
+  for (size_t i = 0; i < SAMPLES; i++) {
+    speech[i] *= scale;
+  }
+}
+
+// The talker at `dbfs` RMS, switching to `later_dbfs` at `change`, over
+// room noise
+static void talker(double dbfs, double later_dbfs, size_t change) {
+  for (size_t i = 0; i < SAMPLES; i++) {
+    double level = pow(10, (i < change ? dbfs : later_dbfs) / 20);
+    in[i] = clip(speech[i] * level +
+                 32768 * pow(10, ROOM_DBFS / 20) * sqrt(3) * white());
+  }
+}
+
+// Runs the AGC from unity gain, recording its gain after every block
+static void run(audio_agc_t *agc, size_t from, size_t to) {
+  for (size_t at = from; at < to; at += BLOCK_SAMPLES) {
+    audio_agc_process_s16(agc, in + at, out + at, BLOCK_SAMPLES);
+    gain_db[at / BLOCK_SAMPLES] = 20 * log10(agc->gain);
+  }
+}
+
+// Seconds from block `from` until the gain first comes within SETTLED_DB
+// of its average over the last two seconds before block `to`. It keeps
+// moving by a few dB after that: the envelope follows the syllables.
+static double settle_s(size_t from, size_t to, double *settled) {
+  size_t tail = 2 * RATE / BLOCK_SAMPLES;
+  *settled = 0;
+  for (size_t b = to - tail; b < to; b++) {
+    *settled += gain_db[b] / tail;
+  }
+  size_t b = from;
+  while (b < to && fabs(gain_db[b] - *settled) > SETTLED_DB) {
+    b++;
+  }
+  return (double)(b - from) * BLOCK_SAMPLES / RATE;
+}
+
+// Active speech level of the output over [from, to): the RMS of the 10ms
+// frames within 30dB of the target, so the pauses do not count
+static double speech_dbfs(size_t from, size_t to) {
+  const size_t frame = RATE / 100;
+  double sum = 0;
+  size_t frames = 0;
+  for (size_t f = from; f + frame <= to; f += frame) {
+    double energy = 0;
+    for (size_t i = f; i < f + frame; i++) {
+      energy += (double)out[i] * out[i];
+    }
+    double db = 10 * log10(energy / frame / (32768.0 * 32768.0) + 1e-12);
+    if (db > TARGET_DBFS - 30) {
+      sum += energy / frame;
+      frames++;
+    }
+  }
+  return 10 * log10(sum / (frames ? frames : 1) / (32768.0 * 32768.0));
+}
+
+static int16_t peak(size_t from, size_t to) {
+  int16_t max = 0;
+  for (size_t i = from; i < to; i++) {
+    int16_t m = out[i] == INT16_MIN ? INT16_MAX : (int16_t)abs(out[i]);
+    max = m > max ? m : max;
+  }
+  return max;
+}
+
+static void settle(audio_agc_t *agc, const char *name, double dbfs,
+                   double max_s) {
+  talker(dbfs, dbfs, SAMPLES);
+  audio_agc_init(agc, RATE, TARGET_DBFS);
+  run(agc, 0, SAMPLES);
+  size_t blocks = SAMPLES / BLOCK_SAMPLES;
+  double settled;
+  double seconds = settle_s(0, blocks, &settled);
+  double level = speech_dbfs(SAMPLES - 2 * RATE, SAMPLES);
+  printf("  %s talker at %.0f dBFS: gain %+.1f dB after %.2f s, speech at "
+         "%.1f dBFS, peak %d\n",
+         name, dbfs, settled, seconds, level, peak(0, SAMPLES));
+  char what[64];
+  snprintf(what, sizeof(what), "%s talker settled within %.1f s", name,
+           max_s);
+  check(seconds <= max_s, what);
+  snprintf(what, sizeof(what), "%s talker brought to the target", name);
+  check(fabs(level - TARGET_DBFS) < MAX_LEVEL_ERROR_DB, what);
+  snprintf(what, sizeof(what), "%s talker never over the ceiling", name);
+  check(peak(0, SAMPLES) <= agc->ceiling + 1, what);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  int count = argc - 1;
+  wav_t *wavs = calloc(count, sizeof(wav_t));
+  if (!wavs) {
+    printf("out of memory\n");
+    return 1;
+  }
+  for (int i = 0; i < count; i++) {
+    if (wav_load(argv[i + 1], &wavs[i]) != 0) {
+      return 1;
+    }
+  }
+  loop_fixtures(wavs, count);
+
+  audio_agc_t agc;
+  printf("From unity gain\n");
+  settle(&agc, "quiet", QUIET_DBFS, MAX_RISE_S);
+  settle(&agc, "loud", LOUD_DBFS, MAX_FALL_S);
+
+  printf("Level change\n");
+  size_t change = SAMPLES / 2 / BLOCK_SAMPLES * BLOCK_SAMPLES;
+  talker(QUIET_DBFS, LOUD_DBFS, change);
+  audio_agc_init(&agc, RATE, TARGET_DBFS);
+  run(&agc, 0, SAMPLES);
+  size_t blocks = SAMPLES / BLOCK_SAMPLES;
+  double settled;
+  double seconds = settle_s(change / BLOCK_SAMPLES, blocks, &settled);
+  printf("  %.0f -> %.0f dBFS: gain %+.1f dB after %.2f s, peak %d\n",
+         QUIET_DBFS, LOUD_DBFS, settled, seconds, peak(change, SAMPLES));
+  check(seconds <= MAX_FALL_S, "followed at attack speed");
+  check(peak(change, SAMPLES) <= agc.ceiling + 1,
+        "the limiter catches the onset at the quiet gain");
+
+  printf("Pause\n");
+  talker(QUIET_DBFS, -200, change);
+  audio_agc_init(&agc, RATE, TARGET_DBFS);
+  run(&agc, 0, SAMPLES);
+  double drift = gain_db[blocks - 1] - gain_db[change / BLOCK_SAMPLES - 1];
+  printf("  %.0f s of room noise at %.0f dBFS: gain moved %+.2f dB\n",
+         (double)(SAMPLES - change) / RATE, ROOM_DBFS, drift);
+  check(fabs(drift) < MAX_PAUSE_DRIFT_DB, "gain held through the pause");
+
+  for (int i = 0; i < count; i++) {
+    wav_free(&wavs[i]);
+  }
+  free(wavs);
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
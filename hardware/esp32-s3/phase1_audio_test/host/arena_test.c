@@ -0,0 +1,129 @@
+// Checks audio_arena: arenas sized exactly from the request list, requested
+// alignments, zeroed buffers that do not overlap, argument checks, and
+// the modules that run over arena storage instead of allocating.
+//
+//   arena_test
+
+#include "audio_arena.h"
+#include "audio_history.h"
+#include "audio_jitter.h"
+#include "esp_heap_caps.h"
+#include "test_util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool aligned(const void *p, size_t align) {
+  return ((uintptr_t)p & (align - 1)) == 0;
+}
+
+static bool all_zero(const void *p, size_t bytes) {
+  const uint8_t *b = p;
+  for (size_t i = 0; i < bytes; i++) {
+    if (b[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(void) {
+  printf("Layout\n");
+  uint8_t *a = NULL, *b = NULL, *c = NULL, *d = NULL, *e = NULL;
+  const audio_arena_request_t requests[] = {
+      {(void **)&a, 3, 0, AUDIO_ARENA_INTERNAL},
+      {(void **)&b, 100, 16, AUDIO_ARENA_INTERNAL},
+      {(void **)&c, 5, 0, AUDIO_ARENA_INTERNAL},
+      {(void **)&d, 256, 64, AUDIO_ARENA_DMA},
+      {(void **)&e, 1000, 0, AUDIO_ARENA_PSRAM},
+  };
+  check(audio_arena_init(requests, 5) == ESP_OK, "init");
+  const audio_arena_t *internal = audio_arena_get(AUDIO_ARENA_INTERNAL);
+  // 3, padded to 16, +100 = 116, padded to 120, +5
+  check(internal->size == 125 && internal->buffers == 3,
+        "internal arena sized exactly from its requests");
+  check(audio_arena_get(AUDIO_ARENA_DMA)->size == 256 &&
+            audio_arena_get(AUDIO_ARENA_PSRAM)->size == 1000,
+        "one arena per kind of memory");
+  check(a == internal->base && b == internal->base + 16 &&
+            c == internal->base + 120,
+        "buffers carved in order");
+  check(aligned(internal->base, AUDIO_ARENA_MAX_ALIGN) && aligned(b, 16) &&
+            aligned(c, AUDIO_ARENA_ALIGN) && aligned(d, 64),
+        "requested alignments");
+  check(all_zero(a, 3) && all_zero(b, 100) && all_zero(d, 256) &&
+            all_zero(e, 1000),
+        "buffers start zeroed");
+  memset(a, 0xAA, 3);
+  memset(c, 0xCC, 5);
+  bool apart = true;
+  for (size_t i = 0; i < 100; i++) {
+    apart = apart && b[i] == 0;
+  }
+  check(apart, "neighbours do not overlap");
+  check((audio_arena_get(AUDIO_ARENA_PSRAM)->caps & MALLOC_CAP_SPIRAM) != 0,
+        "psram arena reports its heap");
+
+  printf("Lifetime\n");
+  uint8_t *again = NULL;
+  audio_arena_request_t more = {(void **)&again, 8, 0, AUDIO_ARENA_INTERNAL};
+  check(audio_arena_init(&more, 1) == ESP_ERR_INVALID_STATE && !again,
+        "second init refused while reserved");
+  audio_arena_free();
+  check(!audio_arena_get(AUDIO_ARENA_INTERNAL)->base &&
+            audio_arena_get(AUDIO_ARENA_INTERNAL)->size == 0,
+        "free returns every arena");
+  more.align = 3;
+  check(audio_arena_init(&more, 1) == ESP_ERR_INVALID_ARG && !again,
+        "alignment that is not a power of two refused");
+  more.align = 2 * AUDIO_ARENA_MAX_ALIGN;
+  check(audio_arena_init(&more, 1) == ESP_ERR_INVALID_ARG,
+        "alignment above a cache line refused");
+  more.align = 0;
+  more.arena = AUDIO_ARENA_COUNT;
+  check(audio_arena_init(&more, 1) == ESP_ERR_INVALID_ARG,
+        "unknown arena refused");
+  more.arena = AUDIO_ARENA_DMA;
+  check(audio_arena_init(&more, 1) == ESP_OK && again &&
+            !audio_arena_get(AUDIO_ARENA_INTERNAL)->base,
+        "reinit after free, unused arenas stay empty");
+  audio_arena_free();
+
+  printf("Modules over arena storage\n");
+  int16_t *history_storage = NULL;
+  void *jitter_storage = NULL;
+  const audio_arena_request_t storage[] = {
+      {(void **)&history_storage, 16000 * sizeof(int16_t), 0,
+       AUDIO_ARENA_PSRAM},
+      {&jitter_storage, 8192, AUDIO_RING_CACHE_LINE, AUDIO_ARENA_INTERNAL},
+  };
+  check(audio_arena_init(storage, 2) == ESP_OK, "init");
+  audio_history_t history;
+  check(audio_history_init_storage(&history, history_storage, 16000) ==
+                ESP_OK &&
+            history.buffer == history_storage && history.caps == 0,
+        "history uses the arena, caps 0");
+  int16_t block[320] = {1, 2, 3};
+  audio_history_write(&history, block, 320);
+  audio_history_free(&history);
+  check(history_storage[0] == 1 && history_storage[2] == 3,
+        "history free leaves arena storage alone");
+
+  audio_jitter_t jb;
+  check(audio_jitter_init_storage(&jb, 16000, jitter_storage, 8192) ==
+                ESP_OK &&
+            jb.ring.buffer == jitter_storage && jb.ring.caps == 0,
+        "jitter buffer uses the arena, caps 0");
+  check(audio_jitter_init_storage(&jb, 16000, jitter_storage, 8000) != ESP_OK,
+        "jitter buffer capacity must be a power of two");
+  audio_jitter_free(&jb);
+  audio_arena_free();
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
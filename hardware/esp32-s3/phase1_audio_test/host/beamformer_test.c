@@ -0,0 +1,205 @@
+// Checks the delay-and-sum beamformer (audio_beamformer.h) on synthetic
+// two-microphone mixtures: a band-limited talker reaching the right mic a
+// known fraction of a sample after the left, plus noise that is
+// independent at each mic. The filters are linear, so the talker and the
+// noise go through separately and the SNR before and after is exact. Two
+// mics aligned on the talker gain 3dB; each steering mode has to get close
+// on its own direction, and adaptive mode has to find the delay. Then
+// full-scale input, which the accumulator has to hold without wrapping.
+//
+//   beamformer_test
+//
+// dsp_bench has the cycle count (stage.beam).
+
+#include "audio_beamformer.h"
+#include "test_util.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATE 16000
+#define SPACING_MM 50 // MIC_SPACING_MM in the firmware
+#define SECONDS 2
+#define SAMPLES (SECONDS * RATE)
+#define BLOCK 512
+#define TONES 24         // The talker: 150Hz to 3.8kHz, random phases
+#define TALKER_RMS 3000  // -21 dBFS
+#define NOISE_RMS 1000   // -30 dBFS at each mic
+#define MIN_GAIN_DB 2.5  // Of the ideal 3
+#define MAX_DELAY_ERROR 0.1
+#define SETTLE (SAMPLES / 2) // SNR measured over the second half
+
+static double freq[TONES], phase[TONES], amp;
+
+static void talker_init(void) {
+  for (int k = 0; k < TONES; k++) {
+    freq[k] = 150 + k * (3800.0 - 150) / (TONES - 1);
+    phase[k] = M_PI * white();
+  }
+  amp = TALKER_RMS * sqrt(2.0 / TONES);
+}
+
+// The talker at time `t` samples; a sum of tones delays exactly
+static double talker(double t) {
+  double x = 0;
+  for (int k = 0; k < TONES; k++) {
+    x += amp * sin(2 * M_PI * freq[k] * t / RATE + phase[k]);
+  }
+  return x;
+}
+
+static int16_t talker_stereo[2 * SAMPLES], noise_stereo[2 * SAMPLES];
+static int16_t out[SAMPLES];
+
+// Right channel `delay` samples behind the left: a talker that far toward
+// the left mic
+static void mixture(double delay) {
+  for (size_t i = 0; i < SAMPLES; i++) {
+    talker_stereo[2 * i] = (int16_t)lrint(talker(i));
+    talker_stereo[2 * i + 1] = (int16_t)lrint(talker(i - delay));
+    noise_stereo[2 * i] = (int16_t)lrint(NOISE_RMS * sqrt(3) * white());
+    noise_stereo[2 * i + 1] = (int16_t)lrint(NOISE_RMS * sqrt(3) * white());
+  }
+}
+
+static double power(const int16_t *x, size_t n, size_t stride) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += (double)x[i * stride] * x[i * stride];
+  }
+  return sum / n;
+}
+
+static void run(audio_beamformer_t *bf, const int16_t *stereo) {
+  for (size_t at = 0; at < SAMPLES; at += BLOCK) {
+    audio_beamformer_process(bf, stereo + 2 * at, out + at, BLOCK);
+  }
+}
+
+// SNR gain over one mic. The talker runs first so adaptive mode steers
+// on it, then the noise goes through filters frozen where it ended up.
+static double snr_gain(audio_beamformer_t *bf) {
+  double in_snr = power(talker_stereo, SAMPLES, 2) /
+                  power(noise_stereo, SAMPLES, 2);
+  run(bf, talker_stereo);
+  double talker_out = power(out + SETTLE, SAMPLES - SETTLE, 1);
+  audio_beam_mode_t mode = bf->mode;
+  bf->mode = AUDIO_BEAM_BROADSIDE; // Keeps the filters, stops adapting
+  run(bf, noise_stereo);
+  bf->mode = mode;
+  double noise_out = power(out + SETTLE, SAMPLES - SETTLE, 1);
+  return 10 * log10(talker_out / noise_out / in_snr);
+}
+
+static void steer(const char *name, audio_beam_mode_t mode, double delay) {
+  audio_beamformer_t bf;
+  audio_beamformer_init(&bf, RATE, SPACING_MM);
+  audio_beamformer_set_mode(&bf, mode);
+  mixture(delay);
+  double gain = snr_gain(&bf);
+  printf("  %s, talker %.2f samples off: SNR %+.2f dB, steered to %.2f "
+         "(%.0f degrees)\n",
+         audio_beamformer_mode_name(mode), delay, gain, bf.delay,
+         audio_beamformer_angle(&bf));
+  char what[64];
+  snprintf(what, sizeof(what), "%s gains more than %.1f dB", name,
+           MIN_GAIN_DB);
+  check(gain > MIN_GAIN_DB, what);
+}
+
+// Each output sample against the sum worked out in 64 bits
+static bool matches_wide(const audio_beamformer_t *bf, const int16_t *stereo,
+                         size_t frames) {
+  bool ok = true;
+  for (size_t i = AUDIO_BEAM_TAPS; i < frames; i++) {
+    int64_t acc = 1 << 15;
+    for (int n = 0; n < AUDIO_BEAM_TAPS; n++) {
+      acc += (int64_t)bf->taps_left[n] * stereo[2 * (i - n)] +
+             (int64_t)bf->taps_right[n] * stereo[2 * (i - n) + 1];
+    }
+    acc >>= 16;
+    acc = acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc;
+    ok = ok && out[i] == acc;
+  }
+  return ok;
+}
+
+static void full_scale(void) {
+  printf("Full scale\n");
+  audio_beamformer_t bf;
+  audio_beamformer_init(&bf, RATE, SPACING_MM);
+  audio_beamformer_set_mode(&bf, AUDIO_BEAM_ENDFIRE);
+  // Every tap's sample at full scale with the tap's sign: the largest sum
+  // the filters can make, well past 32 bits
+  int64_t peak = 0;
+  for (int n = 0; n < AUDIO_BEAM_TAPS; n++) {
+    peak += (llabs(bf.taps_left[n]) + llabs(bf.taps_right[n])) * 32767;
+  }
+  printf("  largest sum %.2f x 2^31\n", peak / 2147483648.0);
+  size_t frames = 4 * AUDIO_BEAM_TAPS;
+  for (size_t i = 0; i < frames; i++) {
+    // Sample i meets tap n at output i + n; line it up for output 2 x taps
+    int n = 2 * AUDIO_BEAM_TAPS - (int)i;
+    int16_t l = 0, r = 0;
+    if (n >= 0 && n < AUDIO_BEAM_TAPS) {
+      l = bf.taps_left[n] < 0 ? -32767 : 32767;
+      r = bf.taps_right[n] < 0 ? -32767 : 32767;
+    }
+    talker_stereo[2 * i] = l;
+    talker_stereo[2 * i + 1] = r;
+  }
+  audio_beamformer_process(&bf, talker_stereo, out, frames);
+  check(peak > INT32_MAX, "the worst case does not fit 32 bits");
+  check(out[2 * AUDIO_BEAM_TAPS] == INT16_MAX, "it saturates positive");
+  check(matches_wide(&bf, talker_stereo, frames),
+        "every output matches the 64-bit sum");
+
+  // Random full-scale samples through every mode
+  bool ok = true;
+  for (int mode = AUDIO_BEAM_BROADSIDE; mode <= AUDIO_BEAM_ADAPTIVE;
+       mode++) {
+    audio_beamformer_init(&bf, RATE, SPACING_MM);
+    audio_beamformer_set_mode(&bf, AUDIO_BEAM_ENDFIRE);
+    audio_beamformer_set_mode(&bf, mode);
+    for (size_t i = 0; i < 2 * BLOCK; i++) {
+      talker_stereo[i] = white() < 0 ? INT16_MIN : INT16_MAX;
+    }
+    audio_beamformer_process(&bf, talker_stereo, out, BLOCK);
+    ok = ok && matches_wide(&bf, talker_stereo, BLOCK);
+  }
+  check(ok, "random full scale matches in every mode");
+}
+
+int main(void) {
+  talker_init();
+  audio_beamformer_t bf;
+  audio_beamformer_init(&bf, RATE, SPACING_MM);
+  double endfire = bf.max_delay;
+  printf("SNR gain, %dmm spacing: endfire is %.2f samples\n", SPACING_MM,
+         endfire);
+  steer("broadside on a talker in front", AUDIO_BEAM_BROADSIDE, 0);
+  steer("endfire on a talker to the left", AUDIO_BEAM_ENDFIRE, endfire);
+  steer("adaptive on a talker at 30 degrees", AUDIO_BEAM_ADAPTIVE,
+        endfire / 2);
+
+  audio_beamformer_init(&bf, RATE, SPACING_MM);
+  audio_beamformer_set_mode(&bf, AUDIO_BEAM_ADAPTIVE);
+  mixture(-endfire / 2);
+  run(&bf, talker_stereo);
+  check(fabs(bf.delay + endfire / 2) < MAX_DELAY_ERROR,
+        "adaptive finds a talker at -30 degrees");
+  mixture(endfire / 2);
+  run(&bf, talker_stereo);
+  check(fabs(bf.delay - endfire / 2) < MAX_DELAY_ERROR,
+        "and follows it to +30 degrees");
+
+  full_scale();
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
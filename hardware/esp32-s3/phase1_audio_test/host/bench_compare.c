@@ -0,0 +1,147 @@
+// Compares two DSP benchmark runs (audio_bench.h), e.g. a device log from
+// before and after a change, or two host builds.
+//
+//   bench_compare [--threshold PCT] old.txt new.txt
+//
+// The "@AB1" lines are picked out of each file, so console logs work as
+// they are. Results are matched by case, placement and block size, and
+// the minimum ticks per frame are compared: one line per match with the
+// change, then a summary. Runs in different units (cycles against ns) do
+// not compare. Exits 1 if any result got slower by more than the threshold
+// (default 10%).
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_THRESHOLD_PCT 10.0
+
+typedef struct {
+  char name[64];
+  char placement[16];
+  unsigned int frames;
+  double per_frame; // Minimum ticks per frame
+  char unit[16];
+} result_t;
+
+typedef struct {
+  result_t *items;
+  size_t count;
+  size_t capacity;
+} results_t;
+
+// Returns false if the file cannot be read
+static bool load(const char *path, results_t *results) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    const char *record = strstr(line, "@AB1 ");
+    if (!record || record[5] == '#') {
+      continue;
+    }
+    result_t r;
+    unsigned int calls, min, mean, max;
+    if (sscanf(record + 5, "%63[^,],%15[^,],%u,%u,%u,%u,%u,%lf,%15s",
+               r.name, r.placement, &r.frames, &calls, &min, &mean, &max,
+               &r.per_frame, r.unit) != 9) {
+      fprintf(stderr, "%s: bad line: %s", path, record);
+      continue;
+    }
+    if (results->count == results->capacity) {
+      results->capacity = results->capacity ? 2 * results->capacity : 256;
+      results->items =
+          realloc(results->items, results->capacity * sizeof(result_t));
+      if (!results->items) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+      }
+    }
+    results->items[results->count++] = r;
+  }
+  fclose(f);
+  return true;
+}
+
+static const result_t *find(const results_t *results, const result_t *key) {
+  for (size_t i = 0; i < results->count; i++) {
+    const result_t *r = &results->items[i];
+    if (r->frames == key->frames && strcmp(r->name, key->name) == 0 &&
+        strcmp(r->placement, key->placement) == 0) {
+      return r;
+    }
+  }
+  return NULL;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [--threshold PCT] old.txt new.txt\n", name);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  double threshold = DEFAULT_THRESHOLD_PCT;
+  const char *paths[2];
+  int path_count = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+      threshold = atof(argv[++i]);
+    } else if (argv[i][0] != '-' && path_count < 2) {
+      paths[path_count++] = argv[i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (path_count != 2) {
+    usage(argv[0]);
+  }
+
+  results_t old_results = {0};
+  results_t new_results = {0};
+  if (!load(paths[0], &old_results) || !load(paths[1], &new_results)) {
+    return 2;
+  }
+
+  printf("%-30s %-9s %6s %10s %10s %8s\n", "case", "placement", "frames",
+         "old", "new", "change");
+  size_t matched = 0, slower = 0, faster = 0, unmatched = 0;
+  for (size_t i = 0; i < new_results.count; i++) {
+    const result_t *now = &new_results.items[i];
+    const result_t *before = find(&old_results, now);
+    if (!before) {
+      unmatched++;
+      continue;
+    }
+    if (strcmp(before->unit, now->unit) != 0) {
+      fprintf(stderr, "units differ: %s against %s\n", before->unit,
+              now->unit);
+      return 2;
+    }
+    matched++;
+    double change = before->per_frame > 0
+                        ? 100.0 * (now->per_frame / before->per_frame - 1.0)
+                        : 0.0;
+    const char *flag = "";
+    if (change > threshold) {
+      slower++;
+      flag = "  SLOWER";
+    } else if (change < -threshold) {
+      faster++;
+      flag = "  faster";
+    }
+    printf("%-30s %-9s %6u %10.2f %10.2f %+7.1f%%%s\n", now->name,
+           now->placement, now->frames, before->per_frame, now->per_frame,
+           change, flag);
+  }
+  printf("%zu matched, %zu slower and %zu faster by more than %.0f%%, "
+         "%zu only in %s\n",
+         matched, slower, faster, threshold, unmatched, paths[1]);
+
+  free(old_results.items);
+  free(new_results.items);
+  return slower > 0 ? 1 : 0;
+}
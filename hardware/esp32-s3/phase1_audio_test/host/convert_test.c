@@ -0,0 +1,107 @@
+// Checks the pcm16 mono uplink conversion (audio_convert.h) against the
+// voice-agent WAV fixtures: each file is played as the INMP441 would
+// deliver it, 24-bit left-aligned in 32-bit stereo slots, and must come
+// back bit for bit, at a quarter of the raw32 bandwidth. Then the rounding
+// of unequal channels, saturation and the little-endian byte layout.
+//
+//   convert_test FIXTURE.wav...
+
+#include "audio_convert.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_FRAMES 512 // One capture block
+
+// A pcm16 sample as an INMP441 slot: the 8 bits below it carry whatever
+// the 24-bit converter saw, and the low 8 bits are always zero
+static int32_t mic_slot(int16_t sample, uint32_t below) {
+  return (int32_t)((uint32_t)(uint16_t)sample << 16 | (below & 0x7f) << 8);
+}
+
+static void fixture(const char *path) {
+  wav_t wav;
+  if (wav_load(path, &wav) != 0) {
+    failures++;
+    return;
+  }
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  printf("%s: %zu frames at %u Hz\n", name, wav.frames,
+         (unsigned int)wav.rate);
+
+  int32_t slots[2 * BLOCK_FRAMES];
+  int16_t out[BLOCK_FRAMES];
+  size_t mismatches = 0, in_bytes = 0, out_bytes = 0;
+  for (size_t at = 0; at < wav.frames; at += BLOCK_FRAMES) {
+    size_t n = wav.frames - at < BLOCK_FRAMES ? wav.frames - at
+                                              : BLOCK_FRAMES;
+    for (size_t i = 0; i < n; i++) {
+      // Both mics hear the same thing, their sub-LSB bits differ
+      slots[2 * i] = mic_slot(wav.samples[at + i], rng() >> 8);
+      slots[2 * i + 1] = mic_slot(wav.samples[at + i], rng() >> 8);
+    }
+    size_t written = audio_convert_stereo32_to_mono16(slots, out, 2 * n);
+    for (size_t i = 0; i < written; i++) {
+      mismatches += out[i] != wav.samples[at + i];
+    }
+    in_bytes += 2 * n * sizeof(int32_t);
+    out_bytes += written * sizeof(int16_t);
+  }
+  check(mismatches == 0, "pcm16 comes back bit-exact");
+  double seconds = (double)wav.frames / wav.rate;
+  printf("  raw32 %.0f kbit/s, pcm16 %.0f kbit/s\n",
+         in_bytes * 8 / seconds / 1000, out_bytes * 8 / seconds / 1000);
+  check(out_bytes * 4 == in_bytes, "a quarter of the raw32 bandwidth");
+  wav_free(&wav);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  for (int i = 1; i < argc; i++) {
+    fixture(argv[i]);
+  }
+
+  printf("Unequal channels\n");
+  size_t wrong = 0;
+  for (int i = 0; i < 100000; i++) {
+    int32_t lr[2] = {(int32_t)(rng() & ~0xffu), (int32_t)(rng() & ~0xffu)};
+    int16_t out;
+    audio_convert_stereo32_to_mono16(lr, &out, 2);
+    // The mean in pcm16 units, rounded half up, computed independently
+    double expected = floor(((double)lr[0] + lr[1]) / 2 / 65536 + 0.5);
+    wrong += out != (int16_t)fmin(fmax(expected, -32768), 32767);
+  }
+  check(wrong == 0, "mean of L and R, rounded to nearest");
+
+  printf("Saturation\n");
+  int32_t loud[4] = {INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN};
+  int16_t clipped[2];
+  audio_convert_stereo32_to_mono16(loud, clipped, 4);
+  check(clipped[0] == INT16_MAX && clipped[1] == INT16_MIN,
+        "full scale clips instead of wrapping");
+  int32_t edge[2] = {0x7fff8000, 0x7fff8000}; // 32767.5
+  audio_convert_stereo32_to_mono16(edge, clipped, 2);
+  check(clipped[0] == INT16_MAX, "rounding up past full scale clips");
+
+  printf("Byte layout\n");
+  int32_t one[2] = {0x12340000, 0x12340000};
+  int16_t word;
+  audio_convert_stereo32_to_mono16(one, &word, 2);
+  uint8_t bytes[2];
+  memcpy(bytes, &word, 2);
+  check(bytes[0] == 0x34 && bytes[1] == 0x12, "little-endian on the wire");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
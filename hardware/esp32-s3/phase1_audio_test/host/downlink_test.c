@@ -0,0 +1,481 @@
+// Feeds server downlink frames through audio_downlink the way the
+// esp_websocket_client delivers them and checks the speaker-rate output.
+//
+//   downlink_test                     synthetic frames, pass/fail checks
+//   downlink_test frames.bin [rate]   recorded frames, pcm16 at `rate`
+//   downlink_test --dump frames.bin   write the synthetic frames
+//
+// A frames file is the binary messages the server sent, in order, each as
+// a little-endian uint32 byte count followed by the payload; the default
+// rate is 24000, OpenAI Realtime pcm16. Every message is delivered whole,
+// in 1024-byte receive buffers as the client posts them, and split into
+// continuation frames and odd-sized, misaligned reads; all three must give
+// the same samples. Synthetic frames are tones, so the output can also be
+// checked against a sine fit for level, noise and aliasing.
+
+#include "audio_downlink.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OUT_RATE 16000 // SAMPLE_RATE
+#define SERVER_RATE 24000
+#define CLIENT_BUFFER 1024 // esp_websocket_client default rx buffer
+#define MAX_MESSAGES 4096
+#define TONE_SECONDS 2
+#define SETTLE 64 // Output samples skipped while the filter fills
+#define MIN_SNR_DB 60.0
+#define MIN_ALIAS_REJECTION_DB 50.0
+
+typedef struct {
+  uint8_t *data; // All messages back to back
+  size_t *lengths;
+  size_t count;
+  size_t bytes;
+} frames_t;
+
+typedef struct {
+  int16_t *pcm;
+  size_t len;
+  size_t capacity;
+  const uint8_t *in_place_lo; // Sinks passed pointers into this range
+  const uint8_t *in_place_hi;
+  size_t in_place;
+} capture_t;
+
+typedef enum {
+  DELIVER_WHOLE = 0,  // One event per message
+  DELIVER_CLIENT,     // CLIENT_BUFFER-sized events
+  DELIVER_FRAGMENTED, // Continuation frames, odd reads, odd addresses
+} delivery_t;
+
+static const char *const delivery_names[] = {"whole", "client", "fragmented"};
+
+// Deterministic so runs compare
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+  rng_state = rng_state * 1664525u + 1013904223u;
+  return rng_state >> 8;
+}
+
+static void capture_sink(const int16_t *pcm, size_t samples, void *ctx) {
+  capture_t *cap = ctx;
+  if ((const uint8_t *)pcm >= cap->in_place_lo &&
+      (const uint8_t *)pcm < cap->in_place_hi) {
+    cap->in_place += samples;
+  }
+  if (cap->len + samples > cap->capacity) {
+    cap->capacity = (cap->len + samples) * 2;
+    cap->pcm = realloc(cap->pcm, cap->capacity * sizeof(int16_t));
+  }
+  memcpy(&cap->pcm[cap->len], pcm, samples * sizeof(int16_t));
+  cap->len += samples;
+}
+
+static void add_message(frames_t *frames, const uint8_t *data, size_t len) {
+  if (frames->count == MAX_MESSAGES) {
+    return;
+  }
+  frames->data = realloc(frames->data, frames->bytes + len);
+  memcpy(&frames->data[frames->bytes], data, len);
+  frames->lengths[frames->count++] = len;
+  frames->bytes += len;
+}
+
+// pcm16 at SERVER_RATE cut into messages of the sizes Realtime audio
+// deltas come in, 50-200ms
+static void make_tone_frames(frames_t *frames, double freq, double dbfs) {
+  const size_t samples = SERVER_RATE * TONE_SECONDS;
+  const double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+  int16_t *pcm = malloc(samples * sizeof(int16_t));
+  for (size_t i = 0; i < samples; i++) {
+    pcm[i] = (int16_t)lrint(amplitude *
+                            sin(2.0 * M_PI * freq * i / SERVER_RATE));
+  }
+  rng_state = 1;
+  frames->count = 0;
+  frames->bytes = 0;
+  for (size_t done = 0; done < samples;) {
+    size_t n = SERVER_RATE / 20 + rng() % (SERVER_RATE * 3 / 20);
+    if (n > samples - done) {
+      n = samples - done;
+    }
+    add_message(frames, (const uint8_t *)&pcm[done], n * sizeof(int16_t));
+    done += n;
+  }
+  free(pcm);
+}
+
+static bool load_frames(frames_t *frames, const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  frames->count = 0;
+  frames->bytes = 0;
+  uint8_t header[4];
+  while (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+    size_t len = header[0] | header[1] << 8 | header[2] << 16 |
+                 (size_t)header[3] << 24;
+    uint8_t *message = malloc(len ? len : 1);
+    if (fread(message, 1, len, f) != len) {
+      fprintf(stderr, "%s: truncated message\n", path);
+      free(message);
+      fclose(f);
+      return false;
+    }
+    add_message(frames, message, len);
+    free(message);
+  }
+  fclose(f);
+  return frames->count > 0;
+}
+
+static bool dump_frames(const frames_t *frames, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  const uint8_t *message = frames->data;
+  for (size_t i = 0; i < frames->count; i++) {
+    size_t len = frames->lengths[i];
+    uint8_t header[4] = {len & 0xff, (len >> 8) & 0xff, (len >> 16) & 0xff,
+                         (len >> 24) & 0xff};
+    fwrite(header, 1, sizeof(header), f);
+    fwrite(message, 1, len, f);
+    message += len;
+  }
+  return fclose(f) == 0;
+}
+
+// Post `len` bytes of one frame as data events of at most `read` bytes
+// (or random odd sizes when read == 0), optionally skipping event `skip`
+static void post_frame(audio_downlink_t *dl, capture_t *cap,
+                       const uint8_t *frame, size_t len, bool first,
+                       bool fin, size_t read, bool misalign, int *skip) {
+  size_t offset = 0;
+  do {
+    size_t n = read ? read : 1 + 2 * (rng() % (CLIENT_BUFFER / 2));
+    if (n > len - offset) {
+      n = len - offset;
+    }
+    // The client reads into its own buffer, which is where data_ptr
+    // points; shift it by a byte to exercise the unaligned path
+    uint8_t *buffer = malloc(n + 1);
+    uint8_t *data = misalign ? buffer + 1 : buffer;
+    memcpy(data, frame + offset, n);
+    cap->in_place_lo = data;
+    cap->in_place_hi = data + n;
+    audio_downlink_fragment_t fragment = {data, n, offset, len, first, fin};
+    if (*skip != 0) {
+      audio_downlink_feed(dl, &fragment, capture_sink, cap);
+    }
+    (*skip)--;
+    free(buffer);
+    offset += n;
+  } while (offset < len);
+}
+
+// Run every message through the decoder. `skip` drops that data event
+// (counting from 0), -1 drops none.
+static void deliver(const frames_t *frames, audio_downlink_t *dl,
+                    capture_t *cap, delivery_t mode, int skip) {
+  rng_state = 7;
+  const uint8_t *message = frames->data;
+  for (size_t i = 0; i < frames->count; i++) {
+    size_t len = frames->lengths[i];
+    switch (mode) {
+    case DELIVER_WHOLE:
+      post_frame(dl, cap, message, len, true, true, len ? len : 1, false,
+                 &skip);
+      break;
+    case DELIVER_CLIENT:
+      post_frame(dl, cap, message, len, true, true, CLIENT_BUFFER, false,
+                 &skip);
+      break;
+    case DELIVER_FRAGMENTED: {
+      // Up to three frames, cut at odd byte counts
+      size_t cut1 = len ? (rng() % len) | 1 : 0;
+      size_t cut2 = cut1 + (len > cut1 ? rng() % (len - cut1) : 0);
+      if (cut1 > len) {
+        cut1 = cut2 = len;
+      }
+      post_frame(dl, cap, message, cut1, true, false, 0, i & 1, &skip);
+      post_frame(dl, cap, message + cut1, cut2 - cut1, false, false, 0,
+                 !(i & 1), &skip);
+      post_frame(dl, cap, message + cut2, len - cut2, false, true, 0, i & 1,
+                 &skip);
+      break;
+    }
+    }
+    message += len;
+  }
+}
+
+// Least-squares fit of a sine at `freq` plus DC. Returns the fitted
+// amplitude and sets *snr_db to fitted power over residual power.
+static double fit_sine(const int16_t *pcm, size_t n, double freq,
+                       double rate, double *snr_db) {
+  double m[3][3] = {{0}};
+  double v[3] = {0};
+  for (size_t i = 0; i < n; i++) {
+    double basis[3] = {sin(2.0 * M_PI * freq * i / rate),
+                       cos(2.0 * M_PI * freq * i / rate), 1.0};
+    for (int r = 0; r < 3; r++) {
+      v[r] += basis[r] * pcm[i];
+      for (int c = 0; c < 3; c++) {
+        m[r][c] += basis[r] * basis[c];
+      }
+    }
+  }
+  // Gaussian elimination, the matrix is well conditioned
+  for (int p = 0; p < 3; p++) {
+    for (int r = p + 1; r < 3; r++) {
+      double f = m[r][p] / m[p][p];
+      for (int c = p; c < 3; c++) {
+        m[r][c] -= f * m[p][c];
+      }
+      v[r] -= f * v[p];
+    }
+  }
+  double x[3];
+  for (int r = 2; r >= 0; r--) {
+    x[r] = v[r];
+    for (int c = r + 1; c < 3; c++) {
+      x[r] -= m[r][c] * x[c];
+    }
+    x[r] /= m[r][r];
+  }
+
+  double signal = 0.0;
+  double noise = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    double fit = x[0] * sin(2.0 * M_PI * freq * i / rate) +
+                 x[1] * cos(2.0 * M_PI * freq * i / rate) + x[2];
+    signal += fit * fit;
+    noise += (pcm[i] - fit) * (pcm[i] - fit);
+  }
+  *snr_db = 10.0 * log10(signal / (noise > 0.0 ? noise : 1e-9));
+  return hypot(x[0], x[1]);
+}
+
+static double rms(const int16_t *pcm, size_t n) {
+  double sum = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    sum += (double)pcm[i] * pcm[i];
+  }
+  return n ? sqrt(sum / n) : 0.0;
+}
+
+static double db(double x) { return 20.0 * log10(x > 0.0 ? x : 1e-9); }
+
+// Decode `frames` with each delivery; all must match the whole-message
+// output. Leaves that output in `whole`.
+static int check_deliveries(const frames_t *frames,
+                            audio_downlink_format_t format, uint32_t rate,
+                            capture_t *whole) {
+  static audio_downlink_t dl;
+  int failures = 0;
+  for (int mode = DELIVER_WHOLE; mode <= DELIVER_FRAGMENTED; mode++) {
+    capture_t cap = {0};
+    if (audio_downlink_init(&dl, format, rate, OUT_RATE) != ESP_OK) {
+      printf("  %s at %uHz not supported\n", audio_downlink_format_name(format),
+             (unsigned int)rate);
+      return 1;
+    }
+    deliver(frames, &dl, &cap, (delivery_t)mode, -1);
+    bool same = mode == DELIVER_WHOLE ||
+                (cap.len == whole->len &&
+                 memcmp(cap.pcm, whole->pcm, cap.len * sizeof(int16_t)) == 0);
+    printf("  %-10s %6u fragments %7u samples, %7u in place%s\n",
+           delivery_names[mode], (unsigned int)dl.stats.fragments,
+           (unsigned int)cap.len, (unsigned int)cap.in_place,
+           same ? "" : "  MISMATCH");
+    if (!same || dl.stats.lost || dl.stats.truncated) {
+      failures++;
+    }
+    if (mode == DELIVER_WHOLE) {
+      *whole = cap;
+    } else {
+      free(cap.pcm);
+    }
+  }
+  return failures;
+}
+
+static int run_recorded(const char *path, uint32_t rate) {
+  static size_t lengths[MAX_MESSAGES];
+  frames_t frames = {NULL, lengths, 0, 0};
+  if (!load_frames(&frames, path)) {
+    return 1;
+  }
+  printf("%s: %zu messages, %zu bytes, pcm16 at %uHz\n", path, frames.count,
+         frames.bytes, (unsigned int)rate);
+  capture_t out = {0};
+  int failures = check_deliveries(&frames, AUDIO_DOWNLINK_PCM16, rate, &out);
+
+  size_t in_samples = frames.bytes / 2;
+  double expected = (double)in_samples * OUT_RATE / rate;
+  double in_rms = rms((const int16_t *)frames.data, in_samples);
+  double out_rms = rms(out.pcm, out.len);
+  printf("  %zu -> %zu samples (expect %.0f), level %.1f -> %.1fdBFS\n",
+         in_samples, out.len, expected, db(in_rms / 32768.0),
+         db(out_rms / 32768.0));
+  if (fabs(out.len - expected) > 2.0) {
+    failures++;
+  }
+  free(out.pcm);
+  free(frames.data);
+  return failures;
+}
+
+int main(int argc, char **argv) {
+  static size_t lengths[MAX_MESSAGES];
+  frames_t frames = {NULL, lengths, 0, 0};
+
+  if (argc == 3 && strcmp(argv[1], "--dump") == 0) {
+    make_tone_frames(&frames, 997.0, -6.0);
+    return dump_frames(&frames, argv[2]) ? 0 : 1;
+  }
+  if (argc > 1) {
+    uint32_t rate = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10)
+                             : SERVER_RATE;
+    return run_recorded(argv[1], rate) ? 1 : 0;
+  }
+
+  int failures = 0;
+  // Flat through the speech band, rolling off towards the filter's
+  // cutoff at 90% of the output Nyquist
+  static const struct {
+    double freq;
+    double max_level_error_db;
+  } tones[] = {{250.0, 0.1}, {997.0, 0.1}, {3000.0, 0.1}, {6000.0, 1.5}};
+  for (size_t f = 0; f < sizeof(tones) / sizeof(tones[0]); f++) {
+    double freq = tones[f].freq;
+    make_tone_frames(&frames, freq, -6.0);
+    printf("%.0fHz at -6dBFS, pcm16 24kHz, %zu messages\n", freq,
+           frames.count);
+    capture_t out = {0};
+    failures += check_deliveries(&frames, AUDIO_DOWNLINK_PCM16, SERVER_RATE,
+                                 &out);
+    double snr;
+    double amplitude = fit_sine(out.pcm + SETTLE, out.len - SETTLE, freq,
+                                OUT_RATE, &snr);
+    double level_error = db(amplitude / (32767.0 * pow(10.0, -6.0 / 20.0)));
+    size_t expected = frames.bytes / 2 * OUT_RATE / SERVER_RATE;
+    printf("  %zu samples (expect %zu), level %+.3fdB, SNR %.1fdB\n",
+           out.len, expected, level_error, snr);
+    if (out.len + 1 < expected || out.len > expected + 1 ||
+        fabs(level_error) > tones[f].max_level_error_db || snr < MIN_SNR_DB) {
+      failures++;
+    }
+    free(out.pcm);
+  }
+
+  // Above the output Nyquist: 10kHz would fold to 6kHz
+  {
+    make_tone_frames(&frames, 10000.0, -6.0);
+    static audio_downlink_t dl;
+    capture_t out = {0};
+    audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM16, SERVER_RATE, OUT_RATE);
+    deliver(&frames, &dl, &out, DELIVER_CLIENT, -1);
+    double rejection = db(rms((const int16_t *)frames.data, frames.bytes / 2) /
+                          rms(out.pcm + SETTLE, out.len - SETTLE));
+    printf("10000Hz alias rejection: %.1fdB\n", rejection);
+    if (rejection < MIN_ALIAS_REJECTION_DB) {
+      failures++;
+    }
+    free(out.pcm);
+  }
+
+  // A lost read mid-message: the rest of it still decodes on the sample
+  // grid, so the output stays a clean tone instead of byte-swapped noise
+  {
+    make_tone_frames(&frames, 997.0, -6.0);
+    static audio_downlink_t dl;
+    capture_t out = {0};
+    audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM16, SERVER_RATE, OUT_RATE);
+    deliver(&frames, &dl, &out, DELIVER_FRAGMENTED, 5);
+    int16_t peak = 0;
+    for (size_t i = 0; i < out.len; i++) {
+      int16_t a = (int16_t)abs(out.pcm[i]);
+      peak = a > peak ? a : peak;
+    }
+    printf("Lost fragment: lost=%u truncated=%u, peak %.1fdBFS\n",
+           (unsigned int)dl.stats.lost, (unsigned int)dl.stats.truncated,
+           db(peak / 32768.0));
+    if (dl.stats.lost == 0 || dl.stats.truncated || db(peak / 32768.0) > -5.0) {
+      failures++;
+    }
+    free(out.pcm);
+  }
+
+  // Speaker-rate pcm16 is passed through without a copy
+  {
+    make_tone_frames(&frames, 997.0, -6.0);
+    static audio_downlink_t dl;
+    capture_t out = {0};
+    audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM16, OUT_RATE, OUT_RATE);
+    deliver(&frames, &dl, &out, DELIVER_CLIENT, -1);
+    bool exact = out.len == frames.bytes / 2 &&
+                 memcmp(out.pcm, frames.data, frames.bytes) == 0;
+    printf("pcm16 16kHz passthrough: %s, %zu of %zu samples in place\n",
+           exact ? "exact" : "MISMATCH", out.in_place, out.len);
+    if (!exact || out.in_place != out.len) {
+      failures++;
+    }
+    free(out.pcm);
+  }
+
+  // 8-bit duty bytes, the old downlink format
+  {
+    uint8_t duty[256];
+    for (int i = 0; i < 256; i++) {
+      duty[i] = (uint8_t)i;
+    }
+    static size_t pcm8_lengths[1] = {sizeof(duty)};
+    frames_t pcm8 = {duty, pcm8_lengths, 1, sizeof(duty)};
+    static audio_downlink_t dl;
+    capture_t out = {0};
+    audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM8, OUT_RATE, OUT_RATE);
+    deliver(&pcm8, &dl, &out, DELIVER_FRAGMENTED, -1);
+    bool exact = out.len == sizeof(duty);
+    for (size_t i = 0; exact && i < out.len; i++) {
+      exact = out.pcm[i] == (int16_t)((duty[i] - 128) * 256);
+    }
+    printf("pcm8 16kHz: %s\n", exact ? "exact" : "MISMATCH");
+    failures += !exact;
+    free(out.pcm);
+  }
+
+  // Rates the resampler cannot do are refused and leave the decoder as is
+  {
+    static audio_downlink_t dl;
+    audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM16, SERVER_RATE, OUT_RATE);
+    esp_err_t cd = audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM16, 22050,
+                                       OUT_RATE);
+    esp_err_t low = audio_downlink_init(&dl, AUDIO_DOWNLINK_PCM16, 6000,
+                                        OUT_RATE);
+    bool kept = dl.in_rate == SERVER_RATE && dl.resampler.in_rate ==
+                                                 SERVER_RATE;
+    printf("22050Hz: %s, 6000Hz: %s, previous rate %s\n",
+           cd == ESP_ERR_NOT_SUPPORTED ? "not supported" : "ACCEPTED",
+           low == ESP_ERR_INVALID_ARG ? "invalid" : "ACCEPTED",
+           kept ? "kept" : "LOST");
+    if (cd != ESP_ERR_NOT_SUPPORTED || low != ESP_ERR_INVALID_ARG || !kept) {
+      failures++;
+    }
+  }
+
+  free(frames.data);
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+// Runs the DSP microbenchmark (main/audio_bench.c) on the host: every
+// kernel, stage and chain over block sizes 64..4096 frames, as @AB1 lines
+// on stdout. The device prints the same lines for the "bench" text
+// command; bench_compare diffs any two runs.
+//
+//   dsp_bench [--filter NAME] [--min FRAMES] [--max FRAMES]
+//             [--budget FRAMES] [--quick]
+//
+// --quick times each point a few times only, to check every case runs.
+
+#include "audio_bench.h"
+#include "audio_kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUICK_BUDGET 256
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [--filter NAME] [--min FRAMES] [--max FRAMES]\n"
+          "          [--budget FRAMES] [--quick]\n",
+          name);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  audio_bench_config_t config = AUDIO_BENCH_CONFIG_DEFAULT;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      config.filter = argv[++i];
+    } else if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+      config.min_frames = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+      config.max_frames = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      config.budget_frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      config.budget_frames = QUICK_BUDGET;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (config.min_frames == 0 || config.max_frames < config.min_frames) {
+    usage(argv[0]);
+  }
+
+  audio_kernels_init();
+  esp_err_t err = audio_bench_run(&config, stdout);
+  if (err != ESP_OK) {
+    fprintf(stderr, "audio_bench_run failed: %d\n", err);
+    return 1;
+  }
+  return 0;
+}
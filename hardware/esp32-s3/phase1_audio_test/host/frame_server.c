@@ -0,0 +1,293 @@
+// Stand-in for the voice-agent server that speaks the audio_frame
+// protocol: turns framing on, keeps the device clock offset from "sync"
+// probes, and reports uplink loss, jitter and one-way latency.
+//
+//   frame_server [--port N] [--tone HZ | --echo [--delay MS]] [--bare]
+//
+// Point WEBSOCKET_URI at this host (any path). With --tone, a framed pcm16
+// sine at 24kHz is streamed back in 20ms messages so the downlink counters
+// on the device's "Downlink frames:" log line have something to count.
+//
+// --echo returns every uplink message after --delay ms, standing in for the
+// model's response time, then starts a "latency test" on the device. The
+// echo keeps the uplink header, capture time and marker flag included,
+// and is followed by "marker:<us held>" for the frame carrying the chirp,
+// so the device can split its round trip into network and server time.
+// --bare leaves framing off: the device then only has the chirp to go by.
+
+#include "audio_frame.h"
+#include "ws_server.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_PORT 3000
+#define SYNC_INTERVAL_US 1000000
+#define REPORT_INTERVAL_US 5000000
+#define TONE_RATE 24000
+#define TONE_FRAME_US 20000
+#define TONE_SAMPLES (TONE_RATE * TONE_FRAME_US / 1000000)
+#define MAX_MESSAGE 65536
+#define ECHO_SLOTS 256   // Messages held at once, ~8s of 32ms blocks
+#define ECHO_BYTES 4200  // Largest uplink message: header + raw32 block
+#define ECHO_CHIRPS "20" // Chirps per latency test
+
+static int64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+  audio_frame_rx_t rx;
+  audio_frame_clock_t clock;
+  audio_frame_header_t last;
+  uint32_t bare;  // Binary messages without a header
+  uint64_t bytes; // Payload
+  uint32_t speech_starts, speech_ends;
+  uint32_t downlink_sequence;
+  double tone_phase;
+  // Echo delay line, oldest at echo_tail
+  struct {
+    int64_t due_us;
+    int64_t arrival_us;
+    size_t len;
+    uint8_t data[ECHO_BYTES];
+  } echo[ECHO_SLOTS];
+  size_t echo_head, echo_tail;
+  uint32_t echo_dropped;
+} session_t;
+
+static void report(const session_t *s) {
+  const audio_frame_rx_t *rx = &s->rx;
+  printf("uplink %s %u Hz x%u: frames=%u lost=%u late=%u catchup=%u "
+         "gaps=%u bare=%u jitter=%uus speech=%u/%u echo drops=%u\n",
+         audio_frame_codec_name(s->last.codec),
+         (unsigned int)s->last.sample_rate, (unsigned int)s->last.channels,
+         (unsigned int)rx->received, (unsigned int)rx->lost,
+         (unsigned int)rx->late, (unsigned int)rx->catchup,
+         (unsigned int)rx->discontinuities, (unsigned int)s->bare,
+         (unsigned int)rx->jitter_us, (unsigned int)s->speech_starts,
+         (unsigned int)s->speech_ends, (unsigned int)s->echo_dropped);
+  if (s->clock.valid) {
+    printf("  capture->server us: n=%u p50=%u p99=%u max=%u "
+           "(clock offset %" PRId64 "us, probe rtt %uus)\n",
+           (unsigned int)rx->latency.count,
+           (unsigned int)audio_latency_percentile(&rx->latency, 500),
+           (unsigned int)audio_latency_percentile(&rx->latency, 990),
+           (unsigned int)rx->latency.max_us, s->clock.offset_us,
+           (unsigned int)s->clock.rtt_us);
+  }
+  fflush(stdout);
+}
+
+static void handle_text(session_t *s, const char *text, int64_t arrival) {
+  long long t1, device;
+  if (sscanf(text, "sync:%lld,%lld", &t1, &device) == 2) {
+    audio_frame_clock_update(&s->clock, t1, device, arrival);
+    return;
+  }
+  printf("text: %s\n", text);
+}
+
+static void queue_echo(session_t *s, const uint8_t *data, size_t len,
+                       int64_t arrival, int delay_ms) {
+  if (s->echo_head - s->echo_tail == ECHO_SLOTS || len > ECHO_BYTES) {
+    s->echo_dropped++;
+    return;
+  }
+  size_t slot = s->echo_head++ % ECHO_SLOTS;
+  s->echo[slot].due_us = arrival + (int64_t)delay_ms * 1000;
+  s->echo[slot].arrival_us = arrival;
+  s->echo[slot].len = len;
+  memcpy(s->echo[slot].data, data, len);
+}
+
+// Return every held message that is due. Framed ones keep their header but
+// take this direction's sequence numbers; bare ones go back as they came.
+static void send_echoes(ws_server_t *ws, session_t *s, int64_t now) {
+  while (s->echo_tail != s->echo_head) {
+    size_t slot = s->echo_tail % ECHO_SLOTS;
+    if (s->echo[slot].due_us > now) {
+      break;
+    }
+    s->echo_tail++;
+    uint8_t *data = s->echo[slot].data;
+    audio_frame_header_t h;
+    size_t header_len;
+    bool framed = audio_frame_decode(data, s->echo[slot].len, &h,
+                                     &header_len) == ESP_OK;
+    if (framed) {
+      h.sequence = s->downlink_sequence++;
+      audio_frame_encode(&h, data);
+    }
+    ws_server_send(ws, WS_BINARY, data, s->echo[slot].len);
+    if (framed && (h.flags & AUDIO_FRAME_FLAG_MARKER)) {
+      char held[32];
+      int n = snprintf(held, sizeof(held), "marker:%" PRId64,
+                       now_us() - s->echo[slot].arrival_us);
+      ws_server_send(ws, WS_TEXT, held, (size_t)n);
+    }
+  }
+}
+
+static void handle_binary(session_t *s, const uint8_t *data, size_t len,
+                          int64_t arrival) {
+  audio_frame_header_t h;
+  size_t header_len;
+  if (audio_frame_decode(data, len, &h, &header_len) != ESP_OK) {
+    s->bare++;
+    return;
+  }
+  audio_frame_rx_update(&s->rx, &h, arrival, &s->clock);
+  s->last = h;
+  s->bytes += len - header_len;
+  if (h.flags & AUDIO_FRAME_FLAG_SPEECH_START) {
+    s->speech_starts++;
+    printf("speech start, frame %u\n", (unsigned int)h.sequence);
+  }
+  if (h.flags & AUDIO_FRAME_FLAG_SPEECH_END) {
+    s->speech_ends++;
+    printf("speech end, frame %u\n", (unsigned int)h.sequence);
+  }
+}
+
+static int send_tone(ws_server_t *ws, session_t *s, double hz) {
+  uint8_t message[AUDIO_FRAME_HEADER_BYTES + TONE_SAMPLES * 2];
+  audio_frame_header_t h = {
+      .codec = AUDIO_FRAME_CODEC_PCM16,
+      .channels = 1,
+      .sequence = s->downlink_sequence++,
+      .sample_rate = TONE_RATE,
+      .capture_us = (uint64_t)now_us(),
+  };
+  audio_frame_encode(&h, message);
+  for (int i = 0; i < TONE_SAMPLES; i++) {
+    int16_t v = (int16_t)(8000 * sin(s->tone_phase));
+    s->tone_phase += 2 * M_PI * hz / TONE_RATE;
+    message[AUDIO_FRAME_HEADER_BYTES + 2 * i] = (uint8_t)v;
+    message[AUDIO_FRAME_HEADER_BYTES + 2 * i + 1] = (uint8_t)(v >> 8);
+  }
+  s->tone_phase = fmod(s->tone_phase, 2 * M_PI);
+  return ws_server_send(ws, WS_BINARY, message, sizeof(message));
+}
+
+typedef struct {
+  double tone_hz; // 0 for none
+  bool echo;
+  int delay_ms;
+  bool bare;
+} options_t;
+
+static void serve(ws_server_t *ws, const options_t *opt) {
+  static uint8_t message[MAX_MESSAGE + 1];
+  static session_t s;
+  memset(&s, 0, sizeof(s));
+  audio_frame_rx_reset(&s.rx);
+
+  const char *command = opt->bare ? "frames off" : "frames on";
+  ws_server_send(ws, WS_TEXT, command, strlen(command));
+  if (opt->echo) {
+    command = "latency test " ECHO_CHIRPS;
+    ws_server_send(ws, WS_TEXT, command, strlen(command));
+  }
+  double tone_hz = opt->tone_hz;
+  int64_t next_sync = now_us();
+  int64_t next_report = next_sync + REPORT_INTERVAL_US;
+  int64_t next_tone = next_sync;
+
+  while (1) {
+    int64_t now = now_us();
+    if (now >= next_sync) {
+      char probe[32];
+      int n = snprintf(probe, sizeof(probe), "sync %" PRId64, now);
+      ws_server_send(ws, WS_TEXT, probe, (size_t)n);
+      next_sync += SYNC_INTERVAL_US;
+    }
+    if (now >= next_report) {
+      report(&s);
+      next_report += REPORT_INTERVAL_US;
+    }
+    if (tone_hz > 0 && now >= next_tone) {
+      send_tone(ws, &s, tone_hz);
+      next_tone += TONE_FRAME_US;
+    }
+    send_echoes(ws, &s, now);
+
+    int64_t wake = next_sync < next_report ? next_sync : next_report;
+    if (tone_hz > 0 && next_tone < wake) {
+      wake = next_tone;
+    }
+    if (s.echo_tail != s.echo_head &&
+        s.echo[s.echo_tail % ECHO_SLOTS].due_us < wake) {
+      wake = s.echo[s.echo_tail % ECHO_SLOTS].due_us;
+    }
+    int timeout_ms = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+    size_t len;
+    int opcode = ws_server_recv(ws, message, MAX_MESSAGE, &len, timeout_ms);
+    int64_t arrival = now_us();
+    if (opcode < 0) {
+      break;
+    }
+    if (len > MAX_MESSAGE) {
+      len = MAX_MESSAGE;
+    }
+    if (opcode == WS_TEXT) {
+      message[len] = '\0';
+      handle_text(&s, (const char *)message, arrival);
+    } else if (opcode == WS_BINARY) {
+      handle_binary(&s, message, len, arrival);
+      if (opt->echo) {
+        queue_echo(&s, message, len, arrival, opt->delay_ms);
+      }
+    }
+  }
+  report(&s);
+}
+
+int main(int argc, char **argv) {
+  int port = DEFAULT_PORT;
+  options_t opt = {0};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--tone") == 0 && i + 1 < argc) {
+      opt.tone_hz = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--echo") == 0) {
+      opt.echo = true;
+    } else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+      opt.delay_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--bare") == 0) {
+      opt.bare = true;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--port N] [--tone HZ | --echo [--delay MS]] "
+              "[--bare]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (opt.echo && opt.tone_hz > 0) {
+    fprintf(stderr, "--tone and --echo both use the downlink\n");
+    return 2;
+  }
+
+  ws_server_t ws;
+  if (ws_server_listen(&ws, (uint16_t)port) < 0) {
+    perror("listen");
+    return 1;
+  }
+  printf("Listening on port %d\n", port);
+  while (1) {
+    if (ws_server_accept(&ws) < 0) {
+      continue;
+    }
+    printf("Device connected\n");
+    serve(&ws, &opt);
+    printf("Device disconnected\n");
+  }
+}
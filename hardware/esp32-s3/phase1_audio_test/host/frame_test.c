@@ -0,0 +1,148 @@
+// Checks audio_frame: the header byte layout, decode errors, loss and
+// reordering accounting, interarrival jitter and the clock offset that
+// turns capture timestamps into one-way latency.
+//
+//   frame_test
+
+#include "audio_frame.h"
+#include "test_util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static audio_frame_header_t frame(uint32_t sequence, uint64_t capture_us) {
+  audio_frame_header_t h = {
+      .codec = AUDIO_FRAME_CODEC_PCM16,
+      .channels = 1,
+      .sequence = sequence,
+      .sample_rate = 24000,
+      .capture_us = capture_us,
+  };
+  return h;
+}
+
+int main(void) {
+  uint8_t buf[64];
+  audio_frame_header_t h, out;
+  size_t header_len = 0;
+
+  printf("Header\n");
+  h = frame(0x01020304, 0x1122334455667788ull);
+  h.codec = AUDIO_FRAME_CODEC_OPUS;
+  h.flags = AUDIO_FRAME_FLAG_SPEECH_START | AUDIO_FRAME_FLAG_CATCHUP;
+  audio_frame_encode(&h, buf);
+  static const uint8_t expected[AUDIO_FRAME_HEADER_BYTES] = {
+      'A',  'F',  1,    24,   4,    0x05, 1,    0,    0x04, 0x03, 0x02, 0x01,
+      0xc0, 0x5d, 0x00, 0x00, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11};
+  check(memcmp(buf, expected, sizeof(expected)) == 0,
+        "little-endian layout as documented");
+  check(audio_frame_decode(buf, AUDIO_FRAME_HEADER_BYTES, &out,
+                           &header_len) == ESP_OK &&
+            header_len == AUDIO_FRAME_HEADER_BYTES && out.version == 1 &&
+            out.codec == h.codec && out.flags == h.flags &&
+            out.channels == 1 && out.sequence == h.sequence &&
+            out.sample_rate == 24000 && out.capture_us == h.capture_us,
+        "decodes what it encoded");
+  check(strcmp(audio_frame_codec_name(out.codec), "opus") == 0,
+        "codec name");
+
+  // A later version may append fields: readers skip to header_len
+  buf[3] = 32;
+  check(audio_frame_decode(buf, 32, &out, &header_len) == ESP_OK &&
+            header_len == 32,
+        "longer header is skipped, not rejected");
+  check(audio_frame_decode(buf, 28, &out, &header_len) ==
+            ESP_ERR_INVALID_SIZE,
+        "message shorter than its header");
+  buf[3] = 16;
+  check(audio_frame_decode(buf, 32, &out, &header_len) == ESP_ERR_INVALID_ARG,
+        "header_len below the version 1 size");
+  buf[3] = 24;
+  buf[2] = 2;
+  check(audio_frame_decode(buf, 32, &out, &header_len) ==
+            ESP_ERR_NOT_SUPPORTED,
+        "unknown version");
+  check(audio_frame_decode((const uint8_t *)"\x01\x02\x03\x04....", 8, &out,
+                           &header_len) == ESP_ERR_INVALID_ARG,
+        "bare pcm is not mistaken for a frame");
+
+  printf("Sequence\n");
+  audio_frame_rx_t rx;
+  audio_frame_rx_reset(&rx);
+  uint32_t order[] = {100, 101, 103, 104, 102, 105, 108};
+  for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+    h = frame(order[i], order[i] * 20000);
+    audio_frame_rx_update(&rx, &h, order[i] * 20000 + 5000, NULL);
+  }
+  check(rx.received == 7 && rx.late == 1 && rx.lost == 2 &&
+            rx.next_sequence == 109,
+        "gap of 2 lost, late 102 taken back off the loss");
+  audio_frame_rx_reset(&rx);
+  h = frame(UINT32_MAX, 0);
+  audio_frame_rx_update(&rx, &h, 0, NULL);
+  h = frame(0, 20000);
+  audio_frame_rx_update(&rx, &h, 20000, NULL);
+  check(rx.lost == 0 && rx.late == 0, "sequence wraps without a gap");
+
+  printf("Jitter\n");
+  audio_frame_rx_reset(&rx);
+  for (uint32_t i = 0; i < 400; i++) {
+    h = frame(i, i * 20000ull);
+    audio_frame_rx_update(&rx, &h, i * 20000 + 7000, NULL);
+  }
+  check(rx.jitter_us == 0, "0 for a constant transit time");
+  audio_frame_rx_reset(&rx);
+  for (uint32_t i = 0; i < 400; i++) {
+    h = frame(i, i * 20000ull);
+    audio_frame_rx_update(&rx, &h, i * 20000 + 7000 + (i & 1) * 4000, NULL);
+  }
+  // Every transit differs from the last by 4ms: J converges on 4000
+  check(rx.jitter_us > 3900 && rx.jitter_us <= 4000,
+        "converges on the transit difference");
+  uint32_t jitter = rx.jitter_us;
+  h = frame(400, 0); // Hours old: from the backlog
+  h.flags = AUDIO_FRAME_FLAG_CATCHUP;
+  audio_frame_rx_update(&rx, &h, 400 * 20000 + 7000, NULL);
+  h = frame(401, 401 * 20000ull);
+  audio_frame_rx_update(&rx, &h, 401 * 20000 + 7000, NULL);
+  check(rx.catchup == 1 && rx.jitter_us == jitter,
+        "catch-up frames stay out of the jitter");
+
+  printf("Clock\n");
+  audio_frame_clock_t clock = {0};
+  // Device clock runs 5s behind ours; 30ms round trip, symmetric
+  const int64_t behind = 5000000;
+  audio_frame_clock_update(&clock, 1000000, 1015000 - behind, 1030000);
+  check(clock.valid && clock.offset_us == -behind && clock.rtt_us == 30000,
+        "offset from a symmetric probe");
+  // A slow probe with the delay all on one leg does not displace it
+  audio_frame_clock_update(&clock, 2000000, 2090000 - behind, 2100000);
+  check(clock.offset_us == -behind, "shortest round trip wins");
+  for (int i = 0; i < AUDIO_FRAME_CLOCK_PROBES; i++) {
+    int64_t t1 = 3000000 + i * 1000000;
+    audio_frame_clock_update(&clock, t1, t1 + 50000 - behind - 1000,
+                             t1 + 100000);
+  }
+  check(clock.rtt_us == 100000 && clock.offset_us == -behind - 1000,
+        "best probe expires so drift is followed");
+  check(clock.age < AUDIO_FRAME_CLOCK_PROBES, "age restarts on replacement");
+
+  audio_frame_rx_reset(&rx);
+  clock = (audio_frame_clock_t){.valid = true, .offset_us = -behind};
+  for (uint32_t i = 0; i < 100; i++) {
+    uint64_t captured = 10000000 + i * 20000ull; // Device clock
+    h = frame(i, captured);
+    // 25ms after capture, on our clock
+    audio_frame_rx_update(&rx, &h, (int64_t)captured + behind + 25000,
+                          &clock);
+  }
+  check(rx.latency.count == 100 && rx.latency.max_us == 25000,
+        "one-way latency on the receiver's clock");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
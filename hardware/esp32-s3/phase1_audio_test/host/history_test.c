@@ -0,0 +1,171 @@
+// Checks audio_history as the sender task drives it: triggers rewind into
+// the past, catch-up runs at (1 + CATCHUP_BLOCKS)x real time, and what
+// reaches the server is one gap-free, duplicate-free run per stream.
+//
+//   history_test
+//
+// Each written sample carries its own absolute position (mod 2^16), so the
+// sent stream can be checked sample by sample.
+
+#include "audio_history.h"
+#include "esp_heap_caps.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define BLOCK 512 // Samples per capture block, 32ms
+#define HISTORY_SECONDS 10
+#define CATCHUP_BLOCKS 3
+#define SEND_CHUNK 512 // AUDIO_BUFFER_SIZE / 2
+
+typedef struct {
+  audio_history_t history;
+  uint64_t written;
+  uint64_t expected; // Position the next sent sample must have
+  bool have_expected;
+  uint32_t sent;
+  uint32_t errors;
+} sim_t;
+
+static void write_block(sim_t *sim) {
+  int16_t block[BLOCK];
+  for (int i = 0; i < BLOCK; i++) {
+    block[i] = (int16_t)(uint16_t)(sim->written + i);
+  }
+  audio_history_write(&sim->history, block, BLOCK);
+  sim->written += BLOCK;
+}
+
+// The sender's send_history(): at most `budget` samples up to `until`
+static void send(sim_t *sim, uint64_t until, size_t budget) {
+  audio_history_t *h = &sim->history;
+  while (budget > 0 && h->cursor < until) {
+    size_t max = budget < SEND_CHUNK ? budget : SEND_CHUNK;
+    if (max > until - h->cursor) {
+      max = (size_t)(until - h->cursor);
+    }
+    const int16_t *region;
+    size_t n = audio_history_peek(h, max, &region);
+    if (!sim->have_expected) {
+      sim->expected = h->cursor;
+      sim->have_expected = true;
+    }
+    for (size_t i = 0; i < n; i++) {
+      if ((uint16_t)region[i] != (uint16_t)(sim->expected + i)) {
+        sim->errors++;
+      }
+    }
+    sim->expected += n;
+    sim->sent += n;
+    audio_history_release(h, n);
+    budget -= n;
+  }
+}
+
+static void sim_init(sim_t *sim) {
+  memset(sim, 0, sizeof(*sim));
+  if (audio_history_init(&sim->history, HISTORY_SECONDS * SAMPLE_RATE,
+                         MALLOC_CAP_SPIRAM) != ESP_OK) {
+    fprintf(stderr, "history allocation failed\n");
+    exit(1);
+  }
+}
+
+int main(void) {
+  sim_t sim;
+
+  printf("Trigger with 1500ms of pre-roll after 5s idle\n");
+  sim_init(&sim);
+  for (int i = 0; i < 5 * SAMPLE_RATE / BLOCK; i++) {
+    write_block(&sim);
+    audio_history_skip(&sim.history);
+  }
+  write_block(&sim);
+  size_t backlog =
+      audio_history_rewind(&sim.history, SAMPLE_RATE * 1500 / 1000 + BLOCK);
+  check(backlog == SAMPLE_RATE * 1500 / 1000 + BLOCK,
+        "cursor 1500ms before the triggering block");
+  uint64_t start = sim.history.cursor;
+  int blocks = 0;
+  do {
+    if (blocks > 0) {
+      write_block(&sim);
+    }
+    send(&sim, sim.history.head, BLOCK * (1 + CATCHUP_BLOCKS));
+    blocks++;
+  } while (audio_history_backlog(&sim.history) > 0 && blocks < 1000);
+  printf("  caught up after %d blocks (%dms)\n", blocks,
+         blocks * BLOCK * 1000 / SAMPLE_RATE);
+  // The first send takes the trigger block and CATCHUP_BLOCKS of backlog,
+  // each later one nets CATCHUP_BLOCKS
+  const int net = CATCHUP_BLOCKS * BLOCK;
+  int expected_blocks =
+      1 + ((int)backlog - (1 + CATCHUP_BLOCKS) * BLOCK + net - 1) / net;
+  check(blocks == expected_blocks,
+        "backlog shrinks by CATCHUP_BLOCKS blocks per block");
+  for (int i = 0; i < 20; i++) {
+    write_block(&sim);
+    send(&sim, sim.history.head, BLOCK * (1 + CATCHUP_BLOCKS));
+  }
+  check(audio_history_backlog(&sim.history) == 0, "then follows live audio");
+  check(sim.errors == 0 && sim.sent == sim.history.head - start,
+        "sent stream is contiguous");
+
+  printf("Stream closes mid catch-up, a new trigger overlaps it\n");
+  uint64_t end = sim.history.head;
+  write_block(&sim);
+  audio_history_rewind(&sim.history, 3 * SAMPLE_RATE);
+  check(sim.history.cursor == end,
+        "rewind stops at what the server already has");
+  audio_history_skip(&sim.history);
+  for (int i = 0; i < 4; i++) {
+    write_block(&sim);
+    audio_history_skip(&sim.history);
+  }
+  sim.have_expected = false;
+  audio_history_rewind(&sim.history, 2 * BLOCK);
+  uint64_t close_at = sim.history.head;
+  write_block(&sim);
+  send(&sim, close_at, BLOCK * (1 + CATCHUP_BLOCKS));
+  check(sim.history.cursor == close_at && sim.errors == 0,
+        "backlog drains to the close position, nothing after it");
+
+  printf("Throttle trickle blocks stay contiguous with the pre-roll\n");
+  audio_history_skip(&sim.history);
+  write_block(&sim);
+  audio_history_rewind(&sim.history, BLOCK); // Trickle: this block only
+  uint64_t trickle_end = sim.history.head;
+  send(&sim, sim.history.head, BLOCK);
+  write_block(&sim);
+  audio_history_skip(&sim.history);
+  write_block(&sim);
+  size_t preroll = audio_history_rewind(&sim.history, 300 * 16 + BLOCK);
+  check(sim.history.cursor == trickle_end && preroll == 2 * BLOCK,
+        "pre-roll starts right after the trickled block");
+
+  printf("Sender stalls for longer than the history\n");
+  audio_history_free(&sim.history);
+  sim_init(&sim);
+  sim.have_expected = false;
+  for (int i = 0; i < 12 * SAMPLE_RATE / BLOCK; i++) {
+    write_block(&sim);
+  }
+  check(sim.history.overwritten ==
+            sim.written - HISTORY_SECONDS * SAMPLE_RATE,
+        "overwritten counts the audio that never went out");
+  check(audio_history_backlog(&sim.history) == HISTORY_SECONDS * SAMPLE_RATE,
+        "cursor moved to the oldest sample still stored");
+  send(&sim, sim.history.head, HISTORY_SECONDS * SAMPLE_RATE);
+  check(sim.errors == 0 && sim.sent == HISTORY_SECONDS * SAMPLE_RATE,
+        "which reads out across the wrap without a gap");
+
+  audio_history_free(&sim.history);
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
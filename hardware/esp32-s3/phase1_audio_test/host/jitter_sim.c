@@ -0,0 +1,333 @@
+// Replays downlink arrival traces through audio_jitter and reports the
+// latency vs underrun trade-off of fixed and adaptive target depths.
+//
+//   jitter_sim                    built-in scenarios
+//   jitter_sim trace.txt ...      recorded traces
+//   jitter_sim --dump <scenario>  print a built-in scenario as a trace
+//
+// A trace is one received message per line, "<arrival ms> <samples>" at
+// 16kHz, in arrival order; '#' starts a comment. The playback side is
+// modelled as in the firmware: the I2S clock drains four 128-sample DMA
+// buffers and the playback task refills them one at a time.
+
+#include "audio_jitter.h"
+#include "esp_heap_caps.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define JITTER_BYTES 32768 // PLAYBACK_JITTER_BYTES
+#define OUTPUT_SAMPLES 512 // PLAYBACK_DMA_BUFFERS x PLAYBACK_CHUNK
+#define CHUNK 128          // PLAYBACK_CHUNK
+#define LEAD_MS ((OUTPUT_SAMPLES - CHUNK) * 1000 / SAMPLE_RATE)
+#define STEP_US 1000
+#define TAIL_MS 2000 // Run on after the last arrival so everything plays
+#define MAX_PACKETS 100000
+
+typedef struct {
+  int64_t arrival_us;
+  uint32_t samples;
+} packet_t;
+
+typedef struct {
+  packet_t *packets;
+  size_t count;
+} trace_t;
+
+typedef struct {
+  const char *name;
+  bool adaptive;
+  bool stretch;
+  uint32_t target_ms; // Fixed target, or the adaptive minimum
+} policy_t;
+
+typedef struct {
+  double mean_ms; // Audio queued ahead of the speaker while playing
+  double p95_ms;
+  uint32_t underruns;
+  uint32_t late;
+  uint32_t gaps;      // Times the speaker ran dry mid-stream
+  uint32_t gap_ms;    // Total mid-stream silence the listener hears
+  uint32_t compressed;
+  uint32_t expanded;
+  uint32_t overrun;
+} result_t;
+
+static const policy_t policies[] = {
+    {"immediate", false, false, 0},
+    {"fixed 40", false, true, 40},
+    {"fixed 80", false, true, 80},
+    {"fixed 160", false, true, 160},
+    {"adaptive", true, true, 20},
+};
+
+// Deterministic so runs compare
+static uint32_t rng_state = 1;
+
+static double uniform(void) {
+  rng_state = rng_state * 1664525u + 1013904223u;
+  return (rng_state >> 8) / 16777216.0;
+}
+
+static double exponential(double mean) { return -mean * log(1.0 - uniform()); }
+
+static void add_packet(trace_t *trace, double arrival_ms, uint32_t samples) {
+  if (trace->count == MAX_PACKETS) {
+    return;
+  }
+  int64_t us = (int64_t)(arrival_ms * 1000.0);
+  // Messages come over one TCP connection, so never out of order
+  if (trace->count > 0 && us < trace->packets[trace->count - 1].arrival_us) {
+    us = trace->packets[trace->count - 1].arrival_us;
+  }
+  trace->packets[trace->count++] = (packet_t){us, samples};
+}
+
+// Real-time 20ms packets with exponential network delay
+static void scenario_paced(trace_t *trace, double delay_ms) {
+  for (int i = 0; i < 1500; i++) {
+    add_packet(trace, 100.0 + i * 20.0 + exponential(delay_ms), 320);
+  }
+}
+
+// Paced packets, but WiFi stops delivering for 80-300ms every few seconds
+// and then hands over the backlog at once
+static void scenario_stalls(trace_t *trace) {
+  double stall_start = 2000.0;
+  double stall_end = 0.0;
+  for (int i = 0; i < 1500; i++) {
+    double t = 100.0 + i * 20.0 + exponential(3.0);
+    if (t >= stall_start) {
+      stall_end = stall_start + 80.0 + 220.0 * uniform();
+      stall_start += 2000.0 + 3000.0 * uniform();
+    }
+    if (t < stall_end) {
+      t = stall_end;
+    }
+    add_packet(trace, t, 320);
+  }
+}
+
+// TTS replies: each 1-2s utterance is sent at twice real time in 100ms
+// messages, with a second of silence between utterances
+static void scenario_tts(trace_t *trace) {
+  double t = 100.0;
+  for (int utterance = 0; utterance < 12; utterance++) {
+    int messages = 10 + (int)(10 * uniform());
+    for (int i = 0; i < messages; i++) {
+      add_packet(trace, t + exponential(8.0), 1600);
+      t += 50.0;
+    }
+    t += messages * 50.0 + 1000.0;
+  }
+}
+
+typedef struct {
+  const char *name;
+  const char *description;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"lan", "20ms packets, 2ms mean delay"},
+    {"wifi", "20ms packets, 15ms mean delay"},
+    {"stalls", "20ms packets, 80-300ms stalls every 2-5s"},
+    {"tts", "100ms messages at 2x real time, 1s between replies"},
+};
+
+static void build_scenario(trace_t *trace, const char *name) {
+  rng_state = 1;
+  trace->count = 0;
+  if (strcmp(name, "lan") == 0) {
+    scenario_paced(trace, 2.0);
+  } else if (strcmp(name, "wifi") == 0) {
+    scenario_paced(trace, 15.0);
+  } else if (strcmp(name, "stalls") == 0) {
+    scenario_stalls(trace);
+  } else if (strcmp(name, "tts") == 0) {
+    scenario_tts(trace);
+  }
+}
+
+static bool load_trace(trace_t *trace, const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  trace->count = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    double ms;
+    unsigned int samples;
+    if (line[0] != '#' && sscanf(line, "%lf %u", &ms, &samples) == 2) {
+      add_packet(trace, ms, samples);
+    }
+  }
+  fclose(f);
+  return trace->count > 0;
+}
+
+static int compare_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static result_t simulate(const trace_t *trace, const policy_t *policy) {
+  static int16_t silence[SAMPLE_RATE];
+  static int16_t chunk[CHUNK];
+  static audio_jitter_t jb;
+
+  result_t result = {0};
+  if (audio_jitter_init(&jb, SAMPLE_RATE, JITTER_BYTES, MALLOC_CAP_INTERNAL) !=
+      ESP_OK) {
+    fprintf(stderr, "jitter buffer allocation failed\n");
+    exit(1);
+  }
+  jb.output_lead_ms = LEAD_MS;
+  jb.adaptive = policy->adaptive;
+  jb.stretch = policy->stretch;
+  jb.min_target_ms = policy->target_ms;
+  if (!policy->adaptive) {
+    jb.max_target_ms = policy->target_ms;
+  }
+
+  int64_t end_us = trace->packets[trace->count - 1].arrival_us +
+                   (int64_t)TAIL_MS * 1000;
+  size_t steps = (size_t)(end_us / STEP_US) + 1;
+  uint32_t *depths = malloc(steps * sizeof(uint32_t));
+  size_t depth_count = 0;
+  double depth_sum = 0.0;
+
+  const int64_t gap_us = (int64_t)jb.stream_gap_ms * 1000;
+  size_t next = 0;
+  uint32_t queued = 0; // Samples in the DMA buffers
+  double clock = 0.0;
+  bool stream_played = false;
+  bool silent = false;
+  for (int64_t now = 0; now <= end_us; now += STEP_US) {
+    while (next < trace->count && trace->packets[next].arrival_us <= now) {
+      if (next > 0 && trace->packets[next].arrival_us -
+                              trace->packets[next - 1].arrival_us >
+                          gap_us) {
+        stream_played = false;
+      }
+      uint32_t left = trace->packets[next].samples;
+      while (left > 0) {
+        uint32_t n = left < SAMPLE_RATE ? left : SAMPLE_RATE;
+        audio_jitter_push(&jb, silence, n, now);
+        left -= n;
+      }
+      next++;
+    }
+
+    // Sample clock
+    clock += SAMPLE_RATE * (STEP_US / 1e6);
+    uint32_t ticks = (uint32_t)clock;
+    clock -= ticks;
+    bool dry = ticks > queued;
+    queued = dry ? 0 : queued - ticks;
+
+    // Playback task
+    while (OUTPUT_SAMPLES - queued >= CHUNK) {
+      size_t n = audio_jitter_pull(&jb, chunk, CHUNK, now);
+      if (n == 0) {
+        break;
+      }
+      queued += n;
+    }
+
+    if (jb.state == AUDIO_JITTER_PLAYING) {
+      uint32_t ms = (uint32_t)((audio_jitter_depth(&jb) + queued) * 1000 /
+                               SAMPLE_RATE);
+      depths[depth_count++] = ms;
+      depth_sum += ms;
+    }
+
+    // Silence between two messages of the same stream, once it has
+    // started playing, is a gap the listener hears
+    bool mid_stream = stream_played && next > 0 && next < trace->count &&
+                      trace->packets[next].arrival_us -
+                              trace->packets[next - 1].arrival_us <=
+                          gap_us;
+    if (dry && queued == 0 && mid_stream) {
+      result.gaps += !silent;
+      result.gap_ms++;
+      silent = true;
+    } else {
+      silent = false;
+    }
+    stream_played |= queued > 0;
+  }
+
+  if (depth_count > 0) {
+    qsort(depths, depth_count, sizeof(uint32_t), compare_u32);
+    result.mean_ms = depth_sum / depth_count;
+    result.p95_ms = depths[depth_count * 95 / 100];
+  }
+  free(depths);
+
+  result.underruns = jb.underruns;
+  result.late = jb.late_packets;
+  result.compressed = jb.compressed;
+  result.expanded = jb.expanded;
+  result.overrun = jb.overrun_samples;
+  audio_jitter_free(&jb);
+  return result;
+}
+
+static void report(const char *name, const char *description,
+                   const trace_t *trace) {
+  printf("\n%s: %s (%zu messages)\n", name, description, trace->count);
+  printf("  %-10s %8s %8s %6s %7s %9s %6s %6s %6s %8s\n", "policy",
+         "mean ms", "p95 ms", "gaps", "gap ms", "underruns", "late", "comp",
+         "exp", "overrun");
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    result_t r = simulate(trace, &policies[i]);
+    printf("  %-10s %8.1f %8.1f %6u %7u %9u %6u %6u %6u %8u\n",
+           policies[i].name, r.mean_ms, r.p95_ms, (unsigned int)r.gaps,
+           (unsigned int)r.gap_ms, (unsigned int)r.underruns,
+           (unsigned int)r.late, (unsigned int)r.compressed,
+           (unsigned int)r.expanded, (unsigned int)r.overrun);
+  }
+}
+
+int main(int argc, char **argv) {
+  static packet_t packets[MAX_PACKETS];
+  trace_t trace = {packets, 0};
+
+  if (argc == 3 && strcmp(argv[1], "--dump") == 0) {
+    build_scenario(&trace, argv[2]);
+    if (trace.count == 0) {
+      fprintf(stderr, "unknown scenario %s\n", argv[2]);
+      return 1;
+    }
+    printf("# %s: arrival ms, samples at %dHz\n", argv[2], SAMPLE_RATE);
+    for (size_t i = 0; i < trace.count; i++) {
+      printf("%.3f %u\n", packets[i].arrival_us / 1000.0,
+             (unsigned int)packets[i].samples);
+    }
+    return 0;
+  }
+
+  printf("Buffered audio while playing (jitter buffer + DMA buffers) and "
+         "mid-stream\ngaps heard, per target policy\n");
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      if (!load_trace(&trace, argv[i])) {
+        return 1;
+      }
+      report(argv[i], "recorded", &trace);
+    }
+    return 0;
+  }
+
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    build_scenario(&trace, scenarios[i].name);
+    report(scenarios[i].name, scenarios[i].description, &trace);
+  }
+  return 0;
+}
@@ -0,0 +1,212 @@
+// Checks audio_kernels: each dispatching kernel against its scalar
+// reference over random and full-scale input, at aligned and misaligned
+// pointers and with lengths that leave a tail, and each reference against
+// its definition worked out in wider arithmetic. Gains above unity and
+// negated full scale have to saturate, never wrap.
+//
+//   kernels_test
+//
+// The host has no PIE, so the dispatchers run the reference here; the same
+// cases run against the vector paths at boot (check_kernels).
+
+#include "audio_kernels.h"
+#include "test_util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_SAMPLES 515 // Not a multiple of the 8-sample vector step
+
+static int64_t clamp16(int64_t value) {
+  if (value > INT16_MAX)
+    return INT16_MAX;
+  if (value < INT16_MIN)
+    return INT16_MIN;
+  return value;
+}
+
+// Random samples with full scale sprinkled in, both signs
+static void fill16(int16_t *buf, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = rng();
+    if ((r & 0x700) == 0) {
+      buf[i] = INT16_MAX;
+    } else if ((r & 0x700) == 0x100) {
+      buf[i] = INT16_MIN;
+    } else {
+      buf[i] = (int16_t)(r >> 16);
+    }
+  }
+}
+
+static void fill32(int32_t *buf, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = rng();
+    if ((r & 0x700) == 0) {
+      buf[i] = INT32_MAX;
+    } else if ((r & 0x700) == 0x100) {
+      buf[i] = INT32_MIN;
+    } else {
+      buf[i] = (int32_t)r;
+    }
+  }
+}
+
+// Buffers with room to start up to 15 bytes off alignment
+static _Alignas(AUDIO_KERNEL_ALIGN) int32_t in32[MAX_SAMPLES + 8];
+static _Alignas(AUDIO_KERNEL_ALIGN) int16_t in16[2 * MAX_SAMPLES + 16];
+static _Alignas(AUDIO_KERNEL_ALIGN) int16_t out_a[2 * MAX_SAMPLES + 16];
+static _Alignas(AUDIO_KERNEL_ALIGN) int16_t out_b[2 * MAX_SAMPLES + 16];
+static _Alignas(AUDIO_KERNEL_ALIGN) int16_t out_c[MAX_SAMPLES + 16];
+static _Alignas(AUDIO_KERNEL_ALIGN) int16_t out_d[MAX_SAMPLES + 16];
+
+// Offsets in samples: aligned, and off by one, three and seven
+static const size_t offsets[] = {0, 1, 3, 7};
+static const size_t lengths[] = {1, 7, 8, 9, 64, 255, MAX_SAMPLES};
+
+#define FOR_CASES                                                           \
+  for (size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)         \
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+
+static bool narrow(void) {
+  bool ok = true;
+  static const int shifts[] = {16, 12, 8, 0};
+  for (size_t s = 0; s < sizeof(shifts) / sizeof(shifts[0]); s++) {
+    FOR_CASES {
+      size_t n = lengths[l], off = offsets[o];
+      fill32(in32 + off, n);
+      audio_kernel_narrow_s32_s16(in32 + off, out_a + off, n, shifts[s]);
+      audio_kernel_narrow_s32_s16_ref(in32 + off, out_b, n, shifts[s]);
+      ok = ok && memcmp(out_a + off, out_b, n * sizeof(int16_t)) == 0;
+      for (size_t i = 0; i < n; i++) {
+        ok = ok && out_b[i] == clamp16((int64_t)in32[off + i] >> shifts[s]);
+      }
+    }
+  }
+  return ok;
+}
+
+static bool mix(void) {
+  bool ok = true;
+  FOR_CASES {
+    size_t n = lengths[l], off = offsets[o];
+    fill16(in16 + off, 2 * n);
+    audio_kernel_mix_stereo_s16(in16 + off, out_a + off, n);
+    audio_kernel_mix_stereo_s16_ref(in16 + off, out_b, n);
+    ok = ok && memcmp(out_a + off, out_b, n * sizeof(int16_t)) == 0;
+    for (size_t i = 0; i < n; i++) {
+      // Each channel halved, rounding toward minus infinity
+      double half_l = (in16[off + 2 * i] - (in16[off + 2 * i] & 1)) / 2.0;
+      double half_r = (in16[off + 2 * i + 1] - (in16[off + 2 * i + 1] & 1)) /
+                      2.0;
+      ok = ok && out_b[i] == half_l + half_r;
+    }
+    // In place, as the capture path runs it
+    audio_kernel_mix_stereo_s16(in16 + off, in16 + off, n);
+    ok = ok && memcmp(in16 + off, out_b, n * sizeof(int16_t)) == 0;
+  }
+  return ok;
+}
+
+static bool to_u8(void) {
+  bool ok = true;
+  uint8_t *a = (uint8_t *)out_a, *b = (uint8_t *)out_b;
+  FOR_CASES {
+    size_t n = lengths[l], off = offsets[o];
+    fill16(in16 + off, n);
+    audio_kernel_s16_to_u8(in16 + off, a + off, n);
+    audio_kernel_s16_to_u8_ref(in16 + off, b, n);
+    ok = ok && memcmp(a + off, b, n) == 0;
+    for (size_t i = 0; i < n; i++) {
+      ok = ok && b[i] == (in16[off + i] + 32768) / 256;
+    }
+  }
+  return ok;
+}
+
+static bool gain(int16_t g, int shift, size_t *clipped) {
+  bool ok = true;
+  FOR_CASES {
+    size_t n = lengths[l], off = offsets[o];
+    fill16(in16 + off, n);
+    audio_kernel_gain_s16(in16 + off, out_a + off, n, g, shift);
+    audio_kernel_gain_s16_ref(in16 + off, out_b, n, g, shift);
+    ok = ok && memcmp(out_a + off, out_b, n * sizeof(int16_t)) == 0;
+    for (size_t i = 0; i < n; i++) {
+      int64_t wide = ((int64_t)in16[off + i] * g) >> shift;
+      ok = ok && out_b[i] == clamp16(wide);
+      *clipped += wide != clamp16(wide);
+    }
+  }
+  return ok;
+}
+
+static bool interleave(void) {
+  bool ok = true;
+  FOR_CASES {
+    size_t n = lengths[l], off = offsets[o];
+    fill16(in16 + off, 2 * n);
+    audio_kernel_deinterleave_s16(in16 + off, out_a + off, out_c + off, n);
+    audio_kernel_deinterleave_s16_ref(in16 + off, out_b, out_d, n);
+    ok = ok && memcmp(out_a + off, out_b, n * sizeof(int16_t)) == 0 &&
+         memcmp(out_c + off, out_d, n * sizeof(int16_t)) == 0;
+    for (size_t i = 0; i < n; i++) {
+      ok = ok && out_b[i] == in16[off + 2 * i] &&
+           out_d[i] == in16[off + 2 * i + 1];
+    }
+    audio_kernel_interleave_s16(out_b, out_d, out_a + off, n);
+    ok = ok && memcmp(out_a + off, in16 + off, 2 * n * sizeof(int16_t)) == 0;
+    audio_kernel_interleave_s16_ref(out_b, out_d, out_a, n);
+    ok = ok && memcmp(out_a, in16 + off, 2 * n * sizeof(int16_t)) == 0;
+  }
+  return ok;
+}
+
+int main(void) {
+  check(audio_kernels_init() == ESP_OK, "init");
+
+  printf("Against the references\n");
+  check(narrow(), "narrow_s32_s16, shifts 16, 12, 8 and 0");
+  check(mix(), "mix_stereo_s16, also in place");
+  check(to_u8(), "s16_to_u8");
+  check(interleave(), "deinterleave_s16 and interleave_s16 round trip");
+
+  printf("Gain\n");
+  size_t clipped = 0;
+  check(gain(23170, 15, &clipped) && clipped == 0, "-3dB never clips");
+  check(gain(INT16_MAX, 13, &clipped) && clipped > 0,
+        "x4 saturates on full-scale input");
+  clipped = 0;
+  check(gain(20000, 12, &clipped) && clipped > 0,
+        "x4.9 saturates on full-scale input");
+  clipped = 0;
+  check(gain(3, 0, &clipped) && clipped > 0, "x3 with no shift saturates");
+  clipped = 0;
+  check(gain(INT16_MIN, 15, &clipped) && clipped > 0,
+        "-1 saturates on INT16_MIN");
+  clipped = 0;
+  check(gain(-12345, 11, &clipped) && clipped > 0,
+        "negative gain above unity saturates both ways");
+  int16_t loud[2] = {INT16_MAX, INT16_MIN}, out[2];
+  audio_kernel_gain_s16(loud, out, 2, INT16_MAX, 13);
+  check(out[0] == INT16_MAX && out[1] == INT16_MIN,
+        "full scale clips to full scale, same sign");
+  audio_kernel_gain_s16(loud, out, 2, INT16_MIN, 15);
+  check(out[0] == -INT16_MAX && out[1] == INT16_MAX,
+        "negated full scale clips instead of wrapping");
+
+  printf("Levels\n");
+  uint8_t duty[5] = {128, 0, 255, 130, 127};
+  audio_u8_levels_t levels;
+  audio_kernel_u8_levels(duty, 5, &levels);
+  check(levels.avg == 128 && levels.min == 0 && levels.max == 255,
+        "mean, minimum and maximum");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Checks audio_latency: bucket edges, percentiles and the JSON the "stats"
+// frame is built from.
+//
+//   latency_test
+
+#include "audio_latency.h"
+#include "test_util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(void) {
+  audio_latency_t hist;
+
+  printf("Buckets\n");
+  bool ok = true;
+  for (int i = 0; i < AUDIO_LATENCY_BUCKETS - 1; i++) {
+    uint32_t bound = audio_latency_bucket_bound(i);
+    memset(&hist, 0, sizeof(hist));
+    audio_latency_add(&hist, bound - 1);
+    audio_latency_add(&hist, bound);
+    ok = ok && hist.buckets[i] == 1 && hist.buckets[i + 1] == 1;
+  }
+  check(ok, "each bound is the first value of the next bucket");
+  memset(&hist, 0, sizeof(hist));
+  audio_latency_add(&hist, 0);
+  audio_latency_add(&hist, UINT32_MAX);
+  check(hist.buckets[0] == 1 && hist.buckets[AUDIO_LATENCY_BUCKETS - 1] == 1 &&
+            hist.max_us == UINT32_MAX,
+        "0 and UINT32_MAX land in the end buckets");
+
+  printf("Percentiles\n");
+  memset(&hist, 0, sizeof(hist));
+  check(audio_latency_percentile(&hist, 500) == 0, "0 while empty");
+  for (int i = 0; i < 990; i++) {
+    audio_latency_add(&hist, 100); // Bucket [64, 128)
+  }
+  for (int i = 0; i < 10; i++) {
+    audio_latency_add(&hist, 5000); // Bucket [4096, 8192)
+  }
+  check(audio_latency_percentile(&hist, 500) == 128 &&
+            audio_latency_percentile(&hist, 990) == 128,
+        "p50 and p99 at the bound of the bucket holding them");
+  check(audio_latency_percentile(&hist, 999) == 5000 &&
+            audio_latency_percentile(&hist, 1000) == 5000,
+        "capped at the largest sample");
+
+  printf("JSON\n");
+  char json[512];
+  int len = audio_latency_json(&hist, "send", json, sizeof(json));
+  printf("  %s\n", json);
+  check(len == (int)strlen(json) &&
+            strncmp(json,
+                    "\"send\":{\"n\":1000,\"avg\":149,\"p50\":128,\"p99\":128,"
+                    "\"max\":5000,\"hist\":[0,990,0,0,0,0,0,10,",
+                    80) == 0 &&
+            strcmp(json + len - 2, "]}") == 0,
+        "fields and 16 bucket counts");
+  char small[16];
+  int needed = audio_latency_json(&hist, "send", small, sizeof(small));
+  check(needed == len && strlen(small) == sizeof(small) - 1,
+        "truncates like snprintf and reports the length needed");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+// Checks audio_marker, the chirp the mouth-to-ear latency test sends
+// round the loop: it is found at the right sample through the 24kHz
+// uplink and back, mixed into other audio, wherever the receive blocks
+// split it, and not found in audio that does not contain it.
+//
+//   marker_test
+
+#include "audio_marker.h"
+#include "audio_resampler.h"
+#include "test_util.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define UPLINK_RATE 24000
+#define LENGTH (SAMPLE_RATE * 2)
+#define MARKER_AT 12345
+#define BLOCK 512
+
+// Vowel-like harmonics plus white noise, and the chirp at MARKER_AT in
+// place of them, as the device injects it, or on top, as a speaker would
+static void make_signal(const audio_marker_t *marker, int16_t *out,
+                        int16_t chirp_amplitude, float noise_rms, bool mix) {
+  int16_t chirp[AUDIO_MARKER_SAMPLES];
+  audio_marker_generate(marker, chirp_amplitude, chirp);
+  srand(1);
+  for (int i = 0; i < LENGTH; i++) {
+    float t = (float)i / SAMPLE_RATE;
+    float v = 0;
+    for (int h = 1; h <= 8; h++) {
+      v += 1500.0f / h * sinf(2 * (float)M_PI * 140 * h * t);
+    }
+    // Sum of uniforms, close enough to Gaussian
+    float noise = 0;
+    for (int k = 0; k < 12; k++) {
+      noise += (float)rand() / RAND_MAX;
+    }
+    v += (noise - 6) * noise_rms;
+    if (chirp_amplitude && i >= MARKER_AT &&
+        i < MARKER_AT + AUDIO_MARKER_SAMPLES) {
+      v = mix ? v + chirp[i - MARKER_AT] : chirp[i - MARKER_AT];
+    }
+    out[i] = clip(v);
+  }
+}
+
+// Uplink at 24kHz and back down to the speaker rate, block by block like
+// the sender and audio_downlink. `delay` is the filters' delay in samples.
+static size_t round_trip(const int16_t *in, int16_t *out, int64_t *delay) {
+  static int16_t up[LENGTH * 2];
+  audio_resampler_t rs;
+  size_t up_len = 0, out_len = 0;
+  audio_resampler_init(&rs, SAMPLE_RATE, UPLINK_RATE, 0);
+  *delay = audio_resampler_delay(&rs);
+  for (size_t i = 0; i < LENGTH; i += BLOCK) {
+    up_len += audio_resampler_process(&rs, in + i, BLOCK, up + up_len);
+  }
+  audio_resampler_init(&rs, UPLINK_RATE, SAMPLE_RATE, 0);
+  *delay += audio_resampler_delay(&rs) * SAMPLE_RATE / UPLINK_RATE;
+  for (size_t i = 0; i + 480 <= up_len; i += 480) {
+    out_len += audio_resampler_process(&rs, up + i, 480, out + out_len);
+  }
+  return out_len;
+}
+
+// Feed in blocks of `block` samples; absolute start of the first marker
+// found, -1 if none
+static int64_t detect(audio_marker_t *marker, const int16_t *pcm, size_t len,
+                      size_t block, float *score) {
+  audio_marker_reset(marker);
+  for (size_t i = 0; i < len; i += block) {
+    size_t n = len - i < block ? len - i : block;
+    int64_t start;
+    if (audio_marker_feed(marker, pcm + i, n, &start, score)) {
+      return (int64_t)i + start;
+    }
+  }
+  return -1;
+}
+
+int main(void) {
+  static int16_t signal[LENGTH], received[LENGTH * 2];
+  audio_marker_t marker;
+  float score = 0;
+
+  printf("Init\n");
+  check(audio_marker_init(&marker, 6000, AUDIO_MARKER_THRESHOLD) ==
+            ESP_ERR_INVALID_ARG,
+        "rejects a rate below twice the top of the sweep");
+  audio_marker_init(&marker, SAMPLE_RATE, AUDIO_MARKER_THRESHOLD);
+
+  printf("Direct\n");
+  make_signal(&marker, signal, 8000, 300, false);
+  int64_t at = detect(&marker, signal, LENGTH, BLOCK, &score);
+  printf("  found at %lld, score %.3f\n", (long long)at, score);
+  check(at == MARKER_AT && score > 0.99f, "exact sample, correlation 1");
+  bool same = true;
+  size_t blocks[] = {1, 7, 100, 255, 256, 257, 4096};
+  for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+    same = same && detect(&marker, signal, LENGTH, blocks[i], &score) == at;
+  }
+  check(same, "same sample whatever the block size");
+
+  printf("Round trip\n");
+  int64_t delay;
+  size_t len = round_trip(signal, received, &delay);
+  at = detect(&marker, received, len, BLOCK, &score);
+  printf("  found at %lld (filter delay %lld), score %.3f\n", (long long)at,
+         (long long)delay, score);
+  check(llabs(at - MARKER_AT - delay) <= 1 && score > 0.9f,
+        "through 24kHz and back, late by the filter delay");
+
+  make_signal(&marker, signal, 6000, 300, true);
+  len = round_trip(signal, received, &delay);
+  at = detect(&marker, received, len, BLOCK, &score);
+  printf("  over speech and noise: found at %lld, score %.3f\n",
+         (long long)at, score);
+  check(llabs(at - MARKER_AT - delay) <= 1,
+        "mixed into speech-like audio at about its level");
+
+  printf("False alarms\n");
+  make_signal(&marker, signal, 0, 300, false);
+  check(detect(&marker, signal, LENGTH, BLOCK, &score) == -1,
+        "harmonics and noise alone");
+  memset(signal, 0, sizeof(signal));
+  check(detect(&marker, signal, LENGTH, BLOCK, &score) == -1, "silence");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
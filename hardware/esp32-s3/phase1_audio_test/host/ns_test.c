@@ -0,0 +1,188 @@
+// Checks the noise suppressor (audio_ns.h) on the voice-agent WAV fixtures
+// with noise mixed in: white hiss and a low-passed hum, each at 10dB below
+// the speech. Every fixture is led in and out by a second of the noise
+// alone, as a device hears one request. At each level the noise alone has
+// to come down, and the SNR of the speech (the clean file against
+// everything else in the output, distortion included) has to go up. Off
+// has to pass the input through unchanged, two hops late.
+//
+//   ns_test FIXTURE.wav...
+//
+// dsp_bench has the cycle count (stage.ns).
+
+#include "audio_ns.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE 16000
+#define BLOCK_SAMPLES 512 // One capture block
+#define DELAY (2 * AUDIO_NS_HOP)
+#define LEAD_MS 1000  // Noise alone before and after the speech
+#define SETTLE_MS 500 // Of the lead-in, for the floor to learn
+#define INPUT_SNR_DB 10.0
+
+typedef struct {
+  const char *name;
+  double pole; // One-pole low-pass, 0 for white
+} noise_kind_t;
+
+static const noise_kind_t kinds[] = {
+    {"hiss", 0.0},
+    {"hum", 0.95},
+};
+
+typedef struct {
+  audio_ns_level_t level;
+  double min_noise_cut_db;
+  double min_snr_gain_db;
+} level_case_t;
+
+// The cuts are short of the gain floors: musical noise leaks through
+static const level_case_t levels[] = {
+    {AUDIO_NS_LOW, 6.0, 3.0},
+    {AUDIO_NS_MEDIUM, 9.0, 3.0},
+    {AUDIO_NS_HIGH, 12.0, 3.0},
+};
+
+static double power(const double *x, size_t from, size_t to) {
+  double sum = 0;
+  for (size_t i = from; i < to; i++) {
+    sum += x[i] * x[i];
+  }
+  return sum / (to - from) + 1e-9;
+}
+
+// Runs `in` through the suppressor in capture blocks; `out` is realigned
+// with the input
+static void suppress(audio_ns_t *ns, const int16_t *in, double *out,
+                     size_t samples) {
+  static int16_t block[BLOCK_SAMPLES];
+  size_t produced = 0;
+  for (size_t at = 0; at < samples + DELAY; at += BLOCK_SAMPLES) {
+    for (size_t i = 0; i < BLOCK_SAMPLES; i++) {
+      block[i] = at + i < samples ? in[at + i] : 0;
+    }
+    audio_ns_process(ns, block, block, BLOCK_SAMPLES);
+    for (size_t i = 0; i < BLOCK_SAMPLES; i++, produced++) {
+      if (produced >= DELAY && produced - DELAY < samples) {
+        out[produced - DELAY] = block[i];
+      }
+    }
+  }
+}
+
+static void fixture(const char *path, audio_ns_t *ns) {
+  wav_t wav;
+  if (wav_load(path, &wav) != 0) {
+    failures++;
+    return;
+  }
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  printf("%s: %zu frames at %u Hz\n", name, wav.frames,
+         (unsigned int)wav.rate);
+
+  size_t lead = wav.rate * LEAD_MS / 1000;
+  size_t settle = wav.rate * SETTLE_MS / 1000;
+  size_t samples = wav.frames + 2 * lead;
+  double *clean = calloc(samples, sizeof(double));
+  double *noise = calloc(samples, sizeof(double));
+  double *out = calloc(samples, sizeof(double));
+  int16_t *mic = calloc(samples, sizeof(int16_t));
+  if (!clean || !noise || !out || !mic) {
+    printf("  out of memory\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < wav.frames; i++) {
+    clean[lead + i] = wav.samples[i];
+  }
+  size_t speech_from = lead, speech_to = lead + wav.frames;
+
+  for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+    double state = 0;
+    for (size_t i = 0; i < samples; i++) {
+      state = kinds[k].pole * state + white();
+      noise[i] = state;
+    }
+    double scale = sqrt(power(clean, speech_from, speech_to) /
+                        power(noise, 0, samples) /
+                        pow(10, INPUT_SNR_DB / 10));
+    for (size_t i = 0; i < samples; i++) {
+      noise[i] *= scale;
+      mic[i] = clip(clean[i] + noise[i]);
+    }
+    double noise_dbfs =
+        10 * log10(power(noise, 0, samples) / (32768.0 * 32768.0));
+
+    audio_ns_init(ns, AUDIO_NS_OFF);
+    suppress(ns, mic, out, samples);
+    bool same = true;
+    for (size_t i = 0; i < samples; i++) {
+      same = same && out[i] == mic[i];
+    }
+    printf("  %s at %.1f dBFS\n", kinds[k].name, noise_dbfs);
+    check(same, "off passes the input through, two hops late");
+
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+      audio_ns_init(ns, levels[l].level);
+      suppress(ns, mic, out, samples);
+      // Noise alone, half a second into each stretch of it
+      double in_noise = power(noise, settle, speech_from) +
+                        power(noise, speech_to + settle, samples);
+      double out_noise = power(out, settle, speech_from) +
+                         power(out, speech_to + settle, samples);
+      double cut = 10 * log10(in_noise / out_noise);
+      double residual = 0;
+      for (size_t i = speech_from; i < speech_to; i++) {
+        residual += (out[i] - clean[i]) * (out[i] - clean[i]);
+      }
+      residual /= speech_to - speech_from;
+      double snr = 10 * log10(power(clean, speech_from, speech_to) /
+                              residual);
+      printf("    %-6s noise %5.1f dB down, speech SNR %4.1f -> %4.1f dB, "
+             "floor estimate %+.1f dB\n",
+             audio_ns_level_name(levels[l].level), cut, INPUT_SNR_DB, snr,
+             ns->noise_db - noise_dbfs);
+      char what[64];
+      snprintf(what, sizeof(what), "%s: noise down %.0f dB, SNR up %.0f dB",
+               audio_ns_level_name(levels[l].level),
+               levels[l].min_noise_cut_db, levels[l].min_snr_gain_db);
+      check(cut > levels[l].min_noise_cut_db &&
+                snr - INPUT_SNR_DB > levels[l].min_snr_gain_db,
+            what);
+    }
+  }
+
+  free(clean);
+  free(noise);
+  free(out);
+  free(mic);
+  wav_free(&wav);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  audio_ns_t *ns = malloc(sizeof(audio_ns_t));
+  if (!ns) {
+    printf("out of memory\n");
+    return 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    fixture(argv[i], ns);
+  }
+  free(ns);
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
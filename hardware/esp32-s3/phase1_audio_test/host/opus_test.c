@@ -0,0 +1,220 @@
+// Round trip through the Opus uplink codec (audio_opus.h) on the
+// voice-agent WAV fixtures: each file is fed to the encoder in capture
+// blocks as the sender does, at the default bitrate, and decoded again.
+// Opus does not keep the waveform, so the checks are on what a listener
+// and the server's speech model hear: one packet per 20ms, the bitrate,
+// the codec delay, the level, and the speech envelope frame by frame.
+// Then packet loss concealment and a decoder at the other network rate.
+//
+//   opus_test FIXTURE.wav...
+//
+// Needs libopus (pkg-config opus); the Makefile skips it otherwise.
+
+#include "audio_opus.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SAMPLES 512 // One capture block
+#define MAX_LAG_MS 30     // Opus's own delay is 6.5ms plus the decoder's
+#define MIN_ENVELOPE_CORRELATION 0.9
+#define MAX_LEVEL_DB 3.0
+#define SILENCE_DBFS -50.0 // Envelope frames below this are left out
+
+typedef struct {
+  uint8_t *bytes; // Packets back to back
+  size_t *lens;
+  size_t count;
+  size_t max_count;
+  size_t total;
+} packets_t;
+
+static void keep_packet(const uint8_t *packet, size_t len, void *ctx) {
+  packets_t *p = ctx;
+  if (p->count == p->max_count) {
+    return;
+  }
+  memcpy(p->bytes + p->total, packet, len);
+  p->lens[p->count++] = len;
+  p->total += len;
+}
+
+static double energy_db(const int16_t *x, size_t n) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += (double)x[i] * x[i];
+  }
+  return 10 * log10(sum / n / (32768.0 * 32768.0) + 1e-12);
+}
+
+// Normalized cross-correlation of a and b[lag..]
+static double correlation(const int16_t *a, const int16_t *b, size_t n,
+                          size_t lag) {
+  double ab = 0, aa = 0, bb = 0;
+  for (size_t i = 0; i + lag < n; i++) {
+    ab += (double)a[i] * b[i + lag];
+    aa += (double)a[i] * a[i];
+    bb += (double)b[i + lag] * b[i + lag];
+  }
+  return ab / sqrt(aa * bb + 1e-9);
+}
+
+static double pearson(const double *x, const double *y, size_t n) {
+  double mx = 0, my = 0;
+  for (size_t i = 0; i < n; i++) {
+    mx += x[i] / n;
+    my += y[i] / n;
+  }
+  double xy = 0, xx = 0, yy = 0;
+  for (size_t i = 0; i < n; i++) {
+    xy += (x[i] - mx) * (y[i] - my);
+    xx += (x[i] - mx) * (x[i] - mx);
+    yy += (y[i] - my) * (y[i] - my);
+  }
+  return xy / sqrt(xx * yy + 1e-12);
+}
+
+static void fixture(const char *path) {
+  wav_t wav;
+  if (wav_load(path, &wav) != 0) {
+    failures++;
+    return;
+  }
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  printf("%s: %zu frames at %u Hz\n", name, wav.frames,
+         (unsigned int)wav.rate);
+
+  audio_opus_encoder_t enc;
+  audio_opus_decoder_t dec;
+  void *enc_state = malloc(audio_opus_encoder_state_bytes());
+  void *dec_state = malloc(audio_opus_decoder_state_bytes());
+  size_t frame = wav.rate * AUDIO_OPUS_FRAME_MS / 1000;
+  packets_t p = {.max_count = wav.frames / frame + 1};
+  p.bytes = malloc(p.max_count * AUDIO_OPUS_MAX_PACKET);
+  p.lens = calloc(p.max_count, sizeof(size_t));
+  int16_t *decoded = calloc(p.max_count * frame, sizeof(int16_t));
+  if (!enc_state || !dec_state || !p.bytes || !p.lens || !decoded) {
+    printf("  out of memory\n");
+    exit(1);
+  }
+  check(audio_opus_encoder_init(&enc, enc_state, wav.rate, 0) == ESP_OK &&
+            audio_opus_decoder_init(&dec, dec_state, wav.rate) == ESP_OK,
+        "init");
+
+  for (size_t at = 0; at < wav.frames; at += BLOCK_SAMPLES) {
+    size_t n = wav.frames - at < BLOCK_SAMPLES ? wav.frames - at
+                                               : BLOCK_SAMPLES;
+    audio_opus_encoder_feed(&enc, wav.samples + at, n, keep_packet, &p);
+  }
+  check(p.count == wav.frames / frame, "one packet per whole 20ms");
+
+  size_t samples = 0, offset = 0;
+  bool decodes = true;
+  for (size_t i = 0; i < p.count; i++) {
+    int n = audio_opus_decode(&dec, p.bytes + offset, p.lens[i],
+                              decoded + samples, frame);
+    decodes = decodes && n == (int)frame;
+    samples += n > 0 ? (size_t)n : 0;
+    offset += p.lens[i];
+  }
+  check(decodes, "every packet decodes to 20ms");
+
+  double seconds = (double)samples / wav.rate;
+  double kbps = p.total * 8 / seconds / 1000;
+  double pcm_kbps = wav.rate * 16 / 1000.0;
+  printf("  %zu packets, %.1f kbit/s against pcm16's %.0f (%.1fx)\n",
+         p.count, kbps, pcm_kbps, pcm_kbps / kbps);
+  check(kbps > AUDIO_OPUS_DEFAULT_BITRATE / 2000.0 &&
+            kbps < AUDIO_OPUS_DEFAULT_BITRATE * 1.5 / 1000,
+        "bitrate near the configured 24 kbit/s");
+
+  // The codec delay: the lag where the decoded speech lines up best
+  size_t best = 0;
+  double best_corr = -1;
+  for (size_t lag = 0; lag <= wav.rate * MAX_LAG_MS / 1000; lag++) {
+    double c = correlation(wav.samples, decoded, samples, lag);
+    if (c > best_corr) {
+      best_corr = c;
+      best = lag;
+    }
+  }
+  printf("  delay %.1f ms, waveform correlation %.2f\n",
+         best * 1000.0 / wav.rate, best_corr);
+  check(best < wav.rate * MAX_LAG_MS / 1000, "codec delay found");
+
+  // Level and envelope over the 20ms frames that carry speech
+  size_t frames = samples > best ? (samples - best) / frame : 0;
+  double *in_db = calloc(frames, sizeof(double));
+  double *out_db = calloc(frames, sizeof(double));
+  size_t voiced = 0;
+  double level = 0;
+  for (size_t f = 0; f < frames; f++) {
+    double a = energy_db(wav.samples + f * frame, frame);
+    double b = energy_db(decoded + best + f * frame, frame);
+    if (a > SILENCE_DBFS) {
+      in_db[voiced] = a;
+      out_db[voiced] = b;
+      level += b - a;
+      voiced++;
+    }
+  }
+  level = voiced ? level / voiced : 0;
+  double envelope = pearson(in_db, out_db, voiced);
+  printf("  %zu speech frames: level %+.1f dB, envelope correlation %.3f\n",
+         voiced, level, envelope);
+  check(voiced > frames / 4, "fixture has speech in it");
+  check(fabs(level) < MAX_LEVEL_DB, "level kept");
+  check(envelope > MIN_ENVELOPE_CORRELATION, "speech envelope kept");
+  free(in_db);
+  free(out_db);
+
+  // A lost packet: concealment fills the gap with 20ms
+  int16_t gap[AUDIO_OPUS_MAX_FRAME_SAMPLES];
+  check(audio_opus_decode(&dec, NULL, 0, gap, frame) == (int)frame,
+        "lost packet concealed");
+
+  // The other network rate: the same packets decode at 24kHz
+  check(audio_opus_decoder_init(&dec, dec_state, 24000) == ESP_OK &&
+            audio_opus_decode(&dec, p.bytes, p.lens[0], gap,
+                              AUDIO_OPUS_MAX_FRAME_SAMPLES) == 480,
+        "decoder rate independent of the encoder's");
+
+  free(enc_state);
+  free(dec_state);
+  free(p.bytes);
+  free(p.lens);
+  free(decoded);
+  wav_free(&wav);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  for (int i = 1; i < argc; i++) {
+    fixture(argv[i]);
+  }
+
+  printf("Rates\n");
+  audio_opus_encoder_t enc;
+  void *state = malloc(audio_opus_encoder_state_bytes());
+  check(audio_opus_encoder_init(&enc, state, 44100, 0) != ESP_OK,
+        "44.1kHz refused");
+  check(audio_opus_encoder_init(&enc, state, 16000, 0) == ESP_OK &&
+            audio_opus_encoder_set_rate(&enc, 24000) == ESP_OK &&
+            enc.frame_samples == 480,
+        "rate change to 24kHz, 480-sample frames");
+  free(state);
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
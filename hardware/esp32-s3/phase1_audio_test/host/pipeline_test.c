@@ -0,0 +1,240 @@
+// Checks the DSP pipeline (audio_pipeline.h) swapping chains mid-stream: a
+// tone runs through the uplink's mix and a gain stage that is swapped in
+// and out. The swap block has to be the linear crossfade from the old
+// chain's output to the new one's, sample for sample, and no sample step
+// across the whole stream may be larger than the tone's own. Stages that
+// join a chain are reset and stages that stay or move are not, the
+// per-stage timing counts every call, swap blocks included, and chains
+// that do not fit are refused.
+//
+//   pipeline_test
+//
+// dsp_bench has the chain timings (process_audio_data, uplink_chain and
+// uplink_chain_swap, a swap on every block).
+
+#include "audio_convert.h"
+#include "audio_kernels.h"
+#include "audio_pipeline.h"
+#include "audio_stages.h"
+#include "test_util.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE 16000
+#define BLOCK 512
+#define BLOCKS 100
+#define SWAP_EVERY 10
+#define TONE_HZ 440
+#define TONE_AMPLITUDE 20000 // In pcm16, after the mix
+
+// A pass-through stage that counts its resets
+typedef struct {
+  int resets;
+} counter_t;
+
+static void counter_reset(void *state) { ((counter_t *)state)->resets++; }
+
+static size_t counter_process(void *state, const void *in, void *out,
+                              size_t frames) {
+  memcpy(out, in, frames * sizeof(int16_t));
+  return frames;
+}
+
+static void counter_stage(audio_stage_t *stage, counter_t *state,
+                          const char *name) {
+  memset(stage, 0, sizeof(*stage));
+  stage->name = name;
+  stage->in_format = AUDIO_FORMAT_S16_MONO;
+  stage->out_format = AUDIO_FORMAT_S16_MONO;
+  stage->state = state;
+  stage->process = counter_process;
+  stage->reset = counter_reset;
+}
+
+// Block `b` of the tone as raw I2S slots, both mics alike
+static void tone_block(int32_t *stereo, size_t b) {
+  for (size_t i = 0; i < BLOCK; i++) {
+    double t = (double)(b * BLOCK + i) / RATE;
+    int32_t x = (int32_t)lrint(TONE_AMPLITUDE * sin(2 * M_PI * TONE_HZ * t));
+    stereo[2 * i] = x * 65536;
+    stereo[2 * i + 1] = x * 65536;
+  }
+}
+
+static int32_t largest_step(const int16_t *x, size_t n) {
+  int32_t max = 0;
+  for (size_t i = 1; i < n; i++) {
+    int32_t step = abs(x[i] - x[i - 1]);
+    max = step > max ? step : max;
+  }
+  return max;
+}
+
+static void crossfade(void) {
+  printf("Swapping a gain stage in and out every %d blocks\n", SWAP_EVERY);
+  static audio_pipeline_t pipeline;
+  audio_stage_t mix, gain;
+  audio_gain_t half = {.gain = 16384, .shift = 15};
+  audio_stage_mix16(&mix);
+  audio_stage_gain(&gain, &half);
+  audio_chain_t plain = {.slots = {&mix, NULL}, .count = 2};
+  audio_chain_t gained = {.slots = {&mix, &gain}, .count = 2};
+  audio_pipeline_init(&pipeline, AUDIO_FORMAT_S32_STEREO, BLOCK, &plain);
+
+  static int32_t stereo[2 * BLOCK];
+  static int16_t mixed[BLOCK], halved[BLOCK], expected[BLOCK];
+  static int16_t out[BLOCKS * BLOCK];
+  bool faded = true, steady = true;
+  uint32_t gain_calls = 0;
+  for (size_t b = 0; b < BLOCKS; b++) {
+    bool swap = b > 0 && b % SWAP_EVERY == 0;
+    bool on = b / SWAP_EVERY % 2 == 1;
+    if (swap) {
+      audio_pipeline_swap(&pipeline, on ? &gained : &plain);
+    }
+    tone_block(stereo, b);
+    size_t frames;
+    const int16_t *y =
+        audio_pipeline_process(&pipeline, stereo, BLOCK, &frames);
+    memcpy(out + b * BLOCK, y, BLOCK * sizeof(int16_t));
+    gain_calls += on || swap;
+
+    // The two chains' outputs, and the fade between them the same way
+    audio_convert_stereo32_to_mono16(stereo, mixed, 2 * BLOCK);
+    audio_kernel_gain_s16(mixed, halved, BLOCK, half.gain, half.shift);
+    const int16_t *from = on ? mixed : halved;
+    const int16_t *to = on ? halved : mixed;
+    for (size_t i = 0; i < BLOCK; i++) {
+      int32_t w = (int32_t)((i << 15) / BLOCK);
+      expected[i] = swap ? (int16_t)(from[i] + (((to[i] - from[i]) * w) >> 15))
+                         : to[i];
+    }
+    bool same = frames == BLOCK &&
+                memcmp(y, expected, BLOCK * sizeof(int16_t)) == 0;
+    if (swap) {
+      faded = faded && same;
+    } else {
+      steady = steady && same;
+    }
+  }
+
+  // The tone's slope at its zero crossings, and a little for rounding
+  int32_t tone_step =
+      (int32_t)ceil(TONE_AMPLITUDE * 2 * M_PI * TONE_HZ / RATE) + 2;
+  int32_t step = largest_step(out, BLOCKS * BLOCK);
+  printf("  %u swaps, largest step %d against the tone's %d\n",
+         (unsigned int)pipeline.swaps, (int)step, (int)tone_step);
+  check(pipeline.swaps == BLOCKS / SWAP_EVERY - 1, "every swap taken");
+  check(steady, "other blocks are the active chain's output");
+  check(faded, "swap blocks crossfade from the old chain to the new");
+  check(step <= tone_step, "no click: no step larger than the tone's");
+  check(mix.calls == BLOCKS, "unchanged slots run once in a swap block");
+  check(gain.calls == gain_calls,
+        "the swapped stage also runs to fade itself out");
+}
+
+static void resets(void) {
+  printf("Resets\n");
+  static audio_pipeline_t pipeline;
+  counter_t a_state = {0}, b_state = {0};
+  audio_stage_t a, b;
+  counter_stage(&a, &a_state, "a");
+  counter_stage(&b, &b_state, "b");
+  audio_chain_t only_a = {.slots = {&a, NULL}, .count = 2};
+  audio_chain_t both = {.slots = {&a, &b}, .count = 2};
+  audio_chain_t moved = {.slots = {&b, &a}, .count = 2};
+  audio_pipeline_init(&pipeline, AUDIO_FORMAT_S16_MONO, BLOCK, &only_a);
+
+  static int16_t in[BLOCK];
+  size_t frames;
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(a_state.resets == 0 && b_state.resets == 0,
+        "init resets nothing, the caller set the state up");
+  audio_pipeline_swap(&pipeline, &both);
+  check(b_state.resets == 0, "nothing happens until the next block");
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(b_state.resets == 1 && a_state.resets == 0,
+        "a joining stage is reset, one that stays is not");
+  audio_pipeline_swap(&pipeline, &moved);
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(a_state.resets == 0 && b_state.resets == 1,
+        "stages moving to another slot are not reset");
+  audio_pipeline_swap(&pipeline, &only_a);
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  audio_pipeline_swap(&pipeline, &both);
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(b_state.resets == 2, "and reset again when it rejoins");
+  uint32_t swaps = pipeline.swaps;
+  audio_pipeline_swap(&pipeline, &both);
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(pipeline.swaps == swaps && b_state.resets == 2,
+        "swapping to the active chain does nothing");
+
+  // A real stage with history: the DC blocker settles on an offset, and
+  // after rejoining starts from rest instead of replaying it
+  audio_dc_block_t dc_state;
+  audio_stage_t dc;
+  audio_stage_dc_block(&dc, &dc_state);
+  audio_chain_t with_dc = {.slots = {&a, &dc}, .count = 2};
+  audio_chain_t without_dc = {.slots = {&a, NULL}, .count = 2};
+  audio_pipeline_init(&pipeline, AUDIO_FORMAT_S16_MONO, BLOCK, &with_dc);
+  for (size_t i = 0; i < BLOCK; i++) {
+    in[i] = 1000;
+  }
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  audio_pipeline_swap(&pipeline, &without_dc);
+  audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(dc_state.x1 == 1000, "the DC blocker holds the old input");
+  audio_pipeline_swap(&pipeline, &with_dc);
+  memset(in, 0, sizeof(in));
+  const int16_t *y = audio_pipeline_process(&pipeline, in, BLOCK, &frames);
+  check(largest_step(y, frames) == 0 && y[0] == 0,
+        "rejoining, it starts from rest");
+}
+
+static void checks(void) {
+  printf("Chain checks\n");
+  static audio_pipeline_t pipeline;
+  audio_stage_t mix, gain, dc;
+  audio_gain_t unity = {.gain = 32767, .shift = 15};
+  audio_dc_block_t dc_state;
+  audio_stage_mix16(&mix);
+  audio_stage_gain(&gain, &unity);
+  audio_stage_dc_block(&dc, &dc_state);
+  audio_chain_t good = {.slots = {&mix, &gain}, .count = 2};
+  audio_chain_t unmixed = {.slots = {&gain, &mix}, .count = 2};
+  audio_chain_t long_chain = {.count = AUDIO_PIPELINE_MAX_STAGES + 1};
+  check(audio_pipeline_init(&pipeline, AUDIO_FORMAT_S32_STEREO, BLOCK,
+                            &good) == ESP_OK,
+        "a chain that fits is taken");
+  check(audio_pipeline_swap(&pipeline, &unmixed) == ESP_ERR_INVALID_ARG,
+        "a stage that cannot take its input is refused");
+  check(audio_pipeline_swap(&pipeline, &long_chain) == ESP_ERR_INVALID_ARG,
+        "so is a chain longer than the slots");
+  check(audio_pipeline_init(&pipeline, AUDIO_FORMAT_S16_MONO,
+                            AUDIO_PIPELINE_BUFFER_BYTES, &good) ==
+            ESP_ERR_INVALID_ARG,
+        "and a chain built for another input");
+  audio_chain_t dc_only = {.slots = {&dc}, .count = 1};
+  check(audio_pipeline_init(&pipeline, AUDIO_FORMAT_S16_MONO,
+                            AUDIO_PIPELINE_BUFFER_BYTES, &dc_only) ==
+            ESP_ERR_INVALID_SIZE,
+        "and blocks too big for the buffers");
+  check(pipeline.active == NULL, "a refused chain is not made active");
+}
+
+int main(void) {
+  crossfade();
+  resets();
+  checks();
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,180 @@
+// Checks audio_resampler on the ratios the firmware uses: 16k -> 24k for
+// the uplink, 24k -> 16k for the downlink and 48k -> 16k for a 48kHz
+// server. Tones across the passband have to come through with their SNR
+// intact and the speech band flat, a tone above the output Nyquist has to
+// be rejected rather than aliased, and the output must not depend on how
+// the input is split into blocks. Prints the host time per input sample;
+// dsp_bench has the device cycle counts (stage.resample_up, _down).
+//
+//   resampler_test
+
+#include "audio_resampler.h"
+#include "test_util.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SECONDS 1
+#define MAX_RATE 48000
+#define AMPLITUDE 16384 // -6dBFS
+#define MIN_SNR_DB 70.0
+#define MIN_REJECTION_DB 60.0
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int16_t in[SECONDS * MAX_RATE];
+static int16_t out[2 * SECONDS * MAX_RATE];
+static int16_t again[2 * SECONDS * MAX_RATE];
+
+static size_t tone(uint32_t rate, double freq) {
+  size_t n = SECONDS * rate;
+  for (size_t i = 0; i < n; i++) {
+    in[i] = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * freq * i / rate));
+  }
+  return n;
+}
+
+// Fit a sine and cosine at `freq` to out[skip..n) by least squares; the
+// remainder is noise, distortion and aliases. Returns the SNR in dB and
+// the fitted amplitude.
+static double fit_snr(const int16_t *x, size_t n, size_t skip, double freq,
+                      uint32_t rate, double *amplitude) {
+  double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0;
+  for (size_t i = skip; i < n; i++) {
+    double s = sin(2 * M_PI * freq * i / rate);
+    double c = cos(2 * M_PI * freq * i / rate);
+    ss += s * s;
+    cc += c * c;
+    sc += s * c;
+    xs += x[i] * s;
+    xc += x[i] * c;
+  }
+  double det = ss * cc - sc * sc;
+  double a = (xs * cc - xc * sc) / det;
+  double b = (xc * ss - xs * sc) / det;
+  double signal = 0, noise = 0;
+  for (size_t i = skip; i < n; i++) {
+    double fit = a * sin(2 * M_PI * freq * i / rate) +
+                 b * cos(2 * M_PI * freq * i / rate);
+    signal += fit * fit;
+    noise += (x[i] - fit) * (x[i] - fit);
+  }
+  *amplitude = sqrt(a * a + b * b);
+  return 10 * log10(signal / (noise > 0 ? noise : 1e-9));
+}
+
+// Blocks of `block` samples, or of random sizes 1..400 when 0
+static size_t run(audio_resampler_t *rs, size_t n, size_t block,
+                  int16_t *dst) {
+  size_t produced = 0;
+  uint32_t seed = 3;
+  for (size_t at = 0; at < n;) {
+    size_t len = block;
+    if (!len) {
+      seed = seed * 1664525u + 1013904223u;
+      len = 1 + (seed >> 8) % 400;
+    }
+    if (len > n - at) {
+      len = n - at;
+    }
+    produced += audio_resampler_process(rs, in + at, len, dst + produced);
+    at += len;
+  }
+  return produced;
+}
+
+static void ratio(uint32_t in_rate, uint32_t out_rate) {
+  printf("%u -> %u Hz\n", (unsigned int)in_rate, (unsigned int)out_rate);
+  audio_resampler_t rs;
+  check(audio_resampler_init(&rs, in_rate, out_rate, 0) == ESP_OK, "init");
+
+  uint32_t nyquist = (in_rate < out_rate ? in_rate : out_rate) / 2;
+  const double fractions[] = {0.0125, 0.125, 0.4, 0.75};
+  size_t skip = 4 * AUDIO_RESAMPLER_MAX_TAPS; // Past the filter's warm-up
+  double worst = 1e9, lowest_db = 0, highest_db = 0;
+  for (size_t f = 0; f < sizeof(fractions) / sizeof(fractions[0]); f++) {
+    double freq = fractions[f] * nyquist;
+    size_t n = tone(in_rate, freq);
+    audio_resampler_reset(&rs);
+    size_t produced = run(&rs, n, 160, out);
+    double amplitude;
+    double snr = fit_snr(out, produced, skip, freq, out_rate, &amplitude);
+    double gain_db = 20 * log10(amplitude / AMPLITUDE);
+    printf("  %6.0f Hz: SNR %5.1f dB, gain %+.2f dB\n", freq, snr, gain_db);
+    worst = snr < worst ? snr : worst;
+    if (fractions[f] <= 0.4) { // The band edge rolls off, it is only reported
+      lowest_db = gain_db < lowest_db ? gain_db : lowest_db;
+      highest_db = gain_db > highest_db ? gain_db : highest_db;
+    }
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "passband SNR above %.0f dB", MIN_SNR_DB);
+  check(worst > MIN_SNR_DB, what);
+  check(lowest_db > -0.5 && highest_db < 0.5,
+        "flat within 0.5 dB up to 0.4 x Nyquist");
+
+  size_t n = tone(in_rate, 0.4 * nyquist);
+  audio_resampler_reset(&rs);
+  size_t whole = run(&rs, n, n, out);
+  audio_resampler_reset(&rs);
+  size_t pieces = run(&rs, n, 0, again);
+  check(whole == pieces && memcmp(out, again, whole * sizeof(int16_t)) == 0,
+        "same output for any block split");
+  check(whole + 1 >= (size_t)n * out_rate / in_rate &&
+            whole <= (size_t)n * out_rate / in_rate + 1,
+        "output count follows the ratio");
+
+  if (in_rate > out_rate) {
+    // Halfway between the output Nyquist and the input's
+    double freq = (out_rate / 2.0 + in_rate / 2.0) / 2;
+    n = tone(in_rate, freq);
+    audio_resampler_reset(&rs);
+    size_t produced = run(&rs, n, 160, out);
+    double power = 0;
+    for (size_t i = skip; i < produced; i++) {
+      power += (double)out[i] * out[i];
+    }
+    double rms = sqrt(power / (produced - skip));
+    double rejection = 20 * log10(AMPLITUDE / sqrt(2) / fmax(rms, 1e-9));
+    printf("  %6.0f Hz above the output Nyquist: rejected by %.1f dB\n", freq,
+           rejection);
+    snprintf(what, sizeof(what), "alias rejected by more than %.0f dB",
+             MIN_REJECTION_DB);
+    check(rejection > MIN_REJECTION_DB, what);
+  }
+
+  n = tone(in_rate, 0.125 * nyquist);
+  const int reps = 20;
+  audio_resampler_reset(&rs);
+  double start = now_s();
+  for (int r = 0; r < reps; r++) {
+    run(&rs, n, 160, out);
+  }
+  printf("  %.1f ns per input sample on this host\n",
+         (now_s() - start) * 1e9 / ((double)reps * n));
+}
+
+int main(void) {
+  ratio(16000, 24000);
+  ratio(24000, 16000);
+  ratio(48000, 16000);
+
+  printf("Unsupported ratio\n");
+  audio_resampler_t rs;
+  check(audio_resampler_init(&rs, 44100, 16000, 0) == ESP_ERR_NOT_SUPPORTED,
+        "44.1k -> 16k refused");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
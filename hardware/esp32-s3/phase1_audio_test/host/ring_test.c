@@ -0,0 +1,225 @@
+// Checks audio_ring: capacity rules, wrap-around in place and through the
+// copying calls, full and empty, then a producer and a consumer thread
+// racing over a small ring with odd chunk sizes, checking every byte
+// arrives once and in order.
+//
+//   ring_test            run the checks
+//   ring_test --bench    throughput of the in-place calls per block size
+//
+// Threads stand in for the capture and sender tasks on their two cores.
+
+#include "audio_ring.h"
+#include "test_util.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STRESS_CAPACITY 4096
+#define STRESS_BYTES (64u * 1024 * 1024)
+#define BENCH_CAPACITY (64 * 1024) // The firmware's capture ring
+#define BENCH_BYTES (512u * 1024 * 1024)
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Byte n of the stream; not periodic in any power of two, so a chunk
+// landing at the wrong offset or twice shows up
+static uint8_t pattern(uint64_t n) {
+  return (uint8_t)((n * 2654435761u) >> 13 ^ (n >> 8));
+}
+
+// Chunk sizes from a cheap generator, 1..max
+static size_t next_chunk(uint32_t *state, size_t max) {
+  *state = *state * 1664525u + 1013904223u;
+  return 1 + (*state >> 8) % max;
+}
+
+typedef struct {
+  audio_ring_t ring;
+  uint64_t total;
+  size_t block;         // Fixed chunk size, 0 for random ones
+  uint64_t mismatches;  // First bad offset is kept too
+  uint64_t first_bad;
+  uint64_t full_spins;  // Producer found no space and yielded
+  uint64_t empty_spins; // Consumer found nothing and yielded
+} stress_t;
+
+static void *producer(void *arg) {
+  stress_t *s = arg;
+  uint32_t rng = 1;
+  uint64_t n = 0;
+  while (n < s->total) {
+    void *region;
+    size_t space = audio_ring_write_reserve(&s->ring, &region);
+    if (space == 0) {
+      s->full_spins++;
+      sched_yield(); // The host may have a single core
+      continue;
+    }
+    size_t chunk = s->block ? s->block : next_chunk(&rng, 1500);
+    if (chunk > space) {
+      chunk = space;
+    }
+    if (chunk > s->total - n) {
+      chunk = (size_t)(s->total - n);
+    }
+    uint8_t *out = region;
+    if (s->block) {
+      memset(out, (int)(n & 0xff), chunk); // Bench: keep the write cheap
+    } else {
+      for (size_t i = 0; i < chunk; i++) {
+        out[i] = pattern(n + i);
+      }
+    }
+    audio_ring_write_commit(&s->ring, chunk);
+    n += chunk;
+  }
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  stress_t *s = arg;
+  uint32_t rng = 7;
+  uint64_t n = 0;
+  while (n < s->total) {
+    const void *region;
+    size_t used = audio_ring_read_peek(&s->ring, &region);
+    if (used == 0) {
+      s->empty_spins++;
+      sched_yield();
+      continue;
+    }
+    size_t chunk = s->block ? s->block : next_chunk(&rng, 1100);
+    if (chunk > used) {
+      chunk = used;
+    }
+    const uint8_t *in = region;
+    if (s->block) {
+      s->mismatches += in[0] != (uint8_t)(n & 0xff) && chunk == s->block;
+    } else {
+      for (size_t i = 0; i < chunk; i++) {
+        if (in[i] != pattern(n + i) && s->mismatches++ == 0) {
+          s->first_bad = n + i;
+        }
+      }
+    }
+    audio_ring_read_release(&s->ring, chunk);
+    n += chunk;
+  }
+  return NULL;
+}
+
+static double run_threads(stress_t *s) {
+  pthread_t p, c;
+  double start = now_s();
+  pthread_create(&c, NULL, consumer, s);
+  pthread_create(&p, NULL, producer, s);
+  pthread_join(p, NULL);
+  pthread_join(c, NULL);
+  return now_s() - start;
+}
+
+static int bench(void) {
+  static const size_t blocks[] = {64, 256, 1024, 4096, 16384};
+  static _Alignas(AUDIO_RING_CACHE_LINE) uint8_t storage[BENCH_CAPACITY];
+  printf("%8s %10s %12s %12s\n", "block", "MB/s", "full spins",
+         "empty spins");
+  for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+    static stress_t s;
+    memset(&s, 0, sizeof(s));
+    audio_ring_init(&s.ring, storage, BENCH_CAPACITY);
+    s.total = BENCH_BYTES;
+    s.block = blocks[b];
+    double seconds = run_threads(&s);
+    printf("%8zu %10.0f %12llu %12llu%s\n", blocks[b],
+           s.total / seconds / 1e6, (unsigned long long)s.full_spins,
+           (unsigned long long)s.empty_spins,
+           s.mismatches ? "  MISMATCH" : "");
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    return bench();
+  }
+
+  static _Alignas(AUDIO_RING_CACHE_LINE) uint8_t storage[STRESS_CAPACITY];
+  audio_ring_t ring;
+
+  printf("Capacity\n");
+  check(audio_ring_init(&ring, storage, 3000) == ESP_ERR_INVALID_ARG,
+        "capacity that is not a power of two refused");
+  check(audio_ring_init(&ring, NULL, 4096) == ESP_ERR_INVALID_ARG,
+        "missing storage refused");
+  check(audio_ring_init(&ring, storage, 16) == ESP_OK &&
+            audio_ring_free_space(&ring) == 16 && audio_ring_used(&ring) == 0,
+        "starts empty with the whole capacity free");
+
+  printf("Wrap-around\n");
+  uint8_t in[16], out[16];
+  for (int i = 0; i < 16; i++) {
+    in[i] = (uint8_t)(i + 1);
+  }
+  audio_ring_write(&ring, in, 12);
+  audio_ring_read(&ring, out, 12);
+  void *region;
+  check(audio_ring_write_reserve(&ring, &region) == 4 &&
+            region == storage + 12,
+        "reserve stops at the end of the buffer");
+  check(audio_ring_write(&ring, in, 10) == 10 && audio_ring_used(&ring) == 10,
+        "copying write splits across the wrap");
+  const void *peek;
+  check(audio_ring_read_peek(&ring, &peek) == 4 && peek == storage + 12,
+        "peek stops at the end of the buffer");
+  memset(out, 0, sizeof(out));
+  check(audio_ring_read(&ring, out, 16) == 10 && memcmp(out, in, 10) == 0,
+        "copying read joins the two parts in order");
+
+  printf("Full and empty\n");
+  check(audio_ring_write(&ring, in, 16) == 16 &&
+            audio_ring_write(&ring, in, 1) == 0 &&
+            audio_ring_free_space(&ring) == 0,
+        "full ring takes nothing more");
+  check(audio_ring_used_approx(&ring) == 16,
+        "the read-only fill sees it full too");
+  check(audio_ring_write_reserve(&ring, &region) == 0,
+        "reserve on a full ring is empty");
+  check(audio_ring_read(&ring, out, 16) == 16 &&
+            audio_ring_read_peek(&ring, &peek) == 0,
+        "drained ring peeks empty");
+  check(audio_ring_used(&ring) == 0 && audio_ring_free_space(&ring) == 16 &&
+            audio_ring_used_approx(&ring) == 0,
+        "indices keep running past the capacity");
+
+  printf("Producer and consumer threads\n");
+  static stress_t s;
+  audio_ring_init(&s.ring, storage, STRESS_CAPACITY);
+  s.total = STRESS_BYTES;
+  double seconds = run_threads(&s);
+  printf("  %u MB in %.2fs through %d bytes, %llu full / %llu empty spins\n",
+         STRESS_BYTES >> 20, seconds, STRESS_CAPACITY,
+         (unsigned long long)s.full_spins,
+         (unsigned long long)s.empty_spins);
+  if (s.mismatches) {
+    printf("  first bad byte at %llu\n", (unsigned long long)s.first_bad);
+  }
+  check(s.mismatches == 0, "every byte arrives once and in order");
+  check(audio_ring_used(&s.ring) == 0, "ring ends empty");
+  check(s.full_spins > 0 && s.empty_spins > 0,
+        "both sides waited on the other at some point");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,206 @@
+// In-band SNR of the speaker output: audio_sdm against the 8-bit PWM duty
+// it replaces, with and without TPDF dither.
+//
+//   sdm_snr            sine sweep over level and frequency
+//
+// Each case plays a sine for 2^15 samples at 16kHz. The bitstream (or the
+// 8-bit signal) is windowed, transformed, and the power
+// in 20Hz-8kHz outside the signal's bins is the noise, so distortion and
+// idle tones count against the SNR. Exits non-zero if the modulator falls
+// below MIN_SDM_SNR_DB at -6dBFS, or if its integrators run away on
+// full-scale sines or DC.
+
+#include "audio_sdm.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_RATE 16000
+#define SAMPLES (1 << 15)
+#define BITS (SAMPLES * AUDIO_SDM_OSR)
+#define BAND_LOW_HZ 20.0
+#define BAND_HIGH_HZ 8000.0
+#define SIGNAL_BINS 10 // Each side of the tone, the window's main lobe
+#define MIN_SDM_SNR_DB 65.0
+#define MAX_INTEGRATOR (16 * 32768) // Bounded loop state, as a stability test
+
+static void fft(double complex *x, size_t n) {
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      double complex t = x[i];
+      x[i] = x[j];
+      x[j] = t;
+    }
+  }
+  for (size_t len = 2; len <= n; len <<= 1) {
+    double complex w = cexp(-2.0 * M_PI * I / len);
+    for (size_t i = 0; i < n; i += len) {
+      double complex wk = 1.0;
+      for (size_t k = 0; k < len / 2; k++) {
+        double complex a = x[i + k];
+        double complex b = x[i + k + len / 2] * wk;
+        x[i + k] = a + b;
+        x[i + k + len / 2] = a - b;
+        wk *= w;
+      }
+    }
+  }
+}
+
+// 7-term Blackman-Harris: -180dB sidelobes, so the modulator's shaped noise
+// above the band cannot leak into it
+static double window(size_t i, size_t n) {
+  static const double a[] = {0.27105140069342, 0.43329793923448,
+                             0.21812299954311, 0.06592544638803,
+                             0.01081174209837, 0.00077658482522,
+                             0.00001388721735};
+  double t = 2.0 * M_PI * i / n;
+  double w = 0.0;
+  for (int k = 0; k < 7; k++) {
+    w += (k & 1 ? -a[k] : a[k]) * cos(k * t);
+  }
+  return w;
+}
+
+// SNR in dB of n samples at `rate` holding a tone at `freq`
+static double in_band_snr(double complex *x, size_t n, double rate,
+                          double freq) {
+  for (size_t i = 0; i < n; i++) {
+    x[i] *= window(i, n);
+  }
+  fft(x, n);
+
+  double bin_hz = rate / n;
+  size_t tone = (size_t)lround(freq / bin_hz);
+  size_t low = (size_t)ceil(BAND_LOW_HZ / bin_hz);
+  size_t high = (size_t)floor(BAND_HIGH_HZ / bin_hz);
+  double signal = 0.0;
+  double noise = 0.0;
+  for (size_t k = low; k <= high && k < n / 2; k++) {
+    double power = creal(x[k] * conj(x[k]));
+    if (k + SIGNAL_BINS >= tone && k <= tone + SIGNAL_BINS) {
+      signal += power;
+    } else {
+      noise += power;
+    }
+  }
+  if (signal <= 0.0) {
+    return -INFINITY; // The tone was quantised away
+  }
+  return 10.0 * log10(signal / noise);
+}
+
+static void make_sine(int16_t *pcm, double dbfs, double freq) {
+  double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+  for (size_t i = 0; i < SAMPLES; i++) {
+    pcm[i] = (int16_t)lrint(amplitude * sin(2.0 * M_PI * freq * i /
+                                            SAMPLE_RATE));
+  }
+}
+
+static bool sdm_bounded(const audio_sdm_t *sdm) {
+  return abs(sdm->x1) < MAX_INTEGRATOR && abs(sdm->x2) < MAX_INTEGRATOR;
+}
+
+static double sdm_snr(const int16_t *pcm, double freq, uint32_t *words,
+                      double complex *x, bool *bounded) {
+  audio_sdm_t sdm;
+  audio_sdm_reset(&sdm);
+  audio_sdm_modulate(&sdm, pcm, SAMPLES, words);
+  *bounded = sdm_bounded(&sdm);
+  for (size_t i = 0; i < BITS; i++) {
+    uint32_t word = words[i / 32];
+    x[i] = (word >> (31 - i % 32)) & 1 ? 1.0 : -1.0;
+  }
+  return in_band_snr(x, BITS, SAMPLE_RATE * AUDIO_SDM_OSR, freq);
+}
+
+// The duty byte the old path wrote, optionally TPDF dithered by +-1 LSB
+static double pwm8_snr(const int16_t *pcm, double freq, bool dither,
+                       double complex *x) {
+  uint32_t noise = 1;
+  for (size_t i = 0; i < SAMPLES; i++) {
+    int32_t s = pcm[i];
+    if (dither) {
+      noise = noise * 1664525u + 1013904223u;
+      int32_t a = (noise >> 24) & 0xff;
+      noise = noise * 1664525u + 1013904223u;
+      int32_t b = (noise >> 24) & 0xff;
+      s += a - b;
+    }
+    int32_t duty = ((s + 128) >> 8) + 128;
+    duty = duty < 0 ? 0 : duty > 255 ? 255 : duty;
+    x[i] = (duty - 128) / 128.0;
+  }
+  return in_band_snr(x, SAMPLES, SAMPLE_RATE, freq);
+}
+
+int main(void) {
+  static int16_t pcm[SAMPLES];
+  uint32_t *words = malloc(BITS / 8);
+  double complex *x = malloc(BITS * sizeof(double complex));
+  if (!words || !x) {
+    return 1;
+  }
+
+  static const double levels[] = {0.0, -6.0, -20.0, -40.0, -60.0};
+  static const double freqs[] = {251.0, 997.0, 3989.0};
+  int failures = 0;
+
+  printf("In-band (20Hz-8kHz) SNR, dB\n");
+  printf("  %-8s %7s %8s %8s %8s\n", "level", "freq", "pwm8", "pwm8+tpdf",
+         "sdm");
+  for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+      make_sine(pcm, levels[l], freqs[f]);
+      double plain = pwm8_snr(pcm, freqs[f], false, x);
+      double dithered = pwm8_snr(pcm, freqs[f], true, x);
+      bool bounded;
+      double sdm = sdm_snr(pcm, freqs[f], words, x, &bounded);
+      printf("  %5.0fdBFS %5.0fHz %8.1f %9.1f %8.1f\n", levels[l], freqs[f],
+             plain, dithered, sdm);
+      if ((levels[l] == -6.0 && sdm < MIN_SDM_SNR_DB) || !bounded) {
+        failures++;
+      }
+    }
+  }
+
+  // Rail-to-rail DC is the hardest input for a 1-bit loop
+  static const int16_t dc_levels[] = {INT16_MIN, -16384, 0, 16384, INT16_MAX};
+  for (size_t d = 0; d < sizeof(dc_levels) / sizeof(dc_levels[0]); d++) {
+    audio_sdm_t sdm;
+    audio_sdm_reset(&sdm);
+    for (size_t i = 0; i < SAMPLES; i++) {
+      pcm[i] = dc_levels[d];
+    }
+    audio_sdm_modulate(&sdm, pcm, SAMPLES, words);
+    size_t ones = 0;
+    for (size_t i = 0; i < BITS / 32; i++) {
+      ones += __builtin_popcount(words[i]);
+    }
+    double mean = 2.0 * ones / BITS - 1.0;
+    bool bounded = sdm_bounded(&sdm);
+    printf("  DC %6d: bitstream mean %+.4f (expect %+.4f)%s\n", dc_levels[d],
+           mean, dc_levels[d] / 32768.0 * 0.875,
+           bounded ? "" : " UNSTABLE");
+    if (!bounded || fabs(mean - dc_levels[d] / 32768.0 * 0.875) > 1e-3) {
+      failures++;
+    }
+  }
+
+  free(words);
+  free(x);
+  if (failures) {
+    printf("FAIL: %d case(s) below limits\n", failures);
+    return 1;
+  }
+  return 0;
+}
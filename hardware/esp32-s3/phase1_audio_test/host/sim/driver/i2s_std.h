@@ -0,0 +1,133 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF I2S standard-mode driver. A channel is a
+// ring of dma_desc_num buffers of dma_frame_num frames, serviced by a
+// "DMA" thread at the configured sample rate in simulated time:
+//
+// - RX fills the next buffer from sim_mic_load's WAV audio and queues it;
+//   when the reader has left every buffer unread the oldest is dropped and
+//   on_recv_q_ovf runs, as in the driver.
+// - TX sends the next buffer to the speaker sink each period; if the writer
+//   has not refilled it, the old contents go out again (zeros with
+//   auto_clear) and on_send_q_ovf runs.
+//
+// Callbacks run on the DMA thread, standing in for the ISR.
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  GPIO_NUM_NC = -1,
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6,
+  GPIO_NUM_7, GPIO_NUM_8, GPIO_NUM_9, GPIO_NUM_10, GPIO_NUM_11, GPIO_NUM_12,
+  GPIO_NUM_13, GPIO_NUM_14, GPIO_NUM_15, GPIO_NUM_16, GPIO_NUM_17,
+  GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_20, GPIO_NUM_21, GPIO_NUM_26 = 26,
+  GPIO_NUM_27, GPIO_NUM_28, GPIO_NUM_29, GPIO_NUM_30, GPIO_NUM_31,
+  GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35, GPIO_NUM_36,
+  GPIO_NUM_37, GPIO_NUM_38, GPIO_NUM_39, GPIO_NUM_40, GPIO_NUM_41,
+  GPIO_NUM_42, GPIO_NUM_43, GPIO_NUM_44, GPIO_NUM_45, GPIO_NUM_46,
+  GPIO_NUM_47, GPIO_NUM_48,
+} gpio_num_t;
+
+#define I2S_GPIO_UNUSED GPIO_NUM_NC
+
+typedef enum { I2S_NUM_0, I2S_NUM_1, I2S_NUM_AUTO } i2s_port_t;
+typedef enum { I2S_ROLE_MASTER, I2S_ROLE_SLAVE } i2s_role_t;
+typedef enum {
+  I2S_DATA_BIT_WIDTH_8BIT = 8,
+  I2S_DATA_BIT_WIDTH_16BIT = 16,
+  I2S_DATA_BIT_WIDTH_24BIT = 24,
+  I2S_DATA_BIT_WIDTH_32BIT = 32,
+} i2s_data_bit_width_t;
+typedef enum { I2S_SLOT_MODE_MONO = 1, I2S_SLOT_MODE_STEREO } i2s_slot_mode_t;
+
+typedef struct i2s_channel_obj_t *i2s_chan_handle_t;
+
+typedef struct {
+  i2s_port_t id;
+  i2s_role_t role;
+  uint32_t dma_desc_num;
+  uint32_t dma_frame_num;
+  bool auto_clear;
+  int intr_priority;
+} i2s_chan_config_t;
+
+#define I2S_CHANNEL_DEFAULT_CONFIG(i2s_num, i2s_role)                          \
+  {                                                                            \
+    .id = i2s_num, .role = i2s_role, .dma_desc_num = 6, .dma_frame_num = 240,  \
+    .auto_clear = false, .intr_priority = 0,                                   \
+  }
+
+typedef struct {
+  uint32_t sample_rate_hz;
+} i2s_std_clk_config_t;
+
+typedef struct {
+  i2s_data_bit_width_t data_bit_width;
+  i2s_slot_mode_t slot_mode;
+  bool msb_right; // Unused, kept for the initializers' shape
+} i2s_std_slot_config_t;
+
+#define I2S_STD_CLK_DEFAULT_CONFIG(rate)                                       \
+  { .sample_rate_hz = rate }
+#define I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(bits, mode)                        \
+  { .data_bit_width = bits, .slot_mode = mode }
+#define I2S_STD_MSB_SLOT_DEFAULT_CONFIG(bits, mode)                            \
+  { .data_bit_width = bits, .slot_mode = mode }
+
+typedef struct {
+  gpio_num_t mclk;
+  gpio_num_t bclk;
+  gpio_num_t ws;
+  gpio_num_t dout;
+  gpio_num_t din;
+  struct {
+    bool mclk_inv;
+    bool bclk_inv;
+    bool ws_inv;
+  } invert_flags;
+} i2s_std_gpio_config_t;
+
+typedef struct {
+  i2s_std_clk_config_t clk_cfg;
+  i2s_std_slot_config_t slot_cfg;
+  i2s_std_gpio_config_t gpio_cfg;
+} i2s_std_config_t;
+
+typedef struct {
+  void *data;
+  size_t size;
+} i2s_event_data_t;
+
+typedef bool (*i2s_isr_callback_t)(i2s_chan_handle_t handle,
+                                   i2s_event_data_t *event, void *user_ctx);
+
+typedef struct {
+  i2s_isr_callback_t on_recv;
+  i2s_isr_callback_t on_recv_q_ovf;
+  i2s_isr_callback_t on_sent;
+  i2s_isr_callback_t on_send_q_ovf;
+} i2s_event_callbacks_t;
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t *chan_cfg,
+                          i2s_chan_handle_t *tx_handle,
+                          i2s_chan_handle_t *rx_handle);
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t handle,
+                                    const i2s_std_config_t *std_cfg);
+esp_err_t
+i2s_channel_register_event_callback(i2s_chan_handle_t handle,
+                                    const i2s_event_callbacks_t *callbacks,
+                                    void *user_data);
+esp_err_t i2s_channel_preload_data(i2s_chan_handle_t tx_handle,
+                                   const void *src, size_t size,
+                                   size_t *bytes_loaded);
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle);
+esp_err_t i2s_channel_read(i2s_chan_handle_t handle, void *dest, size_t size,
+                           size_t *bytes_read, uint32_t timeout_ms);
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void *src,
+                            size_t size, size_t *bytes_written,
+                            uint32_t timeout_ms);
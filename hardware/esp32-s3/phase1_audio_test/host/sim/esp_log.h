@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: "I (ms) TAG: message" on stdout,
+// stamped with simulated time
+
+#include "esp_err.h"
+
+void sim_log(char level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) sim_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) sim_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) sim_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
+#define ESP_LOGV(tag, format, ...) ((void)(tag))
@@ -0,0 +1,16 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: the host's own network stack is
+// used, so there is nothing to set up
+
+#include "esp_err.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
+
+typedef enum {
+  IP_EVENT_STA_GOT_IP,
+  IP_EVENT_STA_LOST_IP,
+} ip_event_t;
@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header. The host heap has no fixed size,
+// so the free heap reads as a constant.
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#define SIM_FREE_HEAP_BYTES (8u * 1024 * 1024)
+
+static inline uint32_t esp_get_free_heap_size(void) {
+  return SIM_FREE_HEAP_BYTES;
+}
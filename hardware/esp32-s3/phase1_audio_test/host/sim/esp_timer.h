@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: simulated microseconds since boot
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,63 @@
+#pragma once
+
+// Host stand-in for the esp_websocket_client component over a plain TCP
+// socket (ws:// only). It behaves like the real client where the firmware
+// can tell: messages are sent as buffer_size fragments, received frames
+// larger than buffer_size arrive as several DATA events with
+// payload_offset set, and a dropped connection is retried after
+// reconnect_timeout_ms. The URI can be replaced with sim_options.uri.
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct esp_websocket_client *esp_websocket_client_handle_t;
+
+typedef enum {
+  WEBSOCKET_EVENT_ANY = -1,
+  WEBSOCKET_EVENT_ERROR = 0,
+  WEBSOCKET_EVENT_CONNECTED,
+  WEBSOCKET_EVENT_DISCONNECTED,
+  WEBSOCKET_EVENT_DATA,
+  WEBSOCKET_EVENT_CLOSED,
+  WEBSOCKET_EVENT_BEFORE_CONNECT,
+  WEBSOCKET_EVENT_BEGIN,
+  WEBSOCKET_EVENT_FINISH,
+  WEBSOCKET_EVENT_MAX
+} esp_websocket_event_id_t;
+
+typedef struct {
+  const char *data_ptr;
+  int data_len;
+  bool fin;
+  uint8_t op_code;
+  esp_websocket_client_handle_t client;
+  void *user_context;
+  int payload_len;
+  int payload_offset;
+} esp_websocket_event_data_t;
+
+typedef struct {
+  const char *uri;
+  int task_stack;
+  int buffer_size;          // Default 1024, as on the device
+  int reconnect_timeout_ms; // Default 10000
+  void *user_context;
+} esp_websocket_client_config_t;
+
+esp_websocket_client_handle_t
+esp_websocket_client_init(const esp_websocket_client_config_t *config);
+esp_err_t esp_websocket_register_events(esp_websocket_client_handle_t client,
+                                        esp_websocket_event_id_t event,
+                                        esp_event_handler_t handler,
+                                        void *arg);
+esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t client);
+bool esp_websocket_client_is_connected(esp_websocket_client_handle_t client);
+int esp_websocket_client_send_bin(esp_websocket_client_handle_t client,
+                                  const char *data, int len,
+                                  TickType_t timeout);
+int esp_websocket_client_send_text(esp_websocket_client_handle_t client,
+                                   const char *data, int len,
+                                   TickType_t timeout);
@@ -0,0 +1,54 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header. The station "associates" with any
+// network after SIM_WIFI_CONNECT_MS and then gets an address; the traffic
+// goes over the host's own interfaces.
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include <stdint.h>
+
+#define SIM_WIFI_CONNECT_MS 300
+
+typedef enum {
+  WIFI_EVENT_STA_START = 2,
+  WIFI_EVENT_STA_STOP,
+  WIFI_EVENT_STA_CONNECTED,
+  WIFI_EVENT_STA_DISCONNECTED,
+} wifi_event_t;
+
+typedef enum { WIFI_MODE_NULL, WIFI_MODE_STA, WIFI_MODE_AP } wifi_mode_t;
+typedef enum { WIFI_IF_STA, WIFI_IF_AP } wifi_interface_t;
+typedef enum {
+  WIFI_AUTH_OPEN,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+} wifi_auth_mode_t;
+
+typedef struct {
+  int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT()                                             \
+  { 0 }
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t password[64];
+  struct {
+    wifi_auth_mode_t authmode;
+  } threshold;
+} wifi_sta_config_t;
+
+typedef union {
+  wifi_sta_config_t sta;
+} wifi_config_t;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface,
+                              wifi_config_t *config);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
@@ -0,0 +1,22 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS header: ticks are simulated milliseconds
+
+#include "sdkconfig.h"
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffu)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)                                                      \
+  ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+#define IRAM_ATTR // esp_attr.h, pulled in by FreeRTOS.h on the device
@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS header: each task is a thread that reports
+// the core it was pinned to. Priorities and stack sizes are not simulated;
+// the host scheduler decides who runs.
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+#define tskNO_AFFINITY 0x7fffffff
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t task); // NULL only: the calling task ends
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
@@ -0,0 +1,64 @@
+#pragma once
+
+// Stand-in for libopus when the host has none (no pkg-config opus). The
+// state can be set up, so the firmware starts as usual, but every encode
+// and decode fails: "format opus" needs libopus-dev installed.
+
+#include <stdint.h>
+
+typedef int32_t opus_int32;
+typedef struct OpusEncoder OpusEncoder;
+typedef struct OpusDecoder OpusDecoder;
+
+#define OPUS_OK 0
+#define OPUS_UNIMPLEMENTED -5
+#define OPUS_APPLICATION_VOIP 2048
+#define OPUS_SIGNAL_VOICE 3001
+#define OPUS_SET_BITRATE(x) 4002, (opus_int32)(x)
+#define OPUS_SET_COMPLEXITY(x) 4010, (opus_int32)(x)
+#define OPUS_SET_SIGNAL(x) 4024, (opus_int32)(x)
+#define OPUS_SET_VBR(x) 4006, (opus_int32)(x)
+
+static inline int opus_encoder_get_size(int channels) {
+  return 64 * channels;
+}
+
+static inline int opus_decoder_get_size(int channels) {
+  return 64 * channels;
+}
+
+static inline int opus_encoder_init(OpusEncoder *st, opus_int32 rate,
+                                    int channels, int application) {
+  (void)st, (void)rate, (void)channels, (void)application;
+  return OPUS_OK;
+}
+
+static inline int opus_decoder_init(OpusDecoder *st, opus_int32 rate,
+                                    int channels) {
+  (void)st, (void)rate, (void)channels;
+  return OPUS_OK;
+}
+
+static inline int opus_encoder_ctl(OpusEncoder *st, int request, ...) {
+  (void)st, (void)request;
+  return OPUS_OK;
+}
+
+static inline opus_int32 opus_encode(OpusEncoder *st, const int16_t *pcm,
+                                     int frame_size, unsigned char *data,
+                                     opus_int32 max_data_bytes) {
+  (void)st, (void)pcm, (void)frame_size, (void)data, (void)max_data_bytes;
+  return OPUS_UNIMPLEMENTED;
+}
+
+static inline int opus_decode(OpusDecoder *st, const unsigned char *data,
+                              opus_int32 len, int16_t *pcm, int frame_size,
+                              int decode_fec) {
+  (void)st, (void)data, (void)len, (void)pcm, (void)frame_size;
+  (void)decode_fec;
+  return OPUS_UNIMPLEMENTED;
+}
+
+static inline const char *opus_strerror(int error) {
+  return error == OPUS_OK ? "success" : "not built with libopus";
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: there is no flash to initialize
+
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+
+static inline esp_err_t nvs_flash_init(void) { return ESP_OK; }
+static inline esp_err_t nvs_flash_erase(void) { return ESP_OK; }
@@ -0,0 +1,75 @@
+#pragma once
+
+// Host simulation of the phase1_audio_test firmware: the application and
+// its audio modules are compiled unchanged against the stand-ins in this
+// directory, which replace FreeRTOS, I2S, WiFi and the WebSocket client.
+//
+// Time is simulated: esp_timer, ticks, delays and timeouts all run
+// `speed` times faster than the wall clock, so the firmware sees a normal
+// 16kHz device while it is driven faster than real time. CPU time is
+// always real.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SIM_MAX_WAVS 16
+#define SIM_MAX_TASKS 16
+
+typedef struct {
+  const char *wav[SIM_MAX_WAVS]; // Played into the microphones in order
+  int wav_count;
+  bool loop;          // Start over instead of going silent at the end
+  double speed;       // Simulated seconds per wall-clock second
+  double seconds;     // Simulated run time
+  const char *out;    // Speaker recording, NULL for none
+  const char *uri;    // Replaces WEBSOCKET_URI, NULL to keep it
+} sim_options_t;
+
+extern sim_options_t sim_options;
+
+// Clock: simulated microseconds since sim_clock_start
+void sim_clock_start(double speed);
+int64_t sim_now_us(void);
+void sim_sleep_until(int64_t us);
+struct timespec sim_wall_time(int64_t us); // CLOCK_MONOTONIC deadline
+
+// CPU time of each task so far
+typedef struct {
+  const char *name;
+  int core;
+  double cpu_s;
+} sim_task_usage_t;
+int sim_task_usage(sim_task_usage_t *out, int max);
+
+// Microphones: WAV files as 32-bit stereo I2S frames, the left channel on
+// slot 0 and the right (or the left again) on slot 1. Any rate, pcm16.
+// Returns the total length in 16kHz frames, negative on error.
+int64_t sim_mic_load(const char *const *paths, int count, bool loop);
+
+// Speaker: the TX bitstream decoded back to 16kHz pcm16
+int sim_speaker_open(const char *path);
+void sim_speaker_close(void);
+
+typedef struct {
+  uint64_t mic_frames;      // Delivered by the RX DMA
+  uint32_t mic_buffers;
+  uint32_t mic_overflows;   // RX buffers dropped, the reader fell behind
+  uint64_t speaker_frames;  // Sent by the TX DMA
+  uint32_t speaker_stale;   // TX buffers resent, the writer fell behind
+  uint64_t speaker_active;  // Frames above -60dBFS
+} sim_i2s_stats_t;
+void sim_i2s_stats(sim_i2s_stats_t *stats);
+
+typedef struct {
+  uint32_t connects;
+  uint32_t messages_sent;
+  uint64_t bytes_sent;
+  uint32_t messages_received;
+  uint64_t bytes_received;
+} sim_ws_stats_t;
+void sim_ws_stats(sim_ws_stats_t *stats);
+
+// Event loop for WiFi and IP events, posted `delay_us` from now
+void sim_event_post(const char *base, int32_t id, int64_t delay_us);
@@ -0,0 +1,33 @@
+// The allocator hooks of ESP-IDF's heap_caps, for the simulation.
+// phase1_sim links with --wrap for the C allocator, so every allocation
+// made by the firmware and the stand-ins, whichever task makes it, reaches
+// esp_heap_trace_alloc_hook() as it would on the device. Allocations
+// inside libc and libopus are not seen.
+
+#include "esp_heap_caps.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+
+static void *hooked(void *ptr, size_t size) {
+  if (ptr) {
+    esp_heap_trace_alloc_hook(ptr, size, MALLOC_CAP_8BIT);
+  }
+  return ptr;
+}
+
+void *__wrap_malloc(size_t size) { return hooked(__real_malloc(size), size); }
+
+void *__wrap_calloc(size_t count, size_t size) {
+  return hooked(__real_calloc(count, size), count * size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  return hooked(__real_realloc(ptr, size), size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+  return hooked(__real_aligned_alloc(alignment, size), size);
+}
@@ -0,0 +1,515 @@
+// I2S channels paced in simulated time, WAV microphones and a speaker sink
+
+#include "sim.h"
+
+#include "audio_resampler.h"
+#include "audio_sdm.h"
+#include "driver/i2s_std.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIC_RATE 16000
+#define SPEAKER_RATE 16000
+#define SPEAKER_ACTIVE_LEVEL 33 // -60dBFS
+#define CIC_GAIN (AUDIO_SDM_OSR * AUDIO_SDM_OSR * AUDIO_SDM_OSR)
+
+struct i2s_channel_obj_t {
+  bool tx;
+  uint32_t desc_num;
+  uint32_t frame_num;
+  size_t buf_bytes;
+  bool auto_clear;
+  uint32_t rate;
+  uint8_t *bufs; // desc_num buffers of buf_bytes
+  i2s_event_callbacks_t callbacks;
+  void *user_data;
+  pthread_mutex_t lock;
+  pthread_cond_t cond; // A buffer was filled (RX) or freed (TX)
+  // RX: buffers filled by the DMA / fully read. TX: buffers fully written /
+  // sent by the DMA. Both count up; buffer n lives at n % desc_num.
+  uint64_t filled, drained;
+  size_t offset; // Into the buffer being read (RX) or written (TX)
+  bool enabled;
+  pthread_t dma;
+};
+
+// Microphones: interleaved stereo pcm16 at MIC_RATE
+static struct {
+  int16_t *pcm;
+  size_t frames;
+  size_t pos;
+  bool loop;
+} mic;
+
+// Speaker: sinc^3 decimator over the bitstream, as a sigma-delta ADC
+// would read it, into a 16kHz WAV
+static struct {
+  pthread_mutex_t lock;
+  FILE *file;
+  uint32_t data_bytes;
+  uint32_t integrator[3]; // Wrap around; the comb differences stay exact
+  uint32_t comb[3];
+} speaker = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_i2s_stats_t stats;
+
+// --- WAV files ---
+
+static uint32_t le32(const uint8_t *p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint16_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+// Append one pcm16 WAV file to mic.pcm as 16kHz stereo
+static int load_wav(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *file = malloc((size_t)size);
+  if (!file || fread(file, 1, (size_t)size, f) != (size_t)size) {
+    fprintf(stderr, "%s: read failed\n", path);
+    fclose(f);
+    free(file);
+    return -1;
+  }
+  fclose(f);
+
+  uint16_t channels = 0, bits = 0, format = 0;
+  uint32_t rate = 0;
+  const uint8_t *data = NULL;
+  size_t data_len = 0;
+  if (size < 12 || memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4)) {
+    fprintf(stderr, "%s: not a WAV file\n", path);
+    free(file);
+    return -1;
+  }
+  for (long at = 12; at + 8 <= size;) {
+    uint32_t len = le32(file + at + 4);
+    const uint8_t *body = file + at + 8;
+    if (len > (uint32_t)(size - at - 8)) {
+      len = (uint32_t)(size - at - 8);
+    }
+    if (memcmp(file + at, "fmt ", 4) == 0 && len >= 16) {
+      format = le16(body);
+      channels = le16(body + 2);
+      rate = le32(body + 4);
+      bits = le16(body + 14);
+    } else if (memcmp(file + at, "data", 4) == 0) {
+      data = body;
+      data_len = len;
+    }
+    at += 8 + len + (len & 1);
+  }
+  // 0xfffe is WAVE_FORMAT_EXTENSIBLE, which pcm16 files may use as well
+  if (!data || (format != 1 && format != 0xfffe) || bits != 16 ||
+      channels < 1 || channels > 2) {
+    fprintf(stderr, "%s: need 16-bit PCM, mono or stereo\n", path);
+    free(file);
+    return -1;
+  }
+
+  size_t in_frames = data_len / (2 * channels);
+  audio_resampler_t rs[2];
+  size_t out_max = in_frames;
+  if (rate != MIC_RATE) {
+    for (int c = 0; c < 2; c++) {
+      if (audio_resampler_init(&rs[c], rate, MIC_RATE, 0) != ESP_OK) {
+        fprintf(stderr, "%s: cannot resample %u Hz\n", path,
+                (unsigned int)rate);
+        free(file);
+        return -1;
+      }
+    }
+    out_max = audio_resampler_max_output(&rs[0], in_frames);
+  }
+
+  int16_t *in = malloc(in_frames * sizeof(int16_t));
+  int16_t *out = malloc(out_max * sizeof(int16_t));
+  int16_t *grown =
+      realloc(mic.pcm, (mic.frames + out_max) * 2 * sizeof(int16_t));
+  if (!in || !out || !grown) {
+    free(in);
+    free(out);
+    free(file);
+    return -1;
+  }
+  mic.pcm = grown;
+  size_t out_frames = 0;
+  for (int c = 0; c < 2; c++) {
+    int source = c < channels ? c : 0;
+    for (size_t i = 0; i < in_frames; i++) {
+      in[i] = (int16_t)le16(data + 2 * (i * channels + source));
+    }
+    out_frames = in_frames;
+    if (rate != MIC_RATE) {
+      out_frames = audio_resampler_process(&rs[c], in, in_frames, out);
+    } else {
+      memcpy(out, in, in_frames * sizeof(int16_t));
+    }
+    for (size_t i = 0; i < out_frames; i++) {
+      mic.pcm[2 * (mic.frames + i) + c] = out[i];
+    }
+  }
+  mic.frames += out_frames;
+  printf("sim: mic %s, %u Hz x%u, %.2fs\n", path, (unsigned int)rate,
+         (unsigned int)channels, (double)out_frames / MIC_RATE);
+  free(in);
+  free(out);
+  free(file);
+  return 0;
+}
+
+int64_t sim_mic_load(const char *const *paths, int count, bool loop) {
+  for (int i = 0; i < count; i++) {
+    if (load_wav(paths[i]) < 0) {
+      return -1;
+    }
+  }
+  mic.loop = loop && mic.frames > 0;
+  return (int64_t)mic.frames;
+}
+
+// INMP441 frames: 24-bit samples left-aligned in 32-bit slots
+static void mic_fill(int32_t *frames, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (mic.pos == mic.frames && mic.loop) {
+      mic.pos = 0;
+    }
+    int32_t left = 0, right = 0;
+    if (mic.pos < mic.frames) {
+      left = mic.pcm[2 * mic.pos];
+      right = mic.pcm[2 * mic.pos + 1];
+      mic.pos++;
+    }
+    frames[2 * i] = (int32_t)((uint32_t)left << 16);
+    frames[2 * i + 1] = (int32_t)((uint32_t)right << 16);
+  }
+}
+
+int sim_speaker_open(const char *path) {
+  pthread_mutex_lock(&speaker.lock);
+  speaker.file = fopen(path, "wb");
+  if (speaker.file) {
+    uint8_t header[44] = {0};
+    fwrite(header, 1, sizeof(header), speaker.file);
+  }
+  pthread_mutex_unlock(&speaker.lock);
+  return speaker.file ? 0 : -1;
+}
+
+void sim_speaker_close(void) {
+  pthread_mutex_lock(&speaker.lock);
+  if (speaker.file) {
+    uint8_t h[44];
+    memcpy(h, "RIFF", 4);
+    put_le32(h + 4, 36 + speaker.data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le32(h + 16, 16);
+    h[20] = 1, h[21] = 0; // PCM
+    h[22] = 1, h[23] = 0; // Mono
+    put_le32(h + 24, SPEAKER_RATE);
+    put_le32(h + 28, SPEAKER_RATE * 2);
+    h[32] = 2, h[33] = 0;
+    h[34] = 16, h[35] = 0;
+    memcpy(h + 36, "data", 4);
+    put_le32(h + 40, speaker.data_bytes);
+    fseek(speaker.file, 0, SEEK_SET);
+    fwrite(h, 1, sizeof(h), speaker.file);
+    fclose(speaker.file);
+    speaker.file = NULL;
+  }
+  pthread_mutex_unlock(&speaker.lock);
+}
+
+// One TX buffer: each 32-bit stereo frame carries the AUDIO_SDM_OSR bits of
+// one sample, MSB first, left slot first
+static void speaker_play(const uint32_t *words, size_t frames) {
+  int16_t pcm[512];
+  uint64_t active = 0;
+  pthread_mutex_lock(&speaker.lock);
+  for (size_t i = 0; i < frames; i++) {
+    for (int w = 0; w < AUDIO_SDM_WORDS_PER_SAMPLE; w++) {
+      uint32_t word = words[i * AUDIO_SDM_WORDS_PER_SAMPLE + w];
+      for (int b = 31; b >= 0; b--) {
+        speaker.integrator[0] += (word >> b & 1) ? 1u : (uint32_t)-1;
+        speaker.integrator[1] += speaker.integrator[0];
+        speaker.integrator[2] += speaker.integrator[1];
+      }
+    }
+    uint32_t v = speaker.integrator[2];
+    for (int k = 0; k < 3; k++) {
+      uint32_t d = v - speaker.comb[k];
+      speaker.comb[k] = v;
+      v = d;
+    }
+    // Undo the modulator's 7/8 input scaling
+    float x = (float)(int32_t)v / CIC_GAIN * 8 / 7 * 32767;
+    int16_t s = (int16_t)(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+    active += s > SPEAKER_ACTIVE_LEVEL || s < -SPEAKER_ACTIVE_LEVEL;
+    pcm[i % 512] = s;
+    if (speaker.file && (i % 512 == 511 || i + 1 == frames)) {
+      size_t n = i % 512 + 1;
+      fwrite(pcm, sizeof(int16_t), n, speaker.file);
+      speaker.data_bytes += (uint32_t)(n * sizeof(int16_t));
+    }
+  }
+  pthread_mutex_unlock(&speaker.lock);
+
+  pthread_mutex_lock(&stats_lock);
+  stats.speaker_frames += frames;
+  stats.speaker_active += active;
+  pthread_mutex_unlock(&stats_lock);
+}
+
+void sim_i2s_stats(sim_i2s_stats_t *out) {
+  pthread_mutex_lock(&stats_lock);
+  *out = stats;
+  pthread_mutex_unlock(&stats_lock);
+}
+
+// --- Channels ---
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t *chan_cfg,
+                          i2s_chan_handle_t *tx_handle,
+                          i2s_chan_handle_t *rx_handle) {
+  if (!tx_handle == !rx_handle) {
+    return ESP_ERR_NOT_SUPPORTED; // One direction per channel here
+  }
+  i2s_chan_handle_t ch = calloc(1, sizeof(*ch));
+  if (!ch) {
+    return ESP_ERR_NO_MEM;
+  }
+  ch->tx = tx_handle != NULL;
+  ch->desc_num = chan_cfg->dma_desc_num;
+  ch->frame_num = chan_cfg->dma_frame_num;
+  ch->auto_clear = chan_cfg->auto_clear;
+  pthread_mutex_init(&ch->lock, NULL);
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&ch->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  *(ch->tx ? tx_handle : rx_handle) = ch;
+  return ESP_OK;
+}
+
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t ch,
+                                    const i2s_std_config_t *std_cfg) {
+  if (std_cfg->slot_cfg.data_bit_width != I2S_DATA_BIT_WIDTH_32BIT ||
+      std_cfg->slot_cfg.slot_mode != I2S_SLOT_MODE_STEREO) {
+    return ESP_ERR_NOT_SUPPORTED; // All the firmware uses
+  }
+  ch->rate = std_cfg->clk_cfg.sample_rate_hz;
+  ch->buf_bytes = ch->frame_num * 2 * sizeof(int32_t);
+  ch->bufs = calloc(ch->desc_num, ch->buf_bytes);
+  return ch->bufs ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t
+i2s_channel_register_event_callback(i2s_chan_handle_t ch,
+                                    const i2s_event_callbacks_t *callbacks,
+                                    void *user_data) {
+  ch->callbacks = *callbacks;
+  ch->user_data = user_data;
+  return ESP_OK;
+}
+
+static uint8_t *buffer(i2s_chan_handle_t ch, uint64_t n) {
+  return ch->bufs + (n % ch->desc_num) * ch->buf_bytes;
+}
+
+static void dma_rx_period(i2s_chan_handle_t ch) {
+  pthread_mutex_lock(&ch->lock);
+  if (ch->filled - ch->drained == ch->desc_num) {
+    // Queue full: the oldest buffer is overwritten unread
+    ch->drained++;
+    ch->offset = 0;
+    if (ch->callbacks.on_recv_q_ovf) {
+      ch->callbacks.on_recv_q_ovf(ch, NULL, ch->user_data);
+    }
+    pthread_mutex_lock(&stats_lock);
+    stats.mic_overflows++;
+    pthread_mutex_unlock(&stats_lock);
+  }
+  uint8_t *buf = buffer(ch, ch->filled);
+  mic_fill((int32_t *)buf, ch->frame_num);
+  ch->filled++;
+  if (ch->callbacks.on_recv) {
+    i2s_event_data_t event = {.data = buf, .size = ch->buf_bytes};
+    ch->callbacks.on_recv(ch, &event, ch->user_data);
+  }
+  pthread_cond_broadcast(&ch->cond);
+  pthread_mutex_unlock(&ch->lock);
+
+  pthread_mutex_lock(&stats_lock);
+  stats.mic_frames += ch->frame_num;
+  stats.mic_buffers++;
+  pthread_mutex_unlock(&stats_lock);
+}
+
+static void dma_tx_period(i2s_chan_handle_t ch, uint32_t *out) {
+  pthread_mutex_lock(&ch->lock);
+  uint8_t *buf = buffer(ch, ch->drained);
+  bool stale = ch->filled == ch->drained;
+  if (stale) {
+    // The writer is late: the ring comes round to old data again
+    if (ch->auto_clear) {
+      memset(buf, 0, ch->buf_bytes);
+    }
+    if (ch->callbacks.on_send_q_ovf) {
+      ch->callbacks.on_send_q_ovf(ch, NULL, ch->user_data);
+    }
+  }
+  memcpy(out, buf, ch->buf_bytes);
+  ch->drained++;
+  if (stale) {
+    ch->filled = ch->drained;
+    ch->offset = 0;
+  }
+  pthread_cond_broadcast(&ch->cond);
+  pthread_mutex_unlock(&ch->lock);
+
+  if (stale) {
+    pthread_mutex_lock(&stats_lock);
+    stats.speaker_stale++;
+    pthread_mutex_unlock(&stats_lock);
+  }
+  speaker_play(out, ch->frame_num);
+}
+
+// Stands in for the DMA engine: one buffer per period, in simulated time
+static void *dma_thread(void *arg) {
+  i2s_chan_handle_t ch = arg;
+  uint32_t *out = malloc(ch->buf_bytes);
+  int64_t start = sim_now_us();
+  for (uint64_t n = 1;; n++) {
+    sim_sleep_until(start +
+                    (int64_t)(n * ch->frame_num * 1000000 / ch->rate));
+    if (ch->tx) {
+      dma_tx_period(ch, out);
+    } else {
+      dma_rx_period(ch);
+    }
+  }
+  return NULL;
+}
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t ch) {
+  if (ch->enabled || !ch->bufs) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  ch->enabled = true;
+  if (pthread_create(&ch->dma, NULL, dma_thread, ch) != 0) {
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+// Copy into the TX ring at the write position; the caller holds the lock
+static size_t tx_copy(i2s_chan_handle_t ch, const uint8_t *src, size_t size) {
+  size_t done = 0;
+  while (done < size && ch->filled - ch->drained < ch->desc_num) {
+    size_t n = ch->buf_bytes - ch->offset;
+    n = n < size - done ? n : size - done;
+    memcpy(buffer(ch, ch->filled) + ch->offset, src + done, n);
+    ch->offset += n;
+    done += n;
+    if (ch->offset == ch->buf_bytes) {
+      ch->filled++;
+      ch->offset = 0;
+    }
+  }
+  return done;
+}
+
+esp_err_t i2s_channel_preload_data(i2s_chan_handle_t ch, const void *src,
+                                   size_t size, size_t *bytes_loaded) {
+  if (!ch->tx || ch->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  pthread_mutex_lock(&ch->lock);
+  *bytes_loaded = tx_copy(ch, src, size);
+  pthread_mutex_unlock(&ch->lock);
+  return ESP_OK;
+}
+
+// Wait on the channel for up to `timeout_ms` simulated; false on timeout
+static bool wait(i2s_chan_handle_t ch, uint32_t timeout_ms,
+                 const struct timespec *deadline) {
+  if (timeout_ms == portMAX_DELAY) {
+    pthread_cond_wait(&ch->cond, &ch->lock);
+    return true;
+  }
+  return pthread_cond_timedwait(&ch->cond, &ch->lock, deadline) != ETIMEDOUT;
+}
+
+esp_err_t i2s_channel_read(i2s_chan_handle_t ch, void *dest, size_t size,
+                           size_t *bytes_read, uint32_t timeout_ms) {
+  struct timespec deadline =
+      sim_wall_time(sim_now_us() + (int64_t)timeout_ms * 1000);
+  uint8_t *out = dest;
+  size_t done = 0;
+  esp_err_t ret = ESP_OK;
+  pthread_mutex_lock(&ch->lock);
+  while (done < size) {
+    if (ch->filled == ch->drained) {
+      if (!wait(ch, timeout_ms, &deadline)) {
+        ret = ESP_ERR_TIMEOUT;
+        break;
+      }
+      continue;
+    }
+    size_t n = ch->buf_bytes - ch->offset;
+    n = n < size - done ? n : size - done;
+    memcpy(out + done, buffer(ch, ch->drained) + ch->offset, n);
+    ch->offset += n;
+    done += n;
+    if (ch->offset == ch->buf_bytes) {
+      ch->drained++;
+      ch->offset = 0;
+    }
+  }
+  pthread_mutex_unlock(&ch->lock);
+  *bytes_read = done;
+  return ret;
+}
+
+esp_err_t i2s_channel_write(i2s_chan_handle_t ch, const void *src,
+                            size_t size, size_t *bytes_written,
+                            uint32_t timeout_ms) {
+  struct timespec deadline =
+      sim_wall_time(sim_now_us() + (int64_t)timeout_ms * 1000);
+  const uint8_t *in = src;
+  size_t done = 0;
+  esp_err_t ret = ESP_OK;
+  pthread_mutex_lock(&ch->lock);
+  while (done < size) {
+    done += tx_copy(ch, in + done, size - done);
+    if (done < size && !wait(ch, timeout_ms, &deadline)) {
+      ret = ESP_ERR_TIMEOUT;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ch->lock);
+  *bytes_written = done;
+  return ret;
+}
@@ -0,0 +1,162 @@
+// Runs the firmware's app_main on the host, with WAV files for microphones,
+// a WAV recording for the speaker and a real WebSocket connection.
+//
+//   phase1_sim [--wav FILE]... [--loop] [--speed X] [--seconds S]
+//              [--out FILE] [--uri ws://HOST:PORT/PATH]
+//
+// The run lasts --seconds of simulated time (default: the WAV files plus
+// 3s for the reply), --speed times faster than real time. At the end the
+// CPU time of every task, the achieved speed and the I2S and WebSocket
+// traffic are printed; the firmware's own stats log and "stats" frames
+// carry its latency histograms as usual. The server keeps wall-clock
+// time, so its own delays only read true at --speed 1. For example,
+// against the echo server:
+//
+//   ./frame_server --echo --delay 200 &
+//   ./phase1_sim --wav $WAVS/monthly-expenses.wav --loop --seconds 60
+//       --speed 4 --out speaker.wav
+//
+// with WAVS=../../../../voice-agent/tests/audio.
+
+#include "sim.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "freertos/task.h"
+
+#define DEFAULT_URI "ws://127.0.0.1:3000/api/audio/realtime"
+#define TAIL_SECONDS 3.0
+#define MAIN_TASK_CORE 0 // app_main runs on the PRO CPU
+#define MAIN_TASK_STACK 3584
+
+void app_main(void);
+
+sim_options_t sim_options = {.speed = 1.0, .uri = DEFAULT_URI};
+
+static volatile sig_atomic_t interrupted;
+
+static void on_signal(int sig) {
+  (void)sig;
+  interrupted = 1;
+}
+
+static void main_task(void *arg) {
+  (void)arg;
+  app_main();
+  // app_main only returns when setup failed; keep the task alive like
+  // the idle task would be
+  while (1) {
+    vTaskDelay(portMAX_DELAY);
+  }
+}
+
+static double timeval_s(struct timeval tv) {
+  return (double)tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(double sim_s) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double cpu_s = timeval_s(usage.ru_utime) + timeval_s(usage.ru_stime);
+  sim_i2s_stats_t i2s;
+  sim_i2s_stats(&i2s);
+  sim_ws_stats_t ws;
+  sim_ws_stats(&ws);
+
+  printf("\nsim: %.1fs simulated at %.2fx real time\n", sim_s,
+         sim_options.speed);
+  printf("sim: mic %.1fs in %u DMA buffers, %u overflows\n",
+         (double)i2s.mic_frames / 16000, (unsigned int)i2s.mic_buffers,
+         (unsigned int)i2s.mic_overflows);
+  printf("sim: speaker %.1fs, %.1fs audible, %u stale DMA buffers\n",
+         (double)i2s.speaker_frames / 16000,
+         (double)i2s.speaker_active / 16000, (unsigned int)i2s.speaker_stale);
+  printf("sim: websocket %u connects, sent %u messages %.1f kbit/s, "
+         "received %u messages %.1f kbit/s\n",
+         (unsigned int)ws.connects, (unsigned int)ws.messages_sent,
+         (double)ws.bytes_sent * 8 / 1000 / sim_s,
+         (unsigned int)ws.messages_received,
+         (double)ws.bytes_received * 8 / 1000 / sim_s);
+  printf("sim: cpu %.3fs, %.2f%% of one host core per simulated second\n",
+         cpu_s, 100 * cpu_s / sim_s);
+
+  sim_task_usage_t tasks[SIM_MAX_TASKS];
+  int n = sim_task_usage(tasks, SIM_MAX_TASKS);
+  printf("  %-16s %4s %10s %8s\n", "task", "core", "cpu ms", "% core");
+  for (int i = 0; i < n; i++) {
+    printf("  %-16s %4d %10.1f %8.3f\n", tasks[i].name, tasks[i].core,
+           tasks[i].cpu_s * 1000, 100 * tasks[i].cpu_s / sim_s);
+  }
+  fflush(stdout);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [--wav FILE]... [--loop] [--speed X] [--seconds S]\n"
+          "          [--out FILE] [--uri ws://HOST:PORT/PATH]\n",
+          name);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--wav") == 0 && i + 1 < argc) {
+      if (sim_options.wav_count == SIM_MAX_WAVS) {
+        usage(argv[0]);
+      }
+      sim_options.wav[sim_options.wav_count++] = argv[++i];
+    } else if (strcmp(argv[i], "--loop") == 0) {
+      sim_options.loop = true;
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      sim_options.speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      sim_options.seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      sim_options.out = argv[++i];
+    } else if (strcmp(argv[i], "--uri") == 0 && i + 1 < argc) {
+      sim_options.uri = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (sim_options.speed <= 0) {
+    usage(argv[0]);
+  }
+
+  int64_t frames =
+      sim_mic_load(sim_options.wav, sim_options.wav_count, sim_options.loop);
+  if (frames < 0) {
+    return 1;
+  }
+  if (sim_options.seconds <= 0) {
+    sim_options.seconds = (double)frames / 16000 + TAIL_SECONDS;
+  }
+  if (sim_options.out && sim_speaker_open(sim_options.out) < 0) {
+    perror(sim_options.out);
+    return 1;
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  printf("sim: %.1fs at %.2fx, server %s\n", sim_options.seconds,
+         sim_options.speed, sim_options.uri);
+  sim_clock_start(sim_options.speed);
+  xTaskCreatePinnedToCore(main_task, "main", MAIN_TASK_STACK, NULL, 1, NULL,
+                          MAIN_TASK_CORE);
+
+  int64_t end = (int64_t)(sim_options.seconds * 1e6);
+  while (!interrupted && sim_now_us() < end) {
+    usleep(20000);
+  }
+  double sim_s = (double)sim_now_us() / 1e6;
+  sim_speaker_close();
+  report(sim_s);
+  // The firmware's tasks never end; leave them running into exit
+  fflush(stdout);
+  _exit(0);
+}
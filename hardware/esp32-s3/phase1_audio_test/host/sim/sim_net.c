@@ -0,0 +1,545 @@
+// Event loop, WiFi, and a WebSocket client on a host TCP socket
+
+#include "sim.h"
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_websocket_client.h"
+#include "esp_wifi.h"
+#include "freertos/task.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_HANDLERS 8
+#define MAX_EVENTS 16
+#define DEFAULT_BUFFER_SIZE 1024
+#define DEFAULT_RECONNECT_MS 10000
+#define WS_CONTINUATION 0x0
+#define WS_TEXT 0x1
+#define WS_BINARY 0x2
+#define WS_CLOSE 0x8
+#define WS_PING 0x9
+#define WS_PONG 0xa
+#define WS_FIN 0x80
+
+static const char *TAG = "websocket_client";
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+// --- Default event loop ---
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+  } handlers[MAX_HANDLERS];
+  int handler_count;
+  struct {
+    esp_event_base_t base;
+    int32_t id;
+    int64_t due_us;
+  } queue[MAX_EVENTS];
+  int queued;
+} loop = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void event_task(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&loop.lock);
+  while (1) {
+    // Earliest due event first
+    int next = -1;
+    for (int i = 0; i < loop.queued; i++) {
+      if (next < 0 || loop.queue[i].due_us < loop.queue[next].due_us) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      pthread_cond_wait(&loop.cond, &loop.lock);
+      continue;
+    }
+    if (loop.queue[next].due_us > sim_now_us()) {
+      struct timespec ts = sim_wall_time(loop.queue[next].due_us);
+      pthread_cond_timedwait(&loop.cond, &loop.lock, &ts);
+      continue;
+    }
+    esp_event_base_t base = loop.queue[next].base;
+    int32_t id = loop.queue[next].id;
+    loop.queue[next] = loop.queue[--loop.queued];
+    for (int i = 0; i < loop.handler_count; i++) {
+      if (loop.handlers[i].base == base &&
+          (loop.handlers[i].id == ESP_EVENT_ANY_ID ||
+           loop.handlers[i].id == id)) {
+        esp_event_handler_t handler = loop.handlers[i].handler;
+        void *handler_arg = loop.handlers[i].arg;
+        pthread_mutex_unlock(&loop.lock);
+        handler(handler_arg, base, id, NULL);
+        pthread_mutex_lock(&loop.lock);
+      }
+    }
+  }
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&loop.cond, &attr);
+  pthread_condattr_destroy(&attr);
+  return xTaskCreatePinnedToCore(event_task, "sys_evt", 2304, NULL, 20, NULL,
+                                 0) == pdPASS
+             ? ESP_OK
+             : ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+                                     esp_event_handler_t handler, void *arg) {
+  pthread_mutex_lock(&loop.lock);
+  esp_err_t ret = ESP_ERR_NO_MEM;
+  if (loop.handler_count < MAX_HANDLERS) {
+    loop.handlers[loop.handler_count].base = base;
+    loop.handlers[loop.handler_count].id = id;
+    loop.handlers[loop.handler_count].handler = handler;
+    loop.handlers[loop.handler_count].arg = arg;
+    loop.handler_count++;
+    ret = ESP_OK;
+  }
+  pthread_mutex_unlock(&loop.lock);
+  return ret;
+}
+
+void sim_event_post(const char *base, int32_t id, int64_t delay_us) {
+  pthread_mutex_lock(&loop.lock);
+  if (loop.queued < MAX_EVENTS) {
+    loop.queue[loop.queued].base = base;
+    loop.queue[loop.queued].id = id;
+    loop.queue[loop.queued].due_us = sim_now_us() + delay_us;
+    loop.queued++;
+    pthread_cond_signal(&loop.cond);
+  }
+  pthread_mutex_unlock(&loop.lock);
+}
+
+// --- WiFi and netif ---
+
+esp_err_t esp_netif_init(void) { return ESP_OK; }
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void) { return NULL; }
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) {
+  (void)config;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+  (void)mode;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface,
+                              wifi_config_t *config) {
+  (void)interface, (void)config;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+  sim_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, 0);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void) {
+  sim_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                 (int64_t)SIM_WIFI_CONNECT_MS * 1000);
+  return ESP_OK;
+}
+
+// --- WebSocket client ---
+
+struct esp_websocket_client {
+  char uri[256];
+  char host[128];
+  char port[8];
+  char path[128];
+  int buffer_size;
+  int reconnect_ms;
+  void *user_context;
+  esp_event_handler_t handler;
+  void *handler_arg;
+  int fd;
+  volatile bool connected;
+  bool started;
+  uint32_t mask_seed;
+  pthread_mutex_t tx_lock; // One message at a time, like the client's lock
+  uint8_t *rx_buffer;
+  uint8_t *tx_buffer; // Header plus buffer_size, masked in place
+};
+
+static pthread_mutex_t ws_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_ws_stats_t ws_stats;
+
+void sim_ws_stats(sim_ws_stats_t *out) {
+  pthread_mutex_lock(&ws_stats_lock);
+  *out = ws_stats;
+  pthread_mutex_unlock(&ws_stats_lock);
+}
+
+// ws://host[:port][/path]
+static bool parse_uri(esp_websocket_client_handle_t client, const char *uri) {
+  if (strncmp(uri, "ws://", 5) != 0) {
+    return false;
+  }
+  const char *host = uri + 5;
+  size_t host_len = strcspn(host, ":/");
+  if (host_len == 0 || host_len >= sizeof(client->host)) {
+    return false;
+  }
+  memcpy(client->host, host, host_len);
+  client->host[host_len] = '\0';
+  const char *rest = host + host_len;
+  snprintf(client->port, sizeof(client->port), "80");
+  if (*rest == ':') {
+    size_t port_len = strcspn(rest + 1, "/");
+    if (port_len == 0 || port_len >= sizeof(client->port)) {
+      return false;
+    }
+    memcpy(client->port, rest + 1, port_len);
+    client->port[port_len] = '\0';
+    rest += 1 + port_len;
+  }
+  snprintf(client->path, sizeof(client->path), "%s", *rest ? rest : "/");
+  return true;
+}
+
+esp_websocket_client_handle_t
+esp_websocket_client_init(const esp_websocket_client_config_t *config) {
+  esp_websocket_client_handle_t client = calloc(1, sizeof(*client));
+  if (!client) {
+    return NULL;
+  }
+  const char *uri = sim_options.uri ? sim_options.uri : config->uri;
+  snprintf(client->uri, sizeof(client->uri), "%s", uri);
+  if (!parse_uri(client, uri)) {
+    ESP_LOGE(TAG, "Unsupported URI %s (ws:// only)", uri);
+    free(client);
+    return NULL;
+  }
+  client->buffer_size =
+      config->buffer_size > 0 ? config->buffer_size : DEFAULT_BUFFER_SIZE;
+  client->reconnect_ms = config->reconnect_timeout_ms > 0
+                             ? config->reconnect_timeout_ms
+                             : DEFAULT_RECONNECT_MS;
+  client->user_context = config->user_context;
+  client->fd = -1;
+  client->mask_seed = 0x9e3779b9u;
+  pthread_mutex_init(&client->tx_lock, NULL);
+  client->rx_buffer = malloc((size_t)client->buffer_size);
+  client->tx_buffer = malloc((size_t)client->buffer_size + 14);
+  if (!client->rx_buffer || !client->tx_buffer) {
+    free(client->rx_buffer);
+    free(client->tx_buffer);
+    free(client);
+    return NULL;
+  }
+  return client;
+}
+
+esp_err_t esp_websocket_register_events(esp_websocket_client_handle_t client,
+                                        esp_websocket_event_id_t event,
+                                        esp_event_handler_t handler,
+                                        void *arg) {
+  if (!client || event != WEBSOCKET_EVENT_ANY) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  client->handler = handler;
+  client->handler_arg = arg;
+  return ESP_OK;
+}
+
+static void post(esp_websocket_client_handle_t client, int32_t id,
+                 esp_websocket_event_data_t *data) {
+  esp_websocket_event_data_t empty = {0};
+  data = data ? data : &empty;
+  data->client = client;
+  data->user_context = client->user_context;
+  if (client->handler) {
+    client->handler(client->handler_arg, "WEBSOCKET_EVENTS", id, data);
+  }
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+  uint8_t *p = buf;
+  while (len > 0) {
+    ssize_t n = recv(fd, p, len, 0);
+    if (n <= 0) {
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+  const uint8_t *p = buf;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int tcp_connect(const char *host, const char *port) {
+  struct addrinfo hints = {.ai_family = AF_UNSPEC,
+                           .ai_socktype = SOCK_STREAM};
+  struct addrinfo *res;
+  if (getaddrinfo(host, port, &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd >= 0) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+  return fd;
+}
+
+// Upgrade request; any "101" status is taken as success, the accept key
+// is not checked
+static bool handshake(esp_websocket_client_handle_t client) {
+  char request[512];
+  int n = snprintf(request, sizeof(request),
+                   "GET %s HTTP/1.1\r\n"
+                   "Host: %s:%s\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                   "Sec-WebSocket-Version: 13\r\n"
+                   "User-Agent: ESP32 Websocket Client\r\n\r\n",
+                   client->path, client->host, client->port);
+  if (write_all(client->fd, request, (size_t)n) < 0) {
+    return false;
+  }
+  char response[1024];
+  size_t used = 0;
+  while (used < sizeof(response) - 1) {
+    if (recv(client->fd, &response[used], 1, 0) != 1) {
+      return false;
+    }
+    used++;
+    if (used >= 4 && memcmp(&response[used - 4], "\r\n\r\n", 4) == 0) {
+      break;
+    }
+  }
+  response[used] = '\0';
+  return strncmp(response, "HTTP/1.1 101", 12) == 0;
+}
+
+static int send_frame(esp_websocket_client_handle_t client, uint8_t opcode,
+                      const uint8_t *data, size_t len) {
+  uint8_t *frame = client->tx_buffer;
+  size_t header = 2;
+  frame[0] = opcode;
+  if (len < 126) {
+    frame[1] = 0x80 | (uint8_t)len;
+  } else {
+    frame[1] = 0x80 | 126;
+    frame[2] = (uint8_t)(len >> 8);
+    frame[3] = (uint8_t)len;
+    header = 4;
+  }
+  // Clients must mask; any key will do
+  client->mask_seed = client->mask_seed * 1664525u + 1013904223u;
+  uint8_t *mask = frame + header;
+  for (int i = 0; i < 4; i++) {
+    mask[i] = (uint8_t)(client->mask_seed >> (8 * i));
+  }
+  for (size_t i = 0; i < len; i++) {
+    frame[header + 4 + i] = data[i] ^ mask[i % 4];
+  }
+  return write_all(client->fd, frame, header + 4 + len);
+}
+
+static int send_message(esp_websocket_client_handle_t client, uint8_t opcode,
+                        const char *data, int len) {
+  if (!client || !client->connected) {
+    ESP_LOGE(TAG, "Websocket client is not connected");
+    return -1;
+  }
+  pthread_mutex_lock(&client->tx_lock);
+  // Split at buffer_size like the client: continuation frames after the
+  // first, FIN on the last
+  int done = 0;
+  do {
+    int n = len - done;
+    bool last = n <= client->buffer_size;
+    n = last ? n : client->buffer_size;
+    uint8_t op = (done == 0 ? opcode : WS_CONTINUATION) | (last ? WS_FIN : 0);
+    if (send_frame(client, op, (const uint8_t *)data + done, (size_t)n) < 0) {
+      ESP_LOGE(TAG, "esp_transport_write() failed");
+      shutdown(client->fd, SHUT_RDWR); // The receive task reconnects
+      pthread_mutex_unlock(&client->tx_lock);
+      return -1;
+    }
+    done += n;
+  } while (done < len);
+  pthread_mutex_unlock(&client->tx_lock);
+
+  pthread_mutex_lock(&ws_stats_lock);
+  ws_stats.messages_sent++;
+  ws_stats.bytes_sent += (uint64_t)len;
+  pthread_mutex_unlock(&ws_stats_lock);
+  return done;
+}
+
+int esp_websocket_client_send_bin(esp_websocket_client_handle_t client,
+                                  const char *data, int len,
+                                  TickType_t timeout) {
+  (void)timeout;
+  return send_message(client, WS_BINARY, data, len);
+}
+
+int esp_websocket_client_send_text(esp_websocket_client_handle_t client,
+                                   const char *data, int len,
+                                   TickType_t timeout) {
+  (void)timeout;
+  return send_message(client, WS_TEXT, data, len);
+}
+
+bool esp_websocket_client_is_connected(esp_websocket_client_handle_t client) {
+  return client && client->connected;
+}
+
+// Read frames until the connection drops, posting one DATA event per
+// buffer_size piece
+static void receive(esp_websocket_client_handle_t client) {
+  while (1) {
+    uint8_t header[2];
+    if (read_all(client->fd, header, 2) < 0) {
+      return;
+    }
+    bool fin = header[0] & WS_FIN;
+    uint8_t opcode = header[0] & 0x0f;
+    uint64_t payload = header[1] & 0x7f;
+    if (payload >= 126) {
+      uint8_t ext[8];
+      size_t n = payload == 126 ? 2 : 8;
+      if (read_all(client->fd, ext, n) < 0) {
+        return;
+      }
+      payload = 0;
+      for (size_t i = 0; i < n; i++) {
+        payload = payload << 8 | ext[i];
+      }
+    }
+    if (header[1] & 0x80) {
+      return; // Servers must not mask
+    }
+
+    uint64_t offset = 0;
+    do {
+      size_t n = payload - offset < (uint64_t)client->buffer_size
+                     ? (size_t)(payload - offset)
+                     : (size_t)client->buffer_size;
+      if (read_all(client->fd, client->rx_buffer, n) < 0) {
+        return;
+      }
+      if (opcode == WS_PING) {
+        pthread_mutex_lock(&client->tx_lock);
+        send_frame(client, WS_PONG | WS_FIN, client->rx_buffer, n);
+        pthread_mutex_unlock(&client->tx_lock);
+      } else if (opcode == WS_CLOSE) {
+        pthread_mutex_lock(&client->tx_lock);
+        send_frame(client, WS_CLOSE | WS_FIN, NULL, 0);
+        pthread_mutex_unlock(&client->tx_lock);
+        return;
+      }
+      esp_websocket_event_data_t data = {
+          .data_ptr = (const char *)client->rx_buffer,
+          .data_len = (int)n,
+          .fin = fin,
+          .op_code = opcode,
+          .payload_len = (int)payload,
+          .payload_offset = (int)offset,
+      };
+      post(client, WEBSOCKET_EVENT_DATA, &data);
+      offset += n;
+    } while (offset < payload);
+
+    if (opcode != WS_PING && opcode != WS_PONG) {
+      pthread_mutex_lock(&ws_stats_lock);
+      ws_stats.messages_received += fin;
+      ws_stats.bytes_received += payload;
+      pthread_mutex_unlock(&ws_stats_lock);
+    }
+  }
+}
+
+static void websocket_task(void *arg) {
+  esp_websocket_client_handle_t client = arg;
+  while (1) {
+    client->fd = tcp_connect(client->host, client->port);
+    if (client->fd >= 0 && handshake(client)) {
+      ESP_LOGI(TAG, "Connected to %s", client->uri);
+      pthread_mutex_lock(&ws_stats_lock);
+      ws_stats.connects++;
+      pthread_mutex_unlock(&ws_stats_lock);
+      client->connected = true;
+      post(client, WEBSOCKET_EVENT_CONNECTED, NULL);
+      receive(client);
+      client->connected = false;
+      post(client, WEBSOCKET_EVENT_DISCONNECTED, NULL);
+    } else {
+      ESP_LOGE(TAG, "Error connecting to %s", client->uri);
+      post(client, WEBSOCKET_EVENT_ERROR, NULL);
+    }
+    pthread_mutex_lock(&client->tx_lock);
+    if (client->fd >= 0) {
+      close(client->fd);
+      client->fd = -1;
+    }
+    pthread_mutex_unlock(&client->tx_lock);
+    ESP_LOGI(TAG, "Reconnect after %d ms", client->reconnect_ms);
+    vTaskDelay(pdMS_TO_TICKS(client->reconnect_ms));
+  }
+}
+
+esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t client) {
+  if (!client || client->started) {
+    return ESP_FAIL;
+  }
+  client->started = true;
+  // The component's task is not pinned; core 0 is where lwIP runs
+  return xTaskCreatePinnedToCore(websocket_task, "websocket_task", 0, client,
+                                 5, NULL, 0) == pdPASS
+             ? ESP_OK
+             : ESP_ERR_NO_MEM;
+}
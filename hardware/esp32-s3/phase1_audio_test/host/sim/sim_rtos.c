@@ -0,0 +1,211 @@
+// Simulated clock, FreeRTOS tasks on threads, and logging
+
+#include "sim.h"
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+struct tskTaskControlBlock {
+  pthread_t thread;
+  const char *name;
+  int core;
+  TaskFunction_t fn;
+  void *arg;
+  pthread_mutex_t lock;
+  pthread_cond_t cond; // Signalled on notify
+  uint32_t notify;
+  clockid_t cpu_clock;
+  bool cpu_clock_valid;
+  double exit_cpu_s; // CPU time of a deleted task, its clock is gone
+};
+
+static struct tskTaskControlBlock tasks[SIM_MAX_TASKS];
+static int task_count;
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct tskTaskControlBlock *current;
+
+static int64_t start_ns;
+static double clock_speed = 1.0;
+
+static int64_t wall_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void sim_clock_start(double speed) {
+  clock_speed = speed;
+  start_ns = wall_ns();
+}
+
+int64_t sim_now_us(void) {
+  return (int64_t)((double)(wall_ns() - start_ns) * clock_speed / 1000);
+}
+
+struct timespec sim_wall_time(int64_t us) {
+  int64_t ns = start_ns + (int64_t)((double)us * 1000 / clock_speed);
+  struct timespec ts = {.tv_sec = ns / 1000000000,
+                        .tv_nsec = ns % 1000000000};
+  return ts;
+}
+
+void sim_sleep_until(int64_t us) {
+  struct timespec ts = sim_wall_time(us);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+         EINTR) {
+  }
+}
+
+int64_t esp_timer_get_time(void) { return sim_now_us(); }
+
+// Threads that are not tasks (the DMA and event loop) count as core 0
+int esp_cpu_get_core_id(void) { return current ? current->core : 0; }
+
+void sim_log(char level, const char *tag, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  pthread_mutex_lock(&log_lock);
+  printf("%c (%lld) %s: ", level, (long long)(sim_now_us() / 1000), tag);
+  vprintf(format, args);
+  putchar('\n');
+  fflush(stdout);
+  pthread_mutex_unlock(&log_lock);
+  va_end(args);
+}
+
+static struct tskTaskControlBlock *new_task(const char *name, int core) {
+  pthread_mutex_lock(&tasks_lock);
+  struct tskTaskControlBlock *task = NULL;
+  if (task_count < SIM_MAX_TASKS) {
+    task = &tasks[task_count++];
+    task->name = name;
+    task->core = core == tskNO_AFFINITY ? 0 : core;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&task->cond, &attr);
+    pthread_condattr_destroy(&attr);
+  }
+  pthread_mutex_unlock(&tasks_lock);
+  return task;
+}
+
+static void enter_task(struct tskTaskControlBlock *task) {
+  current = task;
+  task->cpu_clock_valid =
+      pthread_getcpuclockid(pthread_self(), &task->cpu_clock) == 0;
+}
+
+int sim_task_usage(sim_task_usage_t *out, int max) {
+  pthread_mutex_lock(&tasks_lock);
+  int n = task_count < max ? task_count : max;
+  for (int i = 0; i < n; i++) {
+    struct timespec ts = {0};
+    if (tasks[i].cpu_clock_valid) {
+      clock_gettime(tasks[i].cpu_clock, &ts);
+    }
+    out[i].name = tasks[i].name;
+    out[i].core = tasks[i].core;
+    out[i].cpu_s = (double)ts.tv_sec + ts.tv_nsec / 1e9 + tasks[i].exit_cpu_s;
+  }
+  pthread_mutex_unlock(&tasks_lock);
+  return n;
+}
+
+static void *run_task(void *arg) {
+  struct tskTaskControlBlock *task = arg;
+  enter_task(task);
+  task->fn(task->arg);
+  // FreeRTOS tasks must not return; mirror the assert
+  fprintf(stderr, "task %s returned\n", task->name);
+  abort();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core) {
+  (void)stack, (void)priority;
+  struct tskTaskControlBlock *task = new_task(name, core);
+  if (!task) {
+    return pdFAIL;
+  }
+  task->fn = fn;
+  task->arg = arg;
+  if (handle) {
+    *handle = task;
+  }
+  if (pthread_create(&task->thread, NULL, run_task, task) != 0) {
+    return pdFAIL;
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task && task != current) {
+    fprintf(stderr, "vTaskDelete of another task is not simulated\n");
+    abort();
+  }
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  pthread_mutex_lock(&tasks_lock);
+  current->cpu_clock_valid = false;
+  current->exit_cpu_s = (double)ts.tv_sec + ts.tv_nsec / 1e9;
+  pthread_mutex_unlock(&tasks_lock);
+  pthread_detach(pthread_self());
+  pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return current; }
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t)(sim_now_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks) {
+  sim_sleep_until(sim_now_us() +
+                  (int64_t)ticks * (1000000 / configTICK_RATE_HZ));
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  struct tskTaskControlBlock *task = current;
+  int64_t deadline = sim_now_us() +
+                     (int64_t)ticks * (1000000 / configTICK_RATE_HZ);
+  struct timespec ts = sim_wall_time(deadline);
+
+  pthread_mutex_lock(&task->lock);
+  while (task->notify == 0) {
+    if (ticks == portMAX_DELAY) {
+      pthread_cond_wait(&task->cond, &task->lock);
+    } else if (pthread_cond_timedwait(&task->cond, &task->lock, &ts) ==
+               ETIMEDOUT) {
+      break;
+    }
+  }
+  uint32_t value = task->notify;
+  if (value > 0) {
+    task->notify = clear ? 0 : value - 1;
+  }
+  pthread_mutex_unlock(&task->lock);
+  return value;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  if (!task) {
+    return;
+  }
+  pthread_mutex_lock(&task->lock);
+  task->notify++;
+  pthread_cond_signal(&task->cond);
+  pthread_mutex_unlock(&task->lock);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: the program provides the core id,
+// e.g. per thread, to stand in for the two cores
+
+int esp_cpu_get_core_id(void);
@@ -0,0 +1,38 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: capabilities are ignored
+
+#include "sdkconfig.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+static inline void *heap_caps_aligned_alloc(size_t alignment, size_t size,
+                                            unsigned int caps) {
+  (void)caps;
+  return aligned_alloc(alignment, (size + alignment - 1) / alignment *
+                                      alignment);
+}
+
+static inline void *heap_caps_malloc(size_t size, unsigned int caps) {
+  (void)caps;
+  return malloc(size);
+}
+
+static inline void heap_caps_free(void *ptr) { free(ptr); }
+
+// The host heap has no fixed size, as esp_get_free_heap_size() in sim/
+static inline size_t heap_caps_get_largest_free_block(unsigned int caps) {
+  (void)caps;
+  return 8u * 1024 * 1024;
+}
+
+#if CONFIG_HEAP_USE_HOOKS
+// Defined by the firmware. phase1_sim calls it from its malloc wrappers
+// (sim/sim_heap.c), as heap_caps does after every allocation on the device.
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+#endif
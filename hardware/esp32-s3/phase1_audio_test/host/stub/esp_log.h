@@ -0,0 +1,14 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF header: "I TAG: message" on stderr
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  fprintf(stderr, "I %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
+#define ESP_LOGV(tag, format, ...) ((void)(tag))
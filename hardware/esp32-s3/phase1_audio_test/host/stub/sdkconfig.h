@@ -0,0 +1,11 @@
+#pragma once
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_IDF_TARGET "linux"
+
+// audio_pipeline counts nanoseconds on the host, so stage "cycles" convert
+// to microseconds as on a 1GHz CPU
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 1000
+
+// As on the device: phase1_sim reports allocations from the audio tasks
+#define CONFIG_HEAP_USE_HOOKS 1
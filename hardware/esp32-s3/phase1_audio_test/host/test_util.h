@@ -0,0 +1,33 @@
+#pragma once
+
+// What every host test shares: the check() report and deterministic noise.
+// Each test is one translation unit, so the state lives here as statics.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+static int failures = 0;
+
+static inline void check(bool ok, const char *what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAIL");
+  failures += !ok;
+}
+
+// Deterministic so runs compare
+static uint32_t rng_state = 1;
+
+static inline uint32_t rng(void) {
+  rng_state = rng_state * 1664525u + 1013904223u;
+  return rng_state;
+}
+
+// Uniform in [-1, 1)
+static inline double white(void) {
+  return (double)(rng() >> 8) / (1 << 23) - 1.0;
+}
+
+static inline int16_t clip(double x) {
+  return (int16_t)fmax(-32768, fmin(32767, lrint(x)));
+}
@@ -0,0 +1,124 @@
+// Decodes the firmware's binary trace (audio_trace.h) in a console log.
+//
+//   trace_decode [log.txt]     default: stdin
+//
+// "@AT1" lines become one text line per record, with the time since the
+// first record, the core and the event's format from audio_trace_events.h;
+// every other line passes through, so the trace reads in place among the
+// ESP_LOG output. Capture the log with e.g. `idf.py monitor | tee log.txt`.
+// Exits 1 if any trace line was corrupt.
+
+#include "audio_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  const char *level;
+  const char *format;
+} event_t;
+
+#define EVENT(name, level, format) {#name, #level, format},
+static const event_t events[] = {AUDIO_TRACE_EVENTS(EVENT)};
+#undef EVENT
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+static bool have_start = false;
+static uint32_t last_us = 0;
+static int64_t elapsed_us = 0;
+
+static void print_record(const audio_trace_record_t *record) {
+  // 32-bit microseconds wrap; records are close enough to unwrap them
+  if (have_start) {
+    elapsed_us += (int32_t)(record->time_us - last_us);
+  }
+  have_start = true;
+  last_us = record->time_us;
+
+  printf("[%4lld.%06lld] c%u ", (long long)(elapsed_us / 1000000),
+         (long long)(elapsed_us % 1000000), (unsigned int)record->core);
+  if (record->id >= sizeof(events) / sizeof(events[0])) {
+    printf("? unknown event %u\n", (unsigned int)record->id);
+    return;
+  }
+  const event_t *event = &events[record->id];
+  printf("%c %s: ", event->level[0], event->name);
+  // Formats only take int-sized arguments; extra ones are ignored
+  printf(event->format, (unsigned int)record->args[0],
+         (unsigned int)record->args[1], (unsigned int)record->args[2],
+         (unsigned int)record->args[3]);
+  putchar('\n');
+}
+
+// Returns false if the line is damaged
+static bool decode_line(const char *hex) {
+  uint8_t bytes[AUDIO_TRACE_LINE_RECORDS * sizeof(audio_trace_record_t) + 1];
+  size_t n = 0;
+  while (n < sizeof(bytes)) {
+    int hi = hex_value(hex[2 * n]);
+    int lo = hi < 0 ? -1 : hex_value(hex[2 * n + 1]);
+    if (lo < 0) {
+      break;
+    }
+    bytes[n++] = (uint8_t)(hi << 4 | lo);
+  }
+  if (n < 1 + sizeof(audio_trace_record_t) ||
+      (n - 1) % sizeof(audio_trace_record_t) != 0) {
+    return false;
+  }
+  uint8_t sum = 0;
+  for (size_t i = 0; i + 1 < n; i++) {
+    sum += bytes[i];
+  }
+  if (sum != bytes[n - 1]) {
+    return false;
+  }
+  for (size_t i = 0; i + 1 < n; i += sizeof(audio_trace_record_t)) {
+    audio_trace_record_t record;
+    memcpy(&record, &bytes[i], sizeof(record));
+    print_record(&record);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if (argc > 1 && !(in = fopen(argv[1], "r"))) {
+    perror(argv[1]);
+    return 2;
+  }
+
+  char line[1024];
+  unsigned int corrupt = 0;
+  while (fgets(line, sizeof(line), in)) {
+    // The monitor may put a prefix or colour codes in front
+    const char *trace = strstr(line, "@AT1 ");
+    if (!trace) {
+      fputs(line, stdout);
+      continue;
+    }
+    if (!decode_line(trace + 5)) {
+      printf("? corrupt trace line\n");
+      corrupt++;
+    }
+  }
+
+  if (in != stdin) {
+    fclose(in);
+  }
+  if (corrupt > 0) {
+    fprintf(stderr, "%u corrupt trace line(s)\n", corrupt);
+    return 1;
+  }
+  return 0;
+}
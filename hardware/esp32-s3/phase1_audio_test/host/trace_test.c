@@ -0,0 +1,174 @@
+// Checks the trace rings: records come back whole and in order, overflow is
+// reported instead of hidden, and writers on two "cores" racing a reader
+// never produce a torn record.
+//
+//   trace_test            run the checks
+//   trace_test --emit     print a sample console log for trace_decode
+//
+// Threads stand in for the cores; each one sets the id
+// esp_cpu_get_core_id() returns.
+
+#include "audio_trace.h"
+#include "test_util.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRESS_RECORDS 200000 // Per writer
+
+static _Thread_local int core_id = 0;
+
+int esp_cpu_get_core_id(void) { return core_id; }
+
+static atomic_int writers_done;
+
+static void *writer(void *arg) {
+  core_id = (int)(intptr_t)arg;
+  for (uint32_t i = 0; i < STRESS_RECORDS; i++) {
+    // The checksum argument catches a record mixed from two writes
+    AUDIO_TRACE(STREAM_OPEN, i, ~i, i * 2654435761u, (uint32_t)core_id);
+  }
+  atomic_fetch_add(&writers_done, 1);
+  return NULL;
+}
+
+static int emit(void) {
+  printf("I (1234) PHASE1_AUDIO_WS: Pipeline started\n");
+  AUDIO_TRACE(I2S_READ, 1, 4096);
+  AUDIO_TRACE(AUDIO_LEVEL, 128, 12, 120, 132);
+  core_id = 1;
+  AUDIO_TRACE(WS_RX, 2, 1024, 2048, 9600);
+  AUDIO_TRACE(VAD, 1, 1);
+  audio_trace_print(stdout, SIZE_MAX);
+  printf("I (1300) PHASE1_AUDIO_WS: Heap: 123456 bytes free\n");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--emit") == 0) {
+    return emit();
+  }
+
+  printf("Records come back as written\n");
+  audio_trace_stats_t before, after;
+  audio_trace_get_stats(&before);
+  for (uint32_t i = 0; i < 10; i++) {
+    AUDIO_TRACE(I2S_READ, i, 4096);
+  }
+  AUDIO_TRACE(I2S_RAW, 1, 2, 3, 4); // Above the default level
+  audio_trace_get_stats(&after);
+  check(after.written - before.written == 10,
+        "events above AUDIO_TRACE_LEVEL compile out");
+  audio_trace_record_t record;
+  bool ok = true;
+  for (uint32_t i = 0; i < 10; i++) {
+    ok = ok && audio_trace_read(&record) &&
+         record.id == AUDIO_TRACE_ID_I2S_READ && record.args[0] == i &&
+         record.args[1] == 4096 && record.args[2] == 0 && record.core == 0;
+  }
+  check(ok && !audio_trace_read(&record), "ids, arguments and order");
+
+  printf("A full ring overwrites its oldest records\n");
+  core_id = 1;
+  for (uint32_t i = 0; i < AUDIO_TRACE_RECORDS + 50; i++) {
+    AUDIO_TRACE(LOUD_AUDIO, i);
+  }
+  check(audio_trace_read(&record) && record.id == AUDIO_TRACE_ID_LOST &&
+            record.args[0] == 50 && record.args[1] == 1,
+        "reported as a LOST record");
+  ok = true;
+  for (uint32_t i = 50; i < AUDIO_TRACE_RECORDS + 50; i++) {
+    ok = ok && audio_trace_read(&record) && record.args[0] == i;
+  }
+  check(ok && !audio_trace_read(&record), "the newest records survive");
+
+  printf("Two cores are merged in time order\n");
+  for (uint32_t i = 0; i < 40; i++) {
+    core_id = i % 3 == 0;
+    AUDIO_TRACE(I2S_READ, i, 0);
+  }
+  ok = true;
+  uint32_t count = 0, last = 0;
+  while (audio_trace_read(&record)) {
+    ok = ok && (count == 0 || (int32_t)(record.time_us - last) >= 0);
+    last = record.time_us;
+    count++;
+  }
+  check(ok && count == 40, "timestamps never go backwards");
+
+  printf("Two writers racing the reader\n");
+  audio_trace_get_stats(&before);
+  pthread_t threads[2];
+  for (int core = 0; core < 2; core++) {
+    pthread_create(&threads[core], NULL, writer, (void *)(intptr_t)core);
+  }
+  uint32_t received = 0, lost = 0, torn = 0, reordered = 0;
+  int64_t next[2] = {0, 0};
+  bool finished = false;
+  while (!finished) {
+    // One last pass once both writers are done
+    finished = atomic_load(&writers_done) == 2;
+    while (audio_trace_read(&record)) {
+      if (record.id == AUDIO_TRACE_ID_LOST) {
+        lost += record.args[0];
+        continue;
+      }
+      uint32_t i = record.args[0];
+      if (record.args[1] != ~i || record.args[2] != i * 2654435761u ||
+          record.args[3] != record.core || record.core > 1) {
+        torn++;
+        continue;
+      }
+      if ((int64_t)i < next[record.core]) {
+        reordered++;
+      }
+      next[record.core] = (int64_t)i + 1;
+      received++;
+    }
+  }
+  for (int core = 0; core < 2; core++) {
+    pthread_join(threads[core], NULL);
+  }
+  audio_trace_get_stats(&after);
+  printf("  %u received, %u lost of %u\n", (unsigned int)received,
+         (unsigned int)lost, 2 * STRESS_RECORDS);
+  check(torn == 0, "no torn records");
+  check(reordered == 0, "each core's records stay in order");
+  check(received + lost == 2 * STRESS_RECORDS &&
+            after.written - before.written == 2 * STRESS_RECORDS,
+        "every record is either received or counted lost");
+
+  printf("Console lines\n");
+  char *text = NULL;
+  size_t text_len = 0;
+  FILE *out = open_memstream(&text, &text_len);
+  for (uint32_t i = 0; i < 20; i++) {
+    AUDIO_TRACE(I2S_READ, i, 4096);
+  }
+  size_t printed = audio_trace_print(out, SIZE_MAX);
+  fclose(out);
+  int lines = 0;
+  ok = true;
+  for (char *line = text; line && *line;) {
+    char *end = strchr(line, '\n');
+    size_t len = end ? (size_t)(end - line) : strlen(line);
+    ok = ok && strncmp(line, "@AT1 ", 5) == 0 &&
+         len <= 5 + 2 * (AUDIO_TRACE_LINE_RECORDS * 24 + 1);
+    lines++;
+    line = end ? end + 1 : line + len;
+  }
+  free(text);
+  check(printed == 20 &&
+            lines == (20 + AUDIO_TRACE_LINE_RECORDS - 1) /
+                         AUDIO_TRACE_LINE_RECORDS &&
+            ok,
+        "AUDIO_TRACE_LINE_RECORDS records per @AT1 line");
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,277 @@
+// Checks the uplink VAD (audio_vad.h) on the voice-agent WAV fixtures:
+// each file is played between stretches of room noise, as a device would
+// hear one request, and the decisions are scored against the clean file's
+// own level, 10ms at a time. Reports detection accuracy, the uplink
+// bandwidth gate mode saves with its 300ms pre-roll, and the cost per 10ms
+// sub-frame on this host (dsp_bench has it in device cycles). Then the
+// background steps up 20dB with nobody talking, as a fan switching on: the
+// VAD has to settle back to silence instead of hearing speech forever, and
+// still hear speech over the fan afterwards.
+//
+//   vad_test FIXTURE.wav...
+
+#include "audio_vad.h"
+#include "test_util.h"
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RATE 16000
+#define SUB_FRAME (RATE * AUDIO_VAD_FRAME_MS / 1000)
+#define BLOCK_SAMPLES 512 // The sender's block, gate mode works in these
+#define PREROLL_MS 300    // VAD_PREROLL_MS in the firmware
+#define PAD_MS 1500       // Room noise before and after each request
+#define HANGOVER_MS 400   // audio_vad_init's, not counted as false alarms
+#define ROOM_DBFS -55.0
+#define FAN_DBFS -35.0
+#define SPEECH_BELOW_PEAK_DB 30.0 // Clean sub-frames this close to the peak
+#define MIN_HIT_RATE 0.9
+#define MAX_FALSE_ALARMS 0.05
+#define MIN_COVERAGE 0.99
+#define SETTLE_S 5 // After the fan starts, at most
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Low-passed noise at `dbfs` RMS: a hum with few zero crossings, the kind
+// the VAD's zero-crossing margin does not catch
+typedef struct {
+  double state;
+  double gain;
+} noise_t;
+
+static void noise_init(noise_t *noise, double dbfs) {
+  noise->state = 0;
+  // One pole at 0.9 passes white noise of RMS 1/sqrt(3) at ~0.132 RMS
+  noise->gain = 32768.0 * pow(10, dbfs / 20) / 0.132;
+}
+
+static double noise_next(noise_t *noise) {
+  noise->state = 0.9 * noise->state + 0.1 * white();
+  return noise->state * noise->gain;
+}
+
+static double level_dbfs(const int16_t *x, size_t n) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += (double)x[i] * x[i];
+  }
+  return 10 * log10(sum / n / (32768.0 * 32768.0) + 1e-12);
+}
+
+// Gate mode: a stream opens on speech start, reaching PREROLL_MS back
+// from the start of that block, and closes on speech end after sending
+// the block. Marks the samples that go out.
+static void gate(const bool *speech, size_t sub_frames, bool *sent) {
+  size_t samples = sub_frames * SUB_FRAME;
+  memset(sent, 0, samples);
+  bool open = false;
+  for (size_t block = 0; block * BLOCK_SAMPLES < samples; block++) {
+    size_t start = block * BLOCK_SAMPLES;
+    size_t end = start + BLOCK_SAMPLES < samples ? start + BLOCK_SAMPLES
+                                                 : samples;
+    bool now = speech[(end - 1) / SUB_FRAME];
+    if (now && !open) {
+      size_t from = start > RATE * PREROLL_MS / 1000
+                        ? start - RATE * PREROLL_MS / 1000
+                        : 0;
+      memset(sent + from, 1, start - from);
+    }
+    if (now || open) {
+      memset(sent + start, 1, end - start);
+    }
+    open = now;
+  }
+}
+
+static void fixture(const char *path) {
+  wav_t wav;
+  if (wav_load(path, &wav) != 0) {
+    failures++;
+    return;
+  }
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  printf("%s: %zu frames at %u Hz\n", name, wav.frames,
+         (unsigned int)wav.rate);
+  if (wav.rate != RATE) {
+    printf("  needs %d Hz\n", RATE);
+    failures++;
+    wav_free(&wav);
+    return;
+  }
+
+  size_t pad = RATE * PAD_MS / 1000;
+  size_t speech_frames = wav.frames / SUB_FRAME;
+  size_t sub_frames = 2 * pad / SUB_FRAME + speech_frames;
+  size_t samples = sub_frames * SUB_FRAME;
+  int16_t *mic = malloc(samples * sizeof(int16_t));
+  bool *truth = calloc(sub_frames, sizeof(bool));
+  bool *speech = calloc(sub_frames, sizeof(bool));
+  bool *sent = malloc(samples);
+  if (!mic || !truth || !speech || !sent) {
+    printf("  out of memory\n");
+    exit(1);
+  }
+
+  // Truth from the clean file: within SPEECH_BELOW_PEAK_DB of its loudest
+  double peak = -200;
+  for (size_t f = 0; f < speech_frames; f++) {
+    peak = fmax(peak, level_dbfs(wav.samples + f * SUB_FRAME, SUB_FRAME));
+  }
+  for (size_t f = 0; f < speech_frames; f++) {
+    truth[pad / SUB_FRAME + f] =
+        level_dbfs(wav.samples + f * SUB_FRAME, SUB_FRAME) >
+        peak - SPEECH_BELOW_PEAK_DB;
+  }
+  noise_t room;
+  noise_init(&room, ROOM_DBFS);
+  for (size_t i = 0; i < samples; i++) {
+    double voice = i >= pad && i - pad < speech_frames * SUB_FRAME
+                       ? wav.samples[i - pad]
+                       : 0;
+    mic[i] = clip(voice + noise_next(&room));
+  }
+
+  audio_vad_t vad;
+  audio_vad_init(&vad, RATE);
+  double start = now_s();
+  for (size_t f = 0; f < sub_frames; f++) {
+    audio_vad_process(&vad, mic + f * SUB_FRAME, SUB_FRAME);
+    speech[f] = audio_vad_is_speech(&vad);
+  }
+  double ns = (now_s() - start) * 1e9 / sub_frames;
+
+  size_t voiced = 0, hits = 0, quiet = 0, alarms = 0;
+  size_t after = (pad + speech_frames * SUB_FRAME) / SUB_FRAME +
+                 HANGOVER_MS / AUDIO_VAD_FRAME_MS + 1;
+  for (size_t f = 0; f < sub_frames; f++) {
+    if (truth[f]) {
+      voiced++;
+      hits += speech[f];
+    } else if (f < pad / SUB_FRAME || f >= after) {
+      quiet++;
+      alarms += speech[f];
+    }
+  }
+  gate(speech, sub_frames, sent);
+  size_t sent_samples = 0, covered = 0, needed = 0;
+  for (size_t i = 0; i < samples; i++) {
+    sent_samples += sent[i];
+    if (truth[i / SUB_FRAME]) {
+      needed++;
+      covered += sent[i];
+    }
+  }
+  double hit_rate = (double)hits / voiced;
+  double false_alarms = (double)alarms / quiet;
+  printf("  speech %zu of %zu sub-frames detected (%.1f%%), %zu of %zu "
+         "noise sub-frames flagged (%.1f%%)\n",
+         hits, voiced, 100.0 * hit_rate, alarms, quiet, 100.0 * false_alarms);
+  printf("  gate sends %.1f of %.1f s: %.0f%% of the uplink saved; "
+         "%.0f ns per sub-frame on this host\n",
+         (double)sent_samples / RATE, (double)samples / RATE,
+         100.0 * (samples - sent_samples) / samples, ns);
+  char what[64];
+  snprintf(what, sizeof(what), "more than %.0f%% of speech detected",
+           100 * MIN_HIT_RATE);
+  check(hit_rate > MIN_HIT_RATE, what);
+  snprintf(what, sizeof(what), "under %.0f%% of room noise flagged",
+           100 * MAX_FALSE_ALARMS);
+  check(false_alarms < MAX_FALSE_ALARMS, what);
+  check((double)covered / needed > MIN_COVERAGE,
+        "gate mode sends all the speech, pre-roll included");
+  check(sent_samples < samples * 2 / 3, "gate mode drops the silences");
+
+  free(mic);
+  free(truth);
+  free(speech);
+  free(sent);
+  wav_free(&wav);
+}
+
+// Feed `seconds` of noise, plus `voice` on top when given; returns the
+// share of sub-frames in the last `tail` seconds flagged as speech
+static double feed(audio_vad_t *vad, noise_t *noise, double seconds,
+                   const wav_t *voice, double tail) {
+  size_t sub_frames = (size_t)(seconds * 1000 / AUDIO_VAD_FRAME_MS);
+  size_t tail_frames = (size_t)(tail * 1000 / AUDIO_VAD_FRAME_MS);
+  size_t flagged = 0;
+  int16_t block[SUB_FRAME];
+  for (size_t f = 0; f < sub_frames; f++) {
+    for (size_t i = 0; i < SUB_FRAME; i++) {
+      size_t at = f * SUB_FRAME + i;
+      double x = noise_next(noise);
+      if (voice && at < voice->frames) {
+        x += voice->samples[at];
+      }
+      block[i] = clip(x);
+    }
+    audio_vad_process(vad, block, SUB_FRAME);
+    if (f >= sub_frames - tail_frames) {
+      flagged += audio_vad_is_speech(vad);
+    }
+  }
+  return tail_frames ? (double)flagged / tail_frames : 0;
+}
+
+static void fan_step(const char *path) {
+  printf("Fan switching on: %+.0f to %+.0f dBFS, nobody talking\n",
+         ROOM_DBFS, FAN_DBFS);
+  audio_vad_t vad;
+  audio_vad_init(&vad, RATE);
+  noise_t room, fan;
+  noise_init(&room, ROOM_DBFS);
+  noise_init(&fan, FAN_DBFS);
+  feed(&vad, &room, 3, NULL, 0);
+  check(!audio_vad_is_speech(&vad), "quiet room is not speech");
+
+  // Right after the step it may well sound like someone started talking
+  double floor_before = vad.noise_floor_db;
+  feed(&vad, &fan, SETTLE_S, NULL, 0);
+  double late = feed(&vad, &fan, 10, NULL, 10);
+  printf("  floor %.1f -> %.1f dB, %.1f%% of the 10s after settling "
+         "flagged\n",
+         floor_before, vad.noise_floor_db, 100 * late);
+  char what[64];
+  snprintf(what, sizeof(what), "back to silence within %ds of the step",
+           SETTLE_S);
+  check(late == 0, what);
+
+  wav_t wav;
+  if (wav_load(path, &wav) != 0) {
+    failures++;
+    return;
+  }
+  double heard = feed(&vad, &fan, (double)wav.frames / RATE, &wav,
+                      (double)wav.frames / RATE);
+  printf("  then a request over the fan: %.0f%% flagged\n", 100 * heard);
+  check(heard > 0.8, "speech over the fan still heard");
+  feed(&vad, &fan, 1, NULL, 0);
+  check(!audio_vad_is_speech(&vad), "and the fan alone is silence again");
+  wav_free(&wav);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FIXTURE.wav...\n", argv[0]);
+    return 2;
+  }
+  for (int i = 1; i < argc; i++) {
+    fixture(argv[i]);
+  }
+  fan_step(argv[1]);
+
+  if (failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
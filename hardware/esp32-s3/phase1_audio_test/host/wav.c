@@ -0,0 +1,89 @@
+#include "wav.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t le32(const uint8_t *p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint16_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+int wav_load(const char *path, wav_t *wav) {
+  memset(wav, 0, sizeof(*wav));
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *file = malloc(size > 0 ? (size_t)size : 1);
+  if (!file || fread(file, 1, (size_t)size, f) != (size_t)size) {
+    fprintf(stderr, "%s: read failed\n", path);
+    fclose(f);
+    free(file);
+    return -1;
+  }
+  fclose(f);
+
+  uint16_t channels = 0, bits = 0, format = 0;
+  const uint8_t *data = NULL;
+  size_t data_len = 0;
+  if (size < 12 || memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4)) {
+    fprintf(stderr, "%s: not a WAV file\n", path);
+    free(file);
+    return -1;
+  }
+  for (long at = 12; at + 8 <= size;) {
+    uint32_t len = le32(file + at + 4);
+    const uint8_t *body = file + at + 8;
+    if (len > (uint32_t)(size - at - 8)) {
+      len = (uint32_t)(size - at - 8);
+    }
+    if (memcmp(file + at, "fmt ", 4) == 0 && len >= 16) {
+      format = le16(body);
+      channels = le16(body + 2);
+      wav->rate = le32(body + 4);
+      bits = le16(body + 14);
+    } else if (memcmp(file + at, "data", 4) == 0) {
+      data = body;
+      data_len = len;
+    }
+    at += 8 + len + (len & 1);
+  }
+  // 0xfffe is WAVE_FORMAT_EXTENSIBLE, which pcm16 files may use as well
+  if (!data || (format != 1 && format != 0xfffe) || bits != 16 ||
+      channels < 1 || channels > 2) {
+    fprintf(stderr, "%s: need 16-bit PCM, mono or stereo\n", path);
+    free(file);
+    return -1;
+  }
+
+  wav->frames = data_len / (2 * channels);
+  wav->samples = malloc((wav->frames ? wav->frames : 1) * sizeof(int16_t));
+  if (!wav->samples) {
+    fprintf(stderr, "%s: out of memory\n", path);
+    free(file);
+    return -1;
+  }
+  for (size_t i = 0; i < wav->frames; i++) {
+    const uint8_t *frame = data + i * 2 * channels;
+    int32_t sum = 0;
+    for (int c = 0; c < channels; c++) {
+      sum += (int16_t)le16(frame + 2 * c);
+    }
+    wav->samples[i] = (int16_t)(sum / channels);
+  }
+  free(file);
+  return 0;
+}
+
+void wav_free(wav_t *wav) {
+  free(wav->samples);
+  wav->samples = NULL;
+  wav->frames = 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// pcm16 WAV files for the host tests, e.g. the voice-agent fixtures
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  int16_t *samples; // Mono; stereo files are averaged
+  size_t frames;
+  uint32_t rate;
+} wav_t;
+
+// Returns 0, or -1 after printing why to stderr
+int wav_load(const char *path, wav_t *wav);
+void wav_free(wav_t *wav);
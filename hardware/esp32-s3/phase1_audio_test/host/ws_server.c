@@ -0,0 +1,337 @@
+#include "ws_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define WS_CONTINUATION 0x0
+#define WS_CLOSE 0x8
+#define WS_PING 0x9
+#define WS_PONG 0xa
+
+// SHA-1 of one short message, only for Sec-WebSocket-Accept
+static void sha1(const uint8_t *msg, size_t len, uint8_t digest[20]) {
+  uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476,
+                   0xc3d2e1f0};
+  uint64_t bits = (uint64_t)len * 8;
+  size_t total = (len + 9 + 63) / 64 * 64;
+  for (size_t block = 0; block < total; block += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 64; i++) {
+      size_t at = block + i;
+      uint8_t byte = 0;
+      if (at < len) {
+        byte = msg[at];
+      } else if (at == len) {
+        byte = 0x80;
+      } else if (at >= total - 8) {
+        byte = (uint8_t)(bits >> (8 * (total - 1 - at)));
+      }
+      if (i % 4 == 0) {
+        w[i / 4] = 0;
+      }
+      w[i / 4] |= (uint32_t)byte << (24 - 8 * (i % 4));
+    }
+    for (int i = 16; i < 80; i++) {
+      uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+      w[i] = x << 1 | x >> 31;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
+      uint32_t t = (a << 5 | a >> 27) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = b << 30 | b >> 2;
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+  for (int i = 0; i < 20; i++) {
+    digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+  }
+}
+
+static void base64(const uint8_t *in, size_t len, char *out) {
+  static const char table[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < len; i += 3) {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < len) {
+      v |= (uint32_t)in[i + 1] << 8;
+    }
+    if (i + 2 < len) {
+      v |= in[i + 2];
+    }
+    *out++ = table[v >> 18 & 63];
+    *out++ = table[v >> 12 & 63];
+    *out++ = i + 1 < len ? table[v >> 6 & 63] : '=';
+    *out++ = i + 2 < len ? table[v & 63] : '=';
+  }
+  *out = '\0';
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+  uint8_t *p = buf;
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n <= 0) {
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+  const uint8_t *p = buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n <= 0) {
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+int ws_server_listen(ws_server_t *ws, uint16_t port) {
+  ws->fd = -1;
+  ws->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (ws->listen_fd < 0) {
+    return -1;
+  }
+  int on = 1;
+  setsockopt(ws->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET,
+      .sin_port = htons(port),
+      .sin_addr.s_addr = htonl(INADDR_ANY),
+  };
+  if (bind(ws->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(ws->listen_fd, 1) < 0) {
+    close(ws->listen_fd);
+    return -1;
+  }
+  return 0;
+}
+
+int ws_server_accept(ws_server_t *ws) {
+  ws->fd = accept(ws->listen_fd, NULL, NULL);
+  if (ws->fd < 0) {
+    return -1;
+  }
+  int on = 1;
+  setsockopt(ws->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  // Read the request up to the blank line, a byte at a time: it is short
+  // and nothing may be read past it
+  char request[2048];
+  size_t used = 0;
+  while (used < sizeof(request) - 1) {
+    if (read(ws->fd, &request[used], 1) != 1) {
+      break;
+    }
+    used++;
+    if (used >= 4 && memcmp(&request[used - 4], "\r\n\r\n", 4) == 0) {
+      break;
+    }
+  }
+  request[used] = '\0';
+
+  const char *key = NULL;
+  for (char *line = strtok(request, "\r\n"); line;
+       line = strtok(NULL, "\r\n")) {
+    if (strncasecmp(line, "Sec-WebSocket-Key:", 18) == 0) {
+      key = line + 18;
+      key += strspn(key, " \t");
+    }
+  }
+  if (!key) {
+    ws_server_disconnect(ws);
+    return -1;
+  }
+
+  char joined[128];
+  snprintf(joined, sizeof(joined), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11",
+           key);
+  uint8_t digest[20];
+  sha1((const uint8_t *)joined, strlen(joined), digest);
+  char accept_key[32];
+  base64(digest, sizeof(digest), accept_key);
+
+  char response[256];
+  int n = snprintf(response, sizeof(response),
+                   "HTTP/1.1 101 Switching Protocols\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: %s\r\n\r\n",
+                   accept_key);
+  if (write_all(ws->fd, response, (size_t)n) < 0) {
+    ws_server_disconnect(ws);
+    return -1;
+  }
+  return 0;
+}
+
+static int send_frame(ws_server_t *ws, int opcode, const void *data,
+                      size_t len) {
+  uint8_t header[10];
+  size_t header_len = 2;
+  header[0] = 0x80 | (uint8_t)opcode;
+  if (len < 126) {
+    header[1] = (uint8_t)len;
+  } else if (len < 65536) {
+    header[1] = 126;
+    header[2] = (uint8_t)(len >> 8);
+    header[3] = (uint8_t)len;
+    header_len = 4;
+  } else {
+    header[1] = 127;
+    for (int i = 0; i < 8; i++) {
+      header[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+    }
+    header_len = 10;
+  }
+  if (write_all(ws->fd, header, header_len) < 0 ||
+      write_all(ws->fd, data, len) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+int ws_server_send(ws_server_t *ws, int opcode, const void *data,
+                   size_t len) {
+  if (ws->fd < 0) {
+    return -1;
+  }
+  return send_frame(ws, opcode, data, len);
+}
+
+int ws_server_recv(ws_server_t *ws, uint8_t *buf, size_t cap, size_t *len,
+                   int timeout_ms) {
+  int message_opcode = 0;
+  *len = 0;
+  while (ws->fd >= 0) {
+    // Only wait for the start of a message; the rest follows promptly
+    if (message_opcode == 0) {
+      struct pollfd pfd = {.fd = ws->fd, .events = POLLIN};
+      int ready = poll(&pfd, 1, timeout_ms);
+      if (ready == 0) {
+        return 0;
+      }
+      if (ready < 0) {
+        break;
+      }
+    }
+
+    uint8_t header[2];
+    if (read_all(ws->fd, header, 2) < 0) {
+      break;
+    }
+    bool fin = header[0] & 0x80;
+    int opcode = header[0] & 0x0f;
+    bool masked = header[1] & 0x80;
+    uint64_t payload = header[1] & 0x7f;
+    if (payload >= 126) {
+      uint8_t ext[8];
+      size_t n = payload == 126 ? 2 : 8;
+      if (read_all(ws->fd, ext, n) < 0) {
+        break;
+      }
+      payload = 0;
+      for (size_t i = 0; i < n; i++) {
+        payload = payload << 8 | ext[i];
+      }
+    }
+    uint8_t mask[4] = {0};
+    if (masked && read_all(ws->fd, mask, 4) < 0) {
+      break;
+    }
+
+    // Control frames may arrive between fragments and are at most 125
+    // bytes; data goes to the caller's buffer, the overflow is discarded
+    uint8_t control[125];
+    bool is_control = opcode & 0x8;
+    if (is_control && payload > sizeof(control)) {
+      break;
+    }
+    uint64_t done = 0;
+    while (done < payload) {
+      uint8_t chunk[512];
+      size_t n = payload - done < sizeof(chunk) ? (size_t)(payload - done)
+                                                : sizeof(chunk);
+      if (read_all(ws->fd, chunk, n) < 0) {
+        break;
+      }
+      for (size_t i = 0; i < n; i++) {
+        uint64_t at = done + i;
+        uint8_t byte = chunk[i] ^ mask[at % 4];
+        if (is_control) {
+          control[at] = byte;
+        } else if (*len + at < cap) {
+          buf[*len + at] = byte;
+        }
+      }
+      done += n;
+    }
+    if (done < payload) {
+      break;
+    }
+
+    if (opcode == WS_PING) {
+      send_frame(ws, WS_PONG, control, (size_t)payload);
+      continue;
+    }
+    if (opcode == WS_PONG) {
+      continue;
+    }
+    if (opcode == WS_CLOSE) {
+      send_frame(ws, WS_CLOSE, control, payload < 2 ? 0 : 2);
+      break;
+    }
+    if (opcode != WS_CONTINUATION) {
+      message_opcode = opcode;
+    }
+    *len += (size_t)payload;
+    if (fin) {
+      return message_opcode;
+    }
+  }
+  ws_server_disconnect(ws);
+  return -1;
+}
+
+void ws_server_disconnect(ws_server_t *ws) {
+  if (ws->fd >= 0) {
+    close(ws->fd);
+    ws->fd = -1;
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Just enough RFC 6455 server for the host stand-ins: one client at a
+// time, any path, no extensions. Fragmented messages are reassembled and
+// pings answered inside ws_server_recv.
+
+#define WS_TEXT 0x1
+#define WS_BINARY 0x2
+
+typedef struct {
+  int listen_fd;
+  int fd; // Connected client, -1 while none
+} ws_server_t;
+
+// Listen on `port` on all interfaces. 0 on success, -1 with errno set.
+int ws_server_listen(ws_server_t *ws, uint16_t port);
+
+// Wait for a client and complete the opening handshake. 0 on success.
+int ws_server_accept(ws_server_t *ws);
+
+// Wait up to `timeout_ms` for the next message and copy up to `cap` bytes
+// of it into `buf`; `len` is its full length. Returns WS_TEXT or
+// WS_BINARY, 0 on timeout, -1 once the client is gone.
+int ws_server_recv(ws_server_t *ws, uint8_t *buf, size_t cap, size_t *len,
+                   int timeout_ms);
+
+// Send one unfragmented message. 0 on success, -1 once the client is gone.
+int ws_server_send(ws_server_t *ws, int opcode, const void *data,
+                   size_t len);
+
+// Drop the client, keep listening
+void ws_server_disconnect(ws_server_t *ws);
@@ -0,0 +1,125 @@
+#include "audio_adpcm.h"
+
+static const int16_t step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                       -1, -1, -1, -1, 2, 4, 6, 8};
+
+void audio_adpcm_reset(audio_adpcm_state_t *state) {
+  state->predictor = 0;
+  state->step_index = 0;
+}
+
+// Apply one nibble to the state, exactly as the decoder will
+static inline void adpcm_update(int32_t *predictor, int32_t *index,
+                                uint8_t nibble) {
+  int32_t step = step_table[*index];
+  int32_t diff = step >> 3;
+  if (nibble & 4)
+    diff += step;
+  if (nibble & 2)
+    diff += step >> 1;
+  if (nibble & 1)
+    diff += step >> 2;
+
+  int32_t value = (nibble & 8) ? *predictor - diff : *predictor + diff;
+  if (value > INT16_MAX)
+    value = INT16_MAX;
+  if (value < INT16_MIN)
+    value = INT16_MIN;
+  *predictor = value;
+
+  *index += index_table[nibble];
+  if (*index < 0)
+    *index = 0;
+  if (*index > 88)
+    *index = 88;
+}
+
+static inline uint8_t adpcm_encode_sample(int32_t *predictor, int32_t *index,
+                                          int16_t sample) {
+  int32_t step = step_table[*index];
+  int32_t diff = sample - *predictor;
+  uint8_t nibble = 0;
+  if (diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+  if (diff >= step) {
+    nibble |= 4;
+    diff -= step;
+  }
+  if (diff >= step >> 1) {
+    nibble |= 2;
+    diff -= step >> 1;
+  }
+  if (diff >= step >> 2) {
+    nibble |= 1;
+  }
+
+  adpcm_update(predictor, index, nibble);
+  return nibble;
+}
+
+size_t audio_adpcm_encode_frame(audio_adpcm_state_t *state,
+                                const int16_t *in, size_t samples,
+                                uint8_t *out) {
+  if (samples > UINT16_MAX) {
+    samples = UINT16_MAX;
+  }
+
+  int32_t predictor = state->predictor;
+  int32_t index = state->step_index;
+
+  out[0] = (uint8_t)(predictor & 0xFF);
+  out[1] = (uint8_t)((predictor >> 8) & 0xFF);
+  out[2] = (uint8_t)index;
+  out[3] = 0;
+  out[4] = (uint8_t)(samples & 0xFF);
+  out[5] = (uint8_t)(samples >> 8);
+
+  uint8_t *data = out + AUDIO_ADPCM_HEADER_BYTES;
+  for (size_t i = 0; i < samples; i += 2) {
+    uint8_t lo = adpcm_encode_sample(&predictor, &index, in[i]);
+    uint8_t hi = (i + 1 < samples)
+                     ? adpcm_encode_sample(&predictor, &index, in[i + 1])
+                     : 0;
+    *data++ = (uint8_t)(lo | (hi << 4));
+  }
+
+  state->predictor = (int16_t)predictor;
+  state->step_index = (uint8_t)index;
+  return AUDIO_ADPCM_FRAME_BYTES(samples);
+}
+
+size_t audio_adpcm_decode_frame(const uint8_t *in, size_t len, int16_t *out,
+                                size_t max_samples) {
+  if (len < AUDIO_ADPCM_HEADER_BYTES) {
+    return 0;
+  }
+
+  int32_t predictor = (int16_t)(in[0] | (in[1] << 8));
+  int32_t index = in[2];
+  size_t samples = in[4] | (in[5] << 8);
+  if (index > 88 || len < AUDIO_ADPCM_FRAME_BYTES(samples) ||
+      samples > max_samples) {
+    return 0;
+  }
+
+  const uint8_t *data = in + AUDIO_ADPCM_HEADER_BYTES;
+  for (size_t i = 0; i < samples; i++) {
+    uint8_t nibble = (i & 1) ? (data[i / 2] >> 4) : (data[i / 2] & 0x0F);
+    adpcm_update(&predictor, &index, nibble);
+    out[i] = (int16_t)predictor;
+  }
+  return samples;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// IMA-ADPCM (4 bits per sample) for mono pcm16.
+//
+// Every frame starts with the encoder state it was coded from, so a decoder
+// can start at any frame and a lost frame never corrupts the next one:
+//
+//   offset 0  int16  predictor   (little-endian)
+//   offset 2  uint8  step_index  (0..88)
+//   offset 3  uint8  reserved    (0)
+//   offset 4  uint16 samples     (little-endian)
+//   offset 6  nibbles, low nibble first, padded to a whole byte
+
+#define AUDIO_ADPCM_HEADER_BYTES 6
+#define AUDIO_ADPCM_FRAME_BYTES(samples)                                       \
+  (AUDIO_ADPCM_HEADER_BYTES + ((samples) + 1) / 2)
+
+typedef struct {
+  int16_t predictor;
+  uint8_t step_index;
+} audio_adpcm_state_t;
+
+void audio_adpcm_reset(audio_adpcm_state_t *state);
+
+// Encode `samples` (<= 65535) into one self-describing frame and return its
+// size in bytes. The state carries over so consecutive frames stay
+// continuous.
+size_t audio_adpcm_encode_frame(audio_adpcm_state_t *state,
+                                const int16_t *in, size_t samples,
+                                uint8_t *out);
+
+// Decode one frame without any prior state. Returns the number of samples
+// written (at most `max_samples`), or 0 for a malformed frame.
+size_t audio_adpcm_decode_frame(const uint8_t *in, size_t len, int16_t *out,
+                                size_t max_samples);
@@ -0,0 +1,265 @@
+#include "audio_aec.h"
+
+#include <math.h>
+#include <string.h>
+
+#define POWER_SMOOTHING 0.7f  // Weight of the previous per-bin power estimate
+#define POWER_FLOOR 1.0e4f    // Regularizes bins with no reference energy
+#define ERLE_SMOOTHING 0.95f  // Per block, ~160ms
+#define CONVERGED_ERLE_DB 6.0f
+#define DIVERGENCE_RATIO 4.0f // Error this much louder than the mic resets
+#define SEARCH_INTERVAL 4     // Blocks between bulk delay searches
+#define SEARCH_MIN_CORR 0.5f
+#define SEARCH_MIN_VAR 9.0f // Reference envelope variance (dB^2) needed
+
+static float block_energy(const float *x, size_t n) {
+  float sum = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    sum += x[i] * x[i];
+  }
+  return sum / n;
+}
+
+static void reset_filter(audio_aec_t *aec) {
+  memset(aec->weights, 0, sizeof(aec->weights));
+  aec->mic_energy = 0.0f;
+  aec->error_energy = 0.0f;
+  aec->erle_db = 0.0f;
+  aec->converged = false;
+  aec->resets++;
+}
+
+void audio_aec_init(audio_aec_t *aec, uint32_t sample_rate) {
+  memset(aec, 0, sizeof(*aec));
+  aec->step = 0.5f;
+  aec->far_min_energy = 1.0e3f; // ~ -60 dBFS
+  aec->dt_ratio = 4.0f;         // 6 dB
+  aec->delay_search = true;
+
+  aec->max_delay = sample_rate * AUDIO_AEC_MAX_DELAY_MS / 1000;
+  if (aec->max_delay > AUDIO_AEC_HISTORY - 2 * AUDIO_AEC_BLOCK) {
+    aec->max_delay = AUDIO_AEC_HISTORY - 2 * AUDIO_AEC_BLOCK;
+  }
+  audio_fft_init(&aec->fft, AUDIO_AEC_FFT_SIZE);
+  audio_aec_reset(aec);
+}
+
+void audio_aec_reset(audio_aec_t *aec) {
+  memset(aec->far_spectra, 0, sizeof(aec->far_spectra));
+  memset(aec->far_power, 0, sizeof(aec->far_power));
+  memset(aec->history, 0, sizeof(aec->history));
+  memset(aec->far_env, 0, sizeof(aec->far_env));
+  memset(aec->mic_env, 0, sizeof(aec->mic_env));
+  aec->newest = 0;
+  aec->constrain_next = 0;
+  aec->written = 0;
+  aec->delay = 0;
+  aec->blocks = 0;
+  aec->candidate_lag = -1;
+  reset_filter(aec);
+  aec->resets = 0;
+}
+
+// Find the reference -> mic lag (in blocks) with the strongest envelope
+// correlation, and move the filter there once two searches agree
+static void search_delay(audio_aec_t *aec) {
+  const uint32_t max_lag = aec->max_delay / AUDIO_AEC_BLOCK;
+  const uint32_t mask = AUDIO_AEC_ENV_BLOCKS - 1;
+  const uint32_t end = aec->blocks; // One past the newest envelope
+  if (end < AUDIO_AEC_ENV_WINDOW + max_lag) {
+    return;
+  }
+
+  float mic_mean = 0.0f;
+  for (uint32_t i = 0; i < AUDIO_AEC_ENV_WINDOW; i++) {
+    mic_mean += aec->mic_env[(end - 1 - i) & mask];
+  }
+  mic_mean /= AUDIO_AEC_ENV_WINDOW;
+
+  float best_corr = SEARCH_MIN_CORR;
+  int32_t best_lag = -1;
+  for (uint32_t lag = 0; lag <= max_lag; lag++) {
+    float far_mean = 0.0f;
+    for (uint32_t i = 0; i < AUDIO_AEC_ENV_WINDOW; i++) {
+      far_mean += aec->far_env[(end - 1 - i - lag) & mask];
+    }
+    far_mean /= AUDIO_AEC_ENV_WINDOW;
+
+    float sxy = 0.0f, sxx = 0.0f, syy = 0.0f;
+    for (uint32_t i = 0; i < AUDIO_AEC_ENV_WINDOW; i++) {
+      float m = aec->mic_env[(end - 1 - i) & mask] - mic_mean;
+      float f = aec->far_env[(end - 1 - i - lag) & mask] - far_mean;
+      sxy += m * f;
+      sxx += f * f;
+      syy += m * m;
+    }
+    if (sxx < SEARCH_MIN_VAR * AUDIO_AEC_ENV_WINDOW || syy <= 0.0f) {
+      continue; // Reference too steady to say anything
+    }
+    float corr = sxy / sqrtf(sxx * syy);
+    if (corr > best_corr) {
+      best_corr = corr;
+      best_lag = (int32_t)lag;
+    }
+  }
+
+  if (best_lag < 0) {
+    return;
+  }
+  if (best_lag != aec->candidate_lag) {
+    aec->candidate_lag = best_lag;
+    return;
+  }
+
+  // Leave one block of headroom so the echo onset sits inside the tail.
+  // Neighbouring lags are both covered by the tail, so only move (and
+  // lose the converged filter) for a real change.
+  uint32_t delay = best_lag > 0 ? (uint32_t)(best_lag - 1) * AUDIO_AEC_BLOCK
+                                : 0;
+  uint32_t moved = delay > aec->delay ? delay - aec->delay : aec->delay - delay;
+  if (moved > AUDIO_AEC_BLOCK) {
+    aec->delay = delay;
+    memset(aec->far_spectra, 0, sizeof(aec->far_spectra));
+    reset_filter(aec);
+  }
+}
+
+static void process_block(audio_aec_t *aec, const int16_t *mic,
+                          const int16_t *far, int16_t *out) {
+  const uint32_t mask = AUDIO_AEC_HISTORY - 1;
+  float *time = aec->time;
+  audio_fft_complex_t *spectrum = aec->spectrum;
+
+  // Append the reference and record both envelopes for the delay search
+  float far_sum = 0.0f, mic_sum = 0.0f;
+  for (uint32_t i = 0; i < AUDIO_AEC_BLOCK; i++) {
+    aec->history[(aec->written + i) & mask] = far[i];
+    far_sum += (float)far[i] * far[i];
+    mic_sum += (float)mic[i] * mic[i];
+  }
+  aec->written += AUDIO_AEC_BLOCK;
+  uint32_t env = aec->blocks & (AUDIO_AEC_ENV_BLOCKS - 1);
+  aec->far_env[env] = 10.0f * log10f(far_sum / AUDIO_AEC_BLOCK + 1.0f);
+  aec->mic_env[env] = 10.0f * log10f(mic_sum / AUDIO_AEC_BLOCK + 1.0f);
+  aec->blocks++;
+
+  // Overlap-save input: the two newest blocks of delayed reference
+  uint32_t start = aec->written - aec->delay - AUDIO_AEC_FFT_SIZE;
+  for (uint32_t i = 0; i < AUDIO_AEC_FFT_SIZE; i++) {
+    time[i] = aec->history[(start + i) & mask];
+  }
+  float far_energy = block_energy(&time[AUDIO_AEC_BLOCK], AUDIO_AEC_BLOCK);
+
+  aec->newest = (aec->newest + AUDIO_AEC_PARTITIONS - 1) % AUDIO_AEC_PARTITIONS;
+  audio_fft_complex_t *x0 = aec->far_spectra[aec->newest];
+  audio_fft_forward(&aec->fft, time, x0);
+  for (uint32_t k = 0; k < AUDIO_AEC_BINS; k++) {
+    float p = x0[k].re * x0[k].re + x0[k].im * x0[k].im;
+    aec->far_power[k] =
+        POWER_SMOOTHING * aec->far_power[k] + (1.0f - POWER_SMOOTHING) * p;
+  }
+
+  // Echo estimate: sum of partition responses, last block of the IFFT
+  memset(spectrum, 0, sizeof(aec->spectrum));
+  for (uint32_t p = 0; p < AUDIO_AEC_PARTITIONS; p++) {
+    const audio_fft_complex_t *w = aec->weights[p];
+    const audio_fft_complex_t *x =
+        aec->far_spectra[(aec->newest + p) % AUDIO_AEC_PARTITIONS];
+    for (uint32_t k = 0; k < AUDIO_AEC_BINS; k++) {
+      spectrum[k].re += w[k].re * x[k].re - w[k].im * x[k].im;
+      spectrum[k].im += w[k].re * x[k].im + w[k].im * x[k].re;
+    }
+  }
+  audio_fft_inverse(&aec->fft, spectrum, time);
+
+  float mic_energy = 0.0f, echo_energy = 0.0f, error_energy = 0.0f;
+  for (uint32_t i = 0; i < AUDIO_AEC_BLOCK; i++) {
+    float y = time[AUDIO_AEC_BLOCK + i];
+    float e = (float)mic[i] - y;
+    mic_energy += (float)mic[i] * mic[i];
+    echo_energy += y * y;
+    error_energy += e * e;
+
+    long s = lrintf(e);
+    if (s > INT16_MAX)
+      s = INT16_MAX;
+    if (s < INT16_MIN)
+      s = INT16_MIN;
+    out[i] = (int16_t)s;
+    time[i] = 0.0f;
+    time[AUDIO_AEC_BLOCK + i] = e;
+  }
+
+  // Near-end talk is only recognizable once the echo estimate is good;
+  // ERLE is not tracked through it so it cannot unconverge the filter
+  bool far_active = far_energy > aec->far_min_energy;
+  bool near_talk = aec->converged && mic_energy > aec->dt_ratio * echo_energy;
+  if (far_active && !near_talk) {
+    aec->mic_energy = ERLE_SMOOTHING * aec->mic_energy +
+                      (1.0f - ERLE_SMOOTHING) * mic_energy;
+    aec->error_energy = ERLE_SMOOTHING * aec->error_energy +
+                        (1.0f - ERLE_SMOOTHING) * error_energy;
+    aec->erle_db =
+        10.0f * log10f((aec->mic_energy + 1.0f) / (aec->error_energy + 1.0f));
+    aec->converged = aec->erle_db > CONVERGED_ERLE_DB;
+
+    // Judged above the level worth adapting on: an echo onset the filter
+    // is a few samples late for must not throw away the converged model
+    if (error_energy > DIVERGENCE_RATIO * mic_energy +
+                           aec->far_min_energy * AUDIO_AEC_BLOCK) {
+      reset_filter(aec);
+      far_active = false;
+    }
+  }
+
+  if (far_active && !near_talk) {
+    // NLMS update from the error spectrum, normalized per bin
+    audio_fft_forward(&aec->fft, time, spectrum);
+    for (uint32_t k = 0; k < AUDIO_AEC_BINS; k++) {
+      float mu = aec->step / (AUDIO_AEC_PARTITIONS * aec->far_power[k] +
+                              POWER_FLOOR);
+      spectrum[k].re *= mu;
+      spectrum[k].im *= mu;
+    }
+    for (uint32_t p = 0; p < AUDIO_AEC_PARTITIONS; p++) {
+      audio_fft_complex_t *w = aec->weights[p];
+      const audio_fft_complex_t *x =
+          aec->far_spectra[(aec->newest + p) % AUDIO_AEC_PARTITIONS];
+      for (uint32_t k = 0; k < AUDIO_AEC_BINS; k++) {
+        // w += mu * conj(x) * e
+        w[k].re += x[k].re * spectrum[k].re + x[k].im * spectrum[k].im;
+        w[k].im += x[k].re * spectrum[k].im - x[k].im * spectrum[k].re;
+      }
+    }
+
+    // Keep one partition's impulse response causal and one block long
+    audio_fft_complex_t *w = aec->weights[aec->constrain_next];
+    memcpy(spectrum, w, sizeof(aec->spectrum));
+    audio_fft_inverse(&aec->fft, spectrum, time);
+    memset(&time[AUDIO_AEC_BLOCK], 0, AUDIO_AEC_BLOCK * sizeof(float));
+    audio_fft_forward(&aec->fft, time, w);
+    aec->constrain_next = (aec->constrain_next + 1) % AUDIO_AEC_PARTITIONS;
+  }
+
+  // A converged filter already has the right delay
+  if (aec->delay_search && !aec->converged &&
+      aec->blocks % SEARCH_INTERVAL == 0) {
+    search_delay(aec);
+  }
+}
+
+void audio_aec_process(audio_aec_t *aec, const int16_t *mic,
+                       const int16_t *far, int16_t *out, size_t samples) {
+  size_t done = 0;
+  for (; done + AUDIO_AEC_BLOCK <= samples; done += AUDIO_AEC_BLOCK) {
+    process_block(aec, mic + done, far + done, out + done);
+  }
+
+  // A partial tail block passes through; its reference still has to land
+  // in the history so the alignment holds
+  const uint32_t mask = AUDIO_AEC_HISTORY - 1;
+  for (; done < samples; done++) {
+    aec->history[aec->written++ & mask] = far[done];
+    out[done] = mic[done];
+  }
+}
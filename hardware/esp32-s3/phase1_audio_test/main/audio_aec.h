@@ -0,0 +1,89 @@
+#pragma once
+
+#include "audio_fft.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Acoustic echo canceller for the speaker -> microphone path.
+//
+// A partitioned-block frequency-domain NLMS filter (overlap-save, 128-sample
+// blocks, 256-point FFTs) models the echo path from the playback reference
+// to the mic and subtracts its estimate. Four partitions give a 512-tap
+// (32ms at 16kHz) tail; the unconstrained update is made causal again one
+// partition per block, round robin.
+//
+// The tail only has to cover the room, not the playback pipeline: a bulk
+// delay estimator cross-correlates the per-block log energy envelopes of the
+// reference and the mic over ~400ms and offsets the reference by the peak,
+// up to AUDIO_AEC_MAX_DELAY_MS. A delay change resets the filter.
+//
+// Adaptation is frozen while the reference is silent and, once the filter
+// has converged, while the mic carries clearly more energy than the echo
+// estimate (near-end talk). A filter that makes the signal louder is reset.
+//
+// Cost per 128-sample block: 5 real FFTs plus 2 x 4 x 129 complex MACs,
+// roughly 30k flops or ~4M flops/s at 16kHz, a few percent of one core with
+// the S3 FPU. The envelope search adds 26 x 48 MACs every 4 blocks.
+
+#define AUDIO_AEC_BLOCK 128
+#define AUDIO_AEC_FFT_SIZE (2 * AUDIO_AEC_BLOCK)
+#define AUDIO_AEC_BINS (AUDIO_AEC_BLOCK + 1)
+#define AUDIO_AEC_PARTITIONS 4
+#define AUDIO_AEC_HISTORY 4096 // Reference samples kept, power of two
+#define AUDIO_AEC_MAX_DELAY_MS 200
+#define AUDIO_AEC_ENV_BLOCKS 128 // Envelope history, power of two
+#define AUDIO_AEC_ENV_WINDOW 48  // Blocks correlated per delay search
+
+typedef struct {
+  // Configuration, set by audio_aec_init() and adjustable afterwards
+  float step;           // NLMS step size, 0 < step <= 1
+  float far_min_energy; // Mean-square reference level worth adapting on
+  float dt_ratio;       // Mic / echo energy treated as near-end talk
+  bool delay_search;    // Track the bulk delay (otherwise keep `delay`)
+
+  // Echo path model
+  audio_fft_t fft;
+  audio_fft_complex_t weights[AUDIO_AEC_PARTITIONS][AUDIO_AEC_BINS];
+  audio_fft_complex_t far_spectra[AUDIO_AEC_PARTITIONS][AUDIO_AEC_BINS];
+  float far_power[AUDIO_AEC_BINS];
+  uint16_t newest; // Partition holding the latest reference spectrum
+  uint16_t constrain_next;
+
+  // Reference history and bulk delay
+  int16_t history[AUDIO_AEC_HISTORY];
+  uint32_t written; // Reference samples written, wraps
+  uint32_t delay;   // Samples the reference is offset by
+  uint32_t max_delay;
+  float far_env[AUDIO_AEC_ENV_BLOCKS];
+  float mic_env[AUDIO_AEC_ENV_BLOCKS];
+  uint32_t blocks;
+  int32_t candidate_lag; // Delay search result awaiting confirmation
+
+  // Scratch
+  float time[AUDIO_AEC_FFT_SIZE];
+  audio_fft_complex_t spectrum[AUDIO_AEC_BINS];
+
+  // Telemetry
+  float mic_energy;   // Smoothed, for ERLE
+  float error_energy; // Smoothed, for ERLE
+  float erle_db;      // Echo return loss enhancement
+  bool converged;
+  uint32_t resets;
+} audio_aec_t;
+
+// audio_aec_t is ~23KB; keep it off task stacks
+void audio_aec_init(audio_aec_t *aec, uint32_t sample_rate);
+void audio_aec_reset(audio_aec_t *aec);
+
+// Cancel echo from `samples` of mono pcm16 mic audio. `far` holds the same
+// number of reference samples, the audio handed to the speaker over the
+// same interval. `out` may alias `mic`.
+void audio_aec_process(audio_aec_t *aec, const int16_t *mic,
+                       const int16_t *far, int16_t *out, size_t samples);
+
+// Current bulk delay estimate in milliseconds
+static inline uint32_t audio_aec_delay_ms(const audio_aec_t *aec,
+                                          uint32_t sample_rate) {
+  return aec->delay * 1000 / sample_rate;
+}
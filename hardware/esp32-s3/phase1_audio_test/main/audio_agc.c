@@ -0,0 +1,149 @@
+#include "audio_agc.h"
+
+#include <math.h>
+#include <string.h>
+
+#define ATTACK_MS 50.0f
+#define RELEASE_MS 800.0f
+#define LIMITER_RELEASE_MS 50.0f
+#define LOOKAHEAD_MS 2
+#define CEILING_DBFS -1.0f
+#define FULL_SCALE 32768.0f
+
+static float db_to_linear(float db) { return powf(10.0f, db / 20.0f); }
+
+void audio_agc_init(audio_agc_t *agc, uint32_t sample_rate,
+                    float target_dbfs) {
+  memset(agc, 0, sizeof(*agc));
+  agc->target_dbfs = target_dbfs;
+  agc->max_gain_db = 30.0f;
+  agc->min_gain_db = -10.0f;
+  agc->gate_dbfs = -50.0f;
+  agc->ceiling = FULL_SCALE * db_to_linear(CEILING_DBFS);
+  agc->attack_coef = 1.0f - expf(-AUDIO_AGC_FRAME_MS / ATTACK_MS);
+  agc->release_coef = 1.0f - expf(-AUDIO_AGC_FRAME_MS / RELEASE_MS);
+  agc->limiter_release =
+      1.0f - expf(-1000.0f / (LIMITER_RELEASE_MS * sample_rate));
+  agc->enabled = true;
+
+  agc->frame_samples = sample_rate * AUDIO_AGC_FRAME_MS / 1000;
+  agc->lookahead = sample_rate * LOOKAHEAD_MS / 1000;
+  if (agc->lookahead > AUDIO_AGC_MAX_LOOKAHEAD) {
+    agc->lookahead = AUDIO_AGC_MAX_LOOKAHEAD;
+  }
+  if (agc->lookahead == 0) {
+    agc->lookahead = 1;
+  }
+  audio_agc_reset(agc);
+}
+
+void audio_agc_reset(audio_agc_t *agc) {
+  memset(agc->delay, 0, sizeof(agc->delay));
+  agc->pos = 0;
+  agc->energy = 0.0f;
+  agc->envelope_db = agc->target_dbfs; // Start at unity gain
+  agc->gain = 1.0f;
+  agc->gain_step = 0.0f;
+  agc->limiter = 1.0f;
+  agc->peak = 0.0f;
+  agc->peak_age = 0;
+  agc->head = 0;
+}
+
+// End of a detector frame: move the envelope and aim the gain ramp
+static void update_gain(audio_agc_t *agc) {
+  float mean_square = agc->energy / agc->frame_samples;
+  float level_db =
+      10.0f * log10f(mean_square / (FULL_SCALE * FULL_SCALE) + 1e-12f);
+  agc->energy = 0.0f;
+
+  if (level_db > agc->gate_dbfs) {
+    float coef = level_db > agc->envelope_db ? agc->attack_coef
+                                             : agc->release_coef;
+    agc->envelope_db += (level_db - agc->envelope_db) * coef;
+  }
+
+  float gain_db = agc->enabled ? agc->target_dbfs - agc->envelope_db : 0.0f;
+  if (gain_db > agc->max_gain_db)
+    gain_db = agc->max_gain_db;
+  if (gain_db < agc->min_gain_db)
+    gain_db = agc->min_gain_db;
+  agc->gain_step = (db_to_linear(gain_db) - agc->gain) / agc->frame_samples;
+}
+
+// Gain one sample (pcm16 units), run it through the look-ahead limiter and
+// return the sample leaving the delay line
+static inline int16_t agc_sample(audio_agc_t *agc, float x) {
+  agc->energy += x * x;
+  float y = x * agc->gain;
+  agc->gain += agc->gain_step;
+  if (++agc->pos == agc->frame_samples) {
+    agc->pos = 0;
+    update_gain(agc);
+  }
+
+  // Oldest sample out, newest in
+  const uint32_t n = agc->lookahead;
+  float delayed = agc->delay[agc->head];
+  agc->delay[agc->head] = y;
+  agc->head = agc->head + 1 == n ? 0 : agc->head + 1;
+
+  // Peak over the look-ahead window, rescanned only when the held peak
+  // has left it
+  float magnitude = fabsf(y);
+  if (magnitude >= agc->peak) {
+    agc->peak = magnitude;
+    agc->peak_age = 0;
+  } else if (++agc->peak_age >= n) {
+    agc->peak = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+      // Index i counts from the oldest sample (at head)
+      float m = fabsf(agc->delay[(agc->head + i) % n]);
+      if (m >= agc->peak) {
+        agc->peak = m;
+        agc->peak_age = n - 1 - i;
+      }
+    }
+  }
+
+  // Reach the target within the window so the peak is already covered
+  float target = agc->peak > agc->ceiling ? agc->ceiling / agc->peak : 1.0f;
+  if (target < agc->limiter) {
+    agc->limiter += (target - agc->limiter) * (5.0f / n < 1.0f ? 5.0f / n
+                                                               : 1.0f);
+  } else {
+    agc->limiter += (target - agc->limiter) * agc->limiter_release;
+  }
+
+  // With far to fall, the ramp is still a sliver short when the peak
+  // leaves the window; that sample is held to the ceiling itself
+  if (fabsf(delayed) * agc->limiter > agc->ceiling) {
+    agc->limiter = agc->ceiling / fabsf(delayed);
+  }
+
+  long s = lrintf(delayed * agc->limiter);
+  if (s > INT16_MAX)
+    s = INT16_MAX;
+  if (s < INT16_MIN)
+    s = INT16_MIN;
+  return (int16_t)s;
+}
+
+void audio_agc_process_s16(audio_agc_t *agc, const int16_t *in, int16_t *out,
+                           size_t samples) {
+  for (size_t i = 0; i < samples; i++) {
+    out[i] = agc_sample(agc, (float)in[i]);
+  }
+}
+
+void audio_agc_process_s32(audio_agc_t *agc, const int32_t *in, int16_t *out,
+                           size_t samples) {
+  const float scale = 1.0f / 65536.0f;
+  for (size_t i = 0; i < samples; i++) {
+    out[i] = agc_sample(agc, (float)in[i] * scale);
+  }
+}
+
+float audio_agc_gain_db(const audio_agc_t *agc) {
+  return 20.0f * log10f(agc->gain * agc->limiter + 1e-6f);
+}
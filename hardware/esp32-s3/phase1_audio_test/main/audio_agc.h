@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming automatic gain control with a look-ahead peak limiter.
+//
+// Every 10ms frame the input RMS level feeds an envelope that rises with
+// the attack time constant and falls with the release time constant; frames
+// below the gate (silence, room noise) leave it alone so pauses are not
+// pumped up. The gain that brings the envelope to the target level is
+// clamped to [min_gain_db, max_gain_db] and ramped per sample across the
+// next frame.
+//
+// The limiter looks `lookahead` samples (2ms) ahead: when a gained peak
+// would exceed the ceiling, its gain has already ramped down by the time
+// the peak is output, so onsets the AGC has not caught up with do not clip.
+// Output lags input by the look-ahead.
+//
+// pcm32 input (full scale 2^31, e.g. INMP441 slots) is gained before it is
+// narrowed, so quiet talkers keep the low bits a plain >> 16 would drop.
+// All state is inline; nothing is allocated. Roughly 15 flops per sample.
+
+#define AUDIO_AGC_FRAME_MS 10
+#define AUDIO_AGC_MAX_LOOKAHEAD 64
+
+typedef struct {
+  // Configuration, set by audio_agc_init() and adjustable afterwards
+  float target_dbfs;     // Speech RMS level to settle at
+  float max_gain_db;
+  float min_gain_db;
+  float gate_dbfs;       // Quieter frames do not move the envelope
+  float ceiling;         // Limiter ceiling, linear pcm16 units
+  float attack_coef;     // Per frame, envelope rising
+  float release_coef;    // Per frame, envelope falling
+  float limiter_release; // Per sample
+  bool enabled;          // Off: unity gain, limiter still guards clipping
+
+  // State
+  uint32_t frame_samples;
+  uint32_t pos;
+  float energy;
+  float envelope_db;
+  float gain;      // Linear, current
+  float gain_step; // Per sample ramp toward the frame's target
+  float limiter;   // Linear limiter gain
+  float peak;
+  uint32_t peak_age;
+  uint32_t lookahead;
+  uint32_t head;
+  float delay[AUDIO_AGC_MAX_LOOKAHEAD];
+} audio_agc_t;
+
+void audio_agc_init(audio_agc_t *agc, uint32_t sample_rate,
+                    float target_dbfs);
+void audio_agc_reset(audio_agc_t *agc);
+
+// Mono pcm16 in and out; `out` may alias `in`
+void audio_agc_process_s16(audio_agc_t *agc, const int16_t *in, int16_t *out,
+                           size_t samples);
+
+// Mono pcm32 (full scale 2^31) in, pcm16 out
+void audio_agc_process_s32(audio_agc_t *agc, const int32_t *in, int16_t *out,
+                           size_t samples);
+
+// Total gain currently applied (AGC and limiter), for telemetry
+float audio_agc_gain_db(const audio_agc_t *agc);
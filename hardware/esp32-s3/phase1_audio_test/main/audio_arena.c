@@ -0,0 +1,91 @@
+#include "audio_arena.h"
+
+#include "esp_heap_caps.h"
+#include <string.h>
+
+static audio_arena_t arenas[AUDIO_ARENA_COUNT] = {
+    [AUDIO_ARENA_DMA] = {.name = "dma"},
+    [AUDIO_ARENA_INTERNAL] = {.name = "internal"},
+    [AUDIO_ARENA_PSRAM] = {.name = "psram"},
+};
+
+// Preferred heap caps, then the fallback (0 for none)
+static const uint32_t arena_caps[AUDIO_ARENA_COUNT][2] = {
+    [AUDIO_ARENA_DMA] = {MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL, 0},
+    [AUDIO_ARENA_INTERNAL] = {MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, 0},
+    [AUDIO_ARENA_PSRAM] = {MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+                           MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT},
+};
+
+static size_t request_align(const audio_arena_request_t *request) {
+  return request->align ? request->align : AUDIO_ARENA_ALIGN;
+}
+
+static size_t align_up(size_t offset, size_t align) {
+  return (offset + align - 1) & ~(align - 1);
+}
+
+esp_err_t audio_arena_init(const audio_arena_request_t *requests,
+                           size_t count) {
+  for (int a = 0; a < AUDIO_ARENA_COUNT; a++) {
+    if (arenas[a].base) {
+      return ESP_ERR_INVALID_STATE;
+    }
+  }
+
+  // Every arena starts on a cache line, so laying the requests out from
+  // offset 0 gives the exact size
+  size_t sizes[AUDIO_ARENA_COUNT] = {0};
+  for (size_t i = 0; i < count; i++) {
+    const audio_arena_request_t *request = &requests[i];
+    size_t align = request_align(request);
+    if (request->arena >= AUDIO_ARENA_COUNT || !request->out ||
+        align > AUDIO_ARENA_MAX_ALIGN || (align & (align - 1))) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    sizes[request->arena] =
+        align_up(sizes[request->arena], align) + request->bytes;
+  }
+
+  for (int a = 0; a < AUDIO_ARENA_COUNT; a++) {
+    if (sizes[a] == 0) {
+      continue;
+    }
+    for (int c = 0; c < 2 && !arenas[a].base && arena_caps[a][c]; c++) {
+      arenas[a].base = heap_caps_aligned_alloc(AUDIO_ARENA_MAX_ALIGN,
+                                               sizes[a], arena_caps[a][c]);
+      arenas[a].caps = arena_caps[a][c];
+    }
+    if (!arenas[a].base) {
+      audio_arena_free();
+      return ESP_ERR_NO_MEM;
+    }
+    memset(arenas[a].base, 0, sizes[a]);
+    arenas[a].size = sizes[a];
+  }
+
+  size_t offsets[AUDIO_ARENA_COUNT] = {0};
+  for (size_t i = 0; i < count; i++) {
+    const audio_arena_request_t *request = &requests[i];
+    audio_arena_t *arena = &arenas[request->arena];
+    size_t offset = align_up(offsets[request->arena], request_align(request));
+    *request->out = arena->base + offset;
+    offsets[request->arena] = offset + request->bytes;
+    arena->buffers++;
+  }
+  return ESP_OK;
+}
+
+const audio_arena_t *audio_arena_get(audio_arena_id_t id) {
+  return &arenas[id];
+}
+
+void audio_arena_free(void) {
+  for (int a = 0; a < AUDIO_ARENA_COUNT; a++) {
+    heap_caps_free(arenas[a].base);
+    arenas[a].base = NULL;
+    arenas[a].caps = 0;
+    arenas[a].size = 0;
+    arenas[a].buffers = 0;
+  }
+}
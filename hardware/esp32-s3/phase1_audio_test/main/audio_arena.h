@@ -0,0 +1,58 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Boot-time arenas for every buffer the firmware keeps.
+//
+// The firmware lists its buffers once, each with a size, an alignment and
+// the kind of memory it needs. audio_arena_init() sizes one arena per kind
+// from that list, reserves each with a single heap_caps allocation, and
+// carves the buffers out of them in order, zeroed. Nothing is ever handed
+// back, so the heap sees three allocations for the life of the firmware
+// and long uptimes cannot fragment it around the audio buffers.
+//
+//   arena      heap caps                       for
+//   dma        MALLOC_CAP_DMA | INTERNAL       I2S read targets
+//   internal   MALLOC_CAP_INTERNAL | 8BIT      hot-path DSP state, buffers
+//   psram      MALLOC_CAP_SPIRAM | 8BIT        history, codec state
+//
+// The psram arena falls back to internal RAM on boards without PSRAM, as
+// the direct allocations it replaces did; audio_arena_get() tells which.
+
+#define AUDIO_ARENA_ALIGN 8      // Default, enough for int64_t and double
+#define AUDIO_ARENA_MAX_ALIGN 64 // A data cache line
+
+typedef enum {
+  AUDIO_ARENA_DMA = 0,
+  AUDIO_ARENA_INTERNAL,
+  AUDIO_ARENA_PSRAM,
+  AUDIO_ARENA_COUNT,
+} audio_arena_id_t;
+
+// One buffer: audio_arena_init() stores its address in *out
+typedef struct {
+  void **out;
+  size_t bytes;
+  size_t align; // Power of two up to AUDIO_ARENA_MAX_ALIGN, 0 for default
+  audio_arena_id_t arena;
+} audio_arena_request_t;
+
+typedef struct {
+  const char *name;
+  uint32_t caps; // The heap the storage came from, 0 if not reserved
+  uint8_t *base;
+  size_t size;   // Bytes reserved, all of them carved out
+  uint32_t buffers;
+} audio_arena_t;
+
+// Reserve the arenas and hand out every request. On failure nothing stays
+// allocated and no *out is written. Call once.
+esp_err_t audio_arena_init(const audio_arena_request_t *requests,
+                           size_t count);
+
+const audio_arena_t *audio_arena_get(audio_arena_id_t id);
+
+// Return the arenas to the heap; every buffer carved from them is gone
+void audio_arena_free(void);
@@ -0,0 +1,163 @@
+#include "audio_beamformer.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SPEED_OF_SOUND_MM_PER_S 343000.0f
+#define ADAPT_SMOOTHING 0.2f     // Fraction of the new estimate taken per block
+#define REDESIGN_THRESHOLD 0.05f // Samples of delay change before redesign
+
+// Q15 windowed-sinc fractional delay of `delay` samples (0 < delay < taps-1)
+static void design_delay(int16_t *taps, float delay) {
+  float h[AUDIO_BEAM_TAPS];
+  float sum = 0.0f;
+  for (int n = 0; n < AUDIO_BEAM_TAPS; n++) {
+    float t = n - delay;
+    float sinc =
+        fabsf(t) < 1e-6f ? 1.0f : sinf((float)M_PI * t) / ((float)M_PI * t);
+    // Blackman window centred on the delay so the response stays symmetric
+    float w = 0.42f + 0.5f * cosf((float)M_PI * t / (AUDIO_BEAM_TAPS / 2)) +
+              0.08f * cosf(2.0f * (float)M_PI * t / (AUDIO_BEAM_TAPS / 2));
+    h[n] = fabsf(t) < AUDIO_BEAM_TAPS / 2 ? sinc * w : 0.0f;
+    sum += h[n];
+  }
+  for (int n = 0; n < AUDIO_BEAM_TAPS; n++) {
+    taps[n] = (int16_t)lrintf(h[n] / sum * 32767.0f);
+  }
+}
+
+// Split the steering delay across both channels around the filter centre
+static void redesign(audio_beamformer_t *bf) {
+  const float centre = (AUDIO_BEAM_TAPS - 1) * 0.5f;
+  design_delay(bf->taps_left, centre + bf->delay * 0.5f);
+  design_delay(bf->taps_right, centre - bf->delay * 0.5f);
+  bf->designed = bf->delay;
+}
+
+void audio_beamformer_init(audio_beamformer_t *bf, uint32_t sample_rate,
+                           uint32_t spacing_mm) {
+  memset(bf, 0, sizeof(*bf));
+  bf->sample_rate = sample_rate;
+  bf->max_delay = spacing_mm * sample_rate / SPEED_OF_SOUND_MM_PER_S;
+  if (bf->max_delay > AUDIO_BEAM_MAX_LAG) {
+    bf->max_delay = AUDIO_BEAM_MAX_LAG;
+  }
+  bf->min_level = 1.0e5f; // ~ -50 dBFS
+  audio_beamformer_set_mode(bf, AUDIO_BEAM_BROADSIDE);
+}
+
+void audio_beamformer_set_mode(audio_beamformer_t *bf, audio_beam_mode_t mode) {
+  bf->mode = mode;
+  if (mode == AUDIO_BEAM_ENDFIRE) {
+    bf->delay = bf->max_delay;
+  } else if (mode == AUDIO_BEAM_BROADSIDE) {
+    bf->delay = 0.0f;
+  }
+  // Adaptive keeps the current delay as its starting point
+  redesign(bf);
+}
+
+const char *audio_beamformer_mode_name(audio_beam_mode_t mode) {
+  switch (mode) {
+  case AUDIO_BEAM_ENDFIRE:
+    return "endfire";
+  case AUDIO_BEAM_ADAPTIVE:
+    return "adaptive";
+  case AUDIO_BEAM_BROADSIDE:
+  default:
+    return "broadside";
+  }
+}
+
+float audio_beamformer_angle(const audio_beamformer_t *bf) {
+  if (bf->max_delay <= 0.0f) {
+    return 0.0f;
+  }
+  float ratio = bf->delay / bf->max_delay;
+  if (ratio > 1.0f)
+    ratio = 1.0f;
+  if (ratio < -1.0f)
+    ratio = -1.0f;
+  return asinf(ratio) * 180.0f / (float)M_PI;
+}
+
+// Estimate how far the right channel lags the left from the
+// cross-correlation peak, refined with a parabolic fit
+static void adapt_delay(audio_beamformer_t *bf, const int16_t *stereo,
+                        size_t frames) {
+  const int lag = AUDIO_BEAM_MAX_LAG;
+  if (frames <= 2 * lag) {
+    return;
+  }
+
+  float energy = 0.0f;
+  float corr[2 * AUDIO_BEAM_MAX_LAG + 1] = {0};
+  for (size_t n = lag; n < frames - lag; n++) {
+    float l = stereo[2 * n];
+    energy += l * l;
+    for (int k = -lag; k <= lag; k++) {
+      corr[k + lag] += l * stereo[2 * (n + k) + 1];
+    }
+  }
+  if (energy / (frames - 2 * lag) < bf->min_level) {
+    return; // Too quiet to trust
+  }
+
+  int best = 0;
+  for (int i = 1; i < 2 * lag + 1; i++) {
+    if (corr[i] > corr[best])
+      best = i;
+  }
+  float estimate = best - lag;
+  if (best > 0 && best < 2 * lag) {
+    float a = corr[best - 1], b = corr[best], c = corr[best + 1];
+    float denom = a - 2.0f * b + c;
+    if (denom < 0.0f) {
+      estimate += 0.5f * (a - c) / denom;
+    }
+  }
+  if (estimate > bf->max_delay)
+    estimate = bf->max_delay;
+  if (estimate < -bf->max_delay)
+    estimate = -bf->max_delay;
+
+  bf->delay += (estimate - bf->delay) * ADAPT_SMOOTHING;
+  if (fabsf(bf->delay - bf->designed) > REDESIGN_THRESHOLD) {
+    redesign(bf);
+  }
+}
+
+void audio_beamformer_process(audio_beamformer_t *bf, const int16_t *stereo,
+                              int16_t *mono, size_t frames) {
+  if (bf->mode == AUDIO_BEAM_ADAPTIVE) {
+    adapt_delay(bf, stereo, frames);
+  }
+
+  uint32_t pos = bf->pos;
+  for (size_t i = 0; i < frames; i++) {
+    int16_t l = stereo[2 * i];
+    int16_t r = stereo[2 * i + 1];
+    pos = (pos == 0) ? AUDIO_BEAM_TAPS - 1 : pos - 1;
+    bf->hist_left[pos] = bf->hist_left[pos + AUDIO_BEAM_TAPS] = l;
+    bf->hist_right[pos] = bf->hist_right[pos + AUDIO_BEAM_TAPS] = r;
+
+    // Tap n applies to the sample n steps in the past
+    const int16_t *hl = &bf->hist_left[pos];
+    const int16_t *hr = &bf->hist_right[pos];
+    // Rounding for the >> 16 (Q15 taps, halved sum). The taps of each
+    // filter add up to 1 but their magnitudes to more, so full-scale input
+    // can take the two sums past 32 bits.
+    int64_t acc = 1 << 15;
+    for (int n = 0; n < AUDIO_BEAM_TAPS; n++) {
+      acc += (int32_t)bf->taps_left[n] * hl[n] +
+             (int64_t)bf->taps_right[n] * hr[n];
+    }
+    acc >>= 16;
+    if (acc > INT16_MAX)
+      acc = INT16_MAX;
+    if (acc < INT16_MIN)
+      acc = INT16_MIN;
+    mono[i] = (int16_t)acc;
+  }
+  bf->pos = (uint16_t)pos;
+}
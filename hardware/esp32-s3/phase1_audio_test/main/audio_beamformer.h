@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Two-microphone delay-and-sum beamformer for the INMP441 pair.
+//
+// Each channel runs through a 16-tap windowed-sinc fractional delay so the
+// wavefront from the steering direction lines up before the channels are
+// summed. Steering angle is measured from broadside, positive toward the
+// left (L/R = GND) microphone:
+//
+//   BROADSIDE  0 degrees, equal delays (in-phase sum, no comb filtering)
+//   ENDFIRE    +90 degrees, full inter-mic delay d / c
+//   ADAPTIVE   delay tracked from the inter-channel cross-correlation peak
+//              of loud blocks, smoothed and limited to +/- d / c
+//
+// Cycle budget at 16kHz: 2 x 16 MACs per output sample plus a 2 x max-lag + 1
+// point cross-correlation per sample in adaptive mode, about 45 MACs per
+// sample or ~0.7M MAC/s. With the 64-bit accumulator a MAC takes a few
+// cycles, so that is a few percent of one 160MHz core (dsp_bench's
+// stage.beam has the measured count). Filter redesign (32 sinf/cosf) only
+// happens when the steering delay moves.
+
+#define AUDIO_BEAM_TAPS 16
+#define AUDIO_BEAM_MAX_LAG 4 // Samples searched each side in adaptive mode
+
+typedef enum {
+  AUDIO_BEAM_BROADSIDE = 0,
+  AUDIO_BEAM_ENDFIRE,
+  AUDIO_BEAM_ADAPTIVE,
+} audio_beam_mode_t;
+
+typedef struct {
+  audio_beam_mode_t mode;
+  uint32_t sample_rate;
+  float max_delay; // Inter-mic delay in samples for endfire arrival
+  float delay;     // Current steering delay (left relative to right)
+  float designed;  // Delay the filters were last designed for
+  float min_level; // Mean-square level a block needs to adapt on
+  uint16_t pos;
+  int16_t taps_left[AUDIO_BEAM_TAPS];
+  int16_t taps_right[AUDIO_BEAM_TAPS];
+  int16_t hist_left[2 * AUDIO_BEAM_TAPS]; // Mirrored, like the resampler
+  int16_t hist_right[2 * AUDIO_BEAM_TAPS];
+} audio_beamformer_t;
+
+void audio_beamformer_init(audio_beamformer_t *bf, uint32_t sample_rate,
+                           uint32_t spacing_mm);
+void audio_beamformer_set_mode(audio_beamformer_t *bf, audio_beam_mode_t mode);
+const char *audio_beamformer_mode_name(audio_beam_mode_t mode);
+
+// Interleaved stereo pcm16 in, mono pcm16 out (may alias the input)
+void audio_beamformer_process(audio_beamformer_t *bf, const int16_t *stereo,
+                              int16_t *mono, size_t frames);
+
+// Current steering angle in degrees, derived from the delay
+float audio_beamformer_angle(const audio_beamformer_t *bf);
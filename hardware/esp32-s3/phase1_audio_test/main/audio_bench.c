@@ -0,0 +1,629 @@
+#include "audio_bench.h"
+
+#include "audio_convert.h"
+#include "audio_kernels.h"
+#include "audio_opus.h"
+#include "audio_pipeline.h"
+#include "audio_ring.h"
+#include "audio_sdm.h"
+#include "audio_stages.h"
+#include "audio_vad.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include <math.h>
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#define BENCH_UNIT "ns"
+#define BENCH_CPU_MHZ 0 // Unknown, and not what the ticks count
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#define BENCH_UNIT "cycles"
+#define BENCH_CPU_MHZ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#endif
+
+// The settings the firmware runs its modules with
+#define BENCH_SAMPLE_RATE 16000
+#define BENCH_NETWORK_RATE 24000 // Realtime pcm16, both directions
+#define BENCH_MIC_SPACING_MM 50
+#define BENCH_AGC_TARGET_DBFS -20.0f
+#define BENCH_PIPELINE_FRAMES 512 // process_audio_data's block
+#define BENCH_RING_BYTES 4096     // One capture block
+
+// Stereo int32 in; the widest output, the SDM bitstream, is the same size
+#define BENCH_BUFFER_BYTES (AUDIO_BENCH_MAX_FRAMES * 2 * sizeof(int32_t))
+#define BENCH_MIN_CALLS 4
+#define BENCH_MAX_CASES 40
+
+typedef struct {
+  char name[32];
+  audio_stage_t stage;
+} bench_case_t;
+
+// Everything a run needs besides the buffers under test
+typedef struct {
+  audio_pipeline_t monitor; // process_audio_data()
+  audio_pipeline_t uplink;  // The sender task's chain, beam and AEC on
+  audio_pipeline_t swapping; // The same, AEC toggled every block
+  audio_chain_t monitor_chain;
+  audio_chain_t uplink_chain;
+  audio_chain_t uplink_no_aec_chain;
+
+  audio_beamformer_t beam;
+  audio_dc_block_t dc;
+  audio_gain_t gain;
+  audio_aec_t aec;
+  audio_aec_stage_t aec_stage;
+  audio_ns_t ns;
+  audio_agc_t agc;
+  audio_agc_t agc32;
+  audio_meter_t meter;
+  audio_resampler_t upsampler;
+  audio_resampler_t downsampler;
+  audio_adpcm_state_t adpcm;
+  audio_sdm_t sdm;
+  audio_vad_t vad;
+  audio_u8_levels_t levels;
+  int16_t far[AUDIO_BENCH_MAX_FRAMES]; // AEC reference
+  audio_ring_t ring;
+  _Alignas(AUDIO_RING_CACHE_LINE) uint8_t ring_storage[BENCH_RING_BYTES];
+  audio_opus_encoder_t opus;
+  void *opus_state; // libopus's, in PSRAM as in the firmware
+
+  bench_case_t cases[BENCH_MAX_CASES];
+  size_t count;
+} bench_t;
+
+// Kernels and modules with no stage of their own. `state` is the bench_t.
+
+static size_t narrow_process(void *state, const void *in, void *out,
+                             size_t frames) {
+  audio_kernel_narrow_s32_s16(in, out, frames, 16);
+  return frames;
+}
+
+static size_t narrow_ref_process(void *state, const void *in, void *out,
+                                 size_t frames) {
+  audio_kernel_narrow_s32_s16_ref(in, out, frames, 16);
+  return frames;
+}
+
+static size_t mix_process(void *state, const void *in, void *out,
+                          size_t frames) {
+  audio_kernel_mix_stereo_s16(in, out, frames);
+  return frames;
+}
+
+static size_t mix_ref_process(void *state, const void *in, void *out,
+                              size_t frames) {
+  audio_kernel_mix_stereo_s16_ref(in, out, frames);
+  return frames;
+}
+
+static size_t u8_process(void *state, const void *in, void *out,
+                         size_t frames) {
+  audio_kernel_s16_to_u8(in, out, frames);
+  return frames;
+}
+
+static size_t u8_ref_process(void *state, const void *in, void *out,
+                             size_t frames) {
+  audio_kernel_s16_to_u8_ref(in, out, frames);
+  return frames;
+}
+
+// -3dB in Q15
+static size_t gain_process(void *state, const void *in, void *out,
+                           size_t frames) {
+  audio_kernel_gain_s16(in, out, frames, 23170, 15);
+  return frames;
+}
+
+static size_t gain_ref_process(void *state, const void *in, void *out,
+                               size_t frames) {
+  audio_kernel_gain_s16_ref(in, out, frames, 23170, 15);
+  return frames;
+}
+
+// Planar halves of the output, or of the input for interleave
+static size_t deinterleave_process(void *state, const void *in, void *out,
+                                   size_t frames) {
+  int16_t *left = out;
+  audio_kernel_deinterleave_s16(in, left, left + frames, frames);
+  return frames * 2 * sizeof(int16_t);
+}
+
+static size_t deinterleave_ref_process(void *state, const void *in,
+                                       void *out, size_t frames) {
+  int16_t *left = out;
+  audio_kernel_deinterleave_s16_ref(in, left, left + frames, frames);
+  return frames * 2 * sizeof(int16_t);
+}
+
+static size_t interleave_process(void *state, const void *in, void *out,
+                                 size_t frames) {
+  const int16_t *left = in;
+  audio_kernel_interleave_s16(left, left + frames, out, frames);
+  return frames * 2 * sizeof(int16_t);
+}
+
+static size_t interleave_ref_process(void *state, const void *in, void *out,
+                                     size_t frames) {
+  const int16_t *left = in;
+  audio_kernel_interleave_s16_ref(left, left + frames, out, frames);
+  return frames * 2 * sizeof(int16_t);
+}
+
+static size_t stereo32_to_mono16_process(void *state, const void *in,
+                                         void *out, size_t frames) {
+  return audio_convert_stereo32_to_mono16(in, out, frames * 2);
+}
+
+static size_t stereo32_to_mono32_process(void *state, const void *in,
+                                         void *out, size_t frames) {
+  return audio_convert_stereo32_to_mono32(in, out, frames * 2);
+}
+
+// The capture task's 500ms level monitor over one block of duty values
+static size_t level_monitor_process(void *state, const void *in, void *out,
+                                    size_t frames) {
+  bench_t *bench = state;
+  audio_kernel_u8_levels(in, frames, &bench->levels);
+  return 0;
+}
+
+static size_t sdm_process(void *state, const void *in, void *out,
+                          size_t frames) {
+  bench_t *bench = state;
+  audio_sdm_modulate(&bench->sdm, in, frames, out);
+  return frames * AUDIO_SDM_WORDS_PER_SAMPLE * sizeof(uint32_t);
+}
+
+static size_t vad_process(void *state, const void *in, void *out,
+                          size_t frames) {
+  bench_t *bench = state;
+  audio_vad_process(&bench->vad, in, frames);
+  return 0;
+}
+
+// Through the capture ring and out again, a ring's worth at a time, as
+// the capture and sender tasks hand blocks over
+static size_t ring_process(void *state, const void *in, void *out,
+                           size_t frames) {
+  bench_t *bench = state;
+  size_t bytes = frames * 2 * sizeof(int32_t);
+  for (size_t done = 0; done < bytes;) {
+    size_t n = audio_ring_write(&bench->ring, (const uint8_t *)in + done,
+                                bytes - done);
+    audio_ring_read(&bench->ring, (uint8_t *)out + done, n);
+    done += n;
+  }
+  return frames;
+}
+
+static void count_packet(const uint8_t *packet, size_t len, void *ctx) {
+  *(size_t *)ctx += len;
+}
+
+// Buffered into 20ms packets as the sender does, so a call that completes
+// no packet only copies: the mean is the figure to read for this case
+static size_t opus_encode_process(void *state, const void *in, void *out,
+                                  size_t frames) {
+  bench_t *bench = state;
+  size_t bytes = 0;
+  audio_opus_encoder_feed(&bench->opus, in, frames, count_packet, &bytes);
+  return 0;
+}
+
+// Whether libopus encodes at all: the host links a stand-in without it
+static bool opus_works(bench_t *bench) {
+  if (!bench->opus_state ||
+      audio_opus_encoder_init(&bench->opus, bench->opus_state,
+                              BENCH_SAMPLE_RATE, 0) != ESP_OK) {
+    return false;
+  }
+  size_t bytes = 0;
+  audio_opus_encoder_feed(&bench->opus, bench->far, bench->opus.frame_samples,
+                          count_packet, &bytes);
+  return bytes > 0;
+}
+
+// A whole chain fed in pipeline blocks, copied out like
+// process_audio_data() does
+static size_t chain_process(void *state, const void *in, void *out,
+                            size_t frames) {
+  audio_pipeline_t *pipeline = state;
+  const audio_chain_t *chain = pipeline->active;
+  size_t in_bytes = audio_format_frame_bytes(pipeline->in_format);
+  size_t out_bytes =
+      audio_format_frame_bytes(chain->slots[chain->count - 1]->out_format);
+  size_t produced = 0;
+  for (size_t done = 0; done < frames;) {
+    size_t n = frames - done < pipeline->block_frames
+                   ? frames - done
+                   : pipeline->block_frames;
+    size_t out_frames;
+    const void *block = audio_pipeline_process(
+        pipeline, (const uint8_t *)in + done * in_bytes, n, &out_frames);
+    memcpy((uint8_t *)out + produced * out_bytes, block,
+           out_frames * out_bytes);
+    produced += out_frames;
+    done += n;
+  }
+  return produced;
+}
+
+// The uplink chain with AEC toggled before every block, so each block is a
+// swap block: AEC is reset, runs next to its bypass and is crossfaded
+static size_t swap_process(void *state, const void *in, void *out,
+                           size_t frames) {
+  bench_t *bench = state;
+  audio_pipeline_t *pipeline = &bench->swapping;
+  size_t in_bytes = audio_format_frame_bytes(pipeline->in_format);
+  size_t produced = 0;
+  for (size_t done = 0; done < frames;) {
+    size_t n = frames - done < pipeline->block_frames
+                   ? frames - done
+                   : pipeline->block_frames;
+    audio_pipeline_swap(pipeline, pipeline->active == &bench->uplink_chain
+                                      ? &bench->uplink_no_aec_chain
+                                      : &bench->uplink_chain);
+    produced += chain_process(pipeline, (const uint8_t *)in + done * in_bytes,
+                              (int16_t *)out + produced, n);
+    done += n;
+  }
+  return produced;
+}
+
+typedef struct {
+  const char *name;
+  audio_format_t in_format;
+  audio_format_t out_format;
+  audio_stage_process_t process;
+} bench_kernel_t;
+
+static const bench_kernel_t kernels[] = {
+    {"kernel.narrow_s32_s16", AUDIO_FORMAT_S32_MONO, AUDIO_FORMAT_S16_MONO,
+     narrow_process},
+    {"kernel.narrow_s32_s16_ref", AUDIO_FORMAT_S32_MONO,
+     AUDIO_FORMAT_S16_MONO, narrow_ref_process},
+    {"kernel.mix_stereo_s16", AUDIO_FORMAT_S16_STEREO, AUDIO_FORMAT_S16_MONO,
+     mix_process},
+    {"kernel.mix_stereo_s16_ref", AUDIO_FORMAT_S16_STEREO,
+     AUDIO_FORMAT_S16_MONO, mix_ref_process},
+    {"kernel.s16_to_u8", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_U8_MONO,
+     u8_process},
+    {"kernel.s16_to_u8_ref", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_U8_MONO,
+     u8_ref_process},
+    {"kernel.gain_s16", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO,
+     gain_process},
+    {"kernel.gain_s16_ref", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO,
+     gain_ref_process},
+    {"kernel.deinterleave_s16", AUDIO_FORMAT_S16_STEREO, AUDIO_FORMAT_BYTES,
+     deinterleave_process},
+    {"kernel.deinterleave_s16_ref", AUDIO_FORMAT_S16_STEREO,
+     AUDIO_FORMAT_BYTES, deinterleave_ref_process},
+    {"kernel.interleave_s16", AUDIO_FORMAT_S16_STEREO, AUDIO_FORMAT_BYTES,
+     interleave_process},
+    {"kernel.interleave_s16_ref", AUDIO_FORMAT_S16_STEREO,
+     AUDIO_FORMAT_BYTES, interleave_ref_process},
+    {"convert.stereo32_to_mono16", AUDIO_FORMAT_S32_STEREO,
+     AUDIO_FORMAT_S16_MONO, stereo32_to_mono16_process},
+    {"convert.stereo32_to_mono32", AUDIO_FORMAT_S32_STEREO,
+     AUDIO_FORMAT_S32_MONO, stereo32_to_mono32_process},
+    {"level_monitor", AUDIO_FORMAT_U8_MONO, AUDIO_FORMAT_BYTES,
+     level_monitor_process},
+    {"sdm.modulate", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_BYTES, sdm_process},
+    {"vad", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_BYTES, vad_process},
+    {"ring.write_read", AUDIO_FORMAT_S32_STEREO, AUDIO_FORMAT_S32_STEREO,
+     ring_process},
+};
+
+// Stage factories fill in the slot new_case() returns; add_case() then
+// names it and counts it
+static audio_stage_t *new_case(bench_t *bench) {
+  return &bench->cases[bench->count].stage;
+}
+
+static audio_stage_t *add_case(bench_t *bench, const char *prefix) {
+  bench_case_t *c = &bench->cases[bench->count++];
+  snprintf(c->name, sizeof(c->name), "%s%s", prefix, c->stage.name);
+  return &c->stage;
+}
+
+static void add_chain(bench_t *bench, const char *name,
+                      audio_pipeline_t *pipeline) {
+  audio_stage_t *stage = new_case(bench);
+  memset(stage, 0, sizeof(*stage));
+  stage->name = name;
+  stage->in_format = pipeline->in_format;
+  stage->state = pipeline;
+  stage->process = chain_process;
+  add_case(bench, "");
+}
+
+static esp_err_t setup(bench_t *bench) {
+  audio_beamformer_init(&bench->beam, BENCH_SAMPLE_RATE,
+                        BENCH_MIC_SPACING_MM);
+  bench->gain = (audio_gain_t){.gain = 23170, .shift = 15};
+  audio_aec_init(&bench->aec, BENCH_SAMPLE_RATE);
+  bench->aec_stage.aec = &bench->aec;
+  audio_ns_init(&bench->ns, AUDIO_NS_LOW);
+  audio_agc_init(&bench->agc, BENCH_SAMPLE_RATE, BENCH_AGC_TARGET_DBFS);
+  audio_agc_init(&bench->agc32, BENCH_SAMPLE_RATE, BENCH_AGC_TARGET_DBFS);
+  esp_err_t err = audio_resampler_init(&bench->upsampler, BENCH_SAMPLE_RATE,
+                                       BENCH_NETWORK_RATE, 0);
+  if (err == ESP_OK) {
+    err = audio_resampler_init(&bench->downsampler, BENCH_NETWORK_RATE,
+                               BENCH_SAMPLE_RATE, 0);
+  }
+  if (err != ESP_OK) {
+    return err;
+  }
+  audio_adpcm_reset(&bench->adpcm);
+  audio_sdm_reset(&bench->sdm);
+  audio_vad_init(&bench->vad, BENCH_SAMPLE_RATE);
+  audio_ring_init(&bench->ring, bench->ring_storage, BENCH_RING_BYTES);
+  for (size_t i = 0; i < AUDIO_BENCH_MAX_FRAMES; i++) {
+    bench->far[i] = (int16_t)(8000.0f * sinf(0.3f * i));
+  }
+
+  bench->count = 0;
+  for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+    audio_stage_t *stage = new_case(bench);
+    memset(stage, 0, sizeof(*stage));
+    stage->name = kernels[i].name;
+    stage->in_format = kernels[i].in_format;
+    stage->out_format = kernels[i].out_format;
+    stage->state = bench;
+    stage->process = kernels[i].process;
+    add_case(bench, "");
+  }
+
+  audio_stage_mix16(new_case(bench));
+  add_case(bench, "stage.");
+  audio_stage_mix32(new_case(bench));
+  audio_stage_t *mix32 = add_case(bench, "stage.");
+  audio_stage_beamformer(new_case(bench), &bench->beam);
+  audio_stage_t *beam = add_case(bench, "stage.");
+  audio_stage_dc_block(new_case(bench), &bench->dc);
+  audio_stage_t *dc = add_case(bench, "stage.");
+  audio_stage_gain(new_case(bench), &bench->gain);
+  add_case(bench, "stage.");
+  audio_stage_aec(new_case(bench), &bench->aec_stage);
+  audio_stage_t *aec = add_case(bench, "stage.");
+  audio_stage_ns(new_case(bench), &bench->ns);
+  audio_stage_t *ns = add_case(bench, "stage.");
+  audio_stage_agc_s16(new_case(bench), &bench->agc);
+  audio_stage_t *agc = add_case(bench, "stage.");
+  audio_stage_agc_s32(new_case(bench), &bench->agc32);
+  audio_stage_t *agc32 = add_case(bench, "stage.");
+  audio_stage_meter(new_case(bench), &bench->meter);
+  audio_stage_t *meter = add_case(bench, "stage.");
+  audio_stage_resample(new_case(bench), &bench->upsampler);
+  new_case(bench)->name = "resample_up";
+  add_case(bench, "stage.");
+  audio_stage_resample(new_case(bench), &bench->downsampler);
+  new_case(bench)->name = "resample_down";
+  add_case(bench, "stage.");
+  audio_stage_adpcm(new_case(bench), &bench->adpcm);
+  add_case(bench, "stage.");
+  audio_stage_to_u8(new_case(bench));
+  audio_stage_t *duty = add_case(bench, "stage.");
+
+  // The chains reuse the stage cases; timing counters are not read here
+  bench->monitor_chain = (audio_chain_t){
+      .slots = {mix32, agc32, duty},
+      .count = 3,
+  };
+  bench->uplink_chain = (audio_chain_t){
+      .slots = {beam, dc, aec, ns, agc, meter},
+      .count = 6,
+  };
+  bench->uplink_no_aec_chain = (audio_chain_t){
+      .slots = {beam, dc, NULL, ns, agc, meter},
+      .count = 6,
+  };
+  err = audio_pipeline_init(&bench->monitor, AUDIO_FORMAT_S32_STEREO,
+                            BENCH_PIPELINE_FRAMES, &bench->monitor_chain);
+  if (err == ESP_OK) {
+    err = audio_pipeline_init(&bench->uplink, AUDIO_FORMAT_S32_STEREO,
+                              BENCH_PIPELINE_FRAMES, &bench->uplink_chain);
+  }
+  if (err == ESP_OK) {
+    err = audio_pipeline_init(&bench->swapping, AUDIO_FORMAT_S32_STEREO,
+                              BENCH_PIPELINE_FRAMES, &bench->uplink_chain);
+  }
+  if (err != ESP_OK) {
+    return err;
+  }
+  add_chain(bench, "process_audio_data", &bench->monitor);
+  add_chain(bench, "uplink_chain", &bench->uplink);
+  audio_stage_t *swap = new_case(bench);
+  memset(swap, 0, sizeof(*swap));
+  swap->name = "uplink_chain_swap";
+  swap->in_format = AUDIO_FORMAT_S32_STEREO;
+  swap->state = bench;
+  swap->process = swap_process;
+  add_case(bench, "");
+
+  if (opus_works(bench)) {
+    audio_stage_t *stage = new_case(bench);
+    memset(stage, 0, sizeof(*stage));
+    stage->name = "codec.opus_encode";
+    stage->in_format = AUDIO_FORMAT_S16_MONO;
+    stage->out_format = AUDIO_FORMAT_BYTES;
+    stage->state = bench;
+    stage->process = opus_encode_process;
+    add_case(bench, "");
+  }
+  return ESP_OK;
+}
+
+// A 440Hz tone around -20dBFS with some noise, in the case's input format,
+// so level-dependent code (AGC, NS, VAD, AEC) takes its usual path
+static void fill_input(void *in, audio_format_t format) {
+  uint32_t noise = 12345;
+  for (size_t i = 0; i < AUDIO_BENCH_MAX_FRAMES; i++) {
+    noise = noise * 1664525u + 1013904223u;
+    int32_t left =
+        (int32_t)(3000.0f * sinf(2.0f * (float)M_PI * 440.0f * i /
+                                 BENCH_SAMPLE_RATE)) +
+        (int32_t)(noise >> 23) - 256;
+    int32_t right = left * 3 / 4;
+    switch (format) {
+    case AUDIO_FORMAT_S16_MONO:
+      ((int16_t *)in)[i] = (int16_t)left;
+      break;
+    case AUDIO_FORMAT_S16_STEREO:
+      ((int16_t *)in)[2 * i] = (int16_t)left;
+      ((int16_t *)in)[2 * i + 1] = (int16_t)right;
+      break;
+    case AUDIO_FORMAT_S32_MONO:
+      ((int32_t *)in)[i] = left * 65536;
+      break;
+    case AUDIO_FORMAT_S32_STEREO:
+      ((int32_t *)in)[2 * i] = left * 65536;
+      ((int32_t *)in)[2 * i + 1] = right * 65536;
+      break;
+    case AUDIO_FORMAT_U8_MONO:
+    default:
+      ((uint8_t *)in)[i] = (uint8_t)((left >> 8) + 128);
+      break;
+    }
+  }
+}
+
+// One call over `frames`, in the stage's own block size as the pipeline
+// would feed it
+static void run_stage(const audio_stage_t *stage, const void *in, void *out,
+                      size_t frames) {
+  size_t per_call = stage->block_frames ? stage->block_frames : frames;
+  size_t in_bytes = audio_format_frame_bytes(stage->in_format);
+  size_t out_bytes = audio_format_frame_bytes(stage->out_format);
+  size_t produced = 0;
+  for (size_t done = 0; done < frames; done += per_call) {
+    size_t n = frames - done < per_call ? frames - done : per_call;
+    produced += stage->process(stage->state,
+                               (const uint8_t *)in + done * in_bytes,
+                               (uint8_t *)out + produced * out_bytes, n);
+  }
+}
+
+static void bench_point(bench_t *bench, const bench_case_t *c,
+                        const char *placement, const void *in, void *out,
+                        size_t frames, uint32_t budget, FILE *f) {
+  uint32_t calls = budget / frames;
+  if (calls < BENCH_MIN_CALLS) {
+    calls = BENCH_MIN_CALLS;
+  }
+  uint32_t min = UINT32_MAX;
+  uint32_t max = 0;
+  uint64_t total = 0;
+  // Call 0 warms the caches and is not counted
+  for (uint32_t i = 0; i <= calls; i++) {
+    bench->aec_stage.far = bench->far;
+    uint32_t start = audio_pipeline_ticks();
+    run_stage(&c->stage, in, out, frames);
+    uint32_t ticks = audio_pipeline_ticks() - start;
+    if (i == 0) {
+      continue;
+    }
+    total += ticks;
+    if (ticks < min) {
+      min = ticks;
+    }
+    if (ticks > max) {
+      max = ticks;
+    }
+  }
+  // Integer formatting keeps the caller's stack small
+  uint32_t per_frame = (uint32_t)((uint64_t)min * 100 / frames);
+  fprintf(f, "@AB1 %s,%s,%u,%u,%u,%u,%u,%u.%02u,%s\n", c->name, placement,
+          (unsigned int)frames, (unsigned int)calls, (unsigned int)min,
+          (unsigned int)(total / calls), (unsigned int)max,
+          (unsigned int)(per_frame / 100), (unsigned int)(per_frame % 100),
+          BENCH_UNIT);
+  fflush(f);
+}
+
+static const struct {
+  const char *name;
+  uint32_t caps;
+} placements[] = {
+    {"internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT},
+    {"psram", MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT},
+};
+
+esp_err_t audio_bench_run(const audio_bench_config_t *config, FILE *out) {
+  bench_t *bench = heap_caps_aligned_alloc(
+      AUDIO_RING_CACHE_LINE, sizeof(*bench), MALLOC_CAP_INTERNAL);
+  if (!bench) {
+    return ESP_ERR_NO_MEM;
+  }
+  // Without PSRAM the Opus case is skipped rather than take internal RAM
+  bench->opus_state = heap_caps_malloc(audio_opus_encoder_state_bytes(),
+                                       MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  esp_err_t err = setup(bench);
+  if (err != ESP_OK) {
+    heap_caps_free(bench->opus_state);
+    heap_caps_free(bench);
+    return err;
+  }
+
+  fprintf(out,
+          "@AB1 # audio_bench target=%s unit=%s cpu_mhz=%d simd=%d "
+          "budget=%u\n",
+          CONFIG_IDF_TARGET, BENCH_UNIT, BENCH_CPU_MHZ,
+          audio_kernels_simd_enabled() ? 1 : 0,
+          (unsigned int)config->budget_frames);
+  fprintf(out, "@AB1 # case,placement,frames,calls,min,mean,max,"
+               "min_per_frame,unit\n");
+
+  for (size_t p = 0; p < sizeof(placements) / sizeof(placements[0]); p++) {
+    uint8_t *in = heap_caps_aligned_alloc(AUDIO_KERNEL_ALIGN,
+                                          BENCH_BUFFER_BYTES,
+                                          placements[p].caps);
+    uint8_t *result = heap_caps_aligned_alloc(AUDIO_KERNEL_ALIGN,
+                                              BENCH_BUFFER_BYTES,
+                                              placements[p].caps);
+    if (!in || !result) {
+      heap_caps_free(in);
+      heap_caps_free(result);
+      fprintf(out, "@AB1 # %s: no memory, skipped\n", placements[p].name);
+      if (p == 0) {
+        heap_caps_free(bench->opus_state);
+        heap_caps_free(bench);
+        return ESP_ERR_NO_MEM;
+      }
+      continue;
+    }
+
+    for (size_t i = 0; i < bench->count; i++) {
+      const bench_case_t *c = &bench->cases[i];
+      if (config->filter && !strstr(c->name, config->filter)) {
+        continue;
+      }
+      fill_input(in, c->stage.in_format);
+      if (c->stage.reset) {
+        c->stage.reset(c->stage.state);
+      }
+      for (size_t frames = config->min_frames;
+           frames <= config->max_frames &&
+           frames <= AUDIO_BENCH_MAX_FRAMES;
+           frames *= 2) {
+        bench_point(bench, c, placements[p].name, in, result, frames,
+                    config->budget_frames, out);
+#if !CONFIG_IDF_TARGET_LINUX
+        vTaskDelay(1); // Let the idle task feed the watchdog
+#endif
+      }
+    }
+    heap_caps_free(in);
+    heap_caps_free(result);
+  }
+  heap_caps_free(bench->opus_state);
+  heap_caps_free(bench);
+  return ESP_OK;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Microbenchmarks for the per-sample DSP code.
+//
+// Covers every kernel in audio_kernels.h (the dispatching entry point and
+// its scalar reference), the audio_convert.h mixers, each pipeline stage
+// factory in audio_stages.h, the sigma-delta modulator, the VAD, a pass
+// through the capture ring, the monitor chain behind process_audio_data(),
+// the uplink chain, the uplink chain with a swap on every block and the
+// Opus encoder. Each case runs over block sizes doubling from min_frames
+// to max_frames, with its input and output buffers first in internal RAM
+// and then in PSRAM.
+// Stage state always lives in internal RAM, as in the firmware.
+//
+// Calls are timed one at a time with audio_pipeline_ticks(), so the
+// figures line up with the per-stage timing in the stats log: CPU cycles
+// on the ESP32-S3, CLOCK_MONOTONIC nanoseconds on the linux host target.
+// The minimum is the one to compare, the mean and maximum show what
+// preemption and cache misses add. Results are printed one per line,
+//
+//   @AB1 case,placement,frames,calls,min,mean,max,min_per_frame,unit
+//
+// and lines starting "@AB1 #" carry the column names and the build.
+// host/bench_compare diffs two such logs.
+//
+// A run allocates its state (~90KB, internal RAM), libopus's encoder state
+// (PSRAM, the Opus case is skipped without it) and two 32KB buffers per
+// placement, and frees them again. libopus encodes on the caller's stack,
+// which needs roughly 24KB for the Opus case.
+
+#define AUDIO_BENCH_MIN_FRAMES 64
+#define AUDIO_BENCH_MAX_FRAMES 4096
+
+typedef struct {
+  const char *filter;     // Runs cases whose name contains it, NULL for all
+  size_t min_frames;      // Block sizes, doubling
+  size_t max_frames;
+  uint32_t budget_frames; // Frames timed per case and block size
+} audio_bench_config_t;
+
+#define AUDIO_BENCH_CONFIG_DEFAULT                                             \
+  {                                                                            \
+    .filter = NULL, .min_frames = AUDIO_BENCH_MIN_FRAMES,                      \
+    .max_frames = AUDIO_BENCH_MAX_FRAMES, .budget_frames = 16000,              \
+  }
+
+// Run the benchmark, printing results to `out` as they complete. Returns
+// ESP_ERR_NO_MEM if the state or internal buffers cannot be allocated; no
+// PSRAM only skips those results.
+esp_err_t audio_bench_run(const audio_bench_config_t *config, FILE *out);
@@ -0,0 +1,43 @@
+#include "audio_convert.h"
+
+const char *audio_uplink_format_name(uplink_format_t format) {
+  switch (format) {
+  case UPLINK_FORMAT_PCM16_MONO:
+    return "pcm16";
+  case UPLINK_FORMAT_IMA_ADPCM:
+    return "adpcm";
+  case UPLINK_FORMAT_OPUS:
+    return "opus";
+  case UPLINK_FORMAT_RAW32_STEREO:
+  default:
+    return "raw32";
+  }
+}
+
+size_t audio_convert_stereo32_to_mono16(const int32_t *input, int16_t *output,
+                                        size_t samples) {
+  size_t frames = samples / 2;
+  for (size_t i = 0; i < frames; i++) {
+    // Sum in 64 bits so full-scale L+R cannot wrap, then drop the averaging
+    // bit and the 16 low bits (8 of them are always zero on the INMP441)
+    int64_t sum = (int64_t)input[2 * i] + input[2 * i + 1];
+    int64_t mixed = (sum + (1 << 16)) >> 17;
+
+    if (mixed > INT16_MAX)
+      mixed = INT16_MAX;
+    if (mixed < INT16_MIN)
+      mixed = INT16_MIN;
+
+    output[i] = (int16_t)mixed;
+  }
+  return frames;
+}
+
+size_t audio_convert_stereo32_to_mono32(const int32_t *input, int32_t *output,
+                                        size_t samples) {
+  size_t frames = samples / 2;
+  for (size_t i = 0; i < frames; i++) {
+    output[i] = (input[2 * i] >> 1) + (input[2 * i + 1] >> 1);
+  }
+  return frames;
+}
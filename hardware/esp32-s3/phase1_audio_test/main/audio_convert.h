@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample format conversion for the INMP441 capture path.
+//
+// The INMP441 delivers 24-bit samples left-aligned in 32-bit I2S slots, so
+// the top 16 bits of each slot are the pcm16 value. All outputs are
+// little-endian, which is the native byte order on both the ESP32-S3 and the
+// linux host target.
+
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+               "pcm16 output assumes a little-endian target");
+
+// Formats the uplink can be switched between at runtime
+typedef enum {
+  UPLINK_FORMAT_RAW32_STEREO = 0, // Raw I2S slots, 8 bytes per frame
+  UPLINK_FORMAT_PCM16_MONO,       // L/R average, 2 bytes per frame
+  UPLINK_FORMAT_IMA_ADPCM,        // pcm16 mono as IMA-ADPCM, 4 bits per frame
+  UPLINK_FORMAT_OPUS,             // pcm16 mono as 20ms Opus packets
+} uplink_format_t;
+
+const char *audio_uplink_format_name(uplink_format_t format);
+
+// Mix interleaved stereo int32 down to mono pcm16 with rounding and
+// saturation. `samples` counts int32 input values (2 per frame); returns the
+// number of int16 values written.
+size_t audio_convert_stereo32_to_mono16(const int32_t *input, int16_t *output,
+                                        size_t samples);
+
+// Mix interleaved stereo int32 down to mono int32, (L >> 1) + (R >> 1),
+// keeping the full slot precision. Returns the number of frames written.
+size_t audio_convert_stereo32_to_mono32(const int32_t *input, int32_t *output,
+                                        size_t samples);
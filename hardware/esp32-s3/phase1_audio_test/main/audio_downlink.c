@@ -0,0 +1,183 @@
+#include "audio_downlink.h"
+
+#include <string.h>
+
+const char *audio_downlink_format_name(audio_downlink_format_t format) {
+  switch (format) {
+  case AUDIO_DOWNLINK_PCM16:
+    return "pcm16";
+  case AUDIO_DOWNLINK_PCM8:
+    return "pcm8";
+  }
+  return "unknown";
+}
+
+esp_err_t audio_downlink_init(audio_downlink_t *dl,
+                              audio_downlink_format_t format,
+                              uint32_t in_rate, uint32_t out_rate) {
+  // Bounds the resampler's output per block to AUDIO_DOWNLINK_OUT_SAMPLES
+  if (!dl || out_rate == 0 || in_rate < (out_rate + 1) / 2) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (in_rate != out_rate) {
+    // Leaves the resampler untouched if the ratio is unsupported
+    esp_err_t err = audio_resampler_init(&dl->resampler, in_rate, out_rate, 0);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  dl->format = format;
+  dl->in_rate = in_rate;
+  dl->out_rate = out_rate;
+  dl->resample = in_rate != out_rate;
+  dl->in_message = false;
+  dl->has_carry = false;
+  dl->message_pos = 0;
+  dl->frame_start = 0;
+  dl->out_len = 0;
+  memset(&dl->stats, 0, sizeof(dl->stats));
+  return ESP_OK;
+}
+
+static void flush(audio_downlink_t *dl, audio_downlink_sink_t sink,
+                  void *ctx) {
+  if (dl->out_len > 0) {
+    sink(dl->out, dl->out_len, ctx);
+    dl->stats.samples += dl->out_len;
+    dl->out_len = 0;
+  }
+}
+
+// Input-rate samples to the sink, through the resampler if needed. `pcm`
+// may point into the message or at dl->in.
+static void emit(audio_downlink_t *dl, const int16_t *pcm, size_t n,
+                 audio_downlink_sink_t sink, void *ctx) {
+  if (!dl->resample) {
+    sink(pcm, n, ctx);
+    dl->stats.samples += n;
+    return;
+  }
+  while (n > 0) {
+    size_t block = n < AUDIO_DOWNLINK_BLOCK ? n : AUDIO_DOWNLINK_BLOCK;
+    if (dl->out_len + audio_resampler_max_output(&dl->resampler, block) >
+        AUDIO_DOWNLINK_OUT_SAMPLES) {
+      flush(dl, sink, ctx);
+    }
+    dl->out_len += audio_resampler_process(&dl->resampler, pcm, block,
+                                           &dl->out[dl->out_len]);
+    pcm += block;
+    n -= block;
+  }
+}
+
+static void decode_pcm16(audio_downlink_t *dl, const uint8_t *data,
+                         size_t len, audio_downlink_sink_t sink, void *ctx) {
+  size_t n = 0;
+  if (dl->has_carry && len > 0) {
+    // Complete the sample the previous event ended half-way through
+    dl->in[n++] = (int16_t)(dl->carry | data[0] << 8);
+    dl->has_carry = false;
+    data++;
+    len--;
+  }
+
+  size_t samples = len / 2;
+  if (n == 0 && ((uintptr_t)data & 1) == 0) {
+    if (samples > 0) {
+      emit(dl, (const int16_t *)data, samples, sink, ctx); // In place
+    }
+  } else {
+    const uint8_t *src = data;
+    for (size_t left = samples; left > 0 || n > 0;) {
+      size_t take = AUDIO_DOWNLINK_BLOCK - n;
+      if (take > left) {
+        take = left;
+      }
+      memcpy(&dl->in[n], src, take * sizeof(int16_t));
+      src += take * sizeof(int16_t);
+      left -= take;
+      emit(dl, dl->in, n + take, sink, ctx);
+      n = 0;
+    }
+  }
+
+  if (len & 1) {
+    dl->carry = data[len - 1];
+    dl->has_carry = true;
+  }
+}
+
+static void decode_pcm8(audio_downlink_t *dl, const uint8_t *data,
+                        size_t len, audio_downlink_sink_t sink, void *ctx) {
+  while (len > 0) {
+    size_t n = len < AUDIO_DOWNLINK_BLOCK ? len : AUDIO_DOWNLINK_BLOCK;
+    for (size_t i = 0; i < n; i++) {
+      dl->in[i] = (int16_t)((data[i] - 128) * 256);
+    }
+    emit(dl, dl->in, n, sink, ctx);
+    data += n;
+    len -= n;
+  }
+}
+
+size_t audio_downlink_feed(audio_downlink_t *dl,
+                           const audio_downlink_fragment_t *fragment,
+                           audio_downlink_sink_t sink, void *ctx) {
+  const uint8_t *data = fragment->data;
+  size_t len = fragment->len;
+  dl->stats.fragments++;
+
+  if (fragment->offset == 0) {
+    if (fragment->first) {
+      if (dl->in_message) {
+        dl->stats.truncated++;
+      }
+      dl->in_message = true;
+      dl->message_pos = 0;
+      dl->has_carry = false;
+      dl->stats.messages++;
+    }
+    dl->frame_start = dl->message_pos;
+  }
+  if (!dl->in_message) {
+    dl->stats.lost++; // The start of this message never arrived
+    return 0;
+  }
+
+  size_t pos = dl->frame_start + fragment->offset;
+  if (pos != dl->message_pos) {
+    dl->stats.lost++;
+    if (pos < dl->message_pos) {
+      return 0; // Already seen
+    }
+    // Bytes went missing: pick up again on the next whole sample
+    dl->has_carry = false;
+    dl->message_pos = pos;
+    if (dl->format == AUDIO_DOWNLINK_PCM16 && (pos & 1) && len > 0) {
+      data++;
+      len--;
+      dl->message_pos++;
+    }
+  }
+  dl->message_pos += len;
+  dl->stats.bytes += fragment->len;
+
+  uint32_t before = dl->stats.samples;
+  if (dl->format == AUDIO_DOWNLINK_PCM16) {
+    decode_pcm16(dl, data, len, sink, ctx);
+  } else {
+    decode_pcm8(dl, data, len, sink, ctx);
+  }
+  flush(dl, sink, ctx);
+
+  if (fragment->fin &&
+      fragment->offset + fragment->len >= fragment->frame_len) {
+    if (dl->has_carry) {
+      dl->stats.odd++; // Drop the half sample, keep the next one aligned
+      dl->has_carry = false;
+    }
+    dl->in_message = false;
+  }
+  return dl->stats.samples - before;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "audio_resampler.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Downlink PCM decoder: WebSocket binary messages to pcm16 at the speaker
+// rate.
+//
+// The esp_websocket_client posts a message as a series of data events: one
+// per receive buffer (payload_offset/payload_len locate it within the
+// frame) and, for fragmented messages, one frame per continuation opcode.
+// Each event is decoded where it lies, so messages are never reassembled: a
+// pcm16 sample split across two events is the only thing carried over, as
+// one byte. Aligned pcm16 is read in place, both when it goes straight to
+// the sink and when it feeds the resampler.
+//
+// Output is handed to a sink callback, at most once per resampler block
+// and usually once per event. Pure C, no ESP-IDF dependencies beyond
+// esp_err.h.
+
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+               "pcm16 is decoded in place on a little-endian target");
+
+#define AUDIO_DOWNLINK_BLOCK 512 // Input samples per resampler call
+#define AUDIO_DOWNLINK_OUT_SAMPLES (2 * AUDIO_DOWNLINK_BLOCK + 2)
+
+typedef enum {
+  AUDIO_DOWNLINK_PCM16 = 0, // Little-endian signed 16-bit mono
+  AUDIO_DOWNLINK_PCM8,      // Unsigned 8-bit mono, the old PWM duty bytes
+} audio_downlink_format_t;
+
+// One WebSocket data event of a binary message
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+  size_t offset;    // payload_offset: where `data` starts in the frame
+  size_t frame_len; // payload_len: the whole frame's payload
+  bool first;       // Opcode 0x02, the message's first frame (not 0x00)
+  bool fin;         // The message's last frame
+} audio_downlink_fragment_t;
+
+typedef void (*audio_downlink_sink_t)(const int16_t *pcm, size_t samples,
+                                      void *ctx);
+
+typedef struct {
+  uint32_t messages;
+  uint32_t fragments;
+  uint32_t bytes;
+  uint32_t samples;   // Output, at out_rate
+  uint32_t lost;      // Fragments dropped or skipped over, out of sequence
+  uint32_t truncated; // Messages cut short by the next one
+  uint32_t odd;       // pcm16 messages with an odd byte count
+} audio_downlink_stats_t;
+
+typedef struct {
+  audio_downlink_format_t format;
+  uint32_t in_rate;
+  uint32_t out_rate;
+  bool resample;
+  bool in_message;
+  bool has_carry;
+  uint8_t carry;       // Low byte of a pcm16 sample split across events
+  size_t message_pos;  // Bytes of the message seen so far
+  size_t frame_start;  // Message bytes before the current frame
+  size_t out_len;
+  audio_downlink_stats_t stats;
+  audio_resampler_t resampler;
+  int16_t in[AUDIO_DOWNLINK_BLOCK]; // Converted input, when not in place
+  int16_t out[AUDIO_DOWNLINK_OUT_SAMPLES];
+} audio_downlink_t;
+
+const char *audio_downlink_format_name(audio_downlink_format_t format);
+
+// Decode `format` at in_rate to out_rate. in_rate must be at least half
+// of out_rate, and the ratio one audio_resampler supports (24k, 48k, 8k ->
+// 16k do; 22.05k and 44.1k do not). On error the decoder is unchanged.
+esp_err_t audio_downlink_init(audio_downlink_t *dl,
+                              audio_downlink_format_t format,
+                              uint32_t in_rate, uint32_t out_rate);
+
+// Decode one data event and pass the result to `sink`. Returns the number
+// of output samples produced.
+size_t audio_downlink_feed(audio_downlink_t *dl,
+                           const audio_downlink_fragment_t *fragment,
+                           audio_downlink_sink_t sink, void *ctx);
@@ -0,0 +1,268 @@
+#include "audio_fft.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+esp_err_t audio_fft_init(audio_fft_t *fft, uint16_t n) {
+  if (n < 8 || n > AUDIO_FFT_MAX_SIZE || (n & (n - 1))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(fft, 0, sizeof(*fft));
+  fft->n = n;
+
+  const uint16_t m = n / 2;
+  int bits = 0;
+  while ((1u << bits) < m) {
+    bits++;
+  }
+  for (uint16_t i = 0; i < m; i++) {
+    uint16_t r = 0;
+    for (int b = 0; b < bits; b++) {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    fft->bitrev[i] = r;
+  }
+
+  for (uint16_t k = 0; k < m; k++) {
+    double phase = -2.0 * M_PI * k / n;
+    fft->twiddle[k].re = (float)cos(phase);
+    fft->twiddle[k].im = (float)sin(phase);
+    fft->twiddle_q15[k].re = (int16_t)lrint(cos(phase) * 32767.0);
+    fft->twiddle_q15[k].im = (int16_t)lrint(sin(phase) * 32767.0);
+  }
+  return ESP_OK;
+}
+
+// In-place forward complex FFT of n/2 points. Its twiddles exp(-2 pi i j /
+// (n/2)) are the even entries of the real-transform table.
+static void complex_fft(const audio_fft_t *fft, audio_fft_complex_t *x) {
+  const uint16_t m = fft->n / 2;
+
+  for (uint16_t i = 0; i < m; i++) {
+    uint16_t j = fft->bitrev[i];
+    if (j > i) {
+      audio_fft_complex_t t = x[i];
+      x[i] = x[j];
+      x[j] = t;
+    }
+  }
+
+  for (uint16_t len = 2; len <= m; len <<= 1) {
+    const uint16_t half = len / 2;
+    const uint16_t stride = 2 * (m / len);
+    for (uint16_t base = 0; base < m; base += len) {
+      for (uint16_t j = 0; j < half; j++) {
+        const audio_fft_complex_t w = fft->twiddle[j * stride];
+        audio_fft_complex_t *a = &x[base + j];
+        audio_fft_complex_t *b = &x[base + j + half];
+        float tr = b->re * w.re - b->im * w.im;
+        float ti = b->re * w.im + b->im * w.re;
+        b->re = a->re - tr;
+        b->im = a->im - ti;
+        a->re += tr;
+        a->im += ti;
+      }
+    }
+  }
+}
+
+void audio_fft_forward(const audio_fft_t *fft, const float *in,
+                       audio_fft_complex_t *out) {
+  const uint16_t m = fft->n / 2;
+
+  // z[k] = x[2k] + i x[2k + 1]
+  for (uint16_t k = 0; k < m; k++) {
+    out[k].re = in[2 * k];
+    out[k].im = in[2 * k + 1];
+  }
+  complex_fft(fft, out);
+
+  // Split Z into the even/odd sample spectra and recombine, X[k] and
+  // X[m - k] together so the pass can run in place
+  float z0re = out[0].re;
+  float z0im = out[0].im;
+  out[0].re = z0re + z0im;
+  out[0].im = 0.0f;
+  out[m].re = z0re - z0im;
+  out[m].im = 0.0f;
+
+  for (uint16_t k = 1; k <= m / 2; k++) {
+    const audio_fft_complex_t a = out[k];
+    const audio_fft_complex_t b = out[m - k];
+    const audio_fft_complex_t w = fft->twiddle[k];
+
+    // Xe = (a + conj b) / 2, Xo = (a - conj b) / 2i
+    float er = 0.5f * (a.re + b.re);
+    float ei = 0.5f * (a.im - b.im);
+    float or_ = 0.5f * (a.im + b.im);
+    float oi = -0.5f * (a.re - b.re);
+
+    // X[k] = Xe + w Xo; X[m - k] = conj(Xe) - conj(w) conj(Xo)
+    float wr = w.re * or_ - w.im * oi;
+    float wi = w.re * oi + w.im * or_;
+    out[k].re = er + wr;
+    out[k].im = ei + wi;
+    out[m - k].re = er - wr;
+    out[m - k].im = -ei + wi;
+  }
+}
+
+void audio_fft_inverse(const audio_fft_t *fft, audio_fft_complex_t *in,
+                       float *out) {
+  const uint16_t m = fft->n / 2;
+
+  // Undo the split: Z[k] = Xe + i Xo with Xe = (X[k] + conj X[m - k]) / 2
+  // and Xo = (X[k] - conj X[m - k]) conj(w) / 2
+  float x0 = in[0].re;
+  float xm = in[m].re;
+  in[0].re = 0.5f * (x0 + xm);
+  in[0].im = 0.5f * (x0 - xm);
+
+  for (uint16_t k = 1; k <= m / 2; k++) {
+    const audio_fft_complex_t a = in[k];
+    const audio_fft_complex_t b = in[m - k];
+    const audio_fft_complex_t w = fft->twiddle[k];
+
+    float er = 0.5f * (a.re + b.re);
+    float ei = 0.5f * (a.im - b.im);
+    float dr = 0.5f * (a.re - b.re);
+    float di = 0.5f * (a.im + b.im);
+    float or_ = dr * w.re + di * w.im; // d * conj(w)
+    float oi = di * w.re - dr * w.im;
+
+    in[k].re = er - oi;
+    in[k].im = ei + or_;
+    // Mirror bin: Xe' = conj(Xe), Xo' = -conj(d) * (-w) = conj(Xo)
+    in[m - k].re = er + oi;
+    in[m - k].im = -ei + or_;
+  }
+
+  // Inverse complex FFT via conjugation, scaled by 1 / m
+  for (uint16_t k = 0; k < m; k++) {
+    in[k].im = -in[k].im;
+  }
+  complex_fft(fft, in);
+  const float scale = 1.0f / m;
+  for (uint16_t k = 0; k < m; k++) {
+    out[2 * k] = in[k].re * scale;
+    out[2 * k + 1] = -in[k].im * scale;
+  }
+}
+
+// (a * w) >> 15 for a Q15 twiddle component
+static inline int32_t mul_q15(int32_t a, int16_t w) {
+  return (int32_t)(((int64_t)a * w) >> 15);
+}
+
+// Fixed-point complex_fft() with inverse support by conjugated twiddles.
+// The forward direction halves after each stage (overall 1 / (n/2)); the
+// inverse is unscaled, which cannot overflow because every stage output is
+// a time-aliased average of the final, bounded signal.
+static void complex_fft_fixed(const audio_fft_t *fft, audio_fft_fixed_t *x,
+                              bool inverse) {
+  const uint16_t m = fft->n / 2;
+  const int shift = inverse ? 0 : 1;
+
+  for (uint16_t i = 0; i < m; i++) {
+    uint16_t j = fft->bitrev[i];
+    if (j > i) {
+      audio_fft_fixed_t t = x[i];
+      x[i] = x[j];
+      x[j] = t;
+    }
+  }
+
+  for (uint16_t len = 2; len <= m; len <<= 1) {
+    const uint16_t half = len / 2;
+    const uint16_t stride = 2 * (m / len);
+    for (uint16_t base = 0; base < m; base += len) {
+      for (uint16_t j = 0; j < half; j++) {
+        const audio_fft_q15_t w = fft->twiddle_q15[j * stride];
+        const int16_t wi = inverse ? -w.im : w.im;
+        audio_fft_fixed_t *a = &x[base + j];
+        audio_fft_fixed_t *b = &x[base + j + half];
+        int32_t tr = mul_q15(b->re, w.re) - mul_q15(b->im, wi);
+        int32_t ti = mul_q15(b->re, wi) + mul_q15(b->im, w.re);
+        b->re = (a->re - tr) >> shift;
+        b->im = (a->im - ti) >> shift;
+        a->re = (a->re + tr) >> shift;
+        a->im = (a->im + ti) >> shift;
+      }
+    }
+  }
+}
+
+void audio_fft_forward_fixed(const audio_fft_t *fft, const int32_t *in,
+                             audio_fft_fixed_t *out) {
+  const uint16_t m = fft->n / 2;
+
+  for (uint16_t k = 0; k < m; k++) {
+    out[k].re = in[2 * k];
+    out[k].im = in[2 * k + 1];
+  }
+  complex_fft_fixed(fft, out, false);
+
+  // Same split as audio_fft_forward(), with one more halving to reach 1/n
+  int32_t z0re = out[0].re;
+  int32_t z0im = out[0].im;
+  out[0].re = (z0re + z0im) >> 1;
+  out[0].im = 0;
+  out[m].re = (z0re - z0im) >> 1;
+  out[m].im = 0;
+
+  for (uint16_t k = 1; k <= m / 2; k++) {
+    const audio_fft_fixed_t a = out[k];
+    const audio_fft_fixed_t b = out[m - k];
+    const audio_fft_q15_t w = fft->twiddle_q15[k];
+
+    int32_t er = (a.re + b.re) >> 2;
+    int32_t ei = (a.im - b.im) >> 2;
+    int32_t or_ = (a.im + b.im) >> 2;
+    int32_t oi = -((a.re - b.re) >> 2);
+
+    int32_t wr = mul_q15(or_, w.re) - mul_q15(oi, w.im);
+    int32_t wi = mul_q15(oi, w.re) + mul_q15(or_, w.im);
+    out[k].re = er + wr;
+    out[k].im = ei + wi;
+    out[m - k].re = er - wr;
+    out[m - k].im = -ei + wi;
+  }
+}
+
+void audio_fft_inverse_fixed(const audio_fft_t *fft, audio_fft_fixed_t *in,
+                             int32_t *out) {
+  const uint16_t m = fft->n / 2;
+
+  // Same unsplit as audio_fft_inverse(), unhalved since the input is
+  // already scaled by 1/n
+  int32_t x0 = in[0].re;
+  int32_t xm = in[m].re;
+  in[0].re = x0 + xm;
+  in[0].im = x0 - xm;
+
+  for (uint16_t k = 1; k <= m / 2; k++) {
+    const audio_fft_fixed_t a = in[k];
+    const audio_fft_fixed_t b = in[m - k];
+    const audio_fft_q15_t w = fft->twiddle_q15[k];
+
+    int32_t er = a.re + b.re;
+    int32_t ei = a.im - b.im;
+    int32_t dr = a.re - b.re;
+    int32_t di = a.im + b.im;
+    int32_t or_ = mul_q15(dr, w.re) + mul_q15(di, w.im);
+    int32_t oi = mul_q15(di, w.re) - mul_q15(dr, w.im);
+
+    in[k].re = er - oi;
+    in[k].im = ei + or_;
+    in[m - k].re = er + oi;
+    in[m - k].im = -ei + or_;
+  }
+
+  complex_fft_fixed(fft, in, true);
+  for (uint16_t k = 0; k < m; k++) {
+    out[2 * k] = in[k].re;
+    out[2 * k + 1] = in[k].im;
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Radix-2 FFT for real audio blocks.
+//
+// A real transform of size n runs as an n/2 point complex FFT on the packed
+// even/odd samples followed by a split pass, so one twiddle table of n/2
+// entries serves both. Spectra hold bins 0..n/2 (n/2 + 1 values), DC and
+// Nyquist included. The forward transform is unscaled and the inverse scales
+// by 1/n, so a round trip is the identity. Tables live in audio_fft_t;
+// nothing is allocated.
+//
+// The fixed-point variant runs on int32 samples with Q15 twiddles, halving
+// after every butterfly stage so nothing can overflow: its forward output
+// is the spectrum scaled by 1/n (bounded by the input peak) and its inverse
+// undoes exactly that. Give the input ~8 bits of headroom above pcm16 to
+// keep the stage rounding below the signal.
+
+#define AUDIO_FFT_MAX_SIZE 512
+
+typedef struct {
+  float re;
+  float im;
+} audio_fft_complex_t;
+
+typedef struct {
+  int32_t re;
+  int32_t im;
+} audio_fft_fixed_t;
+
+typedef struct {
+  int16_t re;
+  int16_t im;
+} audio_fft_q15_t;
+
+typedef struct {
+  uint16_t n;
+  uint16_t bitrev[AUDIO_FFT_MAX_SIZE / 2];
+  audio_fft_complex_t twiddle[AUDIO_FFT_MAX_SIZE / 2]; // exp(-2 pi i k / n)
+  audio_fft_q15_t twiddle_q15[AUDIO_FFT_MAX_SIZE / 2];
+} audio_fft_t;
+
+// n must be a power of two between 8 and AUDIO_FFT_MAX_SIZE
+esp_err_t audio_fft_init(audio_fft_t *fft, uint16_t n);
+
+// n real samples -> n/2 + 1 bins
+void audio_fft_forward(const audio_fft_t *fft, const float *in,
+                       audio_fft_complex_t *out);
+
+// n/2 + 1 bins -> n real samples. Clobbers `in`.
+void audio_fft_inverse(const audio_fft_t *fft, audio_fft_complex_t *in,
+                       float *out);
+
+// Fixed point: n samples -> n/2 + 1 bins of spectrum / n
+void audio_fft_forward_fixed(const audio_fft_t *fft, const int32_t *in,
+                             audio_fft_fixed_t *out);
+
+// Fixed point: n/2 + 1 bins of spectrum / n -> n samples. Clobbers `in`.
+void audio_fft_inverse_fixed(const audio_fft_t *fft, audio_fft_fixed_t *in,
+                             int32_t *out);
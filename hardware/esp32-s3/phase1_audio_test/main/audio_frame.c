@@ -0,0 +1,145 @@
+#include "audio_frame.h"
+
+#include <string.h>
+
+const char *audio_frame_codec_name(audio_frame_codec_t codec) {
+  switch (codec) {
+  case AUDIO_FRAME_CODEC_PCM16:
+    return "pcm16";
+  case AUDIO_FRAME_CODEC_RAW32:
+    return "raw32";
+  case AUDIO_FRAME_CODEC_IMA_ADPCM:
+    return "adpcm";
+  case AUDIO_FRAME_CODEC_OPUS:
+    return "opus";
+  case AUDIO_FRAME_CODEC_PCM8:
+    return "pcm8";
+  }
+  return "unknown";
+}
+
+static void put_u32(uint8_t *out, uint32_t v) {
+  out[0] = (uint8_t)v;
+  out[1] = (uint8_t)(v >> 8);
+  out[2] = (uint8_t)(v >> 16);
+  out[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 |
+         (uint32_t)in[3] << 24;
+}
+
+void audio_frame_encode(const audio_frame_header_t *header, uint8_t *out) {
+  out[0] = 'A';
+  out[1] = 'F';
+  out[2] = AUDIO_FRAME_VERSION;
+  out[3] = AUDIO_FRAME_HEADER_BYTES;
+  out[4] = header->codec;
+  out[5] = header->flags;
+  out[6] = header->channels;
+  out[7] = 0;
+  put_u32(&out[8], header->sequence);
+  put_u32(&out[12], header->sample_rate);
+  put_u32(&out[16], (uint32_t)header->capture_us);
+  put_u32(&out[20], (uint32_t)(header->capture_us >> 32));
+}
+
+esp_err_t audio_frame_decode(const uint8_t *data, size_t len,
+                             audio_frame_header_t *header,
+                             size_t *header_len) {
+  if (len < 4) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (data[0] != 'A' || data[1] != 'F') {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (data[2] != AUDIO_FRAME_VERSION) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (data[3] < AUDIO_FRAME_HEADER_BYTES) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (len < data[3]) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  header->version = data[2];
+  header->codec = data[4];
+  header->flags = data[5];
+  header->channels = data[6];
+  header->sequence = get_u32(&data[8]);
+  header->sample_rate = get_u32(&data[12]);
+  header->capture_us = get_u32(&data[16]) | (uint64_t)get_u32(&data[20])
+                                                << 32;
+  *header_len = data[3];
+  return ESP_OK;
+}
+
+void audio_frame_clock_update(audio_frame_clock_t *clock, int64_t t1_us,
+                              int64_t sender_us, int64_t t4_us) {
+  if (t4_us < t1_us) {
+    return;
+  }
+  uint32_t rtt = (uint32_t)(t4_us - t1_us);
+  if (!clock->valid || rtt <= clock->rtt_us ||
+      ++clock->age >= AUDIO_FRAME_CLOCK_PROBES) {
+    // The answer left the sender half a round trip before t4
+    clock->offset_us = sender_us - (t1_us + (int64_t)(rtt / 2));
+    clock->rtt_us = rtt;
+    clock->age = 0;
+    clock->valid = true;
+  }
+}
+
+void audio_frame_rx_reset(audio_frame_rx_t *rx) {
+  memset(rx, 0, sizeof(*rx));
+}
+
+void audio_frame_rx_update(audio_frame_rx_t *rx,
+                           const audio_frame_header_t *header,
+                           int64_t arrival_us,
+                           const audio_frame_clock_t *clock) {
+  rx->received++;
+  if (!rx->started) {
+    rx->started = true;
+    rx->next_sequence = header->sequence;
+  }
+  int32_t gap = (int32_t)(header->sequence - rx->next_sequence);
+  if (gap < 0) {
+    // Counted as lost when the gap opened
+    rx->late++;
+    if (rx->lost > 0) {
+      rx->lost--;
+    }
+    return;
+  }
+  rx->lost += (uint32_t)gap;
+  rx->next_sequence = header->sequence + 1;
+  if (header->flags & AUDIO_FRAME_FLAG_DISCONTINUITY) {
+    rx->discontinuities++;
+    rx->has_transit = false; // Transit across a gap says nothing
+  }
+  if (header->flags & AUDIO_FRAME_FLAG_CATCHUP) {
+    rx->catchup++;
+    rx->has_transit = false;
+    return;
+  }
+
+  // Transit includes the unknown clock offset, which cancels out in the
+  // jitter; the latency needs it
+  int64_t transit = arrival_us - (int64_t)header->capture_us;
+  if (rx->has_transit) {
+    int64_t d = transit - rx->last_transit_us;
+    if (d < 0) {
+      d = -d;
+    }
+    rx->jitter_us += (int32_t)((d - (int64_t)rx->jitter_us) / 16);
+  }
+  rx->last_transit_us = transit;
+  rx->has_transit = true;
+
+  if (clock && clock->valid) {
+    int64_t latency = transit + clock->offset_us;
+    audio_latency_add(&rx->latency, latency > 0 ? (uint32_t)latency : 0);
+  }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "audio_latency.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Header for binary audio messages in both directions, and the receiver
+// side bookkeeping that makes use of it. Pure C, shared with the host
+// stand-in server (host/frame_server.c).
+//
+// Every binary WebSocket message starts with AUDIO_FRAME_HEADER_BYTES,
+// little-endian:
+//
+//    0  'A' 'F'       magic
+//    2  version       AUDIO_FRAME_VERSION
+//    3  header_len    bytes before the payload, >= 24
+//    4  codec         audio_frame_codec_t
+//    5  flags         AUDIO_FRAME_FLAG_*
+//    6  channels
+//    7  reserved, 0
+//    8  sequence      u32, +1 per message and direction
+//   12  sample_rate   u32, Hz
+//   16  capture_us    u64, first sample, sender's esp_timer clock
+//
+// A receiver skips header_len bytes, so later versions of this layout can
+// append fields without breaking older readers.
+
+#define AUDIO_FRAME_VERSION 1
+#define AUDIO_FRAME_HEADER_BYTES 24
+
+typedef enum {
+  AUDIO_FRAME_CODEC_PCM16 = 1, // s16le
+  AUDIO_FRAME_CODEC_RAW32,     // INMP441 I2S slots, s32le
+  AUDIO_FRAME_CODEC_IMA_ADPCM, // One audio_adpcm frame
+  AUDIO_FRAME_CODEC_OPUS,      // One packet
+  AUDIO_FRAME_CODEC_PCM8,      // u8, 128 is silence
+} audio_frame_codec_t;
+
+#define AUDIO_FRAME_FLAG_SPEECH_START 0x01 // The VAD heard speech begin
+#define AUDIO_FRAME_FLAG_SPEECH_END 0x02   // ...or end, within this frame
+#define AUDIO_FRAME_FLAG_CATCHUP 0x04 // Sent from a backlog, late on purpose
+#define AUDIO_FRAME_FLAG_DISCONTINUITY 0x08 // Audio before it was not sent
+#define AUDIO_FRAME_FLAG_MARKER 0x10 // Latency test chirp starts in it
+
+typedef struct {
+  uint8_t version;
+  uint8_t codec;
+  uint8_t flags;
+  uint8_t channels;
+  uint32_t sequence;
+  uint32_t sample_rate;
+  uint64_t capture_us;
+} audio_frame_header_t;
+
+const char *audio_frame_codec_name(audio_frame_codec_t codec);
+
+// Write the header, always AUDIO_FRAME_HEADER_BYTES
+void audio_frame_encode(const audio_frame_header_t *header, uint8_t *out);
+
+// Parse the header at the start of a message. On success `header_len` is
+// where the payload starts. ESP_ERR_INVALID_SIZE if `len` is too short,
+// ESP_ERR_INVALID_ARG if it is not a frame, ESP_ERR_NOT_SUPPORTED for a
+// newer version.
+esp_err_t audio_frame_decode(const uint8_t *data, size_t len,
+                             audio_frame_header_t *header,
+                             size_t *header_len);
+
+// Offset of the sender's clock from the receiver's, from probes: the
+// receiver notes t1, asks the sender for its clock, and notes t4 when the
+// answer arrives. The probe with the shortest round trip wins; a best
+// sample older than AUDIO_FRAME_CLOCK_PROBES probes is replaced, so the
+// estimate follows clock drift.
+#define AUDIO_FRAME_CLOCK_PROBES 16
+
+typedef struct {
+  bool valid;
+  int64_t offset_us; // Sender clock minus receiver clock
+  uint32_t rtt_us;   // Round trip of the probe it came from
+  uint32_t age;      // Probes since then
+} audio_frame_clock_t;
+
+void audio_frame_clock_update(audio_frame_clock_t *clock, int64_t t1_us,
+                              int64_t sender_us, int64_t t4_us);
+
+// Receiver statistics for one direction
+typedef struct {
+  bool started;
+  uint32_t next_sequence;
+  uint32_t received;
+  uint32_t lost; // Sequence gaps, less the frames that turned up late
+  uint32_t late; // Arrived after a later sequence number
+  uint32_t catchup;
+  uint32_t discontinuities;
+  int64_t last_transit_us;
+  bool has_transit;
+  uint32_t jitter_us;      // RFC 3550 interarrival jitter
+  audio_latency_t latency; // One-way, once the clock offset is known
+} audio_frame_rx_t;
+
+void audio_frame_rx_reset(audio_frame_rx_t *rx);
+
+// Account for one frame arriving at `arrival_us` (receiver clock). Catch-up
+// frames count for loss only: their capture time is old on purpose. `clock`
+// may be NULL if the sender's clock is unknown.
+void audio_frame_rx_update(audio_frame_rx_t *rx,
+                           const audio_frame_header_t *header,
+                           int64_t arrival_us,
+                           const audio_frame_clock_t *clock);
@@ -0,0 +1,107 @@
+#include "audio_history.h"
+
+#include "esp_heap_caps.h"
+#include <string.h>
+
+esp_err_t audio_history_init(audio_history_t *history, size_t capacity,
+                             uint32_t caps) {
+  if (!history || capacity == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(history, 0, sizeof(*history));
+  history->buffer =
+      (int16_t *)heap_caps_malloc(capacity * sizeof(int16_t), caps);
+  if (!history->buffer) {
+    caps = MALLOC_CAP_8BIT;
+    history->buffer =
+        (int16_t *)heap_caps_malloc(capacity * sizeof(int16_t), caps);
+  }
+  if (!history->buffer) {
+    return ESP_ERR_NO_MEM;
+  }
+  history->capacity = capacity;
+  history->caps = caps;
+  return ESP_OK;
+}
+
+esp_err_t audio_history_init_storage(audio_history_t *history,
+                                     int16_t *storage, size_t capacity) {
+  if (!history || !storage || capacity == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(history, 0, sizeof(*history));
+  history->buffer = storage;
+  history->capacity = capacity;
+  return ESP_OK;
+}
+
+void audio_history_free(audio_history_t *history) {
+  if (history->caps) {
+    heap_caps_free(history->buffer);
+  }
+  history->buffer = NULL;
+}
+
+void audio_history_write(audio_history_t *history, const int16_t *pcm,
+                         size_t samples) {
+  // More than fits: only the newest capacity samples survive anyway
+  if (samples > history->capacity) {
+    pcm += samples - history->capacity;
+    history->head += samples - history->capacity;
+    samples = history->capacity;
+  }
+
+  size_t pos = (size_t)(history->head % history->capacity);
+  size_t first = history->capacity - pos;
+  if (first > samples) {
+    first = samples;
+  }
+  memcpy(&history->buffer[pos], pcm, first * sizeof(int16_t));
+  memcpy(history->buffer, pcm + first, (samples - first) * sizeof(int16_t));
+  history->head += samples;
+
+  // The cursor must not point at audio that has been overwritten
+  uint64_t oldest = history->head > history->capacity
+                        ? history->head - history->capacity
+                        : 0;
+  if (history->cursor < oldest) {
+    history->overwritten += (uint32_t)(oldest - history->cursor);
+    history->cursor = oldest;
+  }
+}
+
+size_t audio_history_rewind(audio_history_t *history, size_t samples) {
+  uint64_t stored = history->head < history->capacity ? history->head
+                                                      : history->capacity;
+  uint64_t back = samples < stored ? samples : stored;
+  uint64_t cursor = history->head - back;
+  if (cursor < history->sent_until) {
+    cursor = history->sent_until;
+  }
+  // Only ever further back than where it already is
+  if (cursor < history->cursor) {
+    history->cursor = cursor;
+  }
+  return audio_history_backlog(history);
+}
+
+size_t audio_history_peek(const audio_history_t *history, size_t max_samples,
+                          const int16_t **region) {
+  size_t pos = (size_t)(history->cursor % history->capacity);
+  size_t n = audio_history_backlog(history);
+  if (n > history->capacity - pos) {
+    n = history->capacity - pos;
+  }
+  if (n > max_samples) {
+    n = max_samples;
+  }
+  *region = &history->buffer[pos];
+  return n;
+}
+
+void audio_history_release(audio_history_t *history, size_t samples) {
+  history->cursor += samples;
+  if (history->cursor > history->sent_until) {
+    history->sent_until = history->cursor;
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Rolling history of processed uplink audio with a send cursor.
+//
+// Every conditioned block is written, streamed or not; once full, the
+// oldest audio is overwritten. Positions are absolute sample counts, so
+// the cursor (the next sample to send) can be rewound into the past when a
+// trigger fires and then read forward faster than real time until it meets
+// the head, after which it follows the live audio. Anything before
+// `sent_until` is already with the server and is never rewound over, so the
+// stream stays contiguous.
+//
+// Writer and reader must be the same task. The buffer is meant for PSRAM:
+// at 16kHz pcm16 each second of history is 32KB.
+
+typedef struct {
+  int16_t *buffer;
+  size_t capacity; // Samples
+  uint32_t caps; // Heap caps when owned, 0 for caller storage
+  uint64_t head;       // Samples written since init
+  uint64_t cursor;     // Next sample to send
+  uint64_t sent_until; // Everything before this has been sent
+  uint32_t overwritten; // Samples lost because the cursor fell too far behind
+} audio_history_t;
+
+// Allocate `capacity` samples with heap_caps_malloc(caps), falling back to
+// any 8-bit capable RAM if that fails
+esp_err_t audio_history_init(audio_history_t *history, size_t capacity,
+                             uint32_t caps);
+
+// Use caller-provided storage for `capacity` samples instead; caps stays 0
+// and audio_history_free() leaves the storage alone
+esp_err_t audio_history_init_storage(audio_history_t *history,
+                                     int16_t *storage, size_t capacity);
+void audio_history_free(audio_history_t *history);
+
+void audio_history_write(audio_history_t *history, const int16_t *pcm,
+                         size_t samples);
+
+// Move the cursor to `samples` before the head, limited to what is stored
+// and to what has not been sent yet. Returns the samples now behind the
+// head.
+size_t audio_history_rewind(audio_history_t *history, size_t samples);
+
+// Drop the backlog: nothing older than now will be sent
+static inline void audio_history_skip(audio_history_t *history) {
+  history->cursor = history->head;
+}
+
+static inline size_t audio_history_backlog(const audio_history_t *history) {
+  return (size_t)(history->head - history->cursor);
+}
+
+// Contiguous run of unsent samples at the cursor, at most `max_samples`.
+// Returns its length; audio_history_release() advances past it.
+size_t audio_history_peek(const audio_history_t *history, size_t max_samples,
+                          const int16_t **region);
+void audio_history_release(audio_history_t *history, size_t samples);
@@ -0,0 +1,269 @@
+#include "audio_jitter.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DEFAULT_MIN_TARGET_MS 20
+#define DEFAULT_MAX_TARGET_MS 300
+#define INITIAL_TARGET_MS 40
+#define DEFAULT_SAFETY_MS 10
+#define DEFAULT_DECAY_MS 4 // Per second
+#define DEFAULT_SLACK_MS 20
+#define DEFAULT_COMPRESS_WINDOW_MS 200
+#define DEFAULT_STREAM_GAP_MS 500
+
+static void setup(audio_jitter_t *jb, uint32_t sample_rate) {
+  memset(jb, 0, sizeof(*jb));
+  jb->sample_rate = sample_rate;
+  jb->min_target_ms = DEFAULT_MIN_TARGET_MS;
+  jb->max_target_ms = DEFAULT_MAX_TARGET_MS;
+  jb->safety_ms = DEFAULT_SAFETY_MS;
+  jb->target_decay_ms = DEFAULT_DECAY_MS;
+  jb->slack_ms = DEFAULT_SLACK_MS;
+  jb->compress_window_ms = DEFAULT_COMPRESS_WINDOW_MS;
+  jb->stream_gap_ms = DEFAULT_STREAM_GAP_MS;
+  jb->adaptive = true;
+  jb->stretch = true;
+
+  jb->target_us = INITIAL_TARGET_MS * 1000.0f;
+  atomic_store(&jb->target, INITIAL_TARGET_MS * sample_rate / 1000);
+  atomic_store(&jb->last_arrival_us, 0);
+  atomic_store(&jb->drains, 0);
+  atomic_store(&jb->drained_at_us, 0);
+  atomic_store(&jb->held, 0);
+  atomic_store(&jb->playing, false);
+}
+
+esp_err_t audio_jitter_init(audio_jitter_t *jb, uint32_t sample_rate,
+                            size_t capacity, uint32_t caps) {
+  setup(jb, sample_rate);
+  return audio_ring_create(&jb->ring, capacity, caps);
+}
+
+esp_err_t audio_jitter_init_storage(audio_jitter_t *jb, uint32_t sample_rate,
+                                    void *storage, size_t capacity) {
+  setup(jb, sample_rate);
+  return audio_ring_init(&jb->ring, storage, capacity);
+}
+
+void audio_jitter_free(audio_jitter_t *jb) { audio_ring_free(&jb->ring); }
+
+static inline int64_t samples_to_us(const audio_jitter_t *jb, size_t n) {
+  return (int64_t)n * 1000000 / jb->sample_rate;
+}
+
+static inline size_t ms_to_samples(const audio_jitter_t *jb, uint32_t ms) {
+  return (size_t)ms * jb->sample_rate / 1000;
+}
+
+// Producer: let the target fall while margins are comfortable, raise it at
+// once to what `margin_us` says would have been needed
+static void update_target(audio_jitter_t *jb, int64_t margin_us,
+                          bool scored, int64_t now_us) {
+  float min_us = jb->min_target_ms * 1000.0f;
+  float max_us = jb->max_target_ms * 1000.0f;
+  if (!jb->adaptive) {
+    jb->target_us = min_us;
+  } else {
+    jb->target_us -= (now_us - jb->decayed_at_us) * 1e-3f *
+                     (float)jb->target_decay_ms;
+    if (scored) {
+      float needed = jb->target_us - (float)margin_us + jb->safety_ms * 1000.0f;
+      if (needed > jb->target_us) {
+        jb->target_us = needed;
+      }
+    }
+    if (jb->target_us < min_us) {
+      jb->target_us = min_us;
+    }
+    if (jb->target_us > max_us) {
+      jb->target_us = max_us;
+    }
+  }
+  jb->decayed_at_us = now_us;
+  atomic_store(&jb->target,
+               (uint_fast32_t)(jb->target_us * jb->sample_rate / 1e6f));
+}
+
+size_t audio_jitter_push(audio_jitter_t *jb, const int16_t *pcm,
+                         size_t samples, int64_t now_us) {
+  const int64_t gap_us = (int64_t)jb->stream_gap_ms * 1000;
+  const int64_t lead_us = (int64_t)jb->output_lead_ms * 1000;
+  size_t free_bytes = audio_ring_free_space(&jb->ring);
+  size_t queued = (jb->ring.capacity - free_bytes) / sizeof(int16_t) +
+                  atomic_load(&jb->held);
+
+  int64_t last = atomic_load(&jb->last_arrival_us);
+  bool new_stream = jb->packets == 0 || now_us - last > gap_us;
+  uint32_t drains = atomic_load(&jb->drains);
+  bool drained = drains != jb->seen_drains;
+  jb->seen_drains = drains;
+  jb->packets++;
+
+  if (new_stream) {
+    // Do not let the target decay across the silence between streams
+    jb->decayed_at_us = now_us;
+    update_target(jb, 0, false, now_us);
+  } else if (drained && queued == 0) {
+    // Ran dry before this arrived; the output lead may have covered it
+    int64_t margin = lead_us - (now_us - atomic_load(&jb->drained_at_us));
+    if (margin < 0) {
+      jb->underruns++;
+    }
+    if (margin < (int64_t)jb->safety_ms * 1000) {
+      jb->late_packets++;
+    }
+    update_target(jb, margin, true, now_us);
+  } else if (atomic_load(&jb->playing)) {
+    int64_t margin = samples_to_us(jb, queued) + lead_us;
+    if (margin < (int64_t)jb->safety_ms * 1000) {
+      jb->late_packets++;
+    }
+    update_target(jb, margin, true, now_us);
+  } else {
+    // Still filling up to the target, nothing to learn yet
+    update_target(jb, 0, false, now_us);
+  }
+
+  size_t bytes = samples * sizeof(int16_t);
+  size_t space = free_bytes & ~(size_t)1;
+  if (bytes > space) {
+    jb->overrun_samples += (bytes - space) / sizeof(int16_t);
+    bytes = space;
+  }
+  audio_ring_write(&jb->ring, pcm, bytes);
+  atomic_store(&jb->last_arrival_us, now_us);
+  return bytes / sizeof(int16_t);
+}
+
+// Lag in [MIN_LAG, MAX_LAG] whose segment best matches `ref`, where the
+// candidate for lag k starts at base + direction * k
+static int best_lag(const int16_t *ref, const int16_t *base, int direction) {
+  int best = AUDIO_JITTER_MIN_LAG;
+  float best_score = -INFINITY;
+  for (int k = AUDIO_JITTER_MIN_LAG; k <= AUDIO_JITTER_MAX_LAG; k++) {
+    const int16_t *candidate = base + direction * k;
+    float corr = 0.0f;
+    float energy = 1.0f;
+    for (int j = 0; j < AUDIO_JITTER_OVERLAP; j++) {
+      corr += (float)ref[j] * candidate[j];
+      energy += (float)candidate[j] * candidate[j];
+    }
+    float score = corr * fabsf(corr) / energy; // Normalized, sign kept
+    if (score > best_score) {
+      best_score = score;
+      best = k;
+    }
+  }
+  return best;
+}
+
+// Fill the frame with `n` samples of work ending in a crossfade from
+// work[n - L ..] to `splice`
+static void splice_frame(audio_jitter_t *jb, size_t n,
+                         const int16_t *splice) {
+  const size_t head = n - AUDIO_JITTER_OVERLAP;
+  const int16_t *tail = &jb->work[head];
+  memcpy(jb->frame, jb->work, head * sizeof(int16_t));
+  for (int j = 0; j < AUDIO_JITTER_OVERLAP; j++) {
+    float w = (j + 0.5f) / AUDIO_JITTER_OVERLAP;
+    jb->frame[head + j] =
+        (int16_t)lrintf(tail[j] + (splice[j] - tail[j]) * w);
+  }
+}
+
+// Consumer: produce the next output frame. False if there is nothing to
+// play (buffering, or just ran dry).
+static bool next_frame(audio_jitter_t *jb, int64_t now_us) {
+  size_t room = AUDIO_JITTER_WORK - jb->work_len;
+  jb->work_len += audio_ring_read(&jb->ring, &jb->work[jb->work_len],
+                                  room * sizeof(int16_t)) /
+                  sizeof(int16_t);
+
+  const size_t target = atomic_load(&jb->target);
+  const size_t depth =
+      jb->work_len + audio_ring_used(&jb->ring) / sizeof(int16_t);
+  const int64_t quiet = now_us - atomic_load(&jb->last_arrival_us);
+
+  if (jb->state == AUDIO_JITTER_BUFFERING) {
+    // Start at the target depth, or with what there is once the sender
+    // has gone quiet for as long (short replies). Play straight on if the
+    // output lead has not yet run out since the buffer ran dry.
+    bool covered = atomic_load(&jb->drains) > 0 &&
+                   now_us - atomic_load(&jb->drained_at_us) <
+                       (int64_t)jb->output_lead_ms * 1000;
+    if (depth == 0 ||
+        (!covered && depth < target && quiet < samples_to_us(jb, target) &&
+         depth < jb->ring.capacity / sizeof(int16_t))) {
+      return false;
+    }
+    jb->state = AUDIO_JITTER_PLAYING;
+    atomic_store(&jb->playing, true);
+  }
+
+  if (jb->work_len == 0) {
+    jb->state = AUDIO_JITTER_BUFFERING;
+    atomic_store(&jb->playing, false);
+    atomic_store(&jb->drained_at_us, now_us);
+    atomic_fetch_add(&jb->drains, 1);
+    return false;
+  }
+
+  size_t n = jb->work_len < AUDIO_JITTER_FRAME ? jb->work_len
+                                               : AUDIO_JITTER_FRAME;
+  size_t consumed = n;
+  bool arriving = quiet < (int64_t)jb->stream_gap_ms * 1000 / 2;
+
+  if (jb->stretch && n == AUDIO_JITTER_FRAME) {
+    const size_t head = n - AUDIO_JITTER_OVERLAP;
+    if (depth > target + ms_to_samples(jb, jb->slack_ms) &&
+        depth <= target + ms_to_samples(jb, jb->compress_window_ms) &&
+        jb->work_len == AUDIO_JITTER_WORK) {
+      // Drop one period: continue from `lag` samples further on
+      int lag = best_lag(&jb->work[head], &jb->work[head], 1);
+      splice_frame(jb, n, &jb->work[head + lag]);
+      consumed = n + lag;
+      jb->compressed++;
+    } else if (arriving &&
+               depth + ms_to_samples(jb, jb->slack_ms) < target) {
+      // Repeat one period: continue from `lag` samples back
+      int lag = best_lag(&jb->work[head], &jb->work[head], -1);
+      splice_frame(jb, n, &jb->work[head - lag]);
+      consumed = n - lag;
+      jb->expanded++;
+    }
+  }
+  if (consumed == n) {
+    memcpy(jb->frame, jb->work, n * sizeof(int16_t));
+  }
+
+  jb->work_len -= consumed;
+  memmove(jb->work, &jb->work[consumed], jb->work_len * sizeof(int16_t));
+  jb->frame_len = n;
+  jb->frame_pos = 0;
+  return true;
+}
+
+size_t audio_jitter_pull(audio_jitter_t *jb, int16_t *out, size_t samples,
+                         int64_t now_us) {
+  size_t done = 0;
+  while (done < samples) {
+    if (jb->frame_pos == jb->frame_len && !next_frame(jb, now_us)) {
+      break;
+    }
+    size_t n = jb->frame_len - jb->frame_pos;
+    if (n > samples - done) {
+      n = samples - done;
+    }
+    memcpy(&out[done], &jb->frame[jb->frame_pos], n * sizeof(int16_t));
+    jb->frame_pos += n;
+    done += n;
+  }
+  atomic_store(&jb->held, jb->work_len + jb->frame_len - jb->frame_pos);
+  return done;
+}
+
+size_t audio_jitter_depth(const audio_jitter_t *jb) {
+  return atomic_load(&jb->held) +
+         audio_ring_used_approx(&jb->ring) / sizeof(int16_t);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "audio_ring.h"
+#include "esp_err.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Adaptive jitter buffer for received mono pcm16.
+//
+// The receiving task pushes whatever arrives; the playback task pulls at
+// the sample clock. It is single-producer/single-consumer like audio_ring,
+// which holds the samples.
+//
+// Target depth. Every packet that arrives mid-stream is scored by its
+// margin: how much audio was still queued ahead of it. A packet that
+// arrives with less than the safety margin queued (or after the buffer ran
+// dry) raises the target by the shortfall at once; comfortable margins let
+// it fall by `target_decay_ms` per second. So the target follows the
+// worst recent lateness rather than inter-arrival spread, and audio
+// delivered ahead of real time (TTS bursts) does not inflate it.
+//
+// Playback starts once the target depth is queued, or when nothing has
+// arrived for a target's worth of time (a short reply). `output_lead_ms`
+// is audio the consumer always has queued downstream (DMA buffers): it
+// counts towards every margin, and audio arriving within it after the
+// buffer ran dry plays on at once. Later than that, the listener has
+// heard a gap: that is an underrun if it happens mid-stream, and playback
+// re-buffers to the target. A silence longer than the stream gap starts
+// a new stream.
+//
+// Depth correction. Output is produced in 16ms frames. While the depth is
+// above target + slack (but within `compress_window_ms`; deeper queues are
+// audio sent ahead of time and are left alone), a frame drops one pitch
+// period; while it is below target - slack and audio is still arriving,
+// a frame repeats one. The period (2.5-10ms) is the lag that best matches
+// the waveform, and the splice is crossfaded over 4ms, so corrections are
+// inaudible on speech. Each changes the depth by 2.5-10ms.
+//
+// Overruns (ring full) drop the newest audio and are counted in samples.
+
+#define AUDIO_JITTER_FRAME 256   // Samples per output frame
+#define AUDIO_JITTER_OVERLAP 64  // Crossfade length of a splice
+#define AUDIO_JITTER_MIN_LAG 40  // Shortest period dropped or repeated
+#define AUDIO_JITTER_MAX_LAG 160 // Longest, 10ms at 16kHz
+#define AUDIO_JITTER_WORK (AUDIO_JITTER_FRAME + AUDIO_JITTER_MAX_LAG)
+
+typedef enum {
+  AUDIO_JITTER_BUFFERING = 0,
+  AUDIO_JITTER_PLAYING,
+} audio_jitter_state_t;
+
+typedef struct {
+  // Configuration, set by audio_jitter_init() and adjustable before use
+  uint32_t sample_rate;
+  uint32_t min_target_ms;
+  uint32_t max_target_ms;
+  uint32_t safety_ms;          // Margin a packet should arrive with
+  uint32_t target_decay_ms;    // Per second while margins are comfortable
+  uint32_t slack_ms;           // Dead band above the target
+  uint32_t compress_window_ms; // Only compress within target + this
+  uint32_t stream_gap_ms;      // Silence that ends a stream
+  uint32_t output_lead_ms;     // Audio always queued after the buffer
+  bool adaptive;               // Off: target stays at min_target_ms
+  bool stretch;                // Off: no compress/expand
+
+  audio_ring_t ring; // pcm16
+
+  // Shared between the two sides
+  atomic_uint_fast32_t target;      // Samples, written by the producer
+  _Atomic int64_t last_arrival_us;  // Written by the producer
+  atomic_uint_fast32_t drains;      // Times the consumer ran dry
+  _Atomic int64_t drained_at_us;    // Written by the consumer
+  atomic_uint_fast32_t held;        // Samples the consumer has taken out
+  atomic_bool playing;              // Written by the consumer
+
+  // Producer side
+  float target_us;
+  int64_t decayed_at_us;
+  uint32_t seen_drains;
+  uint32_t packets;
+  uint32_t late_packets;    // Arrived with less than the safety margin
+  uint32_t underruns;       // Ran dry mid-stream
+  uint32_t overrun_samples; // Dropped, ring full
+
+  // Consumer side
+  audio_jitter_state_t state;
+  uint32_t compressed; // Periods dropped
+  uint32_t expanded;   // Periods repeated
+  uint16_t work_len;
+  uint16_t frame_len;
+  uint16_t frame_pos;
+  int16_t work[AUDIO_JITTER_WORK];
+  int16_t frame[AUDIO_JITTER_FRAME];
+} audio_jitter_t;
+
+// Allocates the sample ring (`capacity` bytes, power of two) with `caps`
+esp_err_t audio_jitter_init(audio_jitter_t *jb, uint32_t sample_rate,
+                            size_t capacity, uint32_t caps);
+// The same over caller-provided storage, see audio_ring_init()
+esp_err_t audio_jitter_init_storage(audio_jitter_t *jb, uint32_t sample_rate,
+                                    void *storage, size_t capacity);
+void audio_jitter_free(audio_jitter_t *jb);
+
+// Producer: queue a received packet. Never blocks; returns samples kept.
+size_t audio_jitter_push(audio_jitter_t *jb, const int16_t *pcm,
+                         size_t samples, int64_t now_us);
+
+// Consumer: up to `samples` of playable audio, 0 while buffering
+size_t audio_jitter_pull(audio_jitter_t *jb, int16_t *out, size_t samples,
+                         int64_t now_us);
+
+// Queued samples: what the consumer holds as of its last pull and what is
+// still in the ring. Any task; reads atomics only.
+size_t audio_jitter_depth(const audio_jitter_t *jb);
+
+static inline uint32_t audio_jitter_target_ms(const audio_jitter_t *jb) {
+  return (uint32_t)(atomic_load(&jb->target) * 1000ull / jb->sample_rate);
+}
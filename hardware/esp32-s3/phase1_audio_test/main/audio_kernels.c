@@ -0,0 +1,381 @@
+#include "audio_kernels.h"
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#define AUDIO_KERNELS_HAVE_PIE 1
+#else
+#define AUDIO_KERNELS_HAVE_PIE 0
+#endif
+
+static const char *TAG = "AUDIO_KERNELS";
+
+static bool simd_enabled = AUDIO_KERNELS_HAVE_PIE;
+
+static inline int16_t saturate_s16(int32_t value) {
+  if (value > INT16_MAX)
+    return INT16_MAX;
+  if (value < INT16_MIN)
+    return INT16_MIN;
+  return (int16_t)value;
+}
+
+static inline bool aligned16(const void *ptr) {
+  return ((uintptr_t)ptr & (AUDIO_KERNEL_ALIGN - 1)) == 0;
+}
+
+// Scalar references
+
+void audio_kernel_narrow_s32_s16_ref(const int32_t *in, int16_t *out,
+                                     size_t n, int shift) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = saturate_s16(in[i] >> shift);
+  }
+}
+
+void audio_kernel_mix_stereo_s16_ref(const int16_t *in, int16_t *out,
+                                     size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    out[i] = (int16_t)((in[2 * i] >> 1) + (in[2 * i + 1] >> 1));
+  }
+}
+
+void audio_kernel_s16_to_u8_ref(const int16_t *in, uint8_t *out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (uint8_t)((in[i] >> 8) + 128);
+  }
+}
+
+void audio_kernel_gain_s16_ref(const int16_t *in, int16_t *out, size_t n,
+                               int16_t gain, int shift) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = saturate_s16(((int32_t)in[i] * gain) >> shift);
+  }
+}
+
+void audio_kernel_deinterleave_s16_ref(const int16_t *in, int16_t *left,
+                                       int16_t *right, size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    left[i] = in[2 * i];
+    right[i] = in[2 * i + 1];
+  }
+}
+
+void audio_kernel_interleave_s16_ref(const int16_t *left,
+                                     const int16_t *right, int16_t *out,
+                                     size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    out[2 * i] = left[i];
+    out[2 * i + 1] = right[i];
+  }
+}
+
+#if AUDIO_KERNELS_HAVE_PIE
+
+// PIE vector bodies. Each processes `blocks` whole 128-bit steps and leaves
+// the pointers advanced past them. q registers are not allocated by the
+// compiler, so each asm block owns q0-q7 for its duration; SAR is loaded
+// inside the block because compiler-generated shifts also use it.
+
+// 8 x int32 -> 8 x int16 (top halves) per step
+static void pie_narrow_hi16(const int32_t **in, int16_t **out,
+                            size_t blocks) {
+  __asm__ volatile("1:\n"
+                   "ee.vld.128.ip q0, %[in], 16\n"
+                   "ee.vld.128.ip q1, %[in], 16\n"
+                   "ee.vunzip.16 q0, q1\n"
+                   "ee.vst.128.ip q1, %[out], 16\n"
+                   "addi %[n], %[n], -1\n"
+                   "bnez %[n], 1b\n"
+                   : [in] "+r"(*in), [out] "+r"(*out), [n] "+r"(blocks)
+                   :
+                   : "memory");
+}
+
+// 8 stereo frames -> 8 mono samples per step
+static void pie_mix_stereo(const int16_t **in, int16_t **out, size_t blocks) {
+  static const int16_t one = 1;
+  __asm__ volatile("movi a8, 1\n"
+                   "wsr.sar a8\n"
+                   "ee.vldbc.16 q7, %[one]\n"
+                   "1:\n"
+                   "ee.vld.128.ip q0, %[in], 16\n"
+                   "ee.vld.128.ip q1, %[in], 16\n"
+                   "ee.vunzip.16 q0, q1\n"
+                   "ee.vmul.s16 q0, q0, q7\n"
+                   "ee.vmul.s16 q1, q1, q7\n"
+                   "ee.vadds.s16 q2, q0, q1\n"
+                   "ee.vst.128.ip q2, %[out], 16\n"
+                   "addi %[n], %[n], -1\n"
+                   "bnez %[n], 1b\n"
+                   : [in] "+r"(*in), [out] "+r"(*out), [n] "+r"(blocks)
+                   : [one] "r"(&one)
+                   : "a8", "memory");
+}
+
+// 16 x int16 -> 16 x uint8 per step: high byte with the sign bit flipped
+static void pie_s16_to_u8(const int16_t **in, uint8_t **out, size_t blocks) {
+  static const uint8_t bias = 0x80;
+  __asm__ volatile("ee.vldbc.8 q7, %[bias]\n"
+                   "1:\n"
+                   "ee.vld.128.ip q0, %[in], 16\n"
+                   "ee.vld.128.ip q1, %[in], 16\n"
+                   "ee.vunzip.8 q0, q1\n"
+                   "ee.xorq q1, q1, q7\n"
+                   "ee.vst.128.ip q1, %[out], 16\n"
+                   "addi %[n], %[n], -1\n"
+                   "bnez %[n], 1b\n"
+                   : [in] "+r"(*in), [out] "+r"(*out), [n] "+r"(blocks)
+                   : [bias] "r"(&bias)
+                   : "memory");
+}
+
+// 8 x int16 per step
+static void pie_gain(const int16_t **in, int16_t **out, size_t blocks,
+                     const int16_t *gain, int shift) {
+  __asm__ volatile("wsr.sar %[shift]\n"
+                   "ee.vldbc.16 q7, %[gain]\n"
+                   "1:\n"
+                   "ee.vld.128.ip q0, %[in], 16\n"
+                   "ee.vmul.s16 q0, q0, q7\n"
+                   "ee.vst.128.ip q0, %[out], 16\n"
+                   "addi %[n], %[n], -1\n"
+                   "bnez %[n], 1b\n"
+                   : [in] "+r"(*in), [out] "+r"(*out), [n] "+r"(blocks)
+                   : [gain] "r"(gain), [shift] "r"(shift)
+                   : "memory");
+}
+
+// 8 stereo frames per step
+static void pie_deinterleave(const int16_t **in, int16_t **left,
+                             int16_t **right, size_t blocks) {
+  __asm__ volatile("1:\n"
+                   "ee.vld.128.ip q0, %[in], 16\n"
+                   "ee.vld.128.ip q1, %[in], 16\n"
+                   "ee.vunzip.16 q0, q1\n"
+                   "ee.vst.128.ip q0, %[left], 16\n"
+                   "ee.vst.128.ip q1, %[right], 16\n"
+                   "addi %[n], %[n], -1\n"
+                   "bnez %[n], 1b\n"
+                   : [in] "+r"(*in), [left] "+r"(*left),
+                     [right] "+r"(*right), [n] "+r"(blocks)
+                   :
+                   : "memory");
+}
+
+static void pie_interleave(const int16_t **left, const int16_t **right,
+                           int16_t **out, size_t blocks) {
+  __asm__ volatile("1:\n"
+                   "ee.vld.128.ip q0, %[left], 16\n"
+                   "ee.vld.128.ip q1, %[right], 16\n"
+                   "ee.vzip.16 q0, q1\n"
+                   "ee.vst.128.ip q0, %[out], 16\n"
+                   "ee.vst.128.ip q1, %[out], 16\n"
+                   "addi %[n], %[n], -1\n"
+                   "bnez %[n], 1b\n"
+                   : [left] "+r"(*left), [right] "+r"(*right),
+                     [out] "+r"(*out), [n] "+r"(blocks)
+                   :
+                   : "memory");
+}
+
+#endif // AUDIO_KERNELS_HAVE_PIE
+
+// Dispatching entry points
+
+void audio_kernel_narrow_s32_s16(const int32_t *in, int16_t *out, size_t n,
+                                 int shift) {
+#if AUDIO_KERNELS_HAVE_PIE
+  if (simd_enabled && shift == 16 && n >= 8 && aligned16(in) &&
+      aligned16(out)) {
+    size_t blocks = n / 8;
+    pie_narrow_hi16(&in, &out, blocks);
+    n -= blocks * 8;
+  }
+#endif
+  audio_kernel_narrow_s32_s16_ref(in, out, n, shift);
+}
+
+void audio_kernel_mix_stereo_s16(const int16_t *in, int16_t *out,
+                                 size_t frames) {
+#if AUDIO_KERNELS_HAVE_PIE
+  if (simd_enabled && frames >= 8 && aligned16(in) && aligned16(out)) {
+    size_t blocks = frames / 8;
+    pie_mix_stereo(&in, &out, blocks);
+    frames -= blocks * 8;
+  }
+#endif
+  audio_kernel_mix_stereo_s16_ref(in, out, frames);
+}
+
+void audio_kernel_s16_to_u8(const int16_t *in, uint8_t *out, size_t n) {
+#if AUDIO_KERNELS_HAVE_PIE
+  if (simd_enabled && n >= 16 && aligned16(in) && aligned16(out)) {
+    size_t blocks = n / 16;
+    pie_s16_to_u8(&in, &out, blocks);
+    n -= blocks * 16;
+  }
+#endif
+  audio_kernel_s16_to_u8_ref(in, out, n);
+}
+
+void audio_kernel_gain_s16(const int16_t *in, int16_t *out, size_t n,
+                           int16_t gain, int shift) {
+#if AUDIO_KERNELS_HAVE_PIE
+  if (simd_enabled && n >= 8 && aligned16(in) && aligned16(out)) {
+    size_t blocks = n / 8;
+    pie_gain(&in, &out, blocks, &gain, shift);
+    n -= blocks * 8;
+  }
+#endif
+  audio_kernel_gain_s16_ref(in, out, n, gain, shift);
+}
+
+void audio_kernel_deinterleave_s16(const int16_t *in, int16_t *left,
+                                   int16_t *right, size_t frames) {
+#if AUDIO_KERNELS_HAVE_PIE
+  if (simd_enabled && frames >= 8 && aligned16(in) && aligned16(left) &&
+      aligned16(right)) {
+    size_t blocks = frames / 8;
+    pie_deinterleave(&in, &left, &right, blocks);
+    frames -= blocks * 8;
+  }
+#endif
+  audio_kernel_deinterleave_s16_ref(in, left, right, frames);
+}
+
+void audio_kernel_interleave_s16(const int16_t *left, const int16_t *right,
+                                 int16_t *out, size_t frames) {
+#if AUDIO_KERNELS_HAVE_PIE
+  if (simd_enabled && frames >= 8 && aligned16(left) && aligned16(right) &&
+      aligned16(out)) {
+    size_t blocks = frames / 8;
+    pie_interleave(&left, &right, &out, blocks);
+    frames -= blocks * 8;
+  }
+#endif
+  audio_kernel_interleave_s16_ref(left, right, out, frames);
+}
+
+void audio_kernel_u8_levels(const uint8_t *in, size_t n,
+                            audio_u8_levels_t *levels) {
+  uint32_t sum = 0;
+  uint32_t min = 255;
+  uint32_t max = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t level = in[i];
+    sum += level;
+    if (level < min)
+      min = level;
+    if (level > max)
+      max = level;
+  }
+  levels->avg = sum / n;
+  levels->min = min;
+  levels->max = max;
+}
+
+bool audio_kernels_simd_enabled(void) { return simd_enabled; }
+
+#if AUDIO_KERNELS_HAVE_PIE
+
+#define CHECK_SAMPLES 64
+
+// Compare one vector path against its reference on a full-range pattern
+static bool check_kernels(void) {
+  static int32_t in32[CHECK_SAMPLES] __attribute__((aligned(16)));
+  static int16_t in16[2 * CHECK_SAMPLES] __attribute__((aligned(16)));
+  static int16_t out_a[2 * CHECK_SAMPLES] __attribute__((aligned(16)));
+  static int16_t out_b[2 * CHECK_SAMPLES] __attribute__((aligned(16)));
+  static int16_t out_c[CHECK_SAMPLES] __attribute__((aligned(16)));
+  static int16_t out_d[CHECK_SAMPLES] __attribute__((aligned(16)));
+
+  uint32_t seed = 0x12345678;
+  for (int i = 0; i < 2 * CHECK_SAMPLES; i++) {
+    seed = seed * 1664525 + 1013904223; // LCG
+    if (i < CHECK_SAMPLES) {
+      in32[i] = (int32_t)seed;
+    }
+    in16[i] = (int16_t)(seed >> 16);
+  }
+  // Full scale both ways, in the first vector and at its end
+  in16[0] = INT16_MIN;
+  in16[1] = INT16_MAX;
+  in16[6] = INT16_MAX;
+  in16[7] = INT16_MIN;
+
+  audio_kernel_narrow_s32_s16(in32, out_a, CHECK_SAMPLES, 16);
+  audio_kernel_narrow_s32_s16_ref(in32, out_b, CHECK_SAMPLES, 16);
+  if (memcmp(out_a, out_b, CHECK_SAMPLES * sizeof(int16_t)) != 0) {
+    ESP_LOGW(TAG, "narrow_s32_s16 mismatch");
+    return false;
+  }
+
+  audio_kernel_mix_stereo_s16(in16, out_a, CHECK_SAMPLES);
+  audio_kernel_mix_stereo_s16_ref(in16, out_b, CHECK_SAMPLES);
+  if (memcmp(out_a, out_b, CHECK_SAMPLES * sizeof(int16_t)) != 0) {
+    ESP_LOGW(TAG, "mix_stereo_s16 mismatch");
+    return false;
+  }
+
+  audio_kernel_s16_to_u8(in16, (uint8_t *)out_a, 2 * CHECK_SAMPLES);
+  audio_kernel_s16_to_u8_ref(in16, (uint8_t *)out_b, 2 * CHECK_SAMPLES);
+  if (memcmp(out_a, out_b, 2 * CHECK_SAMPLES) != 0) {
+    ESP_LOGW(TAG, "s16_to_u8 mismatch");
+    return false;
+  }
+
+  // -3dB, then gains above unity and a negated full scale, which have to
+  // saturate like the reference on the full-scale samples
+  static const struct {
+    int16_t gain;
+    int shift;
+  } gains[] = {{23170, 15}, {INT16_MAX, 13}, {20000, 12}, {3, 0},
+               {INT16_MIN, 15}, {-12345, 11}};
+  for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+    audio_kernel_gain_s16(in16, out_a, 2 * CHECK_SAMPLES, gains[g].gain,
+                          gains[g].shift);
+    audio_kernel_gain_s16_ref(in16, out_b, 2 * CHECK_SAMPLES, gains[g].gain,
+                              gains[g].shift);
+    if (memcmp(out_a, out_b, 2 * CHECK_SAMPLES * sizeof(int16_t)) != 0) {
+      ESP_LOGW(TAG, "gain_s16 mismatch at gain %d >> %d", gains[g].gain,
+               gains[g].shift);
+      return false;
+    }
+  }
+
+  audio_kernel_deinterleave_s16(in16, out_a, out_c, CHECK_SAMPLES);
+  audio_kernel_deinterleave_s16_ref(in16, out_b, out_d, CHECK_SAMPLES);
+  if (memcmp(out_a, out_b, CHECK_SAMPLES * sizeof(int16_t)) != 0 ||
+      memcmp(out_c, out_d, CHECK_SAMPLES * sizeof(int16_t)) != 0) {
+    ESP_LOGW(TAG, "deinterleave_s16 mismatch");
+    return false;
+  }
+
+  audio_kernel_interleave_s16(out_a, out_c, out_b, CHECK_SAMPLES);
+  if (memcmp(out_b, in16, 2 * CHECK_SAMPLES * sizeof(int16_t)) != 0) {
+    ESP_LOGW(TAG, "interleave_s16 mismatch");
+    return false;
+  }
+
+  return true;
+}
+
+#endif // AUDIO_KERNELS_HAVE_PIE
+
+esp_err_t audio_kernels_init(void) {
+#if AUDIO_KERNELS_HAVE_PIE
+  simd_enabled = true;
+  if (!check_kernels()) {
+    simd_enabled = false;
+    ESP_LOGW(TAG, "PIE kernels disagree with reference, using scalar");
+    return ESP_ERR_INVALID_STATE;
+  }
+  ESP_LOGI(TAG, "PIE vector kernels enabled");
+#else
+  ESP_LOGI(TAG, "Scalar kernels (no PIE on this target)");
+#endif
+  return ESP_OK;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-sample conversion kernels for the capture and playback paths.
+//
+// Every kernel has a portable scalar reference (`*_ref`) that defines its
+// exact output. On the ESP32-S3 the dispatching entry points run the bulk of
+// the block on the Xtensa PIE 128-bit vector unit when all pointers are
+// 16-byte aligned, and finish the tail with the reference. On the linux host
+// target they always use the reference.
+//
+// audio_kernels_init() checks the vector paths against the references once
+// at boot and falls back to scalar if any of them disagree.
+
+#define AUDIO_KERNEL_ALIGN 16
+
+esp_err_t audio_kernels_init(void);
+bool audio_kernels_simd_enabled(void);
+
+// out[i] = sat16(in[i] >> shift). shift == 16 takes the top half of each
+// 32-bit slot (INMP441 24-bit data) and is the vectorized case.
+void audio_kernel_narrow_s32_s16(const int32_t *in, int16_t *out, size_t n,
+                                 int shift);
+void audio_kernel_narrow_s32_s16_ref(const int32_t *in, int16_t *out,
+                                     size_t n, int shift);
+
+// out[i] = (in[2i] >> 1) + (in[2i+1] >> 1). Safe to run in place.
+void audio_kernel_mix_stereo_s16(const int16_t *in, int16_t *out,
+                                 size_t frames);
+void audio_kernel_mix_stereo_s16_ref(const int16_t *in, int16_t *out,
+                                     size_t frames);
+
+// out[i] = (in[i] >> 8) + 128, the unsigned 8-bit PWM duty value
+void audio_kernel_s16_to_u8(const int16_t *in, uint8_t *out, size_t n);
+void audio_kernel_s16_to_u8_ref(const int16_t *in, uint8_t *out, size_t n);
+
+// out[i] = sat16((in[i] * gain) >> shift), 0 <= shift <= 15
+void audio_kernel_gain_s16(const int16_t *in, int16_t *out, size_t n,
+                           int16_t gain, int shift);
+void audio_kernel_gain_s16_ref(const int16_t *in, int16_t *out, size_t n,
+                               int16_t gain, int shift);
+
+// Split interleaved stereo into planar channels and back
+void audio_kernel_deinterleave_s16(const int16_t *in, int16_t *left,
+                                   int16_t *right, size_t frames);
+void audio_kernel_deinterleave_s16_ref(const int16_t *in, int16_t *left,
+                                       int16_t *right, size_t frames);
+void audio_kernel_interleave_s16(const int16_t *left, const int16_t *right,
+                                 int16_t *out, size_t frames);
+void audio_kernel_interleave_s16_ref(const int16_t *left,
+                                     const int16_t *right, int16_t *out,
+                                     size_t frames);
+
+// Mean, minimum and maximum of n > 0 PWM duty values, the capture task's
+// level monitor. Scalar on every target: it runs on one block per 500ms.
+typedef struct {
+  uint32_t avg;
+  uint32_t min;
+  uint32_t max;
+} audio_u8_levels_t;
+
+void audio_kernel_u8_levels(const uint8_t *in, size_t n,
+                            audio_u8_levels_t *levels);
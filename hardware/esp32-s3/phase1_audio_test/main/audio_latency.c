@@ -0,0 +1,66 @@
+#include "audio_latency.h"
+
+#include <stdio.h>
+
+void audio_latency_add(audio_latency_t *hist, uint32_t us) {
+  int bucket = 0;
+  uint32_t scaled = us / AUDIO_LATENCY_FIRST_US;
+  if (scaled > 0) {
+    bucket = 32 - __builtin_clz(scaled);
+    if (bucket >= AUDIO_LATENCY_BUCKETS) {
+      bucket = AUDIO_LATENCY_BUCKETS - 1;
+    }
+  }
+  hist->buckets[bucket]++;
+  hist->count++;
+  hist->total_us += us;
+  if (us > hist->max_us) {
+    hist->max_us = us;
+  }
+}
+
+uint32_t audio_latency_bucket_bound(int i) {
+  if (i >= AUDIO_LATENCY_BUCKETS - 1) {
+    return UINT32_MAX;
+  }
+  return (uint32_t)AUDIO_LATENCY_FIRST_US << i;
+}
+
+uint32_t audio_latency_percentile(const audio_latency_t *hist,
+                                  uint32_t permille) {
+  uint32_t count = hist->count;
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t wanted = ((uint64_t)count * permille + 999) / 1000;
+  uint64_t seen = 0;
+  for (int i = 0; i < AUDIO_LATENCY_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if (seen >= wanted) {
+      uint32_t bound = audio_latency_bucket_bound(i);
+      return bound < hist->max_us ? bound : hist->max_us;
+    }
+  }
+  return hist->max_us;
+}
+
+int audio_latency_json(const audio_latency_t *hist, const char *name,
+                       char *buf, size_t len) {
+  uint32_t count = hist->count;
+  int n = snprintf(buf, len,
+                   "\"%s\":{\"n\":%u,\"avg\":%u,\"p50\":%u,\"p99\":%u,"
+                   "\"max\":%u,\"hist\":[",
+                   name, (unsigned int)count,
+                   (unsigned int)(count ? hist->total_us / count : 0),
+                   (unsigned int)audio_latency_percentile(hist, 500),
+                   (unsigned int)audio_latency_percentile(hist, 990),
+                   (unsigned int)hist->max_us);
+  for (int i = 0; i < AUDIO_LATENCY_BUCKETS; i++) {
+    size_t used = (size_t)n < len ? (size_t)n : len;
+    n += snprintf(buf + used, len - used, "%s%u", i ? "," : "",
+                  (unsigned int)hist->buckets[i]);
+  }
+  size_t used = (size_t)n < len ? (size_t)n : len;
+  n += snprintf(buf + used, len - used, "]}");
+  return n;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-bucket latency histogram.
+//
+// Bucket 0 counts durations under AUDIO_LATENCY_FIRST_US, each following
+// bucket doubles the bound, and the last one takes everything from about a
+// second up. Adding a sample is a few instructions and never allocates.
+// One task writes each histogram; others may read it at any time and see
+// a slightly stale but usable snapshot, like the pipeline counters.
+
+#define AUDIO_LATENCY_BUCKETS 16
+#define AUDIO_LATENCY_FIRST_US 64 // Upper bound of bucket 0
+
+typedef struct {
+  uint32_t buckets[AUDIO_LATENCY_BUCKETS];
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t total_us;
+} audio_latency_t;
+
+void audio_latency_add(audio_latency_t *hist, uint32_t us);
+
+// Upper bound of bucket `i`, UINT32_MAX for the last one
+uint32_t audio_latency_bucket_bound(int i);
+
+// Bucket bound at or below which `permille` of the samples lie, capped at
+// the largest sample. 0 while empty.
+uint32_t audio_latency_percentile(const audio_latency_t *hist,
+                                  uint32_t permille);
+
+// `"name":{"n":..,"avg":..,"p50":..,"p99":..,"max":..,"hist":[..]}` into
+// buf, snprintf style: returns the length it needed
+int audio_latency_json(const audio_latency_t *hist, const char *name,
+                       char *buf, size_t len);
@@ -0,0 +1,85 @@
+#include "audio_marker.h"
+
+#include <math.h>
+#include <string.h>
+
+esp_err_t audio_marker_init(audio_marker_t *marker, uint32_t sample_rate,
+                            float threshold) {
+  if (sample_rate < 2 * AUDIO_MARKER_HIGH_HZ || threshold <= 0 ||
+      threshold >= 1) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // Linear sweep under a Hann window, so it starts and ends quietly and
+  // its correlation has one clear peak
+  const float n = AUDIO_MARKER_SAMPLES;
+  const float f0 = AUDIO_MARKER_LOW_HZ / (float)sample_rate;
+  const float f1 = AUDIO_MARKER_HIGH_HZ / (float)sample_rate;
+  marker->chirp_energy = 0;
+  for (int i = 0; i < AUDIO_MARKER_SAMPLES; i++) {
+    float phase = 2 * (float)M_PI * (f0 * i + (f1 - f0) * i * i / (2 * n));
+    float window = 0.5f - 0.5f * cosf(2 * (float)M_PI * i / (n - 1));
+    marker->chirp[i] = window * sinf(phase);
+    marker->chirp_energy += marker->chirp[i] * marker->chirp[i];
+  }
+  marker->threshold = threshold;
+  audio_marker_reset(marker);
+  return ESP_OK;
+}
+
+void audio_marker_reset(audio_marker_t *marker) {
+  memset(marker->window, 0, sizeof(marker->window));
+  marker->pos = 0;
+  marker->fed = 0;
+  marker->best = 0;
+  marker->best_end = 0;
+}
+
+void audio_marker_generate(const audio_marker_t *marker, int16_t amplitude,
+                           int16_t *out) {
+  for (int i = 0; i < AUDIO_MARKER_SAMPLES; i++) {
+    out[i] = (int16_t)lrintf(marker->chirp[i] * amplitude);
+  }
+}
+
+bool audio_marker_feed(audio_marker_t *marker, const int16_t *pcm, size_t n,
+                       int64_t *start, float *score) {
+  const uint64_t first = marker->fed;
+  for (size_t i = 0; i < n; i++) {
+    float x = pcm[i];
+    marker->window[marker->pos] = x;
+    marker->window[marker->pos + AUDIO_MARKER_SAMPLES] = x;
+    marker->pos = (marker->pos + 1) % AUDIO_MARKER_SAMPLES;
+    marker->fed++;
+
+    if (marker->best > 0 &&
+        marker->fed - marker->best_end >= AUDIO_MARKER_SAMPLES) {
+      // Nothing higher within a chirp length: that was the peak
+      *start = (int64_t)(marker->best_end - AUDIO_MARKER_SAMPLES) -
+               (int64_t)first;
+      *score = marker->best;
+      marker->best = 0;
+      return true;
+    }
+    if (marker->fed < AUDIO_MARKER_SAMPLES) {
+      continue;
+    }
+
+    const float *window = &marker->window[marker->pos];
+    float dot = 0, energy = 0;
+    for (int k = 0; k < AUDIO_MARKER_SAMPLES; k++) {
+      dot += marker->chirp[k] * window[k];
+      energy += window[k] * window[k];
+    }
+    if (dot <= 0 || energy <= 0) {
+      continue;
+    }
+    // Compare squares to skip the square root
+    float ncc2 = dot * dot / (energy * marker->chirp_energy);
+    float threshold2 = marker->threshold * marker->threshold;
+    if (ncc2 > threshold2 && ncc2 > marker->best * marker->best) {
+      marker->best = sqrtf(ncc2);
+      marker->best_end = marker->fed;
+    }
+  }
+  return false;
+}
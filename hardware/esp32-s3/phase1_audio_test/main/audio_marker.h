@@ -0,0 +1,49 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Chirp marker for end-to-end latency tests. A short windowed sweep is
+// written into the uplink in place of the microphone signal and found
+// again in the downlink by normalized cross-correlation, so it survives
+// codecs, resampling and gain changes that would lose a header.
+//
+// The detector costs two multiply-adds per template tap per sample; feed
+// it only while a marker is expected.
+
+#define AUDIO_MARKER_SAMPLES 256 // 16ms at 16kHz
+#define AUDIO_MARKER_LOW_HZ 400  // Sweep, inside any speech codec's band
+#define AUDIO_MARKER_HIGH_HZ 3200
+#define AUDIO_MARKER_THRESHOLD 0.6f // Default normalized correlation
+
+typedef struct {
+  float chirp[AUDIO_MARKER_SAMPLES];
+  float chirp_energy;
+  float threshold;
+  // Last AUDIO_MARKER_SAMPLES inputs, stored twice so the window is
+  // always contiguous at window[pos]
+  float window[2 * AUDIO_MARKER_SAMPLES];
+  size_t pos;
+  uint64_t fed;      // Samples since reset
+  float best;        // Peak correlation above the threshold so far...
+  uint64_t best_end; // ...and the sample count where its window ended
+} audio_marker_t;
+
+esp_err_t audio_marker_init(audio_marker_t *marker, uint32_t sample_rate,
+                            float threshold);
+
+// Forget everything fed so far
+void audio_marker_reset(audio_marker_t *marker);
+
+// Write the chirp at `amplitude` to out[0..AUDIO_MARKER_SAMPLES)
+void audio_marker_generate(const audio_marker_t *marker, int16_t amplitude,
+                           int16_t *out);
+
+// Look for the chirp in the next `n` received samples. True once a peak
+// has been passed, with `start` the sample where the chirp began relative
+// to pcm[0] (negative if in an earlier call) and `score` its correlation,
+// 0..1. A peak is reported up to AUDIO_MARKER_SAMPLES samples after it.
+bool audio_marker_feed(audio_marker_t *marker, const int16_t *pcm, size_t n,
+                       int64_t *start, float *score);
@@ -0,0 +1,189 @@
+#include "audio_ns.h"
+
+#include <math.h>
+#include <string.h>
+
+#define INPUT_SHIFT 8        // pcm16 -> FFT input headroom
+#define POWER_SMOOTHING 0.7f // Weight of the previous power estimate
+#define NOISE_FALL 0.2f      // Fraction of a dip the floor follows per hop
+#define NOISE_RISE 1.002f    // Per hop, ~1 dB/s at 125 hops/s
+#define NOISE_INIT_FRAMES 16 // Floor is the plain average for the first 128ms
+#define DD_ALPHA 0.98f       // Decision-directed smoothing
+#define POWER_EPSILON 1.0f
+
+void audio_ns_init(audio_ns_t *ns, audio_ns_level_t level) {
+  memset(ns, 0, sizeof(*ns));
+  audio_fft_init(&ns->fft, AUDIO_NS_FRAME);
+
+  // Periodic sqrt-Hann: squared windows overlap-add to exactly 1
+  for (int n = 0; n < AUDIO_NS_FRAME; n++) {
+    double w = sin(M_PI * n / AUDIO_NS_FRAME);
+    ns->window[n] = (int16_t)lrint(w * 32767.0);
+  }
+  audio_ns_set_level(ns, level);
+  audio_ns_reset(ns);
+}
+
+void audio_ns_reset(audio_ns_t *ns) {
+  memset(ns->in_hop, 0, sizeof(ns->in_hop));
+  memset(ns->out_hop, 0, sizeof(ns->out_hop));
+  memset(ns->prev_hop, 0, sizeof(ns->prev_hop));
+  memset(ns->overlap, 0, sizeof(ns->overlap));
+  memset(ns->smoothed, 0, sizeof(ns->smoothed));
+  memset(ns->noise, 0, sizeof(ns->noise));
+  memset(ns->prev_snr, 0, sizeof(ns->prev_snr));
+  ns->fill = 0;
+  ns->frames = 0;
+  ns->noise_db = -96.0f;
+}
+
+void audio_ns_set_level(audio_ns_t *ns, audio_ns_level_t level) {
+  ns->level = level;
+  switch (level) {
+  case AUDIO_NS_HIGH:
+    ns->over_subtract = 2.0f;
+    ns->gain_floor = 0.1f; // -20 dB
+    break;
+  case AUDIO_NS_MEDIUM:
+    ns->over_subtract = 1.5f;
+    ns->gain_floor = 0.178f; // -15 dB
+    break;
+  case AUDIO_NS_LOW:
+  case AUDIO_NS_OFF:
+  default:
+    ns->over_subtract = 1.0f;
+    ns->gain_floor = 0.316f; // -10 dB
+    break;
+  }
+}
+
+const char *audio_ns_level_name(audio_ns_level_t level) {
+  switch (level) {
+  case AUDIO_NS_LOW:
+    return "low";
+  case AUDIO_NS_MEDIUM:
+    return "medium";
+  case AUDIO_NS_HIGH:
+    return "high";
+  case AUDIO_NS_OFF:
+  default:
+    return "off";
+  }
+}
+
+static inline int16_t sat16(int32_t x) {
+  if (x > INT16_MAX)
+    return INT16_MAX;
+  if (x < INT16_MIN)
+    return INT16_MIN;
+  return (int16_t)x;
+}
+
+// Update the noise floor and per-bin gains from the current spectrum, then
+// apply them
+static void suppress(audio_ns_t *ns) {
+  audio_fft_fixed_t *spectrum = ns->spectrum;
+  float noise_sum = 0.0f;
+
+  for (int k = 0; k < AUDIO_NS_BINS; k++) {
+    float re = (float)spectrum[k].re;
+    float im = (float)spectrum[k].im;
+    float power = re * re + im * im;
+
+    float s = POWER_SMOOTHING * ns->smoothed[k] +
+              (1.0f - POWER_SMOOTHING) * power;
+    ns->smoothed[k] = s;
+    if (ns->frames < NOISE_INIT_FRAMES) {
+      ns->noise[k] += (s - ns->noise[k]) / (ns->frames + 1);
+    } else if (s < ns->noise[k]) {
+      ns->noise[k] += (s - ns->noise[k]) * NOISE_FALL;
+    } else {
+      ns->noise[k] *= NOISE_RISE;
+    }
+    noise_sum += ns->noise[k];
+
+    float post = power / (ns->noise[k] + POWER_EPSILON);
+    float excess = post - ns->over_subtract;
+    float prio = DD_ALPHA * ns->prev_snr[k] +
+                 (1.0f - DD_ALPHA) * (excess > 0.0f ? excess : 0.0f);
+    float gain = prio / (1.0f + prio);
+    if (gain < ns->gain_floor) {
+      gain = ns->gain_floor;
+    }
+    ns->prev_snr[k] = gain * gain * post;
+
+    int32_t g = (int32_t)(gain * 32767.0f);
+    spectrum[k].re = (int32_t)(((int64_t)spectrum[k].re * g) >> 15);
+    spectrum[k].im = (int32_t)(((int64_t)spectrum[k].im * g) >> 15);
+  }
+
+  // Parseval over both half-spectra, undoing the Hann power (0.5) and the
+  // input shift, relative to full-scale pcm16
+  float mean_square = 4.0f * noise_sum / (float)(1 << (2 * INPUT_SHIFT));
+  ns->noise_db = 10.0f * log10f(mean_square / (32768.0f * 32768.0f) + 1e-10f);
+  ns->frames++;
+}
+
+// One hop: analyse [prev_hop, in_hop], suppress, and overlap-add the first
+// half of the result into out_hop
+static void process_hop(audio_ns_t *ns) {
+  const int16_t *w = ns->window;
+  int32_t *time = ns->time;
+
+  if (ns->level == AUDIO_NS_OFF) {
+    // Same delay as the processed path, and keep the overlap consistent
+    // with an unmodified frame so switching back on is seamless
+    for (int i = 0; i < AUDIO_NS_HOP; i++) {
+      ns->out_hop[i] = ns->prev_hop[i];
+      int32_t x = (int32_t)ns->in_hop[i] << INPUT_SHIFT;
+      int32_t ww = ((int32_t)w[AUDIO_NS_HOP + i] * w[AUDIO_NS_HOP + i]) >> 15;
+      ns->overlap[i] = (int32_t)(((int64_t)x * ww) >> 15);
+    }
+    memcpy(ns->prev_hop, ns->in_hop, sizeof(ns->prev_hop));
+    return;
+  }
+
+  for (int i = 0; i < AUDIO_NS_HOP; i++) {
+    int64_t head = (int64_t)ns->prev_hop[i] << INPUT_SHIFT;
+    int64_t tail = (int64_t)ns->in_hop[i] << INPUT_SHIFT;
+    time[i] = (int32_t)((head * w[i]) >> 15);
+    time[AUDIO_NS_HOP + i] = (int32_t)((tail * w[AUDIO_NS_HOP + i]) >> 15);
+  }
+  memcpy(ns->prev_hop, ns->in_hop, sizeof(ns->prev_hop));
+
+  audio_fft_forward_fixed(&ns->fft, time, ns->spectrum);
+  suppress(ns);
+  audio_fft_inverse_fixed(&ns->fft, ns->spectrum, time);
+
+  const int32_t round = 1 << (INPUT_SHIFT - 1);
+  for (int i = 0; i < AUDIO_NS_HOP; i++) {
+    int32_t head = (int32_t)(((int64_t)time[i] * w[i]) >> 15);
+    int32_t y = ns->overlap[i] + head;
+    ns->out_hop[i] = sat16((y + round) >> INPUT_SHIFT);
+    ns->overlap[i] = (int32_t)(((int64_t)time[AUDIO_NS_HOP + i] *
+                                w[AUDIO_NS_HOP + i]) >>
+                               15);
+  }
+}
+
+void audio_ns_process(audio_ns_t *ns, const int16_t *in, int16_t *out,
+                      size_t samples) {
+  while (samples > 0) {
+    size_t chunk = AUDIO_NS_HOP - ns->fill;
+    if (chunk > samples) {
+      chunk = samples;
+    }
+    // Input first so `out` may alias `in`
+    memcpy(&ns->in_hop[ns->fill], in, chunk * sizeof(int16_t));
+    memcpy(out, &ns->out_hop[ns->fill], chunk * sizeof(int16_t));
+    ns->fill += chunk;
+    in += chunk;
+    out += chunk;
+    samples -= chunk;
+
+    if (ns->fill == AUDIO_NS_HOP) {
+      process_hop(ns);
+      ns->fill = 0;
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "audio_fft.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming spectral noise suppressor for mono pcm16.
+//
+// 256-point frames with a 128-sample hop (8ms at 16kHz) and sqrt-Hann
+// analysis/synthesis windows, so unmodified frames overlap-add back to the
+// input exactly. Windowing and both FFTs run in fixed point (audio_fft
+// fixed variant, pcm16 << 8 for headroom); the 129 per-bin gains are
+// computed in float.
+//
+// Each bin tracks a noise floor that follows dips quickly and creeps up at
+// ~1 dB/s, so steady fans and HVAC are learned while speech is not. Gains
+// come from a decision-directed Wiener rule; the level sets how much the
+// noise estimate is over-subtracted and how deep a bin may be cut:
+//
+//   LOW     1.0x, -10 dB floor
+//   MEDIUM  1.5x, -15 dB floor
+//   HIGH    2.0x, -20 dB floor
+//
+// Any block size works; output lags input by two hops (16ms). Cost per hop
+// is two 256-point fixed-point FFTs, 512 window multiplies and 129 gain
+// updates (one divide each).
+
+#define AUDIO_NS_FRAME 256
+#define AUDIO_NS_HOP (AUDIO_NS_FRAME / 2)
+#define AUDIO_NS_BINS (AUDIO_NS_FRAME / 2 + 1)
+
+typedef enum {
+  AUDIO_NS_OFF = 0,
+  AUDIO_NS_LOW,
+  AUDIO_NS_MEDIUM,
+  AUDIO_NS_HIGH,
+} audio_ns_level_t;
+
+typedef struct {
+  audio_ns_level_t level;
+  float over_subtract;
+  float gain_floor;
+
+  audio_fft_t fft;
+  int16_t window[AUDIO_NS_FRAME]; // Q15 sqrt-Hann
+  int16_t in_hop[AUDIO_NS_HOP];   // Input being collected
+  int16_t out_hop[AUDIO_NS_HOP];  // Output being handed out
+  int16_t prev_hop[AUDIO_NS_HOP]; // First half of the next frame
+  int32_t overlap[AUDIO_NS_HOP];  // Synthesis tail of the previous frame
+  uint16_t fill;
+  int32_t time[AUDIO_NS_FRAME];
+  audio_fft_fixed_t spectrum[AUDIO_NS_BINS];
+
+  float smoothed[AUDIO_NS_BINS]; // Recursive power average
+  float noise[AUDIO_NS_BINS];    // Noise floor estimate
+  float prev_snr[AUDIO_NS_BINS]; // Decision-directed a priori SNR memory
+  uint32_t frames;
+  float noise_db; // Broadband noise floor estimate, dBFS, for telemetry
+} audio_ns_t;
+
+void audio_ns_init(audio_ns_t *ns, audio_ns_level_t level);
+void audio_ns_reset(audio_ns_t *ns);
+void audio_ns_set_level(audio_ns_t *ns, audio_ns_level_t level);
+const char *audio_ns_level_name(audio_ns_level_t level);
+
+// Suppress noise in `samples` of pcm16; `out` may alias `in`. AUDIO_NS_OFF
+// passes the signal through with the same delay.
+void audio_ns_process(audio_ns_t *ns, const int16_t *in, int16_t *out,
+                      size_t samples);
@@ -0,0 +1,108 @@
+#include "audio_opus.h"
+
+#include "esp_log.h"
+#include "opus.h"
+#include <string.h>
+
+static const char *TAG = "AUDIO_OPUS";
+
+size_t audio_opus_encoder_state_bytes(void) {
+  return (size_t)opus_encoder_get_size(1);
+}
+
+size_t audio_opus_decoder_state_bytes(void) {
+  return (size_t)opus_decoder_get_size(1);
+}
+
+static esp_err_t configure_encoder(audio_opus_encoder_t *enc) {
+  OpusEncoder *state = (OpusEncoder *)enc->state;
+  int err = opus_encoder_init(state, (opus_int32)enc->sample_rate, 1,
+                              OPUS_APPLICATION_VOIP);
+  if (err != OPUS_OK) {
+    ESP_LOGE(TAG, "Encoder init failed: %s", opus_strerror(err));
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Low complexity keeps a 20ms frame well inside the sender's budget
+  opus_encoder_ctl(state, OPUS_SET_BITRATE(enc->bitrate));
+  opus_encoder_ctl(state, OPUS_SET_COMPLEXITY(3));
+  opus_encoder_ctl(state, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+  opus_encoder_ctl(state, OPUS_SET_VBR(1));
+
+  enc->frame_samples = enc->sample_rate * AUDIO_OPUS_FRAME_MS / 1000;
+  enc->pending = 0;
+  return ESP_OK;
+}
+
+esp_err_t audio_opus_encoder_init(audio_opus_encoder_t *enc, void *state,
+                                  uint32_t sample_rate, int bitrate) {
+  if (!state) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  enc->state = state;
+  enc->sample_rate = sample_rate;
+  enc->bitrate = bitrate ? bitrate : AUDIO_OPUS_DEFAULT_BITRATE;
+  return configure_encoder(enc);
+}
+
+esp_err_t audio_opus_encoder_set_rate(audio_opus_encoder_t *enc,
+                                      uint32_t sample_rate) {
+  enc->sample_rate = sample_rate;
+  return configure_encoder(enc);
+}
+
+size_t audio_opus_encoder_feed(audio_opus_encoder_t *enc, const int16_t *pcm,
+                               size_t samples, audio_opus_packet_cb_t emit,
+                               void *ctx) {
+  size_t packets = 0;
+
+  while (samples > 0) {
+    size_t take = enc->frame_samples - enc->pending;
+    if (take > samples) {
+      take = samples;
+    }
+    memcpy(&enc->frame[enc->pending], pcm, take * sizeof(int16_t));
+    enc->pending += take;
+    pcm += take;
+    samples -= take;
+
+    if (enc->pending < enc->frame_samples) {
+      break;
+    }
+    enc->pending = 0;
+
+    opus_int32 len =
+        opus_encode((OpusEncoder *)enc->state, enc->frame,
+                    (int)enc->frame_samples, enc->packet, sizeof(enc->packet));
+    if (len < 0) {
+      ESP_LOGW(TAG, "Encode failed: %s", opus_strerror(len));
+      continue;
+    }
+    emit(enc->packet, (size_t)len, ctx);
+    packets++;
+  }
+  return packets;
+}
+
+esp_err_t audio_opus_decoder_init(audio_opus_decoder_t *dec, void *state,
+                                  uint32_t sample_rate) {
+  if (!state) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dec->state = state;
+
+  int err =
+      opus_decoder_init((OpusDecoder *)dec->state, (opus_int32)sample_rate, 1);
+  if (err != OPUS_OK) {
+    ESP_LOGE(TAG, "Decoder init failed: %s", opus_strerror(err));
+    return ESP_ERR_INVALID_ARG;
+  }
+  dec->sample_rate = sample_rate;
+  return ESP_OK;
+}
+
+int audio_opus_decode(audio_opus_decoder_t *dec, const uint8_t *packet,
+                      size_t len, int16_t *pcm, size_t max_samples) {
+  return opus_decode((OpusDecoder *)dec->state, len ? packet : NULL,
+                     (opus_int32)len, pcm, (int)max_samples, 0);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Opus speech codec stage for the uplink and downlink (libopus via the
+// 78/esp-opus component).
+//
+// Encoder and decoder state are sized with audio_opus_*_state_bytes() and
+// provided by the caller (PSRAM or internal RAM); encoding and decoding
+// never allocate. The encoder buffers arbitrary
+// block sizes into 20ms frames and emits one packet per frame.
+//
+// libopus works on the calling task's stack: the encoder needs roughly
+// 24KB, the decoder roughly 8KB.
+
+#define AUDIO_OPUS_FRAME_MS 20
+#define AUDIO_OPUS_MAX_FRAME_SAMPLES (48000 * AUDIO_OPUS_FRAME_MS / 1000)
+#define AUDIO_OPUS_MAX_PACKET 256 // Plenty for <= 64 kbit/s at 20ms
+#define AUDIO_OPUS_DEFAULT_BITRATE 24000
+
+typedef void (*audio_opus_packet_cb_t)(const uint8_t *packet, size_t len,
+                                       void *ctx);
+
+typedef struct {
+  void *state; // OpusEncoder, preallocated
+  uint32_t sample_rate;
+  int bitrate;
+  size_t frame_samples;
+  size_t pending;
+  int16_t frame[AUDIO_OPUS_MAX_FRAME_SAMPLES];
+  uint8_t packet[AUDIO_OPUS_MAX_PACKET];
+} audio_opus_encoder_t;
+
+typedef struct {
+  void *state; // OpusDecoder, preallocated
+  uint32_t sample_rate;
+} audio_opus_decoder_t;
+
+size_t audio_opus_encoder_state_bytes(void);
+size_t audio_opus_decoder_state_bytes(void);
+
+// `state` holds audio_opus_encoder_state_bytes(). sample_rate must be one of
+// 8000, 12000, 16000, 24000 or 48000.
+esp_err_t audio_opus_encoder_init(audio_opus_encoder_t *enc, void *state,
+                                  uint32_t sample_rate, int bitrate);
+
+// Re-initialize in place for a new input rate; drops any partial frame
+esp_err_t audio_opus_encoder_set_rate(audio_opus_encoder_t *enc,
+                                      uint32_t sample_rate);
+
+// Buffer `samples` of mono pcm16 and call `emit` once per complete 20ms
+// packet. Returns the number of packets emitted.
+size_t audio_opus_encoder_feed(audio_opus_encoder_t *enc, const int16_t *pcm,
+                               size_t samples, audio_opus_packet_cb_t emit,
+                               void *ctx);
+
+// `state` holds audio_opus_decoder_state_bytes(). The output rate is
+// independent of the rate the stream was encoded at.
+esp_err_t audio_opus_decoder_init(audio_opus_decoder_t *dec, void *state,
+                                  uint32_t sample_rate);
+
+// Decode one packet to mono pcm16. A NULL/empty packet runs packet loss
+// concealment for one frame. Returns samples written or a negative libopus
+// error code.
+int audio_opus_decode(audio_opus_decoder_t *dec, const uint8_t *packet,
+                      size_t len, int16_t *pcm, size_t max_samples);
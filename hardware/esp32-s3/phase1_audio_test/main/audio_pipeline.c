@@ -0,0 +1,286 @@
+#include "audio_pipeline.h"
+
+#include "sdkconfig.h"
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#endif
+
+size_t audio_format_frame_bytes(audio_format_t format) {
+  switch (format) {
+  case AUDIO_FORMAT_S16_MONO:
+    return sizeof(int16_t);
+  case AUDIO_FORMAT_S16_STEREO:
+  case AUDIO_FORMAT_S32_MONO:
+    return 2 * sizeof(int16_t);
+  case AUDIO_FORMAT_S32_STEREO:
+    return 2 * sizeof(int32_t);
+  case AUDIO_FORMAT_U8_MONO:
+  case AUDIO_FORMAT_BYTES:
+  default:
+    return 1;
+  }
+}
+
+uint32_t audio_pipeline_ticks(void) {
+#if CONFIG_IDF_TARGET_LINUX
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#else
+  return esp_cpu_get_cycle_count();
+#endif
+}
+
+// Output frames of one call, or an upper bound from the stage itself
+static size_t stage_output(const audio_stage_t *stage, size_t frames) {
+  return stage->max_output ? stage->max_output(stage->state, frames) : frames;
+}
+
+// Output frames for a whole block, fed in block_frames pieces
+static size_t block_output(const audio_stage_t *stage, size_t frames) {
+  size_t per_call = stage->block_frames;
+  if (per_call == 0 || frames <= per_call) {
+    return stage_output(stage, frames);
+  }
+  size_t total = frames / per_call * stage_output(stage, per_call);
+  if (frames % per_call) {
+    total += stage_output(stage, frames % per_call);
+  }
+  return total;
+}
+
+esp_err_t audio_pipeline_check(const audio_pipeline_t *pipeline,
+                               const audio_chain_t *chain) {
+  if (!chain || chain->count > AUDIO_PIPELINE_MAX_STAGES) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  audio_format_t format = pipeline->in_format;
+  size_t frames = pipeline->block_frames;
+  for (size_t i = 0; i < chain->count; i++) {
+    const audio_stage_t *stage = chain->slots[i];
+    if (!stage) {
+      continue;
+    }
+    if (stage->in_format != format || !stage->process) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    format = stage->out_format;
+    frames = block_output(stage, frames);
+    if (frames * audio_format_frame_bytes(format) >
+        AUDIO_PIPELINE_BUFFER_BYTES) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t audio_pipeline_init(audio_pipeline_t *pipeline,
+                              audio_format_t in_format, size_t block_frames,
+                              const audio_chain_t *chain) {
+  pipeline->in_format = in_format;
+  pipeline->block_frames = block_frames;
+  pipeline->active = NULL;
+  pipeline->swaps = 0;
+  atomic_store(&pipeline->pending, NULL);
+
+  esp_err_t err = audio_pipeline_check(pipeline, chain);
+  if (err != ESP_OK) {
+    return err;
+  }
+  pipeline->active = chain;
+  return ESP_OK;
+}
+
+esp_err_t audio_pipeline_swap(audio_pipeline_t *pipeline,
+                              const audio_chain_t *chain) {
+  esp_err_t err = audio_pipeline_check(pipeline, chain);
+  if (err != ESP_OK) {
+    return err;
+  }
+  atomic_store(&pipeline->pending, chain);
+  return ESP_OK;
+}
+
+static bool chain_contains(const audio_chain_t *chain,
+                           const audio_stage_t *stage) {
+  for (size_t i = 0; i < chain->count; i++) {
+    if (chain->slots[i] == stage) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Run a stage over a block, one block_frames piece at a time, timing the
+// whole block
+static size_t run_stage(audio_stage_t *stage, const void *in, void *out,
+                        size_t frames) {
+  const size_t in_bytes = audio_format_frame_bytes(stage->in_format);
+  const size_t out_bytes = audio_format_frame_bytes(stage->out_format);
+  const size_t per_call = stage->block_frames ? stage->block_frames : frames;
+
+  uint32_t start = audio_pipeline_ticks();
+  size_t produced = 0;
+  size_t done = 0;
+  while (done < frames) {
+    size_t n = frames - done < per_call ? frames - done : per_call;
+    produced += stage->process(stage->state,
+                               (const uint8_t *)in + done * in_bytes,
+                               (uint8_t *)out + produced * out_bytes, n);
+    done += n;
+  }
+  uint32_t ticks = audio_pipeline_ticks() - start;
+
+  stage->calls++;
+  stage->last_ticks = ticks;
+  stage->total_ticks += ticks;
+  if (ticks > stage->max_ticks) {
+    stage->max_ticks = ticks;
+  }
+  return produced;
+}
+
+// Linear crossfade from `from` to `to` across the block. `out` may alias
+// either input.
+static void crossfade(audio_format_t format, const void *from, const void *to,
+                      void *out, size_t frames) {
+  if (format == AUDIO_FORMAT_S16_MONO || format == AUDIO_FORMAT_S16_STEREO) {
+    const size_t samples = frames * audio_format_frame_bytes(format) / 2;
+    const int16_t *a = from;
+    const int16_t *b = to;
+    int16_t *y = out;
+    for (size_t i = 0; i < samples; i++) {
+      int32_t w = (int32_t)((i << 15) / samples); // Q15, 0 -> ~1
+      y[i] = (int16_t)(a[i] + (((b[i] - a[i]) * w) >> 15));
+    }
+  } else {
+    const size_t samples = frames * audio_format_frame_bytes(format) / 4;
+    const int32_t *a = from;
+    const int32_t *b = to;
+    int32_t *y = out;
+    for (size_t i = 0; i < samples; i++) {
+      int64_t w = (int64_t)((i << 15) / samples);
+      y[i] = (int32_t)(a[i] + ((((int64_t)b[i] - a[i]) * w) >> 15));
+    }
+  }
+}
+
+static bool can_crossfade(audio_format_t format) {
+  return format == AUDIO_FORMAT_S16_MONO ||
+         format == AUDIO_FORMAT_S16_STEREO ||
+         format == AUDIO_FORMAT_S32_MONO || format == AUDIO_FORMAT_S32_STEREO;
+}
+
+// First pipeline buffer that is neither `busy` nor `busy2`
+static uint8_t *free_buffer(audio_pipeline_t *pipeline, const void *busy,
+                            const void *busy2) {
+  for (int i = 0; i < 3; i++) {
+    uint8_t *buffer = pipeline->buffers[i];
+    if (buffer != busy && buffer != busy2) {
+      return buffer;
+    }
+  }
+  return NULL; // Unreachable with three buffers
+}
+
+const void *audio_pipeline_process(audio_pipeline_t *pipeline,
+                                   const void *in, size_t frames,
+                                   size_t *out_frames) {
+  const audio_chain_t *previous = NULL;
+  const audio_chain_t *next = atomic_exchange(&pipeline->pending, NULL);
+  if (next && next != pipeline->active) {
+    previous = pipeline->active;
+    for (size_t i = 0; i < next->count; i++) {
+      audio_stage_t *stage = next->slots[i];
+      if (stage && stage->reset && !chain_contains(previous, stage)) {
+        stage->reset(stage->state);
+      }
+    }
+    pipeline->active = next;
+    pipeline->swaps++;
+  }
+
+  const audio_chain_t *chain = pipeline->active;
+  size_t slots = chain->count;
+  if (previous && previous->count > slots) {
+    slots = previous->count;
+  }
+
+  const void *current = in;
+  audio_format_t format = pipeline->in_format;
+  for (size_t i = 0; i < slots; i++) {
+    audio_stage_t *stage = i < chain->count ? chain->slots[i] : NULL;
+    audio_stage_t *old = stage;
+    if (previous) {
+      old = i < previous->count ? previous->slots[i] : NULL;
+    }
+
+    if (stage == old) {
+      if (stage) {
+        uint8_t *out = free_buffer(pipeline, current, NULL);
+        frames = run_stage(stage, current, out, frames);
+        current = out;
+        format = stage->out_format;
+      }
+      continue;
+    }
+
+    // Swap block, slot changed: run the new variant (bypass = identity)
+    const void *fresh = current;
+    size_t fresh_frames = frames;
+    audio_format_t fresh_format = format;
+    if (stage) {
+      uint8_t *out = free_buffer(pipeline, current, NULL);
+      fresh_frames = run_stage(stage, current, out, frames);
+      fresh = out;
+      fresh_format = stage->out_format;
+    }
+
+    // and the old one, if it can still take this input and has not just
+    // moved to another slot, then fade from the old output to the new
+    bool old_fits = old ? old->in_format == format &&
+                              old->out_format == fresh_format &&
+                              !chain_contains(chain, old)
+                        : format == fresh_format;
+    if (old_fits && can_crossfade(fresh_format)) {
+      uint8_t *faded = free_buffer(pipeline, current, fresh);
+      const void *stale = current;
+      size_t stale_frames = frames;
+      if (old) {
+        stale_frames = run_stage(old, current, faded, frames);
+        stale = faded;
+      }
+      if (stale_frames == fresh_frames) {
+        // A bypassed new slot outputs the input itself, which may be the
+        // caller's buffer, so that fade lands in the old stage's buffer
+        void *out = stage ? (void *)fresh : faded;
+        crossfade(fresh_format, stale, fresh, out, fresh_frames);
+        fresh = out;
+      }
+    }
+
+    current = fresh;
+    frames = fresh_frames;
+    format = fresh_format;
+  }
+
+  *out_frames = frames;
+  return current;
+}
+
+void audio_pipeline_reset_timing(const audio_chain_t *chain) {
+  for (size_t i = 0; i < chain->count; i++) {
+    audio_stage_t *stage = chain->slots[i];
+    if (stage) {
+      stage->calls = 0;
+      stage->last_ticks = 0;
+      stage->max_ticks = 0;
+      stage->total_ticks = 0;
+    }
+  }
+}
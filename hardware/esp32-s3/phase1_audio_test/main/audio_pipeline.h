@@ -0,0 +1,104 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Statically allocated DSP chains for block-based audio.
+//
+// A stage is a process function plus its state struct and the formats and
+// block size it accepts; stage instances are set up once (see
+// audio_stages.h) and live as long as the firmware. A chain is a fixed list
+// of slots, each holding a stage or NULL for "bypassed". The pipeline owns
+// the ping-pong buffers a chain runs through, so after init nothing is ever
+// allocated.
+//
+// Chains are checked before they run: every slot must accept what the slot
+// before it produces, and every output must fit a pipeline buffer.
+//
+// audio_pipeline_swap() may be called from any task. The processing task
+// picks the new chain up at its next block boundary and runs that one
+// block through both chains, crossfading each slot that changed from the
+// old stage's output to the new one's (unchanged slots run once), so
+// turning a stage on or off or replacing it never clicks. Stages entering
+// the chain are reset first so they do not replay stale history.
+//
+// Every stage call is timed: CPU cycles on the ESP32-S3, nanoseconds on the
+// linux host target.
+
+#define AUDIO_PIPELINE_MAX_STAGES 8
+#define AUDIO_PIPELINE_BUFFER_BYTES 4096 // 512 frames of stereo int32
+
+typedef enum {
+  AUDIO_FORMAT_S16_MONO = 0,
+  AUDIO_FORMAT_S16_STEREO, // Interleaved
+  AUDIO_FORMAT_S32_MONO,
+  AUDIO_FORMAT_S32_STEREO, // Interleaved, e.g. raw I2S slots
+  AUDIO_FORMAT_U8_MONO,    // PWM duty
+  AUDIO_FORMAT_BYTES,      // Encoded, "frames" count bytes
+} audio_format_t;
+
+// Returns the number of output frames written
+typedef size_t (*audio_stage_process_t)(void *state, const void *in,
+                                        void *out, size_t frames);
+
+typedef struct {
+  const char *name;
+  audio_format_t in_format;
+  audio_format_t out_format;
+  uint16_t block_frames; // Input frames per call, 0 accepts any count
+  void *state;
+  audio_stage_process_t process;
+  void (*reset)(void *state); // Optional
+  // Output frames for `frames` of input; NULL means the same count
+  size_t (*max_output)(const void *state, size_t frames);
+
+  // Timing, written by the processing task only
+  uint32_t calls;
+  uint32_t last_ticks;
+  uint32_t max_ticks;
+  uint64_t total_ticks;
+} audio_stage_t;
+
+typedef struct {
+  audio_stage_t *slots[AUDIO_PIPELINE_MAX_STAGES]; // NULL = bypassed
+  size_t count;
+} audio_chain_t;
+
+typedef struct {
+  audio_format_t in_format;
+  size_t block_frames; // Frames per audio_pipeline_process() call
+  const audio_chain_t *active;
+  _Atomic(const audio_chain_t *) pending;
+  uint32_t swaps;
+  uint8_t buffers[3][AUDIO_PIPELINE_BUFFER_BYTES] __attribute__((aligned(16)));
+} audio_pipeline_t;
+
+size_t audio_format_frame_bytes(audio_format_t format);
+
+esp_err_t audio_pipeline_init(audio_pipeline_t *pipeline,
+                              audio_format_t in_format, size_t block_frames,
+                              const audio_chain_t *chain);
+
+// Check a chain against the pipeline without running it. Stages that slot
+// in for a bypassed one must keep the format and frame count.
+esp_err_t audio_pipeline_check(const audio_pipeline_t *pipeline,
+                               const audio_chain_t *chain);
+
+// Queue `chain` to replace the active one at the next block boundary
+esp_err_t audio_pipeline_swap(audio_pipeline_t *pipeline,
+                              const audio_chain_t *chain);
+
+// Run one block (at most block_frames) through the active chain. Returns a
+// pointer to the output, valid until the next call, and its frame count.
+const void *audio_pipeline_process(audio_pipeline_t *pipeline,
+                                   const void *in, size_t frames,
+                                   size_t *out_frames);
+
+// Clear every stage's timing counters
+void audio_pipeline_reset_timing(const audio_chain_t *chain);
+
+// Cycle counter on target, monotonic nanoseconds on the host
+uint32_t audio_pipeline_ticks(void);
@@ -0,0 +1,127 @@
+#include "audio_resampler.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RESAMPLER_PASSBAND 0.9f // Fraction of the lower Nyquist kept
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// Blackman-windowed sinc prototype tap n of `total` at the upsampled rate
+static float prototype_tap(int n, int total, float cutoff) {
+  float t = n - (total - 1) * 0.5f;
+  float sinc = (t == 0.0f) ? 2.0f * cutoff
+                           : sinf(2.0f * (float)M_PI * cutoff * t) /
+                                 ((float)M_PI * t);
+  float w = 0.42f - 0.5f * cosf(2.0f * (float)M_PI * n / (total - 1)) +
+            0.08f * cosf(4.0f * (float)M_PI * n / (total - 1));
+  return sinc * w;
+}
+
+// Scale the prototype to a DC gain of L and split it into phases:
+// coeffs[p][k] = h[k * L + p]. Taps are recomputed rather than buffered to
+// keep this off the caller's stack.
+static void design_filter(audio_resampler_t *rs) {
+  const int up = rs->up;
+  const int total = up * rs->taps;
+  const int max_ratio = rs->up > rs->down ? rs->up : rs->down;
+  const float cutoff = 0.5f * RESAMPLER_PASSBAND / max_ratio; // cycles/sample
+
+  float sum = 0.0f;
+  for (int n = 0; n < total; n++) {
+    sum += prototype_tap(n, total, cutoff);
+  }
+
+  const float scale = up * 32768.0f / sum;
+  for (int p = 0; p < up; p++) {
+    for (int k = 0; k < rs->taps; k++) {
+      long q = lrintf(prototype_tap(k * up + p, total, cutoff) * scale);
+      if (q > INT16_MAX)
+        q = INT16_MAX;
+      if (q < INT16_MIN)
+        q = INT16_MIN;
+      rs->coeffs[p][k] = (int16_t)q;
+    }
+  }
+}
+
+esp_err_t audio_resampler_init(audio_resampler_t *rs, uint32_t in_rate,
+                               uint32_t out_rate, uint16_t taps_per_phase) {
+  if (!rs || in_rate == 0 || out_rate == 0 ||
+      taps_per_phase > AUDIO_RESAMPLER_MAX_TAPS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint32_t g = gcd_u32(in_rate, out_rate);
+  uint32_t up = out_rate / g;
+  uint32_t down = in_rate / g;
+  if (up > AUDIO_RESAMPLER_MAX_PHASES || down > UINT16_MAX) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  memset(rs, 0, sizeof(*rs));
+  rs->in_rate = in_rate;
+  rs->out_rate = out_rate;
+  rs->up = (uint16_t)up;
+  rs->down = (uint16_t)down;
+  rs->taps = taps_per_phase ? taps_per_phase : AUDIO_RESAMPLER_DEFAULT_TAPS;
+  design_filter(rs);
+  audio_resampler_reset(rs);
+  return ESP_OK;
+}
+
+void audio_resampler_reset(audio_resampler_t *rs) {
+  memset(rs->history, 0, sizeof(rs->history));
+  rs->phase = 0;
+  rs->pos = 0;
+}
+
+size_t audio_resampler_max_output(const audio_resampler_t *rs, size_t in_len) {
+  return (in_len * rs->up + rs->down - 1) / rs->down + 1;
+}
+
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in,
+                               size_t in_len, int16_t *out) {
+  const uint32_t taps = rs->taps;
+  uint32_t phase = rs->phase;
+  uint32_t pos = rs->pos;
+  size_t produced = 0;
+
+  for (size_t i = 0; i < in_len; i++) {
+    // Newest sample at history[pos], mirrored so history[pos..pos+taps) is
+    // always contiguous
+    pos = (pos == 0) ? taps - 1 : pos - 1;
+    rs->history[pos] = in[i];
+    rs->history[pos + taps] = in[i];
+    const int16_t *window = &rs->history[pos];
+
+    while (phase < rs->up) {
+      // Per-phase coefficient magnitudes sum to ~1.2 in Q15, so a 32-bit
+      // accumulator cannot overflow for full-scale input
+      const int16_t *h = rs->coeffs[phase];
+      int32_t acc = 1 << 14; // Rounding
+      for (uint32_t k = 0; k < taps; k++) {
+        acc += (int32_t)h[k] * window[k];
+      }
+      acc >>= 15;
+      if (acc > INT16_MAX)
+        acc = INT16_MAX;
+      if (acc < INT16_MIN)
+        acc = INT16_MIN;
+      out[produced++] = (int16_t)acc;
+      phase += rs->down;
+    }
+    phase -= rs->up;
+  }
+
+  rs->phase = (uint16_t)phase;
+  rs->pos = (uint16_t)pos;
+  return produced;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming fixed-point polyphase resampler for mono pcm16.
+//
+// Converts by the rational ratio L/M (in_rate * L / M == out_rate, reduced by
+// their gcd) with a Blackman-windowed sinc prototype split into L phases.
+// All state, including the Q15 coefficient table, lives inside
+// audio_resampler_t so it can sit in static storage; nothing is allocated.
+// Coefficients are designed in floating point once at init, processing is
+// integer only. Output is produced sample-synchronously, so the only latency
+// is the filter group delay of taps_per_phase / 2 input samples.
+
+#define AUDIO_RESAMPLER_MAX_PHASES 16
+#define AUDIO_RESAMPLER_MAX_TAPS 32 // Per phase
+#define AUDIO_RESAMPLER_DEFAULT_TAPS 24
+
+typedef struct {
+  uint32_t in_rate;
+  uint32_t out_rate;
+  uint16_t up;    // L
+  uint16_t down;  // M
+  uint16_t taps;  // Taps per phase
+  uint16_t phase; // Output phase accumulator, advances by M per output
+  uint16_t pos;   // Newest sample index in history
+  int16_t coeffs[AUDIO_RESAMPLER_MAX_PHASES][AUDIO_RESAMPLER_MAX_TAPS];
+  int16_t history[2 * AUDIO_RESAMPLER_MAX_TAPS]; // Mirrored for contiguity
+} audio_resampler_t;
+
+// taps_per_phase == 0 selects AUDIO_RESAMPLER_DEFAULT_TAPS. Returns
+// ESP_ERR_NOT_SUPPORTED if the reduced ratio needs more than
+// AUDIO_RESAMPLER_MAX_PHASES phases (e.g. 44.1k -> 16k).
+esp_err_t audio_resampler_init(audio_resampler_t *rs, uint32_t in_rate,
+                               uint32_t out_rate, uint16_t taps_per_phase);
+void audio_resampler_reset(audio_resampler_t *rs);
+
+// Upper bound on output samples for `in_len` input samples
+size_t audio_resampler_max_output(const audio_resampler_t *rs, size_t in_len);
+
+// Consume all `in_len` samples and return the number written to `out`.
+// `out` must hold audio_resampler_max_output(rs, in_len) samples.
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in,
+                               size_t in_len, int16_t *out);
+
+// Input samples of delay introduced by the filter
+static inline uint32_t audio_resampler_delay(const audio_resampler_t *rs) {
+  return rs->taps / 2;
+}
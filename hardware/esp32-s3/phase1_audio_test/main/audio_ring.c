@@ -0,0 +1,148 @@
+#include "audio_ring.h"
+
+#include "esp_heap_caps.h"
+#include <string.h>
+
+esp_err_t audio_ring_init(audio_ring_t *ring, void *storage, size_t capacity) {
+  if (!ring || !storage || capacity == 0 || (capacity & (capacity - 1))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  ring->buffer = (uint8_t *)storage;
+  ring->capacity = capacity;
+  ring->mask = capacity - 1;
+  ring->caps = 0;
+  audio_ring_reset(ring);
+  return ESP_OK;
+}
+
+esp_err_t audio_ring_create(audio_ring_t *ring, size_t capacity,
+                            uint32_t caps) {
+  void *storage =
+      heap_caps_aligned_alloc(AUDIO_RING_CACHE_LINE, capacity, caps);
+  if (!storage) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t ret = audio_ring_init(ring, storage, capacity);
+  if (ret != ESP_OK) {
+    heap_caps_free(storage);
+    return ret;
+  }
+  ring->caps = caps;
+  return ESP_OK;
+}
+
+void audio_ring_free(audio_ring_t *ring) {
+  if (ring->caps) {
+    heap_caps_free(ring->buffer);
+  }
+  ring->buffer = NULL;
+  ring->capacity = 0;
+}
+
+void audio_ring_reset(audio_ring_t *ring) {
+  atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+  ring->cached_head = 0;
+  ring->cached_tail = 0;
+}
+
+size_t audio_ring_free_space(audio_ring_t *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return ring->capacity - (head - ring->cached_tail);
+}
+
+size_t audio_ring_write_reserve(audio_ring_t *ring, void **region) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t offset = head & ring->mask;
+  size_t contiguous = ring->capacity - offset;
+
+  // Only refresh the consumer index when the cached view looks too small
+  size_t space = ring->capacity - (head - ring->cached_tail);
+  if (space < contiguous) {
+    ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    space = ring->capacity - (head - ring->cached_tail);
+  }
+
+  *region = ring->buffer + offset;
+  return space < contiguous ? space : contiguous;
+}
+
+void audio_ring_write_commit(audio_ring_t *ring, size_t len) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+size_t audio_ring_write(audio_ring_t *ring, const void *data, size_t len) {
+  const uint8_t *src = (const uint8_t *)data;
+  size_t written = 0;
+
+  // At most two passes: up to the wrap point, then from the start
+  for (int pass = 0; pass < 2 && written < len; pass++) {
+    void *region;
+    size_t avail = audio_ring_write_reserve(ring, &region);
+    size_t chunk = len - written < avail ? len - written : avail;
+    if (chunk == 0) {
+      break;
+    }
+    memcpy(region, src + written, chunk);
+    audio_ring_write_commit(ring, chunk);
+    written += chunk;
+  }
+  return written;
+}
+
+size_t audio_ring_used(audio_ring_t *ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return ring->cached_head - tail;
+}
+
+size_t audio_ring_used_approx(const audio_ring_t *ring) {
+  // Tail first: head only grows, so the difference cannot go negative,
+  // but the consumer may have made room that is already refilled
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  size_t used = head - tail;
+  return used < ring->capacity ? used : ring->capacity;
+}
+
+size_t audio_ring_read_peek(audio_ring_t *ring, const void **region) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t offset = tail & ring->mask;
+  size_t contiguous = ring->capacity - offset;
+
+  size_t used = ring->cached_head - tail;
+  if (used < contiguous) {
+    ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    used = ring->cached_head - tail;
+  }
+
+  *region = ring->buffer + offset;
+  return used < contiguous ? used : contiguous;
+}
+
+void audio_ring_read_release(audio_ring_t *ring, size_t len) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+size_t audio_ring_read(audio_ring_t *ring, void *data, size_t len) {
+  uint8_t *dst = (uint8_t *)data;
+  size_t read = 0;
+
+  for (int pass = 0; pass < 2 && read < len; pass++) {
+    const void *region;
+    size_t avail = audio_ring_read_peek(ring, &region);
+    size_t chunk = len - read < avail ? len - read : avail;
+    if (chunk == 0) {
+      break;
+    }
+    memcpy(dst + read, region, chunk);
+    audio_ring_read_release(ring, chunk);
+    read += chunk;
+  }
+  return read;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer/single-consumer byte ring for the audio sample path.
+//
+// Wait-free on both sides: the producer only writes `head`, the consumer only
+// writes `tail`, and each side keeps a cached copy of the other's index so
+// the shared line is only touched when the cached view runs out. Indices are
+// free-running and the capacity is a power of two, so full/empty never need
+// a spare slot.
+//
+// Producers can write in place with audio_ring_write_reserve() /
+// audio_ring_write_commit() (e.g. i2s_channel_read straight into the ring),
+// consumers can read in place with audio_ring_read_peek() /
+// audio_ring_read_release().
+
+#ifdef CONFIG_ESP32S3_DATA_CACHE_LINE_SIZE
+#define AUDIO_RING_CACHE_LINE CONFIG_ESP32S3_DATA_CACHE_LINE_SIZE
+#else
+#define AUDIO_RING_CACHE_LINE 64 // linux host
+#endif
+
+typedef struct {
+  // Producer side
+  _Alignas(AUDIO_RING_CACHE_LINE) atomic_size_t head;
+  size_t cached_tail;
+
+  // Consumer side
+  _Alignas(AUDIO_RING_CACHE_LINE) atomic_size_t tail;
+  size_t cached_head;
+
+  // Read-only after init
+  _Alignas(AUDIO_RING_CACHE_LINE) uint8_t *buffer;
+  size_t capacity; // Power of two
+  size_t mask;
+  uint32_t caps; // Heap caps when owned by the ring, 0 for caller storage
+} audio_ring_t;
+
+// Initialize a ring over caller-provided storage. `capacity` must be a power
+// of two; storage should be aligned to AUDIO_RING_CACHE_LINE.
+esp_err_t audio_ring_init(audio_ring_t *ring, void *storage, size_t capacity);
+
+// Allocate ring storage with heap_caps_malloc, e.g. MALLOC_CAP_DMA for an
+// I2S read target or MALLOC_CAP_SPIRAM for long history buffers.
+esp_err_t audio_ring_create(audio_ring_t *ring, size_t capacity,
+                            uint32_t caps);
+void audio_ring_free(audio_ring_t *ring);
+
+// Only safe while neither side is running
+void audio_ring_reset(audio_ring_t *ring);
+
+// Producer API
+size_t audio_ring_free_space(audio_ring_t *ring);
+size_t audio_ring_write_reserve(audio_ring_t *ring, void **region);
+void audio_ring_write_commit(audio_ring_t *ring, size_t len);
+size_t audio_ring_write(audio_ring_t *ring, const void *data, size_t len);
+
+// Consumer API
+size_t audio_ring_used(audio_ring_t *ring);
+size_t audio_ring_read_peek(audio_ring_t *ring, const void **region);
+void audio_ring_read_release(audio_ring_t *ring, size_t len);
+size_t audio_ring_read(audio_ring_t *ring, void *data, size_t len);
+
+// Any task, e.g. a stats logger: bytes queued, from the two indices alone.
+// Writes nothing, so it never disturbs either side, but the fill may have
+// moved by the time it returns.
+size_t audio_ring_used_approx(const audio_ring_t *ring);
@@ -0,0 +1,53 @@
+#include "audio_sdm.h"
+
+#include <string.h>
+
+#define SDM_FULL_SCALE 32768 // Feedback level, +-1.0 in Q15
+#define SDM_INPUT_GAIN 28672 // 7/8 in Q15
+#define SDM_DITHER_SHIFT 20  // Uniform dither of +-FS/16 (2^32 >> 20 / 2)
+#define OSR_SHIFT 6          // log2(AUDIO_SDM_OSR)
+
+_Static_assert(AUDIO_SDM_OSR == 1 << OSR_SHIFT, "OSR_SHIFT out of date");
+
+void audio_sdm_reset(audio_sdm_t *sdm) {
+  memset(sdm, 0, sizeof(*sdm));
+  sdm->noise = 1;
+}
+
+void audio_sdm_modulate(audio_sdm_t *sdm, const int16_t *in, size_t n,
+                        uint32_t *out) {
+  int32_t x1 = sdm->x1;
+  int32_t x2 = sdm->x2;
+  int32_t last = sdm->last;
+  uint32_t noise = sdm->noise;
+  int32_t dither = sdm->dither;
+
+  for (size_t i = 0; i < n; i++) {
+    int32_t next = (in[i] * SDM_INPUT_GAIN) >> 15;
+    // Input ramps from `last` to `next` in Q6 steps across the bits
+    int32_t u = last << OSR_SHIFT;
+    int32_t step = next - last;
+    for (int w = 0; w < AUDIO_SDM_WORDS_PER_SAMPLE; w++) {
+      uint32_t word = 0;
+      for (int b = 0; b < 32; b++) {
+        noise = noise * 1664525u + 1013904223u;
+        int32_t uniform = (int32_t)noise >> SDM_DITHER_SHIFT;
+        int32_t v = x2 + uniform - dither >= 0 ? SDM_FULL_SCALE
+                                                : -SDM_FULL_SCALE;
+        dither = uniform;
+        word = (word << 1) | (v > 0);
+        u += step;
+        x1 += (u >> OSR_SHIFT) - v;
+        x2 += x1 - v;
+      }
+      *out++ = word;
+    }
+    last = next;
+  }
+
+  sdm->x1 = x1;
+  sdm->x2 = x2;
+  sdm->last = last;
+  sdm->noise = noise;
+  sdm->dither = dither;
+}
@@ -0,0 +1,252 @@
+#include "audio_stages.h"
+
+#include "audio_convert.h"
+#include "audio_kernels.h"
+#include <math.h>
+#include <string.h>
+
+#define DC_BLOCK_POLE 0.995f
+
+static void describe(audio_stage_t *stage, const char *name,
+                     audio_format_t in_format, audio_format_t out_format,
+                     uint16_t block_frames, void *state,
+                     audio_stage_process_t process,
+                     void (*reset)(void *state)) {
+  memset(stage, 0, sizeof(*stage));
+  stage->name = name;
+  stage->in_format = in_format;
+  stage->out_format = out_format;
+  stage->block_frames = block_frames;
+  stage->state = state;
+  stage->process = process;
+  stage->reset = reset;
+}
+
+static inline int16_t sat16(int32_t x) {
+  if (x > INT16_MAX)
+    return INT16_MAX;
+  if (x < INT16_MIN)
+    return INT16_MIN;
+  return (int16_t)x;
+}
+
+// Mixers
+
+static size_t mix16_process(void *state, const void *in, void *out,
+                            size_t frames) {
+  return audio_convert_stereo32_to_mono16(in, out, frames * 2);
+}
+
+void audio_stage_mix16(audio_stage_t *stage) {
+  describe(stage, "mix16", AUDIO_FORMAT_S32_STEREO, AUDIO_FORMAT_S16_MONO, 0,
+           NULL, mix16_process, NULL);
+}
+
+static size_t mix32_process(void *state, const void *in, void *out,
+                            size_t frames) {
+  return audio_convert_stereo32_to_mono32(in, out, frames * 2);
+}
+
+void audio_stage_mix32(audio_stage_t *stage) {
+  describe(stage, "mix32", AUDIO_FORMAT_S32_STEREO, AUDIO_FORMAT_S32_MONO, 0,
+           NULL, mix32_process, NULL);
+}
+
+// Narrows into the output buffer, then beamforms it in place; the stereo
+// pcm16 block is half the size of the pcm32 input so it always fits
+static size_t beamformer_process(void *state, const void *in, void *out,
+                                 size_t frames) {
+  audio_kernel_narrow_s32_s16(in, out, frames * 2, 16);
+  audio_beamformer_process(state, out, out, frames);
+  return frames;
+}
+
+void audio_stage_beamformer(audio_stage_t *stage, audio_beamformer_t *bf) {
+  describe(stage, "beam", AUDIO_FORMAT_S32_STEREO, AUDIO_FORMAT_S16_MONO, 0,
+           bf, beamformer_process, NULL);
+}
+
+// DC removal: y[n] = x[n] - x[n-1] + a * y[n-1]
+
+static void dc_block_reset(void *state) {
+  audio_dc_block_t *dc = state;
+  dc->x1 = 0;
+  dc->y1 = 0;
+}
+
+static size_t dc_block_process(void *state, const void *in, void *out,
+                               size_t frames) {
+  audio_dc_block_t *dc = state;
+  const int16_t *x = in;
+  int16_t *y = out;
+  int32_t x1 = dc->x1;
+  int32_t y1 = dc->y1;
+  for (size_t i = 0; i < frames; i++) {
+    y1 = ((x[i] - x1) << 8) + (int32_t)(((int64_t)y1 * dc->coef) >> 15);
+    x1 = x[i];
+    y[i] = sat16((y1 + 128) >> 8);
+  }
+  dc->x1 = x1;
+  dc->y1 = y1;
+  return frames;
+}
+
+void audio_stage_dc_block(audio_stage_t *stage, audio_dc_block_t *state) {
+  state->coef = (int16_t)lrintf(DC_BLOCK_POLE * 32768.0f);
+  dc_block_reset(state);
+  describe(stage, "dc", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO, 0,
+           state, dc_block_process, dc_block_reset);
+}
+
+static size_t gain_process(void *state, const void *in, void *out,
+                           size_t frames) {
+  const audio_gain_t *gain = state;
+  audio_kernel_gain_s16(in, out, frames, gain->gain, gain->shift);
+  return frames;
+}
+
+void audio_stage_gain(audio_stage_t *stage, audio_gain_t *state) {
+  describe(stage, "gain", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO, 0,
+           state, gain_process, NULL);
+}
+
+// Echo cancellation, one AEC block per call so the reference is consumed
+// in step with the microphone
+
+static void aec_reset(void *state) {
+  audio_aec_reset(((audio_aec_stage_t *)state)->aec);
+}
+
+static size_t aec_process(void *state, const void *in, void *out,
+                          size_t frames) {
+  audio_aec_stage_t *stage = state;
+  audio_aec_process(stage->aec, in, stage->far, out, frames);
+  stage->far += frames;
+  return frames;
+}
+
+void audio_stage_aec(audio_stage_t *stage, audio_aec_stage_t *state) {
+  describe(stage, "aec", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO,
+           AUDIO_AEC_BLOCK, state, aec_process, aec_reset);
+}
+
+static void ns_reset(void *state) { audio_ns_reset(state); }
+
+static size_t ns_process(void *state, const void *in, void *out,
+                         size_t frames) {
+  audio_ns_process(state, in, out, frames);
+  return frames;
+}
+
+void audio_stage_ns(audio_stage_t *stage, audio_ns_t *ns) {
+  describe(stage, "ns", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO, 0, ns,
+           ns_process, ns_reset);
+}
+
+static void agc_reset(void *state) { audio_agc_reset(state); }
+
+static size_t agc_s16_process(void *state, const void *in, void *out,
+                              size_t frames) {
+  audio_agc_process_s16(state, in, out, frames);
+  return frames;
+}
+
+void audio_stage_agc_s16(audio_stage_t *stage, audio_agc_t *agc) {
+  describe(stage, "agc", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO, 0, agc,
+           agc_s16_process, agc_reset);
+}
+
+static size_t agc_s32_process(void *state, const void *in, void *out,
+                              size_t frames) {
+  audio_agc_process_s32(state, in, out, frames);
+  return frames;
+}
+
+void audio_stage_agc_s32(audio_stage_t *stage, audio_agc_t *agc) {
+  describe(stage, "agc32", AUDIO_FORMAT_S32_MONO, AUDIO_FORMAT_S16_MONO, 0,
+           agc, agc_s32_process, agc_reset);
+}
+
+// Level meter, passes the block through
+
+static void meter_reset(void *state) {
+  audio_meter_t *meter = state;
+  meter->peak_dbfs = -96.0f;
+  meter->rms_dbfs = -96.0f;
+}
+
+static size_t meter_process(void *state, const void *in, void *out,
+                            size_t frames) {
+  audio_meter_t *meter = state;
+  const int16_t *x = in;
+  int32_t peak = 0;
+  int64_t energy = 0;
+  for (size_t i = 0; i < frames; i++) {
+    int32_t s = x[i];
+    energy += s * s;
+    if (s < 0)
+      s = -s;
+    if (s > peak)
+      peak = s;
+  }
+  memcpy(out, in, frames * sizeof(int16_t));
+
+  if (frames > 0) {
+    float mean_square = (float)energy / frames;
+    meter->rms_dbfs =
+        10.0f * log10f(mean_square / (32768.0f * 32768.0f) + 1e-10f);
+    meter->peak_dbfs = 20.0f * log10f(peak / 32768.0f + 1e-5f);
+  }
+  return frames;
+}
+
+void audio_stage_meter(audio_stage_t *stage, audio_meter_t *state) {
+  meter_reset(state);
+  describe(stage, "meter", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO, 0,
+           state, meter_process, meter_reset);
+}
+
+static void resample_reset(void *state) { audio_resampler_reset(state); }
+
+static size_t resample_max_output(const void *state, size_t frames) {
+  return audio_resampler_max_output(state, frames);
+}
+
+static size_t resample_process(void *state, const void *in, void *out,
+                               size_t frames) {
+  return audio_resampler_process(state, in, frames, out);
+}
+
+void audio_stage_resample(audio_stage_t *stage, audio_resampler_t *rs) {
+  describe(stage, "resample", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_S16_MONO, 0,
+           rs, resample_process, resample_reset);
+  stage->max_output = resample_max_output;
+}
+
+static void adpcm_reset(void *state) { audio_adpcm_reset(state); }
+
+static size_t adpcm_max_output(const void *state, size_t frames) {
+  return AUDIO_ADPCM_FRAME_BYTES(frames);
+}
+
+static size_t adpcm_process(void *state, const void *in, void *out,
+                            size_t frames) {
+  return audio_adpcm_encode_frame(state, in, frames, out);
+}
+
+void audio_stage_adpcm(audio_stage_t *stage, audio_adpcm_state_t *state) {
+  describe(stage, "adpcm", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_BYTES, 0,
+           state, adpcm_process, adpcm_reset);
+  stage->max_output = adpcm_max_output;
+}
+
+static size_t to_u8_process(void *state, const void *in, void *out,
+                            size_t frames) {
+  audio_kernel_s16_to_u8(in, out, frames);
+  return frames;
+}
+
+void audio_stage_to_u8(audio_stage_t *stage) {
+  describe(stage, "u8", AUDIO_FORMAT_S16_MONO, AUDIO_FORMAT_U8_MONO, 0, NULL,
+           to_u8_process, NULL);
+}
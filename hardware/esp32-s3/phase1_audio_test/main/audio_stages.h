@@ -0,0 +1,70 @@
+#pragma once
+
+#include "audio_adpcm.h"
+#include "audio_aec.h"
+#include "audio_agc.h"
+#include "audio_beamformer.h"
+#include "audio_ns.h"
+#include "audio_pipeline.h"
+#include "audio_resampler.h"
+
+// Pipeline stages built from the audio_* blocks.
+//
+// Each audio_stage_*() fills in a stage descriptor around a state struct
+// the caller owns. Wrapped modules must already be initialised
+// (audio_ns_init() and so on); the stage only borrows them and they keep
+// their own APIs, so settings such as the NS level or AGC target are still
+// changed on the state directly, from the task that runs the pipeline.
+// dc_block and meter state is set up by its factory; gain takes the
+// caller's values.
+//
+//   stage            in           out          block  notes
+//   mix16            S32_STEREO   S16_MONO     any    (L + R) / 2 >> 16
+//   mix32            S32_STEREO   S32_MONO     any    (L >> 1) + (R >> 1)
+//   beamformer       S32_STEREO   S16_MONO     any    narrow, then steer
+//   dc_block         S16_MONO     S16_MONO     any    one-pole high-pass
+//   gain             S16_MONO     S16_MONO     any    Q15 gain kernel
+//   aec              S16_MONO     S16_MONO     128    `far` set per block
+//   ns               S16_MONO     S16_MONO     any    16ms latency
+//   agc_s16          S16_MONO     S16_MONO     any    2ms latency
+//   agc_s32          S32_MONO     S16_MONO     any
+//   meter            S16_MONO     S16_MONO     any    peak/RMS, copies
+//   resample         S16_MONO     S16_MONO     any    frames change
+//   adpcm            S16_MONO     BYTES        any    one frame per call
+//   to_u8            S16_MONO     U8_MONO      any    PWM duty
+
+typedef struct {
+  int16_t coef; // Q15 pole, 0.995 is ~13Hz at 16kHz
+  int32_t x1;   // Previous input
+  int32_t y1;   // Previous output, Q8 so the pole does not round away
+} audio_dc_block_t;
+
+typedef struct {
+  int16_t gain; // out = in * gain >> shift
+  int shift;
+} audio_gain_t;
+
+typedef struct {
+  audio_aec_t *aec;
+  const int16_t *far; // Played reference for the next samples, advanced
+                      // as they are consumed
+} audio_aec_stage_t;
+
+typedef struct {
+  float peak_dbfs; // Last block
+  float rms_dbfs;
+} audio_meter_t;
+
+void audio_stage_mix16(audio_stage_t *stage);
+void audio_stage_mix32(audio_stage_t *stage);
+void audio_stage_beamformer(audio_stage_t *stage, audio_beamformer_t *bf);
+void audio_stage_dc_block(audio_stage_t *stage, audio_dc_block_t *state);
+void audio_stage_gain(audio_stage_t *stage, audio_gain_t *state);
+void audio_stage_aec(audio_stage_t *stage, audio_aec_stage_t *state);
+void audio_stage_ns(audio_stage_t *stage, audio_ns_t *ns);
+void audio_stage_agc_s16(audio_stage_t *stage, audio_agc_t *agc);
+void audio_stage_agc_s32(audio_stage_t *stage, audio_agc_t *agc);
+void audio_stage_meter(audio_stage_t *stage, audio_meter_t *state);
+void audio_stage_resample(audio_stage_t *stage, audio_resampler_t *rs);
+void audio_stage_adpcm(audio_stage_t *stage, audio_adpcm_state_t *state);
+void audio_stage_to_u8(audio_stage_t *stage);
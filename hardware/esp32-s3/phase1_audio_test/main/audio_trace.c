@@ -0,0 +1,167 @@
+#include "audio_trace.h"
+
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define TRACE_MASK (AUDIO_TRACE_RECORDS - 1)
+
+_Static_assert((AUDIO_TRACE_RECORDS & TRACE_MASK) == 0,
+               "AUDIO_TRACE_RECORDS must be a power of two");
+_Static_assert(sizeof(audio_trace_record_t) == 24, "record is packed");
+
+typedef struct {
+  atomic_uint seq; // Index + 1 once the record is complete, 0 while written
+  audio_trace_record_t record;
+} trace_slot_t;
+
+typedef struct {
+  atomic_uint head; // Next index to reserve, any writer on the core
+  trace_slot_t slots[AUDIO_TRACE_RECORDS];
+
+  // Reader side
+  uint32_t tail;
+  uint32_t lost; // Not yet reported
+  bool has_pending;
+  audio_trace_record_t pending;
+} trace_ring_t;
+
+// Static so trace points work from the first line of app_main
+static trace_ring_t rings[AUDIO_TRACE_CORES];
+static uint32_t total_lost;
+
+void audio_trace_write(uint16_t id, uint32_t a, uint32_t b, uint32_t c,
+                       uint32_t d) {
+  uint32_t core = (uint32_t)esp_cpu_get_core_id();
+  trace_ring_t *ring = &rings[core];
+  uint32_t index =
+      atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+  trace_slot_t *slot = &ring->slots[index & TRACE_MASK];
+
+  atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot->record = (audio_trace_record_t){
+      .time_us = (uint32_t)esp_timer_get_time(),
+      .id = id,
+      .core = (uint8_t)core,
+      .args = {a, b, c, d},
+  };
+  atomic_store_explicit(&slot->seq, index + 1, memory_order_release);
+}
+
+// Oldest complete record of one ring. Stops at a record still being
+// written; records overwritten before they could be read are counted.
+static bool read_ring(trace_ring_t *ring, audio_trace_record_t *record) {
+  while (1) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == ring->tail) {
+      return false;
+    }
+    if (head - ring->tail > AUDIO_TRACE_RECORDS) {
+      ring->lost += head - ring->tail - AUDIO_TRACE_RECORDS;
+      ring->tail = head - AUDIO_TRACE_RECORDS;
+    }
+
+    trace_slot_t *slot = &ring->slots[ring->tail & TRACE_MASK];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != ring->tail + 1) {
+      if ((int32_t)(seq - (ring->tail + 1)) < 0) {
+        return false; // Not finished yet
+      }
+      ring->lost++; // A writer lapped the reader
+      ring->tail++;
+      continue;
+    }
+    *record = slot->record;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+      ring->lost++; // Overwritten while copying
+      ring->tail++;
+      continue;
+    }
+    ring->tail++;
+    return true;
+  }
+}
+
+bool audio_trace_read(audio_trace_record_t *record) {
+  trace_ring_t *oldest = NULL;
+  for (int core = 0; core < AUDIO_TRACE_CORES; core++) {
+    trace_ring_t *ring = &rings[core];
+    if (!ring->has_pending) {
+      ring->has_pending = read_ring(ring, &ring->pending);
+    }
+    if (ring->lost > 0) {
+      *record = (audio_trace_record_t){
+          .time_us = (uint32_t)esp_timer_get_time(),
+          .id = AUDIO_TRACE_ID_LOST,
+          .core = (uint8_t)core,
+          .args = {ring->lost, (uint32_t)core},
+      };
+      total_lost += ring->lost;
+      ring->lost = 0;
+      return true;
+    }
+    if (ring->has_pending &&
+        (!oldest ||
+         (int32_t)(ring->pending.time_us - oldest->pending.time_us) < 0)) {
+      oldest = ring;
+    }
+  }
+  if (!oldest) {
+    return false;
+  }
+  *record = oldest->pending;
+  oldest->has_pending = false;
+  return true;
+}
+
+size_t audio_trace_print(FILE *out, size_t max_records) {
+  static const char hex[] = "0123456789abcdef";
+  // "@AT1 ", two digits per byte, checksum, newline
+  char line[5 + 2 * (AUDIO_TRACE_LINE_RECORDS *
+                         sizeof(audio_trace_record_t) +
+                     1) +
+            1];
+  size_t total = 0;
+
+  while (total < max_records) {
+    uint8_t sum = 0;
+    memcpy(line, "@AT1 ", 5);
+    size_t len = 5;
+    size_t n = 0;
+    audio_trace_record_t record;
+    while (n < AUDIO_TRACE_LINE_RECORDS && total + n < max_records &&
+           audio_trace_read(&record)) {
+      const uint8_t *bytes = (const uint8_t *)&record;
+      for (size_t i = 0; i < sizeof(record); i++) {
+        line[len++] = hex[bytes[i] >> 4];
+        line[len++] = hex[bytes[i] & 15];
+        sum += bytes[i];
+      }
+      n++;
+    }
+    if (n == 0) {
+      break;
+    }
+    line[len++] = hex[sum >> 4];
+    line[len++] = hex[sum & 15];
+    line[len++] = '\n';
+    fwrite(line, 1, len, out);
+    total += n;
+  }
+  if (total > 0) {
+    fflush(out);
+  }
+  return total;
+}
+
+void audio_trace_get_stats(audio_trace_stats_t *stats) {
+  stats->written = 0;
+  for (int core = 0; core < AUDIO_TRACE_CORES; core++) {
+    stats->written += atomic_load_explicit(&rings[core].head,
+                                           memory_order_relaxed);
+  }
+  stats->lost = total_lost;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "audio_trace_events.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Deferred binary trace for the real-time paths.
+//
+// A trace point stores a 24-byte record (timestamp, event id, core, four
+// 32-bit arguments) in a ring owned by the calling core and returns; it
+// never formats, locks or blocks, so it is safe from any task or ISR (but
+// not from IRAM ISRs that run while the flash cache is off). The records
+// are drained later by a low-priority task, or dumped on request, as hex
+// lines tagged "@AT1" on the console, and host/trace_decode turns them
+// back into text using the formats in audio_trace_events.h.
+//
+// Writers reserve a slot with one atomic increment, so tasks that migrate
+// or preempt each other on a core are fine. When a core's ring is full the
+// oldest records are overwritten, and the drain reports how many it missed.
+// A single task may drain.
+//
+// AUDIO_TRACE_LEVEL filters at compile time: trace points of events above
+// it compile to nothing, arguments included.
+
+#define AUDIO_TRACE_ERROR 1
+#define AUDIO_TRACE_WARN 2
+#define AUDIO_TRACE_INFO 3
+#define AUDIO_TRACE_DEBUG 4
+#define AUDIO_TRACE_VERBOSE 5
+
+#ifndef AUDIO_TRACE_LEVEL
+#define AUDIO_TRACE_LEVEL AUDIO_TRACE_DEBUG
+#endif
+
+#define AUDIO_TRACE_RECORDS 256 // Per core, power of two
+#define AUDIO_TRACE_CORES 2
+#define AUDIO_TRACE_LINE_RECORDS 8 // Records per console line
+
+typedef struct {
+  uint32_t time_us; // esp_timer_get_time(), wraps every 71 minutes
+  uint16_t id;
+  uint8_t core;
+  uint8_t reserved;
+  uint32_t args[4];
+} audio_trace_record_t;
+
+#define AUDIO_TRACE_ID(name, level, format) AUDIO_TRACE_ID_##name,
+typedef enum {
+  AUDIO_TRACE_EVENTS(AUDIO_TRACE_ID) AUDIO_TRACE_EVENT_COUNT
+} audio_trace_id_t;
+#undef AUDIO_TRACE_ID
+
+#define AUDIO_TRACE_LEVEL_OF(name, level, format)                              \
+  AUDIO_TRACE_LEVEL_##name = AUDIO_TRACE_##level,
+enum { AUDIO_TRACE_EVENTS(AUDIO_TRACE_LEVEL_OF) };
+#undef AUDIO_TRACE_LEVEL_OF
+
+// AUDIO_TRACE(I2S_READ, reads, bytes): one to four integer arguments
+#define AUDIO_TRACE(name, ...)                                                 \
+  do {                                                                         \
+    if (AUDIO_TRACE_LEVEL_##name <= AUDIO_TRACE_LEVEL) {                       \
+      audio_trace_write(AUDIO_TRACE_ID_##name,                                 \
+                        AUDIO_TRACE_ARGS4(__VA_ARGS__, 0, 0, 0, 0));           \
+    }                                                                          \
+  } while (0)
+#define AUDIO_TRACE_ARGS4(a, b, c, d, ...)                                     \
+  (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)
+
+void audio_trace_write(uint16_t id, uint32_t a, uint32_t b, uint32_t c,
+                       uint32_t d);
+
+// Next record in time order across the cores, false when there is none.
+// Reports missed records as a LOST record first.
+bool audio_trace_read(audio_trace_record_t *record);
+
+// Drain up to `max_records` as "@AT1 <hex>" lines to `out`, one write per
+// line so other console output does not split them. Returns the records
+// written.
+size_t audio_trace_print(FILE *out, size_t max_records);
+
+typedef struct {
+  uint32_t written;
+  uint32_t lost;
+} audio_trace_stats_t;
+
+void audio_trace_get_stats(audio_trace_stats_t *stats);
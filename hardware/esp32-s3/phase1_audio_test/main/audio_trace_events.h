@@ -0,0 +1,18 @@
+#pragma once
+
+// Trace points of the phase 1 firmware: X(name, level, format).
+//
+// The format is only ever applied by host/trace_decode, which includes this
+// file, so it is free to be verbose. Each argument is one 32-bit value
+// printed with %u, %d or %x; ids are positions in this list, so add new
+// events at the end and keep the decoder built from the same revision.
+#define AUDIO_TRACE_EVENTS(X)                                                  \
+  X(LOST, WARN, "%u trace records lost on core %u")                            \
+  X(I2S_READ, DEBUG, "I2S read #%u: %u bytes")                                 \
+  X(I2S_RAW, VERBOSE, "Raw samples: L0=%d R0=%d L1=%d R1=%d")                  \
+  X(AUDIO_LEVEL, INFO, "Audio level: avg=%u range=%u (min %u, max %u)")        \
+  X(LOUD_AUDIO, DEBUG, "Loud audio, duty %u")                                  \
+  X(WS_RX, DEBUG, "WebSocket rx op=%u len=%u at %u of %u")                     \
+  X(VAD, INFO, "VAD speech %u (1 start, 2 end), stream open=%u")               \
+  X(STREAM_OPEN, INFO, "Uplink open, trigger=%u backlog=%u samples")           \
+  X(STREAM_CLOSE, INFO, "Uplink closed at %u, stop=%u timeout=%u")
@@ -0,0 +1,111 @@
+#include "audio_vad.h"
+
+#include <math.h>
+#include <string.h>
+
+#define NOISE_FLOOR_INIT_DB 40.0f
+#define NOISE_FLOOR_RISE_DB 0.01f // Per sub-frame, ~1 dB/s
+#define NOISE_FLOOR_FALL 0.2f     // Fraction of the gap closed per sub-frame
+#define NOISE_FLOOR_TRACK 0.05f   // Same, up to the minimum of the last 2s
+
+void audio_vad_init(audio_vad_t *vad, uint32_t sample_rate) {
+  memset(vad, 0, sizeof(*vad));
+  vad->threshold_db = 9.0f;
+  vad->min_level_db = 30.0f;
+  vad->zcr_noisy = 0.45f;
+  vad->zcr_margin_db = 6.0f;
+  vad->onset_frames = 2;     // 20ms
+  vad->hangover_frames = 40; // 400ms
+  vad->frame_samples = sample_rate * AUDIO_VAD_FRAME_MS / 1000;
+  vad->noise_floor_db = NOISE_FLOOR_INIT_DB;
+  // The window minima start at 0 dB, below any floor, so nothing is
+  // tracked until 2s were heard
+  vad->current_min_db = INFINITY;
+}
+
+// Quietest sub-frame of the last AUDIO_VAD_MIN_WINDOWS windows
+static float track_minimum(audio_vad_t *vad, float level) {
+  if (level < vad->current_min_db) {
+    vad->current_min_db = level;
+  }
+  if (++vad->window_pos == AUDIO_VAD_MIN_WINDOW_FRAMES) {
+    vad->window_min_db[vad->window_index] = vad->current_min_db;
+    vad->window_index = (vad->window_index + 1) % AUDIO_VAD_MIN_WINDOWS;
+    vad->current_min_db = INFINITY;
+    vad->window_pos = 0;
+  }
+  float min = vad->current_min_db;
+  for (int i = 0; i < AUDIO_VAD_MIN_WINDOWS; i++) {
+    if (vad->window_min_db[i] < min) {
+      min = vad->window_min_db[i];
+    }
+  }
+  return min;
+}
+
+// Classify one finished sub-frame and update the speech state
+static void vad_frame(audio_vad_t *vad) {
+  float mean_square = (float)vad->energy / vad->frame_samples;
+  float level = 10.0f * log10f(mean_square + 1.0f);
+  float zcr = (float)vad->crossings / vad->frame_samples;
+  vad->level_db = level;
+
+  float required = vad->noise_floor_db + vad->threshold_db;
+  if (zcr > vad->zcr_noisy) {
+    required += vad->zcr_margin_db;
+  }
+  bool speech_like = level > required && level > vad->min_level_db;
+
+  // Track the floor: follow dips quickly and creep up slowly through
+  // non-speech. Speech does not raise it, except that it never stays below
+  // the quietest moment of the last 2s: that is the new background.
+  float minimum = track_minimum(vad, level);
+  if (level < vad->noise_floor_db) {
+    vad->noise_floor_db += (level - vad->noise_floor_db) * NOISE_FLOOR_FALL;
+  } else if (minimum > vad->noise_floor_db) {
+    vad->noise_floor_db += (minimum - vad->noise_floor_db) * NOISE_FLOOR_TRACK;
+  } else if (!speech_like) {
+    vad->noise_floor_db += NOISE_FLOOR_RISE_DB;
+  }
+
+  if (speech_like) {
+    vad->quiet_run = 0;
+    if (vad->speech_run < UINT16_MAX)
+      vad->speech_run++;
+    if (!vad->speech && vad->speech_run >= vad->onset_frames)
+      vad->speech = true;
+  } else {
+    vad->speech_run = 0;
+    if (vad->quiet_run < UINT16_MAX)
+      vad->quiet_run++;
+    if (vad->speech && vad->quiet_run >= vad->hangover_frames)
+      vad->speech = false;
+  }
+}
+
+audio_vad_event_t audio_vad_process(audio_vad_t *vad, const int16_t *pcm,
+                                    size_t samples) {
+  bool was_speech = vad->speech;
+
+  for (size_t i = 0; i < samples; i++) {
+    int32_t s = pcm[i];
+    vad->energy += s * s;
+    if ((s ^ vad->last_sample) < 0) {
+      vad->crossings++;
+    }
+    vad->last_sample = (int16_t)s;
+
+    if (++vad->pos == vad->frame_samples) {
+      vad_frame(vad);
+      vad->pos = 0;
+      vad->energy = 0;
+      vad->crossings = 0;
+    }
+  }
+
+  if (vad->speech == was_speech) {
+    return AUDIO_VAD_EVENT_NONE;
+  }
+  return vad->speech ? AUDIO_VAD_EVENT_SPEECH_START
+                     : AUDIO_VAD_EVENT_SPEECH_END;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming voice activity detector for mono pcm16.
+//
+// Works on 10ms sub-frames. Each sub-frame is speech-like when its energy is
+// far enough above an adaptive noise floor; noisy, high zero-crossing frames
+// (fans, hiss) need an extra margin. Speech starts after `onset_frames`
+// consecutive speech-like sub-frames and ends after `hangover_frames`
+// without one, so word gaps do not chop the stream.
+//
+// The floor follows dips at once and creeps up through non-speech. It also
+// keeps the quietest sub-frame of each of the last AUDIO_VAD_MIN_WINDOWS
+// windows (minimum statistics): speech always has gaps, so when even the
+// quietest moment of the last 2s is above the floor, the background got
+// louder (a fan switched on) and the floor moves up to it, speech or not.
+
+#define AUDIO_VAD_FRAME_MS 10
+#define AUDIO_VAD_MIN_WINDOWS 4       // Minimum over 4 x 500ms
+#define AUDIO_VAD_MIN_WINDOW_FRAMES 50
+
+typedef enum {
+  AUDIO_VAD_EVENT_NONE = 0,
+  AUDIO_VAD_EVENT_SPEECH_START,
+  AUDIO_VAD_EVENT_SPEECH_END,
+} audio_vad_event_t;
+
+typedef struct {
+  // Configuration, set by audio_vad_init() and adjustable afterwards
+  float threshold_db;       // Energy above noise floor for speech
+  float min_level_db;       // Absolute floor, dB re 1 LSB^2
+  float zcr_noisy;          // Zero-crossing rate treated as noise-like
+  float zcr_margin_db;      // Extra energy needed by noise-like frames
+  uint16_t onset_frames;    // Speech-like sub-frames to start
+  uint16_t hangover_frames; // Quiet sub-frames to end
+
+  // State
+  uint32_t frame_samples;
+  uint32_t pos; // Samples accumulated in the current sub-frame
+  int64_t energy;
+  uint32_t crossings;
+  int16_t last_sample;
+  float noise_floor_db;
+  float level_db; // Last sub-frame level, for telemetry
+  float window_min_db[AUDIO_VAD_MIN_WINDOWS]; // Quietest sub-frame in each
+  float current_min_db;  // Of the window being filled
+  uint16_t window_pos;   // Sub-frames into it
+  uint8_t window_index;  // Slot it goes to
+  uint16_t speech_run;
+  uint16_t quiet_run;
+  bool speech;
+} audio_vad_t;
+
+void audio_vad_init(audio_vad_t *vad, uint32_t sample_rate);
+
+// Feed any number of samples. Returns SPEECH_START/SPEECH_END when the
+// decision changed across this call, otherwise NONE.
+audio_vad_event_t audio_vad_process(audio_vad_t *vad, const int16_t *pcm,
+                                    size_t samples);
+
+static inline bool audio_vad_is_speech(const audio_vad_t *vad) {
+  return vad->speech;
+}
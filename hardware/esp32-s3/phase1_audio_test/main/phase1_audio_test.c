@@ -1,10 +1,11 @@
 #include "driver/i2s_std.h"
-#include "driver/ledc.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +17,36 @@
 #include "esp_wifi.h"
 #include "nvs_flash.h"
 
+// The WebSocket client must keep the rx/tx buffers it allocates at init
+// rather than calloc and free them for every message
+#if CONFIG_ESP_WS_CLIENT_ENABLE_DYNAMIC_BUFFER
+#error "Disable CONFIG_ESP_WS_CLIENT_ENABLE_DYNAMIC_BUFFER in menuconfig"
+#endif
+
+#include "audio_adpcm.h"
+#include "audio_aec.h"
+#include "audio_agc.h"
+#include "audio_arena.h"
+#include "audio_beamformer.h"
+#include "audio_bench.h"
+#include "audio_convert.h"
+#include "audio_downlink.h"
+#include "audio_frame.h"
+#include "audio_history.h"
+#include "audio_jitter.h"
+#include "audio_kernels.h"
+#include "audio_latency.h"
+#include "audio_marker.h"
+#include "audio_ns.h"
+#include "audio_opus.h"
+#include "audio_pipeline.h"
+#include "audio_resampler.h"
+#include "audio_sdm.h"
+#include "audio_stages.h"
+#include "audio_trace.h"
+#include "audio_vad.h"
+#include "audio_ring.h"
+
 static const char *TAG = "PHASE1_AUDIO_WS";
 
 // WiFi Configuration - UPDATE THESE
@@ -30,24 +61,249 @@ static const char *TAG = "PHASE1_AUDIO_WS";
 #define I2S_BCK_IO (GPIO_NUM_7)       // Serial Clock (try different pins)
 #define I2S_WS_IO (GPIO_NUM_8)        // Word Select (try different pins)
 #define I2S_DI_IO (GPIO_NUM_9)        // Serial Data (try different pins)
-#define AUDIO_OUTPUT_IO (GPIO_NUM_44) // PWM audio output
+#define MIC_SPACING_MM 50             // INMP441 pair, 40-65mm per plan.md
+#define AUDIO_OUTPUT_IO (GPIO_NUM_44) // Sigma-delta bitstream, RC to amp
+
+// Network audio, around the SAMPLE_RATE the device runs at
+#define UPLINK_SAMPLE_RATE 24000 // OpenAI Realtime pcm16 is 24kHz
+#define UPLINK_MAX_SAMPLES (AUDIO_BUFFER_SIZE / 2 * 3 / 2 + 2) // Per block
+#define DOWNLINK_SAMPLE_RATE 24000 // Server forwards Realtime pcm16 as is
+#define DOWNLINK_MAX_SAMPLES (SAMPLE_RATE * 60 / 1000) // Longest Opus frame
+#define DOWNLINK_MAX_PACKET 1276 // Largest Opus packet, reassembled if split
+
+// Voice activity gating of the uplink
+#define VAD_PREROLL_MS 300      // Sent ahead of each detected utterance
+#define VAD_THROTTLE_INTERVAL 8 // Throttle mode sends 1 in 8 quiet blocks
+
+// Rolling uplink history: triggers rewind into it and catch up
+#define HISTORY_SECONDS 10 // 320KB of processed pcm16
+#define TRIGGER_PREROLL_MS 1500 // Default history sent ahead of a trigger
+#define TRIGGER_TIMEOUT_MS 8000 // A trigger nobody speaks after ends here
+#define CATCHUP_BLOCKS 3 // Backlog blocks sent per live one, 4x real time
+
+#define AGC_TARGET_DBFS -20.0f        // Speech level the uplink settles at
+#define AEC_REFERENCE_RING_BYTES 8192 // 256ms of played pcm16 in flight
+
+// Mouth-to-ear latency test: chirps injected into the uplink, found in
+// the downlink an echo server returns
+#define MARKER_DEFAULT_COUNT 10
+#define MARKER_INTERVAL_MS 2000 // Between chirps
+#define MARKER_TIMEOUT_MS 5000  // A chirp not heard by then is lost
+#define MARKER_AMPLITUDE 8000   // About -15dBFS rms
+
+#define BEAM_OFF -1 // Plain L/R average instead of audio_beam_mode_t
 
 // Buffer Configuration
 #define DMA_BUF_COUNT 8
 #define DMA_BUF_LEN 512
+#define DMA_BUF_BYTES (DMA_BUF_LEN * 2 * sizeof(int32_t)) // Stereo frames
+#define DMA_TIME_SLOTS 16 // Completion times kept, at least DMA_BUF_COUNT
 #define AUDIO_BUFFER_SIZE 1024
 
-// PWM Configuration for audio
-#define PWM_TIMER LEDC_TIMER_0
-#define PWM_MODE LEDC_LOW_SPEED_MODE
-#define PWM_CHANNEL LEDC_CHANNEL_0
-#define PWM_FREQUENCY (SAMPLE_RATE * 2) // PWM frequency
-#define PWM_RESOLUTION LEDC_TIMER_8_BIT
+// Playback: WebSocket task -> jitter buffer (pcm16) -> playback task ->
+// sigma-delta modulator -> I2S TX DMA -> DOUT. A 32-bit stereo frame at
+// SAMPLE_RATE carries the AUDIO_SDM_OSR bits of one sample, so the I2S
+// clock is the sample clock and the CPU never touches single samples.
+#define SPEAKER_I2S_PORT I2S_NUM_1 // The microphones take I2S_NUM_0
+#define PLAYBACK_JITTER_BYTES 32768 // 1s of pcm16, room for TTS sent ahead
+#define PLAYBACK_CHUNK 128          // Samples per DMA buffer (8ms)
+#define PLAYBACK_DMA_BUFFERS 4      // 32ms queued ahead of the pin
+#define PLAYBACK_BITS_BYTES                                                    \
+  (PLAYBACK_CHUNK * AUDIO_SDM_WORDS_PER_SAMPLE * sizeof(uint32_t))
+
+// Pipeline Configuration - capture and network run on separate cores
+#define CAPTURE_TASK_CORE 1 // Keep I2S servicing away from the WiFi stack
+#define SENDER_TASK_CORE 0  // WiFi/lwIP tasks live on core 0
+#define PLAYBACK_TASK_CORE 1 // Modulates ~1Mbit/s, away from the WiFi stack
+#define CAPTURE_TASK_PRIORITY 10
+#define PLAYBACK_TASK_PRIORITY 8
+#define SENDER_TASK_PRIORITY 5
+#define TRACE_TASK_PRIORITY 1 // Prints the trace when nothing else runs
+#define BENCH_TASK_PRIORITY 1 // The main task's, which waits for it
+#define CAPTURE_TASK_STACK 4096
+#define PLAYBACK_TASK_STACK 4096
+#define TRACE_TASK_STACK 3072
+#define SENDER_TASK_STACK 32768    // libopus encodes on the sender's stack
+#define WEBSOCKET_TASK_STACK 12288 // and decodes on the WebSocket task's
+#define BENCH_TASK_STACK 32768     // and on the benchmark's, while it runs
+#define AUDIO_BLOCK_BYTES (AUDIO_BUFFER_SIZE * sizeof(int32_t))
+#define AUDIO_BLOCK_COUNT 16 // 16 x 32ms blocks = 512ms of network slack
+#define AUDIO_BLOCK_MS (AUDIO_BUFFER_SIZE / 2 * 1000 / SAMPLE_RATE)
+#define SEND_TIMEOUT_MS 100
+#define STATS_LOG_INTERVAL_MS 5000
+#define STATS_FRAME_BYTES 2048 // JSON reply to "stats"
+#define STATS_PUSH_MAX_S 3600  // Longest "stats every" period
+#define TEXT_COMMAND_MAX 64    // Longest text command, NUL included
+#define UPLINK_FRAME_BYTES (AUDIO_FRAME_HEADER_BYTES + AUDIO_BLOCK_BYTES)
+#define TRACE_DRAIN_INTERVAL_MS 250 // Trace ring holds 256 records per core
+#ifndef SENDER_STALL_TEST_MS // host/Makefile stall_test sets it
+#define SENDER_STALL_TEST_MS 0 // >0 stalls the sender every second (testing)
+#endif
+#define HEAP_STRICT_TEST 0 // 1 aborts when an audio task allocates (testing)
+
+// Uplink conditioning chain slots, mic block in, mono pcm16 out
+enum {
+  UPLINK_SLOT_FRONT = 0, // L/R average or beamformer
+  UPLINK_SLOT_DC,
+  UPLINK_SLOT_AEC, // Bypassed while AEC is off
+  UPLINK_SLOT_NS,
+  UPLINK_SLOT_AGC,
+  UPLINK_SLOT_METER,
+  UPLINK_SLOTS,
+};
+
+typedef enum {
+  VAD_MODE_OFF = 0, // Stream continuously
+  VAD_MODE_GATE,    // Send nothing outside speech
+  VAD_MODE_THROTTLE, // Send a trickle of background outside speech
+  VAD_MODE_TRIGGER   // Send nothing until a wake word or server trigger
+} vad_mode_t;
+
+// Pipeline counters - each field has a single writer
+typedef struct {
+  uint32_t blocks_captured;
+  uint32_t blocks_sent;
+  uint32_t messages_sent;    // WebSocket binary messages, catch-up included
+  uint32_t capture_overruns; // Ring full, capture data discarded
+  uint32_t sender_underruns; // Sender waited longer than 2 blocks for data
+  uint32_t i2s_overflows;    // DMA receive queue overflowed (ISR)
+  uint32_t send_failures;    // esp_websocket_client_send_bin failed
+  uint32_t blocks_gated;     // Held back by the VAD outside speech
+  uint32_t uplink_triggers;  // Wake word or server triggers
+  uint32_t reference_drops;  // Played audio the AEC reference had no room for
+  uint32_t playback_underruns; // I2S TX DMA ran out of bitstream (ISR)
+  uint32_t max_ring_fill; // Bytes
+} pipeline_stats_t;
 
 // Global handles and buffers
 static i2s_chan_handle_t rx_handle = NULL;
-static int32_t *audio_input_buffer = NULL; // 32-bit for INMP441
+static i2s_chan_handle_t tx_handle = NULL;
+static int32_t *audio_input_buffer = NULL; // Scratch read target on overrun
 static uint8_t *pwm_output_buffer = NULL;
+static audio_pipeline_t *monitor_pipeline = NULL; // Owned by the capture task
+static audio_chain_t monitor_chain;               // mix32 -> agc32 -> u8
+static struct {
+  audio_stage_t mix, agc, duty;
+} monitor_stages;
+static audio_agc_t monitor_agc;
+static audio_ring_t capture_ring;              // capture -> sender
+static TaskHandle_t sender_task_handle = NULL; // Woken on each commit
+static audio_pipeline_t *uplink_pipeline = NULL; // Owned by the sender task
+static audio_chain_t uplink_chains[2];           // Active and standby
+static struct {
+  audio_stage_t mix, beam, dc, aec, ns, agc, meter;
+} uplink_stages; // The chains pick from these per slot
+static int16_t *uplink_resampled = NULL;         // Uplink block at uplink rate
+static volatile uplink_format_t uplink_format = UPLINK_FORMAT_PCM16_MONO;
+static volatile uint32_t uplink_rate = UPLINK_SAMPLE_RATE; // Requested
+static audio_resampler_t uplink_resampler; // Owned by the sender task
+static audio_adpcm_state_t uplink_adpcm;    // Owned by the sender task
+static uint8_t *uplink_encoded = NULL;      // Encoded uplink frame
+static audio_opus_encoder_t uplink_opus;    // Owned by the sender task
+static audio_opus_decoder_t downlink_opus;  // Owned by the WebSocket task
+static audio_downlink_t downlink;           // Owned by the WebSocket task
+static bool downlink_is_opus = false;       // Else pcm, as `downlink` says
+static bool downlink_binary = false; // Message in progress is binary
+static int16_t *downlink_pcm = NULL; // Decoded downlink packet
+static uint8_t *downlink_packet = NULL; // Opus packet split across events
+static size_t downlink_packet_len = 0;
+static volatile bool frame_headers = false; // "frames on": audio_frame.h
+static audio_frame_rx_t downlink_rx;        // Owned by the WebSocket task
+static uint32_t downlink_bad_frames = 0;    // Header missing or unusable
+static size_t downlink_header_len = 0;      // Of the message in progress
+static bool downlink_skip = false;          // Drop the message in progress
+static uint8_t *uplink_frame = NULL;        // Header + payload, sender
+static struct {
+  uint32_t sequence;
+  uint64_t next_pos;     // History position after the last frame sent
+  uint64_t block_pos;    // Block being processed: first position,
+  uint64_t block_end;    // one past its last,
+  int64_t block_end_us;  // and when I2S finished capturing it
+  uint64_t speech_start; // Pending VAD events, UINT64_MAX for none
+  uint64_t speech_end;
+  uint64_t marker;      // Latency test chirp not sent yet, or UINT64_MAX
+  uint32_t marker_id;
+  uint64_t opus_pos; // First position in the next Opus packet
+} uplink_framing = {.speech_start = UINT64_MAX,
+                    .speech_end = UINT64_MAX,
+                    .marker = UINT64_MAX};
+static volatile vad_mode_t vad_mode = VAD_MODE_GATE;
+static volatile int beam_mode = AUDIO_BEAM_BROADSIDE; // Or BEAM_OFF
+static audio_beamformer_t uplink_beam;  // Owned by the sender task
+static volatile bool aec_enabled = true;
+static audio_aec_t *uplink_aec = NULL; // Owned by the sender task
+static audio_aec_stage_t uplink_aec_stage_state;
+static audio_ring_t aec_reference;     // Playback task -> sender, played pcm16
+static int16_t *aec_far = NULL;        // Reference matched to one block
+static volatile audio_ns_level_t ns_level = AUDIO_NS_LOW;
+static audio_ns_t *uplink_ns = NULL; // Owned by the sender task
+static volatile bool agc_enabled = true;
+static volatile float agc_target_dbfs = AGC_TARGET_DBFS;
+static audio_agc_t uplink_agc;       // Owned by the sender task
+static audio_dc_block_t uplink_dc;
+static audio_meter_t uplink_meter;
+static audio_vad_t uplink_vad;       // Owned by the sender task
+static audio_history_t uplink_history; // Sender-only, processed uplink
+static struct {
+  bool open;         // New audio is streamed
+  bool by_trigger;   // Opened by a wake word or server trigger
+  bool heard_speech; // VAD speech since it opened
+  TickType_t opened_at;
+  uint64_t end;           // History position it closed at
+  uint32_t seen_triggers; // trigger_requests already acted on
+  uint32_t seen_stops;
+} uplink_stream; // Owned by the sender task
+static atomic_uint trigger_requests;   // Any task -> sender
+static atomic_uint trigger_preroll_ms; // With the latest request
+static atomic_uint trigger_stops;
+static audio_jitter_t playback_jitter; // WebSocket task -> playback task
+static audio_sdm_t playback_sdm;       // Owned by the playback task
+static int16_t *playback_pcm = NULL;   // One chunk on its way to the pin
+static uint32_t *playback_bits = NULL; // playback_pcm as a bitstream
+static volatile pipeline_stats_t pipeline_stats = {0};
+
+// Latency histograms in microseconds, one writer each
+static struct {
+  audio_latency_t capture; // DMA completion -> capture ring (capture task)
+  audio_latency_t queue;   // Capture ring -> sender picks the block up
+  audio_latency_t dsp;     // Uplink conditioning of one block
+  audio_latency_t send;    // One esp_websocket_client_send_bin call
+  audio_latency_t uplink;  // DMA completion -> sends for the block done
+  audio_latency_t rx;      // Handling one downlink WebSocket event
+  audio_latency_t play;    // Downlink audio queued ahead of the pin
+} latency;
+static int64_t block_times[AUDIO_BLOCK_COUNT][2]; // DMA done, committed
+
+// One latency test chirp on its way round. Each task fills in its own
+// times, then publishes them by storing the marker id in its `*_id`.
+static struct {
+  atomic_uint id;      // Main task: marker to inject next, 0 for none
+  int64_t mouth_us;    // Sender: capture time of its first sample
+  int64_t sent_us;     // Sender: the frame carrying it was sent
+  atomic_uint sent_id;
+  int64_t rx_us;       // WebSocket: its echo arrived
+  int64_t ear_us;      // WebSocket: its first sample reaches the pin
+  float score;         // Correlation with the chirp, 0 if only the header
+  atomic_uint rx_id;   // Header echo or chirp, whichever came first
+  atomic_uint ear_id;  // Chirp found in the played audio
+  uint32_t server_us;  // WebSocket: hold time the echo server reported
+  atomic_uint server_id;
+} marker;
+static audio_marker_t *marker_detector = NULL; // Owned by the WebSocket task
+static int16_t *marker_block = NULL;           // Uplink block with the chirp
+static volatile uint32_t marker_remaining = 0; // "latency test [n]"
+static volatile uint32_t marker_runs = 0;      // Bumped per command
+static int64_t downlink_event_us;              // WebSocket task
+static volatile int64_t dma_done_us[DMA_TIME_SLOTS]; // I2S RX ISR
+static volatile uint32_t dma_done_count;
+static uint64_t i2s_bytes_read; // Capture task, init test read included
+static TaskHandle_t stats_task_handle = NULL; // Sends the "stats" replies
+static volatile uint32_t stats_push_ms = 0;   // "stats every <s>", 0 = off
+static TaskHandle_t trace_task_handle = NULL; // Woken for "trace dump"
+static volatile bool bench_requested = false; // "bench [case]", main task
+static char bench_filter[32];                 // Written before the flag
+static volatile bool bench_running = false;   // Cleared by the bench task
+static volatile bool trace_streaming = true;  // Else only kept, as a record
 
 // Simplified networking state
 static esp_websocket_client_handle_t websocket_client = NULL;
@@ -57,9 +313,64 @@ static bool can_stream_audio = false; // Only flag we need
 static size_t last_free_heap = 0;
 static size_t min_free_heap = SIZE_MAX;
 
+// Heap steady state: everything the audio tasks touch is carved from the
+// arenas at boot, so once a task reaches its loop it must not allocate.
+// The heap hook below counts allocations per watched task; the WebSocket
+// task is only reported, as esp_event copies every event it dispatches.
+typedef enum {
+  HEAP_WATCH_CAPTURE = 0,
+  HEAP_WATCH_SENDER,
+  HEAP_WATCH_PLAYBACK,
+  HEAP_WATCH_AUDIO_TASKS, // The ones above must stay at zero
+  HEAP_WATCH_WEBSOCKET = HEAP_WATCH_AUDIO_TASKS,
+  HEAP_WATCH_COUNT,
+} heap_watch_id_t;
+
+static struct {
+  TaskHandle_t task;        // Set by the task itself on reaching its loop
+  volatile uint32_t allocs; // Written by the hook, in that task only
+} heap_watch[HEAP_WATCH_COUNT];
+
+#if CONFIG_HEAP_USE_HOOKS
+// Called by heap_caps after every allocation, possibly with the cache
+// disabled: IRAM only, no locks, no logging
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size,
+                                         uint32_t caps) {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  if (!task) {
+    return; // Before the scheduler starts
+  }
+  for (int i = 0; i < HEAP_WATCH_COUNT; i++) {
+    if (heap_watch[i].task == task) {
+      heap_watch[i].allocs++;
+#if HEAP_STRICT_TEST
+      if (i < HEAP_WATCH_AUDIO_TASKS) {
+        abort();
+      }
+#endif
+      return;
+    }
+  }
+}
+#endif
+
+// Start counting the calling task's allocations
+static void heap_watch_start(heap_watch_id_t id) {
+  heap_watch[id].task = xTaskGetCurrentTaskHandle();
+}
+
+static uint32_t heap_watch_audio_allocs(void) {
+  uint32_t allocs = 0;
+  for (int i = 0; i < HEAP_WATCH_AUDIO_TASKS; i++) {
+    allocs += heap_watch[i].allocs;
+  }
+  return allocs;
+}
+
 // Function declarations
-void handle_incoming_audio(uint8_t *audio_data, size_t len);
-void handle_incoming_text(char *text_data, size_t len);
+void handle_incoming_audio(const esp_websocket_event_data_t *data);
+void handle_incoming_text(const char *data, size_t len);
+void request_uplink_trigger(uint32_t preroll_ms);
 
 // Simplified event handlers
 static void websocket_event_handler(void *handler_args, esp_event_base_t base,
@@ -69,6 +380,7 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
   switch (event_id) {
   case WEBSOCKET_EVENT_CONNECTED:
     ESP_LOGI(TAG, "🔗 WebSocket connected");
+    heap_watch_start(HEAP_WATCH_WEBSOCKET);
     can_stream_audio = true;
     break;
   case WEBSOCKET_EVENT_DISCONNECTED:
@@ -77,10 +389,19 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
     can_stream_audio = false;
     break;
   case WEBSOCKET_EVENT_DATA:
-    if (data->op_code == 0x02) { // Binary data (audio)
-      ESP_LOGI(TAG, "📨 Received %d bytes of audio", data->data_len);
-      handle_incoming_audio((uint8_t *)data->data_ptr, data->data_len);
+    // Messages larger than the client's buffer arrive as several events,
+    // and fragmented ones continue in frames with opcode 0x00
+    if (data->op_code == 0x02 ||
+        (data->op_code == 0x00 && downlink_binary)) { // Binary data (audio)
+      downlink_binary = true;
+      AUDIO_TRACE(WS_RX, data->op_code, data->data_len, data->payload_offset,
+                  data->payload_len);
+      int64_t start = esp_timer_get_time();
+      handle_incoming_audio(data);
+      audio_latency_add(&latency.rx,
+                        (uint32_t)(esp_timer_get_time() - start));
     } else if (data->op_code == 0x01) { // Text data
+      downlink_binary = false;
       ESP_LOGI(TAG, "📨 Received text: %.*s", data->data_len,
                (char *)data->data_ptr);
       handle_incoming_text((char *)data->data_ptr, data->data_len);
@@ -142,7 +463,8 @@ esp_err_t init_networking(void) {
   ESP_ERROR_CHECK(esp_wifi_start());
 
   // WebSocket
-  esp_websocket_client_config_t websocket_cfg = {.uri = WEBSOCKET_URI};
+  esp_websocket_client_config_t websocket_cfg = {
+      .uri = WEBSOCKET_URI, .task_stack = WEBSOCKET_TASK_STACK};
   websocket_client = esp_websocket_client_init(&websocket_cfg);
   esp_websocket_register_events(websocket_client, WEBSOCKET_EVENT_ANY,
                                 websocket_event_handler, NULL);
@@ -154,27 +476,232 @@ esp_err_t init_networking(void) {
 // Single function to handle audio streaming
 void stream_audio_if_connected(uint8_t *audio_data, size_t len) {
   if (can_stream_audio) {
-    esp_websocket_client_send_bin(websocket_client, (char *)audio_data, len, 0);
+    int64_t start = esp_timer_get_time();
+    int sent =
+        esp_websocket_client_send_bin(websocket_client, (char *)audio_data,
+                                      len, pdMS_TO_TICKS(SEND_TIMEOUT_MS));
+    audio_latency_add(&latency.send,
+                      (uint32_t)(esp_timer_get_time() - start));
+    if (sent < 0) {
+      pipeline_stats.send_failures++;
+    } else {
+      pipeline_stats.messages_sent++;
+    }
+  }
+}
+
+// While a latency test chirp is out, look for it in downlink audio about
+// to be queued behind `ahead` samples
+static void listen_for_marker(const int16_t *pcm, size_t samples,
+                              size_t ahead) {
+  static uint32_t armed = 0;
+  uint32_t id = atomic_load(&marker.id);
+  if (id == 0 || atomic_load(&marker.ear_id) == id) {
+    return;
+  }
+  if (id != armed) {
+    audio_marker_reset(marker_detector);
+    armed = id;
+  }
+  int64_t start;
+  float score;
+  if (!audio_marker_feed(marker_detector, pcm, samples, &start, &score)) {
+    return;
+  }
+  marker.ear_us = esp_timer_get_time() +
+                  ((int64_t)ahead + start) * 1000000 / SAMPLE_RATE;
+  marker.score = score;
+  if (atomic_load(&marker.rx_id) != id) {
+    // Bare downlink: the chirp is all there is to go by
+    marker.rx_us = downlink_event_us;
+    atomic_store(&marker.rx_id, id);
   }
+  atomic_store(&marker.ear_id, id);
 }
 
-// Handle incoming audio data from server
-void handle_incoming_audio(uint8_t *audio_data, size_t len) {
-  ESP_LOGI(TAG, "🔊 Playing %d bytes of received audio", len);
+// Queue received pcm16 for the playback task. Never waits: if the speaker
+// is more than PLAYBACK_JITTER_BYTES behind, the excess is dropped.
+static void queue_playback(const int16_t *pcm, size_t samples) {
+  // Ahead of this audio: the jitter ring, the chunk being rendered and the
+  // DMA buffers. This task is the ring's producer, so its fill comes from
+  // the producer side; audio_ring_used() belongs to the playback task.
+  audio_ring_t *ring = &playback_jitter.ring;
+  size_t ahead =
+      (ring->capacity - audio_ring_free_space(ring)) / sizeof(int16_t) +
+      (1 + PLAYBACK_DMA_BUFFERS) * PLAYBACK_CHUNK;
+  audio_latency_add(&latency.play,
+                    (uint32_t)(ahead * 1000000ull / SAMPLE_RATE));
+  listen_for_marker(pcm, samples, ahead);
+  audio_jitter_push(&playback_jitter, pcm, samples, esp_timer_get_time());
+}
 
-  // Play received audio through PWM speaker
-  for (int i = 0; i < len && i < AUDIO_BUFFER_SIZE; i++) {
-    uint32_t duty = (uint32_t)audio_data[i];
-    ledc_set_duty(PWM_MODE, PWM_CHANNEL, duty);
-    ledc_update_duty(PWM_MODE, PWM_CHANNEL);
+// audio_downlink sink, pcm16 already at SAMPLE_RATE
+static void queue_downlink(const int16_t *pcm, size_t samples, void *ctx) {
+  queue_playback(pcm, samples);
+}
 
-    // Simple timing - matches our sample rate
-    vTaskDelay(pdMS_TO_TICKS(1000 / SAMPLE_RATE));
+// Hand audio about to be played to the sender as the echo reference
+static void push_aec_reference(const int16_t *pcm, size_t samples) {
+  size_t bytes = samples * sizeof(int16_t);
+  if (audio_ring_write(&aec_reference, pcm, bytes) < bytes) {
+    pipeline_stats.reference_drops++;
   }
 }
 
+// One Opus packet per binary message, decoded at the speaker rate. A
+// packet that arrives in one event is decoded where it lies; only one split
+// across events is gathered in downlink_packet first.
+static void handle_opus_fragment(const audio_downlink_fragment_t *fragment) {
+  const uint8_t *packet = fragment->data;
+  size_t len = fragment->len;
+  bool starts = fragment->first && fragment->offset == 0;
+  bool ends = fragment->fin &&
+              fragment->offset + fragment->len >= fragment->frame_len;
+
+  if (!starts || !ends) {
+    if (starts) {
+      downlink_packet_len = 0;
+    }
+    if (downlink_packet_len + len > DOWNLINK_MAX_PACKET) {
+      downlink_packet_len = DOWNLINK_MAX_PACKET + 1; // Drop the packet
+    } else {
+      memcpy(downlink_packet + downlink_packet_len, packet, len);
+      downlink_packet_len += len;
+    }
+    if (!ends) {
+      return;
+    }
+    if (downlink_packet_len > DOWNLINK_MAX_PACKET) {
+      ESP_LOGW(TAG, "Opus packet too large, dropped");
+      return;
+    }
+    packet = downlink_packet;
+    len = downlink_packet_len;
+  }
+
+  int samples = audio_opus_decode(&downlink_opus, packet, len, downlink_pcm,
+                                  DOWNLINK_MAX_SAMPLES);
+  if (samples < 0) {
+    ESP_LOGW(TAG, "Opus decode failed: %d", samples);
+    return;
+  }
+  queue_playback(downlink_pcm, samples);
+}
+
+// Read the header at the start of a framed downlink message and switch
+// the decoder to its codec and rate. False if the message is unusable.
+static bool start_downlink_frame(const audio_downlink_fragment_t *fragment) {
+  audio_frame_header_t header;
+  if (audio_frame_decode(fragment->data, fragment->len, &header,
+                         &downlink_header_len) != ESP_OK) {
+    return false;
+  }
+  audio_frame_rx_update(&downlink_rx, &header, downlink_event_us, NULL);
+  uint32_t id = atomic_load(&marker.id);
+  if ((header.flags & AUDIO_FRAME_FLAG_MARKER) && id != 0 &&
+      atomic_load(&marker.rx_id) != id) {
+    marker.rx_us = downlink_event_us;
+    atomic_store(&marker.rx_id, id);
+  }
+
+  if (header.codec == AUDIO_FRAME_CODEC_OPUS) {
+    downlink_is_opus = true;
+    return true;
+  }
+  audio_downlink_format_t format;
+  if (header.codec == AUDIO_FRAME_CODEC_PCM16) {
+    format = AUDIO_DOWNLINK_PCM16;
+  } else if (header.codec == AUDIO_FRAME_CODEC_PCM8) {
+    format = AUDIO_DOWNLINK_PCM8;
+  } else {
+    return false;
+  }
+  if (downlink_is_opus || downlink.format != format ||
+      downlink.in_rate != header.sample_rate) {
+    if (audio_downlink_init(&downlink, format, header.sample_rate,
+                            SAMPLE_RATE) != ESP_OK) {
+      return false;
+    }
+    downlink_is_opus = false;
+  }
+  return true;
+}
+
+// Handle incoming audio data from server, one WebSocket data event at a time
+void handle_incoming_audio(const esp_websocket_event_data_t *data) {
+  downlink_event_us = esp_timer_get_time();
+  audio_downlink_fragment_t fragment = {
+      .data = (const uint8_t *)data->data_ptr,
+      .len = data->data_len,
+      .offset = data->payload_offset,
+      .frame_len = data->payload_len,
+      .first = data->op_code == 0x02,
+      .fin = data->fin,
+  };
+
+  if (frame_headers && fragment.first) {
+    // The header leads the message's first WebSocket frame; hide it from
+    // the decoders, offsets included
+    if (fragment.offset == 0) {
+      downlink_skip = !start_downlink_frame(&fragment);
+      downlink_bad_frames += downlink_skip;
+    }
+    if (downlink_skip) {
+      return;
+    }
+    size_t skip = downlink_header_len;
+    if (fragment.offset < skip) {
+      size_t cut = skip - fragment.offset;
+      cut = cut < fragment.len ? cut : fragment.len;
+      fragment.data += cut;
+      fragment.len -= cut;
+      fragment.offset = 0;
+    } else {
+      fragment.offset -= skip;
+    }
+    fragment.frame_len -= skip;
+  } else if (frame_headers && downlink_skip) {
+    return;
+  }
+
+  if (downlink_is_opus) {
+    handle_opus_fragment(&fragment);
+    return;
+  }
+  audio_downlink_feed(&downlink, &fragment, queue_downlink, NULL);
+}
+
+// "downlink pcm16 [rate]" / "downlink pcm8 [rate]"; the rate defaults to
+// DOWNLINK_SAMPLE_RATE for pcm16 and SAMPLE_RATE for pcm8
+static void set_downlink_pcm(audio_downlink_format_t format,
+                             const char *args) {
+  uint32_t rate = (uint32_t)strtoul(args, NULL, 10);
+  if (rate == 0) {
+    rate = format == AUDIO_DOWNLINK_PCM16 ? DOWNLINK_SAMPLE_RATE : SAMPLE_RATE;
+  }
+  esp_err_t err = audio_downlink_init(&downlink, format, rate, SAMPLE_RATE);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Unsupported downlink rate: %u Hz (%s)",
+             (unsigned int)rate, esp_err_to_name(err));
+    return;
+  }
+  ESP_LOGI(TAG, "🎚️ Downlink format: %s %u Hz",
+           audio_downlink_format_name(format), (unsigned int)rate);
+  downlink_is_opus = false;
+}
+
 // Handle incoming text commands/messages from server
-void handle_incoming_text(char *text_data, size_t len) {
+void handle_incoming_text(const char *data, size_t len) {
+  // The payload is not NUL-terminated and the bytes past len are stale, so
+  // every command is matched and parsed on a terminated copy. None is
+  // longer; the rest of a longer message is ignored.
+  char text_data[TEXT_COMMAND_MAX];
+  if (len >= sizeof(text_data)) {
+    len = sizeof(text_data) - 1;
+  }
+  memcpy(text_data, data, len);
+  text_data[len] = '\0';
+
   // Simple command processing
   if (strncmp(text_data, "mute", 4) == 0) {
     ESP_LOGI(TAG, "🔇 Mute command received");
@@ -182,24 +709,225 @@ void handle_incoming_text(char *text_data, size_t len) {
   } else if (strncmp(text_data, "unmute", 6) == 0) {
     ESP_LOGI(TAG, "🔊 Unmute command received");
     can_stream_audio = true;
+  } else if (strncmp(text_data, "format pcm16", 12) == 0) {
+    ESP_LOGI(TAG, "🎚️ Uplink format: pcm16 mono");
+    uplink_format = UPLINK_FORMAT_PCM16_MONO;
+  } else if (strncmp(text_data, "format raw32", 12) == 0) {
+    ESP_LOGI(TAG, "🎚️ Uplink format: raw32 stereo");
+    uplink_format = UPLINK_FORMAT_RAW32_STEREO;
+  } else if (strncmp(text_data, "format adpcm", 12) == 0) {
+    ESP_LOGI(TAG, "🎚️ Uplink format: IMA-ADPCM");
+    uplink_format = UPLINK_FORMAT_IMA_ADPCM;
+  } else if (strncmp(text_data, "format opus", 11) == 0) {
+    ESP_LOGI(TAG, "🎚️ Uplink format: Opus %d bit/s", uplink_opus.bitrate);
+    uplink_format = UPLINK_FORMAT_OPUS;
+  } else if (strncmp(text_data, "downlink opus", 13) == 0) {
+    ESP_LOGI(TAG, "🎚️ Downlink format: Opus");
+    downlink_is_opus = true;
+  } else if (strncmp(text_data, "downlink pcm16", 14) == 0) {
+    set_downlink_pcm(AUDIO_DOWNLINK_PCM16, text_data + 14);
+  } else if (strncmp(text_data, "downlink pcm8", 13) == 0) {
+    set_downlink_pcm(AUDIO_DOWNLINK_PCM8, text_data + 13);
+  } else if (strncmp(text_data, "vad off", 7) == 0) {
+    ESP_LOGI(TAG, "🗣️ VAD off - streaming continuously");
+    vad_mode = VAD_MODE_OFF;
+  } else if (strncmp(text_data, "vad gate", 8) == 0) {
+    ESP_LOGI(TAG, "🗣️ VAD gate - streaming speech only");
+    vad_mode = VAD_MODE_GATE;
+  } else if (strncmp(text_data, "vad throttle", 12) == 0) {
+    ESP_LOGI(TAG, "🗣️ VAD throttle - 1 in %d quiet blocks",
+             VAD_THROTTLE_INTERVAL);
+    vad_mode = VAD_MODE_THROTTLE;
+  } else if (strncmp(text_data, "vad trigger", 11) == 0) {
+    ESP_LOGI(TAG, "🗣️ VAD trigger - streaming only after a trigger");
+    vad_mode = VAD_MODE_TRIGGER;
+  } else if (strncmp(text_data, "trigger stop", 12) == 0) {
+    ESP_LOGI(TAG, "⏹️ Trigger stop");
+    atomic_fetch_add(&trigger_stops, 1);
+  } else if (strncmp(text_data, "trigger", 7) == 0) {
+    uint32_t preroll_ms = (uint32_t)strtoul(text_data + 7, NULL, 10);
+    if (preroll_ms == 0) {
+      preroll_ms = TRIGGER_PREROLL_MS;
+    }
+    if (preroll_ms > HISTORY_SECONDS * 1000) {
+      preroll_ms = HISTORY_SECONDS * 1000;
+    }
+    ESP_LOGI(TAG, "⏺️ Trigger, %u ms of pre-roll", (unsigned int)preroll_ms);
+    request_uplink_trigger(preroll_ms);
+  } else if (strncmp(text_data, "trace on", 8) == 0) {
+    ESP_LOGI(TAG, "🧾 Trace streaming to the console");
+    trace_streaming = true;
+  } else if (strncmp(text_data, "trace off", 9) == 0) {
+    ESP_LOGI(TAG, "🧾 Trace kept on the device until \"trace dump\"");
+    trace_streaming = false;
+  } else if (strncmp(text_data, "trace dump", 10) == 0) {
+    if (trace_task_handle) {
+      xTaskNotifyGive(trace_task_handle);
+    }
+  } else if (strncmp(text_data, "frames on", 9) == 0) {
+    ESP_LOGI(TAG, "🏷️ Binary audio framed with sequence/timestamp headers");
+    audio_frame_rx_reset(&downlink_rx);
+    downlink_skip = false;
+    frame_headers = true;
+  } else if (strncmp(text_data, "frames off", 10) == 0) {
+    ESP_LOGI(TAG, "🏷️ Binary audio sent bare");
+    frame_headers = false;
+  } else if (strncmp(text_data, "sync ", 5) == 0) {
+    // Clock probe: echo the peer's send time with ours, so it can place
+    // frame capture times on its own clock (audio_frame_clock_update)
+    char reply[80];
+    int token = (int)(len - 5) < 32 ? (int)(len - 5) : 32;
+    int n = snprintf(reply, sizeof(reply), "sync:%.*s,%lld", token,
+                     text_data + 5, (long long)esp_timer_get_time());
+    esp_websocket_client_send_text(websocket_client, reply, n,
+                                   pdMS_TO_TICKS(SEND_TIMEOUT_MS));
+  } else if (strncmp(text_data, "beam ", 5) == 0) {
+    const char *mode = text_data + 5;
+    if (strncmp(mode, "off", 3) == 0) {
+      beam_mode = BEAM_OFF;
+    } else if (strncmp(mode, "broadside", 9) == 0) {
+      beam_mode = AUDIO_BEAM_BROADSIDE;
+    } else if (strncmp(mode, "endfire", 7) == 0) {
+      beam_mode = AUDIO_BEAM_ENDFIRE;
+    } else if (strncmp(mode, "adaptive", 8) == 0) {
+      beam_mode = AUDIO_BEAM_ADAPTIVE;
+    } else {
+      ESP_LOGW(TAG, "Unknown beam mode: %.*s", (int)len, text_data);
+      return;
+    }
+    ESP_LOGI(TAG, "🎯 Beamformer: %.*s", (int)len - 5, mode);
+  } else if (strncmp(text_data, "aec on", 6) == 0) {
+    ESP_LOGI(TAG, "🔁 Echo cancellation on");
+    aec_enabled = true;
+  } else if (strncmp(text_data, "aec off", 7) == 0) {
+    ESP_LOGI(TAG, "🔁 Echo cancellation off");
+    aec_enabled = false;
+  } else if (strncmp(text_data, "ns ", 3) == 0) {
+    const char *level = text_data + 3;
+    if (strncmp(level, "off", 3) == 0) {
+      ns_level = AUDIO_NS_OFF;
+    } else if (strncmp(level, "low", 3) == 0) {
+      ns_level = AUDIO_NS_LOW;
+    } else if (strncmp(level, "medium", 6) == 0) {
+      ns_level = AUDIO_NS_MEDIUM;
+    } else if (strncmp(level, "high", 4) == 0) {
+      ns_level = AUDIO_NS_HIGH;
+    } else {
+      ESP_LOGW(TAG, "Unknown noise suppression level: %.*s", (int)len,
+               text_data);
+      return;
+    }
+    ESP_LOGI(TAG, "🌬️ Noise suppression: %s", audio_ns_level_name(ns_level));
+  } else if (strncmp(text_data, "agc on", 6) == 0) {
+    ESP_LOGI(TAG, "🎛️ AGC on, target %.0f dBFS", agc_target_dbfs);
+    agc_enabled = true;
+  } else if (strncmp(text_data, "agc off", 7) == 0) {
+    ESP_LOGI(TAG, "🎛️ AGC off - limiter only");
+    agc_enabled = false;
+  } else if (strncmp(text_data, "agc target ", 11) == 0) {
+    float target = strtof(text_data + 11, NULL);
+    if (target >= -40.0f && target <= -3.0f) {
+      ESP_LOGI(TAG, "🎛️ AGC target: %.0f dBFS", target);
+      agc_target_dbfs = target;
+    } else {
+      ESP_LOGW(TAG, "AGC target out of range: %.*s", (int)len, text_data);
+    }
+  } else if (strncmp(text_data, "rate ", 5) == 0) {
+    uint32_t rate = (uint32_t)strtoul(text_data + 5, NULL, 10);
+    if (rate == 16000 || rate == 24000) {
+      ESP_LOGI(TAG, "🎚️ Uplink rate: %u Hz", (unsigned int)rate);
+      uplink_rate = rate; // Sender re-initializes the resampler
+    } else {
+      ESP_LOGW(TAG, "Unsupported uplink rate: %.*s", (int)len, text_data);
+    }
   } else if (strncmp(text_data, "status", 6) == 0) {
     ESP_LOGI(TAG, "📊 Status requested - streaming: %s",
              can_stream_audio ? "ON" : "OFF");
     // Send status back to server
-    char status_msg[64];
-    snprintf(status_msg, sizeof(status_msg), "status:streaming=%s",
-             can_stream_audio ? "ON" : "OFF");
+    char status_msg[256];
+    snprintf(status_msg, sizeof(status_msg),
+             "status:streaming=%s,format=%s,rate=%u,beam=%s,angle=%d,"
+             "aec=%s,erle=%d,echo_delay=%u,ns=%s,noise=%d,agc=%s,gain=%d,"
+             "downlink=%s,downlink_rate=%u,frames=%s",
+             can_stream_audio ? "ON" : "OFF",
+             audio_uplink_format_name(uplink_format),
+             (unsigned int)uplink_rate,
+             beam_mode == BEAM_OFF ? "off"
+                                   : audio_beamformer_mode_name(beam_mode),
+             (int)audio_beamformer_angle(&uplink_beam),
+             aec_enabled ? "on" : "off", (int)uplink_aec->erle_db,
+             (unsigned int)audio_aec_delay_ms(uplink_aec, SAMPLE_RATE),
+             audio_ns_level_name(ns_level), (int)uplink_ns->noise_db,
+             agc_enabled ? "on" : "off", (int)audio_agc_gain_db(&uplink_agc),
+             downlink_is_opus ? "opus"
+                              : audio_downlink_format_name(downlink.format),
+             (unsigned int)(downlink_is_opus ? SAMPLE_RATE
+                                             : downlink.in_rate),
+             frame_headers ? "on" : "off");
     esp_websocket_client_send_text(websocket_client, status_msg,
                                    strlen(status_msg), portMAX_DELAY);
+  } else if (strncmp(text_data, "latency test stop", 17) == 0) {
+    marker_remaining = 0; // The chirp in flight is still reported
+  } else if (strncmp(text_data, "latency test", 12) == 0) {
+    uint32_t count = (uint32_t)strtoul(text_data + 12, NULL, 10);
+    if (count == 0) {
+      count = MARKER_DEFAULT_COUNT;
+    }
+    if (uplink_format == UPLINK_FORMAT_RAW32_STEREO) {
+      ESP_LOGW(TAG, "Latency test needs a processed uplink, not raw32");
+      return;
+    }
+    ESP_LOGI(TAG, "⏱️ Mouth-to-ear test: %u chirps, %d ms apart",
+             (unsigned int)count, MARKER_INTERVAL_MS);
+    marker_remaining = count;
+    marker_runs++;
+  } else if (strncmp(text_data, "marker:", 7) == 0) {
+    // The echo server's hold time for the marker frame it just returned
+    marker.server_us = (uint32_t)strtoul(text_data + 7, NULL, 10);
+    atomic_store(&marker.server_id, atomic_load(&marker.id));
+  } else if (strcmp(text_data, "bench") == 0 ||
+             strncmp(text_data, "bench ", 6) == 0) {
+    // Runs on the housekeeping task; a case name substring narrows it. The
+    // filter is read by the run it starts, so it is left alone until then
+    if (bench_requested || bench_running) {
+      ESP_LOGW(TAG, "⏱️ Benchmark already running, \"%s\" ignored",
+               text_data);
+      return;
+    }
+    size_t n = len > 6 ? len - 6 : 0;
+    if (n >= sizeof(bench_filter)) {
+      n = sizeof(bench_filter) - 1;
+    }
+    memcpy(bench_filter, text_data + 6, n);
+    bench_filter[n] = '\0';
+    bench_requested = true;
+    if (stats_task_handle) {
+      xTaskNotifyGive(stats_task_handle);
+    }
+  } else if (strncmp(text_data, "stats every", 11) == 0) {
+    // Clamped so the period cannot wrap in milliseconds
+    unsigned long seconds = strtoul(text_data + 11, NULL, 10);
+    if (seconds > STATS_PUSH_MAX_S) {
+      seconds = STATS_PUSH_MAX_S;
+    }
+    ESP_LOGI(TAG, "📈 Stats push every %lu s (0 = off, at most %d)", seconds,
+             STATS_PUSH_MAX_S);
+    stats_push_ms = (uint32_t)seconds * 1000;
+  } else if (strncmp(text_data, "stats", 5) == 0) {
+    // The housekeeping task sends it, so frames never interleave
+    if (stats_task_handle) {
+      xTaskNotifyGive(stats_task_handle);
+    }
   } else {
-    ESP_LOGI(TAG, "📝 Unknown text command: %.*s", len, text_data);
+    ESP_LOGI(TAG, "📝 Unknown text command: %.*s", (int)len, text_data);
   }
 }
 
 void init_memory_monitoring(void) {
   last_free_heap = esp_get_free_heap_size();
   min_free_heap = last_free_heap;
-  ESP_LOGI(TAG, "Initial free heap: %d bytes", last_free_heap);
+  ESP_LOGI(TAG, "Initial free heap: %u bytes",
+           (unsigned int)last_free_heap);
 }
 
 void log_memory_usage(void) {
@@ -209,33 +937,566 @@ void log_memory_usage(void) {
   }
 
   if (abs((int)(current_free - last_free_heap)) > 1024) {
-    ESP_LOGI(TAG, "Heap: %d bytes free (min: %d)", current_free, min_free_heap);
+    ESP_LOGI(TAG, "Heap: %u bytes free (min: %u, largest internal block: %u)",
+             (unsigned int)current_free, (unsigned int)min_free_heap,
+             (unsigned int)heap_caps_get_largest_free_block(
+                 MALLOC_CAP_INTERNAL));
     last_free_heap = current_free;
   }
+
+#if CONFIG_HEAP_USE_HOOKS
+  static uint32_t reported = 0;
+  uint32_t audio_allocs = heap_watch_audio_allocs();
+  if (audio_allocs != reported) {
+    ESP_LOGE(TAG,
+             "🧱 Heap used after init: capture=%u sender=%u playback=%u "
+             "(websocket=%u)",
+             (unsigned int)heap_watch[HEAP_WATCH_CAPTURE].allocs,
+             (unsigned int)heap_watch[HEAP_WATCH_SENDER].allocs,
+             (unsigned int)heap_watch[HEAP_WATCH_PLAYBACK].allocs,
+             (unsigned int)heap_watch[HEAP_WATCH_WEBSOCKET].allocs);
+    reported = audio_allocs;
+  }
+#endif
+}
+
+static const struct {
+  const char *name;
+  const audio_latency_t *hist;
+} latency_names[] = {
+    {"capture", &latency.capture}, {"queue", &latency.queue},
+    {"dsp", &latency.dsp},         {"send", &latency.send},
+    {"uplink", &latency.uplink},   {"rx", &latency.rx},
+    {"play", &latency.play},
+};
+#define LATENCY_COUNT (sizeof(latency_names) / sizeof(latency_names[0]))
+
+// Median and 99th percentile of each latency histogram since boot
+static void log_latency(void) {
+  char line[200];
+  size_t len = 0;
+  line[0] = '\0';
+  for (size_t i = 0; i < LATENCY_COUNT && len < sizeof(line); i++) {
+    const audio_latency_t *hist = latency_names[i].hist;
+    len += snprintf(line + len, sizeof(line) - len, " %s=%u/%u",
+                    latency_names[i].name,
+                    (unsigned int)audio_latency_percentile(hist, 500),
+                    (unsigned int)audio_latency_percentile(hist, 990));
+  }
+  ESP_LOGI(TAG, "Latency p50/p99 us:%s", line);
+}
+
+// Counters and latency histograms as one JSON text frame:
+// {"type":"stats","uptime_ms":..,"counters":{..},"bucket_us":64,
+//  "latency_us":{"capture":{"n":..,"avg":..,"p50":..,"p99":..,"max":..,
+//  "hist":[16 counts]},..}}
+// Bucket i counts durations below bucket_us << i, the last one the rest.
+// heap_allocs counts audio task allocations after init and must stay 0;
+// both heap counters need CONFIG_HEAP_USE_HOOKS.
+static void send_stats_frame(void) {
+  static char frame[STATS_FRAME_BYTES];
+  if (!can_stream_audio) {
+    return;
+  }
+  int len = snprintf(
+      frame, sizeof(frame),
+      "{\"type\":\"stats\",\"uptime_ms\":%u,\"counters\":{"
+      "\"captured\":%u,\"processed\":%u,\"messages\":%u,"
+      "\"i2s_overruns\":%u,\"capture_overruns\":%u,"
+      "\"sender_underruns\":%u,\"send_failures\":%u,"
+      "\"play_underruns\":%u,\"gated\":%u,\"ref_drops\":%u,"
+      "\"uplink_frames\":%u,\"downlink_frames\":%u,"
+      "\"downlink_lost\":%u,\"downlink_late\":%u,"
+      "\"downlink_jitter_us\":%u,\"downlink_bad\":%u,"
+      "\"heap_allocs\":%u,\"ws_heap_allocs\":%u},"
+      "\"bucket_us\":%u,\"latency_us\":{",
+      (unsigned int)(esp_timer_get_time() / 1000),
+      (unsigned int)pipeline_stats.blocks_captured,
+      (unsigned int)pipeline_stats.blocks_sent,
+      (unsigned int)pipeline_stats.messages_sent,
+      (unsigned int)pipeline_stats.i2s_overflows,
+      (unsigned int)pipeline_stats.capture_overruns,
+      (unsigned int)pipeline_stats.sender_underruns,
+      (unsigned int)pipeline_stats.send_failures,
+      (unsigned int)pipeline_stats.playback_underruns,
+      (unsigned int)pipeline_stats.blocks_gated,
+      (unsigned int)pipeline_stats.reference_drops,
+      (unsigned int)uplink_framing.sequence,
+      (unsigned int)downlink_rx.received, (unsigned int)downlink_rx.lost,
+      (unsigned int)downlink_rx.late, (unsigned int)downlink_rx.jitter_us,
+      (unsigned int)downlink_bad_frames,
+      (unsigned int)heap_watch_audio_allocs(),
+      (unsigned int)heap_watch[HEAP_WATCH_WEBSOCKET].allocs,
+      (unsigned int)AUDIO_LATENCY_FIRST_US);
+  for (size_t i = 0; i < LATENCY_COUNT && len < (int)sizeof(frame); i++) {
+    if (i > 0) {
+      frame[len++] = ',';
+    }
+    len += audio_latency_json(latency_names[i].hist, latency_names[i].name,
+                              frame + len, sizeof(frame) - len);
+  }
+  if (len + 2 >= (int)sizeof(frame)) {
+    ESP_LOGW(TAG, "Stats frame does not fit in %d bytes", STATS_FRAME_BYTES);
+    return;
+  }
+  frame[len++] = '}';
+  frame[len++] = '}';
+  esp_websocket_client_send_text(websocket_client, frame, len,
+                                 pdMS_TO_TICKS(SEND_TIMEOUT_MS));
+}
+
+// Mouth-to-ear results of the current test run, main task
+static struct {
+  audio_latency_t total, up, network, server, down;
+  uint32_t chirps, heard, seen_runs, next_id;
+  TickType_t requested; // The chirp in flight
+} marker_results;
+
+// Log the breakdown of one chirp's round trip and add it to the run
+static void report_marker(uint32_t id) {
+  marker_results.chirps++;
+  bool sent = atomic_load(&marker.sent_id) == id;
+  bool rx = atomic_load(&marker.rx_id) == id;
+  if (!sent || !rx) {
+    ESP_LOGW(TAG, "⏱️ Mouth-to-ear #%u: %s", (unsigned int)id,
+             sent ? "no echo" : "never sent");
+    return;
+  }
+  int64_t up = marker.sent_us - marker.mouth_us;
+  int64_t round_trip = marker.rx_us - marker.sent_us;
+  bool server = atomic_load(&marker.server_id) == id;
+  int64_t held = server ? marker.server_us : 0;
+  if (atomic_load(&marker.ear_id) != id) {
+    ESP_LOGW(TAG,
+             "⏱️ Mouth-to-ear #%u: echo header after %.1f ms, chirp not "
+             "heard in the downlink audio",
+             (unsigned int)id, (marker.rx_us - marker.mouth_us) / 1000.0);
+    return;
+  }
+  int64_t down = marker.ear_us - marker.rx_us;
+  int64_t total = marker.ear_us - marker.mouth_us;
+  marker_results.heard++;
+  audio_latency_add(&marker_results.total, (uint32_t)total);
+  audio_latency_add(&marker_results.up, (uint32_t)up);
+  audio_latency_add(&marker_results.network, (uint32_t)(round_trip - held));
+  audio_latency_add(&marker_results.down, (uint32_t)down);
+  if (server) {
+    audio_latency_add(&marker_results.server, (uint32_t)held);
+  }
+  if (server) {
+    ESP_LOGI(TAG,
+             "⏱️ Mouth-to-ear #%u: %.1f ms = device up %.1f + network %.1f + "
+             "server %.1f + device down %.1f (chirp %.2f)",
+             (unsigned int)id, total / 1000.0, up / 1000.0,
+             (round_trip - held) / 1000.0, held / 1000.0, down / 1000.0,
+             marker.score);
+  } else {
+    ESP_LOGI(TAG,
+             "⏱️ Mouth-to-ear #%u: %.1f ms = device up %.1f + "
+             "network+server %.1f + device down %.1f (chirp %.2f)",
+             (unsigned int)id, total / 1000.0, up / 1000.0,
+             round_trip / 1000.0, down / 1000.0, marker.score);
+  }
+}
+
+// Summary of a finished run, logged and sent to the server as
+// {"type":"latency_test","chirps":..,"heard":..,"bucket_us":64,
+//  "latency_us":{"mouth_to_ear":{..},"device_up":..,"network":..,
+//  "server":..,"device_down":..}} with histograms as in "stats"
+static void finish_latency_test(void) {
+  static char frame[1024];
+  const struct {
+    const char *name;
+    const audio_latency_t *hist;
+  } parts[] = {
+      {"mouth_to_ear", &marker_results.total},
+      {"device_up", &marker_results.up},
+      {"network", &marker_results.network},
+      {"server", &marker_results.server},
+      {"device_down", &marker_results.down},
+  };
+  ESP_LOGI(TAG,
+           "⏱️ Mouth-to-ear test: %u/%u heard, p50/p99 ms total %.1f/%.1f, "
+           "up %.1f, network %.1f, server %.1f, down %.1f (p50)",
+           (unsigned int)marker_results.heard,
+           (unsigned int)marker_results.chirps,
+           audio_latency_percentile(&marker_results.total, 500) / 1000.0,
+           audio_latency_percentile(&marker_results.total, 990) / 1000.0,
+           audio_latency_percentile(&marker_results.up, 500) / 1000.0,
+           audio_latency_percentile(&marker_results.network, 500) / 1000.0,
+           audio_latency_percentile(&marker_results.server, 500) / 1000.0,
+           audio_latency_percentile(&marker_results.down, 500) / 1000.0);
+  if (!can_stream_audio) {
+    return;
+  }
+  int len = snprintf(frame, sizeof(frame),
+                     "{\"type\":\"latency_test\",\"chirps\":%u,\"heard\":%u,"
+                     "\"bucket_us\":%u,\"latency_us\":{",
+                     (unsigned int)marker_results.chirps,
+                     (unsigned int)marker_results.heard,
+                     (unsigned int)AUDIO_LATENCY_FIRST_US);
+  for (size_t i = 0; i < 5 && len < (int)sizeof(frame); i++) {
+    if (i > 0) {
+      frame[len++] = ',';
+    }
+    len += audio_latency_json(parts[i].hist, parts[i].name, frame + len,
+                              sizeof(frame) - len);
+  }
+  if (len + 2 >= (int)sizeof(frame)) {
+    ESP_LOGW(TAG, "Latency test summary does not fit in %d bytes",
+             (int)sizeof(frame));
+    return;
+  }
+  frame[len++] = '}';
+  frame[len++] = '}';
+  esp_websocket_client_send_text(websocket_client, frame, len,
+                                 pdMS_TO_TICKS(SEND_TIMEOUT_MS));
 }
 
+// Step the mouth-to-ear test from the housekeeping loop: report the chirp
+// in flight once heard or timed out, then request the next one
+static void run_latency_test(void) {
+  TickType_t now = xTaskGetTickCount();
+  uint32_t runs = marker_runs;
+  if (runs != marker_results.seen_runs) {
+    uint32_t next_id = marker_results.next_id;
+    memset(&marker_results, 0, sizeof(marker_results));
+    marker_results.seen_runs = runs;
+    marker_results.next_id = next_id;
+    marker_results.requested = now - pdMS_TO_TICKS(MARKER_INTERVAL_MS);
+  }
+
+  uint32_t id = atomic_load(&marker.id);
+  if (id != 0) {
+    if (atomic_load(&marker.ear_id) != id &&
+        now - marker_results.requested < pdMS_TO_TICKS(MARKER_TIMEOUT_MS)) {
+      return;
+    }
+    report_marker(id);
+    atomic_store(&marker.id, 0);
+    if (marker_remaining == 0) {
+      finish_latency_test();
+    }
+  }
+  if (marker_remaining == 0 ||
+      now - marker_results.requested < pdMS_TO_TICKS(MARKER_INTERVAL_MS)) {
+    return;
+  }
+  marker_remaining--;
+  marker_results.requested = now;
+  atomic_store(&marker.id, ++marker_results.next_id);
+}
+
+// Average and worst block per stage since boot, in microseconds
+static void log_chain_timing(const char *label, const audio_chain_t *chain) {
+  char line[160];
+  size_t len = 0;
+  line[0] = '\0';
+  for (size_t i = 0; i < chain->count && len < sizeof(line); i++) {
+    const audio_stage_t *stage = chain->slots[i];
+    if (!stage || stage->calls == 0) {
+      continue;
+    }
+    uint32_t avg = (uint32_t)(stage->total_ticks / stage->calls);
+    len += snprintf(line + len, sizeof(line) - len, " %s=%u/%u", stage->name,
+                    (unsigned int)(avg / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ),
+                    (unsigned int)(stage->max_ticks /
+                                   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ));
+  }
+  ESP_LOGI(TAG, "%s stages avg/max us:%s", label, line);
+}
+
+void log_pipeline_stats(void) {
+  ESP_LOGI(TAG,
+           "Pipeline: captured=%u sent=%u overruns=%u underruns=%u "
+           "i2s_ovf=%u send_fail=%u gated=%u ref_drop=%u "
+           "play_underrun=%u max_fill=%u/%u",
+           (unsigned int)pipeline_stats.blocks_captured,
+           (unsigned int)pipeline_stats.blocks_sent,
+           (unsigned int)pipeline_stats.capture_overruns,
+           (unsigned int)pipeline_stats.sender_underruns,
+           (unsigned int)pipeline_stats.i2s_overflows,
+           (unsigned int)pipeline_stats.send_failures,
+           (unsigned int)pipeline_stats.blocks_gated,
+           (unsigned int)pipeline_stats.reference_drops,
+           (unsigned int)pipeline_stats.playback_underruns,
+           (unsigned int)pipeline_stats.max_ring_fill,
+           (unsigned int)capture_ring.capacity);
+  ESP_LOGI(TAG,
+           "History: %s %us in %s, backlog=%ums triggers=%u overwritten=%u",
+           uplink_stream.open ? "streaming" : "idle",
+           (unsigned int)(uplink_history.capacity / SAMPLE_RATE),
+           (audio_arena_get(AUDIO_ARENA_PSRAM)->caps & MALLOC_CAP_SPIRAM)
+               ? "PSRAM"
+               : "internal RAM",
+           (unsigned int)(audio_history_backlog(&uplink_history) * 1000 /
+                          SAMPLE_RATE),
+           (unsigned int)pipeline_stats.uplink_triggers,
+           (unsigned int)uplink_history.overwritten);
+  ESP_LOGI(TAG, "AEC: %s erle=%.1fdB delay=%ums resets=%u",
+           aec_enabled ? "on" : "off", uplink_aec->erle_db,
+           (unsigned int)audio_aec_delay_ms(uplink_aec, SAMPLE_RATE),
+           (unsigned int)uplink_aec->resets);
+  ESP_LOGI(TAG, "AGC: uplink %s gain=%.1fdB, monitor gain=%.1fdB",
+           agc_enabled ? "on" : "off", audio_agc_gain_db(&uplink_agc),
+           audio_agc_gain_db(&monitor_agc));
+  ESP_LOGI(TAG,
+           "Jitter: target=%ums depth=%ums packets=%u late=%u underruns=%u "
+           "overrun=%u compressed=%u expanded=%u",
+           (unsigned int)audio_jitter_target_ms(&playback_jitter),
+           (unsigned int)(audio_jitter_depth(&playback_jitter) * 1000 /
+                          SAMPLE_RATE),
+           (unsigned int)playback_jitter.packets,
+           (unsigned int)playback_jitter.late_packets,
+           (unsigned int)playback_jitter.underruns,
+           (unsigned int)playback_jitter.overrun_samples,
+           (unsigned int)playback_jitter.compressed,
+           (unsigned int)playback_jitter.expanded);
+  ESP_LOGI(TAG,
+           "Downlink: %s messages=%u fragments=%u bytes=%u samples=%u "
+           "lost=%u truncated=%u odd=%u",
+           downlink_is_opus ? "opus"
+                            : audio_downlink_format_name(downlink.format),
+           (unsigned int)downlink.stats.messages,
+           (unsigned int)downlink.stats.fragments,
+           (unsigned int)downlink.stats.bytes,
+           (unsigned int)downlink.stats.samples,
+           (unsigned int)downlink.stats.lost,
+           (unsigned int)downlink.stats.truncated,
+           (unsigned int)downlink.stats.odd);
+  if (frame_headers) {
+    ESP_LOGI(TAG,
+             "Downlink frames: received=%u lost=%u late=%u jitter=%uus "
+             "bad=%u; uplink sequence=%u",
+             (unsigned int)downlink_rx.received,
+             (unsigned int)downlink_rx.lost, (unsigned int)downlink_rx.late,
+             (unsigned int)downlink_rx.jitter_us,
+             (unsigned int)downlink_bad_frames,
+             (unsigned int)uplink_framing.sequence);
+  }
+  ESP_LOGI(TAG, "Uplink level: rms=%.1fdBFS peak=%.1fdBFS chain swaps=%u",
+           uplink_meter.rms_dbfs, uplink_meter.peak_dbfs,
+           (unsigned int)uplink_pipeline->swaps);
+  audio_trace_stats_t trace;
+  audio_trace_get_stats(&trace);
+  ESP_LOGI(TAG, "Trace: %s written=%u lost=%u",
+           trace_streaming ? "streaming" : "kept", (unsigned int)trace.written,
+           (unsigned int)trace.lost);
+  log_latency();
+  log_chain_timing("Uplink", uplink_pipeline->active);
+  log_chain_timing("Monitor", monitor_pipeline->active);
+}
+
+// Uplink conditioning chain for the current beam/AEC settings
+static void build_uplink_chain(audio_chain_t *chain, bool beam, bool aec) {
+  memset(chain, 0, sizeof(*chain));
+  chain->slots[UPLINK_SLOT_FRONT] =
+      beam ? &uplink_stages.beam : &uplink_stages.mix;
+  chain->slots[UPLINK_SLOT_DC] = &uplink_stages.dc;
+  chain->slots[UPLINK_SLOT_AEC] = aec ? &uplink_stages.aec : NULL;
+  chain->slots[UPLINK_SLOT_NS] = &uplink_stages.ns;
+  chain->slots[UPLINK_SLOT_AGC] = &uplink_stages.agc;
+  chain->slots[UPLINK_SLOT_METER] = &uplink_stages.meter;
+  chain->count = UPLINK_SLOTS;
+}
+
+// Wire the DSP modules into chains. Runs after the modules are initialised,
+// over pipelines carved from the internal arena.
+static esp_err_t init_audio_pipelines(void) {
+  audio_stage_mix16(&uplink_stages.mix);
+  audio_stage_beamformer(&uplink_stages.beam, &uplink_beam);
+  audio_stage_dc_block(&uplink_stages.dc, &uplink_dc);
+  uplink_aec_stage_state.aec = uplink_aec;
+  audio_stage_aec(&uplink_stages.aec, &uplink_aec_stage_state);
+  audio_stage_ns(&uplink_stages.ns, uplink_ns);
+  audio_stage_agc_s16(&uplink_stages.agc, &uplink_agc);
+  audio_stage_meter(&uplink_stages.meter, &uplink_meter);
+  build_uplink_chain(&uplink_chains[0], beam_mode != BEAM_OFF, aec_enabled);
+
+  audio_stage_mix32(&monitor_stages.mix);
+  audio_stage_agc_s32(&monitor_stages.agc, &monitor_agc);
+  audio_stage_to_u8(&monitor_stages.duty);
+  monitor_chain = (audio_chain_t){
+      .slots = {&monitor_stages.mix, &monitor_stages.agc,
+                &monitor_stages.duty},
+      .count = 3,
+  };
+
+  esp_err_t err = audio_pipeline_init(uplink_pipeline, AUDIO_FORMAT_S32_STEREO,
+                                      AUDIO_BUFFER_SIZE / 2, &uplink_chains[0]);
+  if (err != ESP_OK) {
+    return err;
+  }
+  return audio_pipeline_init(monitor_pipeline, AUDIO_FORMAT_S32_STEREO,
+                             AUDIO_BUFFER_SIZE / 2, &monitor_chain);
+}
+
+// Every buffer the firmware keeps is listed here and carved from the
+// boot-time arenas (audio_arena.h); nothing is allocated after this.
 esp_err_t init_audio_buffers(void) {
-  // Allocate input buffer for stereo 16-bit samples
-  audio_input_buffer = (int32_t *)heap_caps_malloc(
-      AUDIO_BUFFER_SIZE * sizeof(int32_t), MALLOC_CAP_DMA);
-  if (!audio_input_buffer) {
-    ESP_LOGE(TAG, "Failed to allocate input buffer");
-    return ESP_ERR_NO_MEM;
+  void *capture_storage = NULL;
+  void *aec_reference_storage = NULL;
+  void *jitter_storage = NULL;
+  int16_t *history_storage = NULL;
+  void *opus_encoder_state = NULL;
+  void *opus_decoder_state = NULL;
+  const audio_arena_request_t buffers[] = {
+      // I2S reads land in these. Ring blocks stay cache-line aligned.
+      {&capture_storage, AUDIO_BLOCK_COUNT * AUDIO_BLOCK_BYTES,
+       AUDIO_RING_CACHE_LINE, AUDIO_ARENA_DMA},
+      {(void **)&audio_input_buffer, AUDIO_BUFFER_SIZE * sizeof(int32_t), 0,
+       AUDIO_ARENA_DMA},
+      {(void **)&pwm_output_buffer, AUDIO_BUFFER_SIZE, AUDIO_KERNEL_ALIGN,
+       AUDIO_ARENA_DMA},
+
+      // Touched every block. Stage kernels need 16-byte aligned buffers.
+      {(void **)&uplink_pipeline, sizeof(audio_pipeline_t), AUDIO_KERNEL_ALIGN,
+       AUDIO_ARENA_INTERNAL},
+      {(void **)&monitor_pipeline, sizeof(audio_pipeline_t), AUDIO_KERNEL_ALIGN,
+       AUDIO_ARENA_INTERNAL},
+      // Resampler output for one block at up to 24kHz (3/2 + filter slack)
+      {(void **)&uplink_resampled, UPLINK_MAX_SAMPLES * sizeof(int16_t), 0,
+       AUDIO_ARENA_INTERNAL},
+      {(void **)&uplink_encoded, AUDIO_ADPCM_FRAME_BYTES(UPLINK_MAX_SAMPLES), 0,
+       AUDIO_ARENA_INTERNAL},
+      {(void **)&uplink_frame, UPLINK_FRAME_BYTES, 0, AUDIO_ARENA_INTERNAL},
+      {(void **)&marker_detector, sizeof(audio_marker_t), 0,
+       AUDIO_ARENA_INTERNAL},
+      {(void **)&marker_block, AUDIO_BUFFER_SIZE / 2 * sizeof(int16_t), 0,
+       AUDIO_ARENA_INTERNAL},
+      // Echo canceller state is large and float-heavy: internal RAM, not stack
+      {(void **)&uplink_aec, sizeof(audio_aec_t), 0, AUDIO_ARENA_INTERNAL},
+      {(void **)&aec_far, AUDIO_BUFFER_SIZE / 2 * sizeof(int16_t), 0,
+       AUDIO_ARENA_INTERNAL},
+      {&aec_reference_storage, AEC_REFERENCE_RING_BYTES, AUDIO_RING_CACHE_LINE,
+       AUDIO_ARENA_INTERNAL},
+      {(void **)&uplink_ns, sizeof(audio_ns_t), 0, AUDIO_ARENA_INTERNAL},
+      {(void **)&downlink_pcm, DOWNLINK_MAX_SAMPLES * sizeof(int16_t),
+       AUDIO_KERNEL_ALIGN, AUDIO_ARENA_INTERNAL},
+      {(void **)&playback_pcm, PLAYBACK_CHUNK * sizeof(int16_t),
+       AUDIO_KERNEL_ALIGN, AUDIO_ARENA_INTERNAL},
+      {(void **)&playback_bits, PLAYBACK_BITS_BYTES, AUDIO_KERNEL_ALIGN,
+       AUDIO_ARENA_INTERNAL},
+      {(void **)&downlink_packet, DOWNLINK_MAX_PACKET, 0, AUDIO_ARENA_INTERNAL},
+      {&jitter_storage, PLAYBACK_JITTER_BYTES, AUDIO_RING_CACHE_LINE,
+       AUDIO_ARENA_INTERNAL},
+
+      // Large, and touched a block or a packet at a time
+      {(void **)&history_storage,
+       HISTORY_SECONDS * SAMPLE_RATE * sizeof(int16_t), 0, AUDIO_ARENA_PSRAM},
+      // Opus state is reserved here so switching formats never allocates
+      {&opus_encoder_state, audio_opus_encoder_state_bytes(), 0,
+       AUDIO_ARENA_PSRAM},
+      {&opus_decoder_state, audio_opus_decoder_state_bytes(), 0,
+       AUDIO_ARENA_PSRAM},
+  };
+  esp_err_t err =
+      audio_arena_init(buffers, sizeof(buffers) / sizeof(buffers[0]));
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to reserve audio arenas: %s", esp_err_to_name(err));
+    return err;
+  }
+  for (int a = 0; a < AUDIO_ARENA_COUNT; a++) {
+    const audio_arena_t *arena = audio_arena_get(a);
+    ESP_LOGI(TAG, "🧱 Arena %s: %u bytes, %u buffers, %s", arena->name,
+             (unsigned int)arena->size, (unsigned int)arena->buffers,
+             (arena->caps & MALLOC_CAP_SPIRAM) ? "PSRAM" : "internal RAM");
   }
 
-  // Allocate PWM output buffer (8-bit unsigned)
-  pwm_output_buffer =
-      (uint8_t *)heap_caps_malloc(AUDIO_BUFFER_SIZE, MALLOC_CAP_DMA);
-  if (!pwm_output_buffer) {
-    ESP_LOGE(TAG, "Failed to allocate PWM buffer");
-    free(audio_input_buffer);
-    return ESP_ERR_NO_MEM;
+  audio_agc_init(&monitor_agc, SAMPLE_RATE, AGC_TARGET_DBFS);
+  audio_agc_init(&uplink_agc, SAMPLE_RATE, AGC_TARGET_DBFS);
+
+  if (audio_marker_init(marker_detector, SAMPLE_RATE,
+                        AUDIO_MARKER_THRESHOLD) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up latency test marker");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  audio_history_init_storage(&uplink_history, history_storage,
+                             HISTORY_SECONDS * SAMPLE_RATE);
+  audio_vad_init(&uplink_vad, SAMPLE_RATE);
+
+  audio_beamformer_init(&uplink_beam, SAMPLE_RATE, MIC_SPACING_MM);
+
+  if (audio_ring_init(&aec_reference, aec_reference_storage,
+                      AEC_REFERENCE_RING_BYTES) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up echo canceller reference");
+    return ESP_ERR_INVALID_STATE;
+  }
+  audio_aec_init(uplink_aec, SAMPLE_RATE);
+
+  audio_ns_init(uplink_ns, ns_level);
+
+  if (init_audio_pipelines() != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up DSP pipelines");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (audio_opus_encoder_init(&uplink_opus, opus_encoder_state,
+                              UPLINK_SAMPLE_RATE, 0) != ESP_OK ||
+      audio_opus_decoder_init(&downlink_opus, opus_decoder_state,
+                              SAMPLE_RATE) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up Opus codec state");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (audio_jitter_init_storage(&playback_jitter, SAMPLE_RATE, jitter_storage,
+                                PLAYBACK_JITTER_BYTES) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up playback jitter buffer");
+    return ESP_ERR_INVALID_STATE;
+  }
+  // All but the DMA buffer being refilled are always queued for the pin
+  playback_jitter.output_lead_ms =
+      (PLAYBACK_DMA_BUFFERS - 1) * PLAYBACK_CHUNK * 1000 / SAMPLE_RATE;
+  audio_sdm_reset(&playback_sdm);
+
+  if (audio_downlink_init(&downlink, AUDIO_DOWNLINK_PCM16,
+                          DOWNLINK_SAMPLE_RATE, SAMPLE_RATE) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up downlink resampler");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // The capture -> sender ring; I2S reads land in it directly
+  if (audio_ring_init(&capture_ring, capture_storage,
+                      AUDIO_BLOCK_COUNT * AUDIO_BLOCK_BYTES) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up capture ring");
+    return ESP_ERR_INVALID_STATE;
   }
 
   ESP_LOGI(TAG, "Audio buffers allocated successfully");
   return ESP_OK;
 }
 
+// Runs in ISR context when the DMA receive queue overflows
+static bool IRAM_ATTR i2s_rx_overflow_cb(i2s_chan_handle_t handle,
+                                        i2s_event_data_t *event,
+                                        void *user_ctx) {
+  pipeline_stats.i2s_overflows++;
+  return false;
+}
+
+// Runs in ISR context each time the DMA fills a receive buffer
+static bool IRAM_ATTR i2s_rx_done_cb(i2s_chan_handle_t handle,
+                                    i2s_event_data_t *event, void *user_ctx) {
+  dma_done_us[dma_done_count % DMA_TIME_SLOTS] = esp_timer_get_time();
+  dma_done_count++;
+  return false;
+}
+
+// When the DMA finished the buffer holding the last of `bytes` just read.
+// Reads need not line up with DMA buffers, so count bytes; buffers dropped
+// on overflow never reach a read. Falls back to now if that is too old.
+static int64_t i2s_read_done_time(size_t bytes) {
+  i2s_bytes_read += bytes;
+  uint32_t buffer = (uint32_t)((i2s_bytes_read - 1) / DMA_BUF_BYTES) +
+                    pipeline_stats.i2s_overflows;
+  uint32_t done = dma_done_count;
+  if (buffer < done && done - buffer <= DMA_TIME_SLOTS) {
+    return dma_done_us[buffer % DMA_TIME_SLOTS];
+  }
+  return esp_timer_get_time();
+}
+
 esp_err_t init_i2s_input(void) {
   ESP_LOGI(TAG, "🔧 INMP441 Power-up delay...");
   vTaskDelay(pdMS_TO_TICKS(100)); // INMP441 needs 10ms+ startup time
@@ -280,6 +1541,12 @@ esp_err_t init_i2s_input(void) {
     return ret;
   }
 
+  i2s_event_callbacks_t i2s_callbacks = {
+      .on_recv = i2s_rx_done_cb,
+      .on_recv_q_ovf = i2s_rx_overflow_cb,
+  };
+  i2s_channel_register_event_callback(rx_handle, &i2s_callbacks, NULL);
+
   ret = i2s_channel_enable(rx_handle);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to enable I2S channel: %s", esp_err_to_name(ret));
@@ -297,7 +1564,9 @@ esp_err_t init_i2s_input(void) {
   if (ret == ESP_ERR_TIMEOUT) {
     ESP_LOGE(TAG, "❌ I2S TIMEOUT - Clock not running or no device responding");
   } else if (ret == ESP_OK) {
-    ESP_LOGI(TAG, "✅ I2S responding - Read %d bytes", test_bytes);
+    ESP_LOGI(TAG, "✅ I2S responding - Read %u bytes",
+             (unsigned int)test_bytes);
+    i2s_read_done_time(test_bytes);
   } else {
     ESP_LOGE(TAG, "❌ I2S Error: %s", esp_err_to_name(ret));
   }
@@ -305,37 +1574,73 @@ esp_err_t init_i2s_input(void) {
   return ESP_OK;
 }
 
-esp_err_t init_pwm_output(void) {
-  // Configure PWM timer
-  ledc_timer_config_t timer_config = {.speed_mode = PWM_MODE,
-                                      .timer_num = PWM_TIMER,
-                                      .duty_resolution = PWM_RESOLUTION,
-                                      .freq_hz = PWM_FREQUENCY,
-                                      .clk_cfg = LEDC_AUTO_CLK};
+// Runs in ISR context when the DMA has no fresh bitstream to send and
+// repeats an old buffer
+static bool IRAM_ATTR i2s_tx_underflow_cb(i2s_chan_handle_t handle,
+                                         i2s_event_data_t *event,
+                                         void *user_ctx) {
+  pipeline_stats.playback_underruns++;
+  return false;
+}
+
+// The speaker output is the sigma-delta bitstream on DOUT alone: BCLK and
+// WS stay internal, and the 32-bit slots are filled by audio_sdm
+esp_err_t init_speaker_output(void) {
+  i2s_chan_config_t chan_cfg =
+      I2S_CHANNEL_DEFAULT_CONFIG(SPEAKER_I2S_PORT, I2S_ROLE_MASTER);
+  chan_cfg.dma_desc_num = PLAYBACK_DMA_BUFFERS;
+  chan_cfg.dma_frame_num = PLAYBACK_CHUNK;
+  chan_cfg.auto_clear = false; // Zeros would be full negative scale
 
-  esp_err_t ret = ledc_timer_config(&timer_config);
+  esp_err_t ret = i2s_new_channel(&chan_cfg, &tx_handle, NULL);
   if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to configure PWM timer: %s", esp_err_to_name(ret));
+    ESP_LOGE(TAG, "Failed to create speaker I2S channel: %s",
+             esp_err_to_name(ret));
     return ret;
   }
 
-  // Configure PWM channel
-  ledc_channel_config_t channel_config = {
-      .speed_mode = PWM_MODE,
-      .channel = PWM_CHANNEL,
-      .timer_sel = PWM_TIMER,
-      .intr_type = LEDC_INTR_DISABLE,
-      .gpio_num = AUDIO_OUTPUT_IO,
-      .duty = 128, // 50% duty cycle (middle value for 8-bit)
-      .hpoint = 0};
+  i2s_std_config_t std_cfg = {
+      .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(SAMPLE_RATE),
+      .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT,
+                                                  I2S_SLOT_MODE_STEREO),
+      .gpio_cfg =
+          {
+              .mclk = I2S_GPIO_UNUSED,
+              .bclk = I2S_GPIO_UNUSED,
+              .ws = I2S_GPIO_UNUSED,
+              .dout = AUDIO_OUTPUT_IO,
+              .din = I2S_GPIO_UNUSED,
+          },
+  };
 
-  ret = ledc_channel_config(&channel_config);
+  ret = i2s_channel_init_std_mode(tx_handle, &std_cfg);
   if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to configure PWM channel: %s", esp_err_to_name(ret));
+    ESP_LOGE(TAG, "Failed to initialize speaker I2S: %s",
+             esp_err_to_name(ret));
     return ret;
   }
 
-  ESP_LOGI(TAG, "PWM audio output initialized on GPIO%d", AUDIO_OUTPUT_IO);
+  i2s_event_callbacks_t callbacks = {.on_send_q_ovf = i2s_tx_underflow_cb};
+  i2s_channel_register_event_callback(tx_handle, &callbacks, NULL);
+
+  // Start from silence rather than whatever the DMA buffers hold
+  for (size_t i = 0; i < PLAYBACK_BITS_BYTES / sizeof(uint32_t); i++) {
+    playback_bits[i] = AUDIO_SDM_IDLE_WORD;
+  }
+  for (int i = 0; i < PLAYBACK_DMA_BUFFERS; i++) {
+    size_t loaded = 0;
+    i2s_channel_preload_data(tx_handle, playback_bits, PLAYBACK_BITS_BYTES,
+                             &loaded);
+  }
+
+  ret = i2s_channel_enable(tx_handle);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to enable speaker I2S: %s", esp_err_to_name(ret));
+    return ret;
+  }
+
+  ESP_LOGI(TAG, "Sigma-delta audio output on GPIO%d, %d bits per sample",
+           AUDIO_OUTPUT_IO, AUDIO_SDM_OSR);
   return ESP_OK;
 }
 
@@ -347,7 +1652,7 @@ esp_err_t init_hardware(void) {
     return ret;
   }
 
-  ret = init_pwm_output();
+  ret = init_speaker_output();
   if (ret != ESP_OK) {
     return ret;
   }
@@ -356,34 +1661,388 @@ esp_err_t init_hardware(void) {
   return ESP_OK;
 }
 
-// Convert 16-bit signed stereo input to 8-bit unsigned mono for PWM
+// Convert 32-bit signed stereo input to 8-bit unsigned mono for PWM
 void process_audio_data(int32_t *input, uint8_t *output, size_t samples) {
-  for (size_t i = 0; i < samples; i += 2) { // Process stereo pairs
-    // Mix left and right channels
-    int32_t left = input[i];
-    int32_t right = input[i + 1];
-    int32_t mixed = (left + right) / 2;
+  // For INMP441: 32-bit data is actually 24-bit left-aligned. Mix at full
+  // precision and let the AGC choose the scaling to pcm16 instead of a
+  // fixed >> 16, so quiet talkers are audible and loud ones do not clip,
+  // then bias to 0..255 PWM duty
+  size_t frames;
+  const uint8_t *duty =
+      audio_pipeline_process(monitor_pipeline, input, samples / 2, &frames);
+  memcpy(output, duty, frames);
+}
+
+static void mark_marker_sent(void) {
+  marker.sent_us = esp_timer_get_time();
+  atomic_store(&marker.sent_id, uplink_framing.marker_id);
+}
+
+// Send one uplink message covering history positions [pos, pos + frames).
+// With framing on, the payload is copied behind an audio_frame header,
+// since text frames cannot be interleaved with a fragmented binary one;
+// otherwise it goes out in place as before.
+static void send_uplink_frame(const uint8_t *payload, size_t len,
+                              audio_frame_codec_t codec, uint32_t rate,
+                              uint8_t channels, uint64_t pos, size_t frames) {
+  uint64_t end = pos + frames;
+  bool has_marker = uplink_framing.marker < end;
+  if (has_marker) {
+    uplink_framing.marker = UINT64_MAX;
+  }
+  if (!frame_headers) {
+    stream_audio_if_connected((uint8_t *)payload, len);
+    if (has_marker) {
+      mark_marker_sent();
+    }
+    return;
+  }
 
-    // Convert from signed 32-bit to unsigned 8-bit (0 to 255)
-    // For INMP441: 32-bit data is actually 24-bit left-aligned, so we need
-    // bigger scaling
-    mixed = (mixed >> 16) + 128; // Scale from 32-bit range to 8-bit range
+  int64_t behind = (int64_t)(uplink_framing.block_end - pos);
+  audio_frame_header_t header = {
+      .codec = codec,
+      .channels = channels,
+      .sequence = uplink_framing.sequence++,
+      .sample_rate = rate,
+      .capture_us = (uint64_t)(uplink_framing.block_end_us -
+                               behind * 1000000 / SAMPLE_RATE),
+  };
+  if (pos != uplink_framing.next_pos) {
+    header.flags |= AUDIO_FRAME_FLAG_DISCONTINUITY;
+  }
+  if (end <= uplink_framing.block_pos) {
+    header.flags |= AUDIO_FRAME_FLAG_CATCHUP;
+  }
+  // VAD events ride on the first frame sent at or after them
+  if (uplink_framing.speech_start < end) {
+    header.flags |= AUDIO_FRAME_FLAG_SPEECH_START;
+    uplink_framing.speech_start = UINT64_MAX;
+  }
+  if (uplink_framing.speech_end < end) {
+    header.flags |= AUDIO_FRAME_FLAG_SPEECH_END;
+    uplink_framing.speech_end = UINT64_MAX;
+  }
+  if (has_marker) {
+    header.flags |= AUDIO_FRAME_FLAG_MARKER;
+  }
+  uplink_framing.next_pos = end;
 
-    // Clamp to valid PWM range
-    if (mixed < 0)
-      mixed = 0;
-    if (mixed > 255)
-      mixed = 255;
+  audio_frame_encode(&header, uplink_frame);
+  memcpy(uplink_frame + AUDIO_FRAME_HEADER_BYTES, payload, len);
+  stream_audio_if_connected(uplink_frame, AUDIO_FRAME_HEADER_BYTES + len);
+  if (has_marker) {
+    mark_marker_sent();
+  }
+}
 
-    output[i / 2] = (uint8_t)mixed;
+// Each 20ms Opus packet goes out as its own binary message
+static void send_opus_packet(const uint8_t *packet, size_t len, void *ctx) {
+  size_t frames =
+      uplink_opus.frame_samples * SAMPLE_RATE / uplink_opus.sample_rate;
+  send_uplink_frame(packet, len, AUDIO_FRAME_CODEC_OPUS,
+                    uplink_opus.sample_rate, 1, uplink_framing.opus_pos,
+                    frames);
+  uplink_framing.opus_pos += frames;
+}
+
+// Resample/encode mono pcm16 at SAMPLE_RATE (<= AUDIO_BUFFER_SIZE / 2
+// samples, from history position `pos`) to the selected uplink format and
+// send it
+static void send_uplink_pcm(const int16_t *pcm, size_t frames, uint64_t pos) {
+  uplink_format_t format = uplink_format;
+  size_t span = frames; // In history positions, whatever the rate
+
+  // Rate changes are requested from the WebSocket task; apply them here
+  // so the resampler is only ever touched by the sender
+  uint32_t rate = uplink_rate;
+  if (rate != SAMPLE_RATE) {
+    if (uplink_resampler.out_rate != rate) {
+      audio_resampler_init(&uplink_resampler, SAMPLE_RATE, rate, 0);
+    }
+    frames = audio_resampler_process(&uplink_resampler, pcm, frames,
+                                     uplink_resampled);
+    pcm = uplink_resampled;
   }
+
+  if (format == UPLINK_FORMAT_OPUS) {
+    if (uplink_opus.sample_rate != rate) {
+      audio_opus_encoder_set_rate(&uplink_opus, rate);
+    }
+    // Samples still buffered from the last call start the next packet
+    uplink_framing.opus_pos = pos - uplink_opus.pending * SAMPLE_RATE / rate;
+    audio_opus_encoder_feed(&uplink_opus, pcm, frames, send_opus_packet, NULL);
+    return;
+  }
+
+  if (format == UPLINK_FORMAT_IMA_ADPCM) {
+    // Each frame carries the encoder state, so a dropped send only loses
+    // its own 32ms
+    size_t bytes =
+        audio_adpcm_encode_frame(&uplink_adpcm, pcm, frames, uplink_encoded);
+    send_uplink_frame(uplink_encoded, bytes, AUDIO_FRAME_CODEC_IMA_ADPCM, rate,
+                      1, pos, span);
+    return;
+  }
+
+  send_uplink_frame((const uint8_t *)pcm, frames * sizeof(int16_t),
+                    AUDIO_FRAME_CODEC_PCM16, rate, 1, pos, span);
 }
 
+static void send_vad_event(audio_vad_event_t event) {
+  const char *msg = event == AUDIO_VAD_EVENT_SPEECH_START ? "vad:speech_start"
+                                                          : "vad:speech_end";
+  if (can_stream_audio) {
+    esp_websocket_client_send_text(websocket_client, msg, strlen(msg),
+                                   pdMS_TO_TICKS(SEND_TIMEOUT_MS));
+  }
+}
+
+// Open the uplink stream with `preroll_ms` of history in front of it. Safe
+// from any task: a wake word detector calls this the same way the
+// "trigger" command does.
+void request_uplink_trigger(uint32_t preroll_ms) {
+  atomic_store(&trigger_preroll_ms, preroll_ms);
+  atomic_fetch_add(&trigger_requests, 1);
+}
+
+// Rewind the history cursor so the stream starts `preroll_ms` before the
+// block just captured. Never rewinds over audio the server already has.
+static void open_uplink_stream(uint32_t preroll_ms, size_t frames,
+                               bool by_trigger) {
+  audio_history_rewind(&uplink_history,
+                       SAMPLE_RATE * preroll_ms / 1000 + frames);
+  if (!uplink_stream.open || by_trigger) {
+    uplink_stream.by_trigger = by_trigger;
+    uplink_stream.opened_at = xTaskGetTickCount();
+  }
+  if (!uplink_stream.open) {
+    uplink_stream.heard_speech = audio_vad_is_speech(&uplink_vad);
+    uplink_stream.open = true;
+    AUDIO_TRACE(STREAM_OPEN, by_trigger,
+                audio_history_backlog(&uplink_history));
+  }
+}
+
+// Open on a VAD speech start (gate/throttle) or a trigger, close when the
+// VAD hears the end of the utterance. The backlog up to the close is still
+// sent.
+static void update_uplink_stream(vad_mode_t mode, audio_vad_event_t event,
+                                 size_t frames) {
+  uint32_t triggers = atomic_load(&trigger_requests);
+  if (triggers != uplink_stream.seen_triggers) {
+    uplink_stream.seen_triggers = triggers;
+    pipeline_stats.uplink_triggers++;
+    open_uplink_stream(atomic_load(&trigger_preroll_ms), frames, true);
+  }
+  if (event == AUDIO_VAD_EVENT_SPEECH_START) {
+    uplink_stream.heard_speech = true;
+    if (mode == VAD_MODE_GATE || mode == VAD_MODE_THROTTLE) {
+      open_uplink_stream(VAD_PREROLL_MS, frames, false);
+    }
+  }
+  if (mode == VAD_MODE_OFF) {
+    open_uplink_stream(0, frames, false);
+    return;
+  }
+
+  uint32_t stops = atomic_load(&trigger_stops);
+  bool stop = stops != uplink_stream.seen_stops;
+  uplink_stream.seen_stops = stops;
+  bool timed_out = uplink_stream.by_trigger && !uplink_stream.heard_speech &&
+                   xTaskGetTickCount() - uplink_stream.opened_at >
+                       pdMS_TO_TICKS(TRIGGER_TIMEOUT_MS);
+  if (uplink_stream.open &&
+      (stop || timed_out || event == AUDIO_VAD_EVENT_SPEECH_END)) {
+    uplink_stream.open = false;
+    uplink_stream.end = uplink_history.head;
+    AUDIO_TRACE(STREAM_CLOSE, uplink_stream.end, stop, timed_out);
+  }
+}
+
+// Send from the history cursor up to `until`: the block just captured plus
+// up to CATCHUP_BLOCKS more of backlog. Once capture gets ahead of the
+// sender, only keep pace, so catching up never costs live audio.
+static void send_history(uint64_t until, size_t frames) {
+  size_t budget = frames * (1 + CATCHUP_BLOCKS);
+  if (audio_ring_used(&capture_ring) > capture_ring.capacity / 4) {
+    budget = frames;
+  }
+  while (budget > 0 && uplink_history.cursor < until) {
+    size_t max = budget;
+    if (max > AUDIO_BUFFER_SIZE / 2) {
+      max = AUDIO_BUFFER_SIZE / 2;
+    }
+    if (max > until - uplink_history.cursor) {
+      max = (size_t)(until - uplink_history.cursor);
+    }
+    const int16_t *region;
+    uint64_t pos = uplink_history.cursor;
+    size_t n = audio_history_peek(&uplink_history, max, &region);
+    send_uplink_pcm(region, n, pos);
+    audio_history_release(&uplink_history, n);
+    budget -= n;
+  }
+}
+
+// Take the played reference for one capture block; silence if the speaker
+// had nothing. Called for every block, streamed or not, so the reference
+// stays in step with capture.
+static const int16_t *take_aec_reference(size_t frames) {
+  size_t bytes = frames * sizeof(int16_t);
+  size_t got = audio_ring_read(&aec_reference, aec_far, bytes);
+  memset((uint8_t *)aec_far + got, 0, bytes - got);
+  return aec_far;
+}
+
+// Swap in a chain matching the requested beam/AEC settings when they
+// change. The pipeline crossfades the changed slot over the next block and
+// resets stages that join, so the AEC starts from fresh reference history.
+static void update_uplink_chain(void) {
+  static int active = 0;
+  bool beam = beam_mode != BEAM_OFF;
+  bool aec = aec_enabled;
+  const audio_chain_t *current = &uplink_chains[active];
+  if ((current->slots[UPLINK_SLOT_FRONT] == &uplink_stages.beam) == beam &&
+      (current->slots[UPLINK_SLOT_AEC] != NULL) == aec) {
+    return;
+  }
+
+  audio_chain_t *standby = &uplink_chains[active ^ 1];
+  build_uplink_chain(standby, beam, aec);
+  if (audio_pipeline_swap(uplink_pipeline, standby) == ESP_OK) {
+    active ^= 1;
+  }
+}
+
+// Put a requested latency test chirp at the start of the block, in place
+// of the microphone. False, leaving `pcm` alone, if there is none.
+static bool inject_marker(const int16_t **pcm, size_t frames,
+                          int64_t captured_us) {
+  static uint32_t injected = 0;
+  uint32_t id = atomic_load(&marker.id);
+  if (id == 0 || id == injected || frames < AUDIO_MARKER_SAMPLES) {
+    return false;
+  }
+  injected = id;
+  // Only the detector's chirp template is read here, never its state
+  audio_marker_generate(marker_detector, MARKER_AMPLITUDE, marker_block);
+  memcpy(marker_block + AUDIO_MARKER_SAMPLES, *pcm + AUDIO_MARKER_SAMPLES,
+         (frames - AUDIO_MARKER_SAMPLES) * sizeof(int16_t));
+  *pcm = marker_block;
+  marker.mouth_us = captured_us - (int64_t)frames * 1000000 / SAMPLE_RATE;
+  uplink_framing.marker = uplink_history.head;
+  uplink_framing.marker_id = id;
+  return true;
+}
+
+// Convert a raw stereo block, whose capture finished at `captured_us`, to
+// the selected uplink format and send it, holding it back when the VAD
+// says nobody is talking
+void process_uplink_data(const int32_t *input, size_t samples,
+                         int64_t captured_us) {
+  // Settings are requested from the WebSocket task; apply them here so
+  // the DSP state is only ever touched by the sender
+  update_uplink_chain();
+  int mode_request = beam_mode;
+  if (mode_request != BEAM_OFF &&
+      uplink_beam.mode != (audio_beam_mode_t)mode_request) {
+    audio_beamformer_set_mode(&uplink_beam, mode_request);
+  }
+  audio_ns_level_t level = ns_level;
+  if (uplink_ns->level != level) {
+    audio_ns_set_level(uplink_ns, level);
+  }
+  uplink_agc.enabled = agc_enabled;
+  uplink_agc.target_dbfs = agc_target_dbfs;
+  uplink_aec_stage_state.far = take_aec_reference(samples / 2);
+
+  // Front end, DC removal, AEC, NS, AGC
+  size_t frames;
+  int64_t start = esp_timer_get_time();
+  const int16_t *pcm = audio_pipeline_process(uplink_pipeline, input,
+                                              samples / 2, &frames);
+  audio_latency_add(&latency.dsp, (uint32_t)(esp_timer_get_time() - start));
+  bool marked = uplink_format != UPLINK_FORMAT_RAW32_STEREO &&
+                inject_marker(&pcm, frames, captured_us);
+  uplink_framing.block_pos = uplink_history.head;
+  audio_history_write(&uplink_history, pcm, frames);
+  uplink_framing.block_end = uplink_history.head;
+  uplink_framing.block_end_us = captured_us;
+  if (marked && !uplink_stream.open) {
+    // Sent whatever the VAD makes of it, like a trigger
+    open_uplink_stream(0, frames, true);
+  }
+
+  vad_mode_t mode = vad_mode;
+  audio_vad_event_t event = AUDIO_VAD_EVENT_NONE;
+  if (mode != VAD_MODE_OFF) {
+    event = audio_vad_process(&uplink_vad, pcm, frames);
+  }
+  bool was_open = uplink_stream.open;
+  update_uplink_stream(mode, event, frames);
+  if (event != AUDIO_VAD_EVENT_NONE) {
+    AUDIO_TRACE(VAD, event == AUDIO_VAD_EVENT_SPEECH_START ? 1 : 2,
+                uplink_stream.open);
+  }
+  // Trigger mode stays off the network until something opens the stream
+  if (event != AUDIO_VAD_EVENT_NONE &&
+      (mode != VAD_MODE_TRIGGER || was_open || uplink_stream.open)) {
+    send_vad_event(event);
+    if (event == AUDIO_VAD_EVENT_SPEECH_START) {
+      uplink_framing.speech_start = uplink_framing.block_pos;
+    } else {
+      uplink_framing.speech_end = uplink_framing.block_pos;
+    }
+  }
+
+  if (uplink_format == UPLINK_FORMAT_RAW32_STEREO) {
+    // Raw slots bypass the history: live audio only, no pre-roll
+    audio_history_skip(&uplink_history);
+    if (uplink_stream.open) {
+      send_uplink_frame((const uint8_t *)input, samples * sizeof(int32_t),
+                        AUDIO_FRAME_CODEC_RAW32, SAMPLE_RATE, 2,
+                        uplink_framing.block_pos, frames);
+    } else {
+      pipeline_stats.blocks_gated++;
+    }
+    return;
+  }
+
+  uint64_t until =
+      uplink_stream.open ? uplink_history.head : uplink_stream.end;
+  if (!uplink_stream.open && uplink_history.cursor >= until) {
+    // Idle: keep the cursor on live audio, or send the odd quiet block
+    static uint32_t quiet_blocks = 0;
+    audio_history_skip(&uplink_history);
+    if (mode == VAD_MODE_THROTTLE &&
+        ++quiet_blocks % VAD_THROTTLE_INTERVAL == 0) {
+      audio_history_rewind(&uplink_history, frames);
+      until = uplink_history.head;
+    } else {
+      pipeline_stats.blocks_gated++;
+      return;
+    }
+  }
+  send_history(until, frames);
+}
+
+// Capture one I2S read straight into the capture ring and wake the sender.
+// Runs on CAPTURE_TASK_CORE and never waits on the network.
 void simple_audio_loop(void) {
   size_t bytes_read = 0;
 
+  // Reserve a block in place; if the sender has fallen behind, keep
+  // draining I2S into the scratch buffer so the DMA ring never overflows
+  void *region = NULL;
+  bool in_ring =
+      audio_ring_write_reserve(&capture_ring, &region) >= AUDIO_BLOCK_BYTES;
+  if (!in_ring) {
+    pipeline_stats.capture_overruns++;
+  }
+  int32_t *capture_buffer = in_ring ? (int32_t *)region : audio_input_buffer;
+
   // Read stereo audio data from I2S
-  esp_err_t ret = i2s_channel_read(rx_handle, audio_input_buffer,
+  esp_err_t ret = i2s_channel_read(rx_handle, capture_buffer,
                                    AUDIO_BUFFER_SIZE * sizeof(int32_t),
                                    &bytes_read, portMAX_DELAY);
 
@@ -391,21 +2050,17 @@ void simple_audio_loop(void) {
     ESP_LOGW(TAG, "I2S read error: %s", esp_err_to_name(ret));
     return;
   }
+  int64_t dma_done = i2s_read_done_time(bytes_read);
 
-  // LOG EVERYTHING - Debug I2S data reception
+  // Every read is traced, formatting happens on the host
   static uint32_t total_reads = 0;
   total_reads++;
 
   if (bytes_read > 0) {
-    ESP_LOGI(TAG, "📡 I2S READ #%u: %d bytes, %d samples",
-             (unsigned int)total_reads, (int)bytes_read,
-             (int)(bytes_read / sizeof(int16_t)));
-
-    // Show first few raw samples from microphones
-    if (bytes_read >= 8) { // At least 4 int16_t samples
-      ESP_LOGI(TAG, "📊 Raw samples: L0=%d, R0=%d, L1=%d, R1=%d",
-               (int)audio_input_buffer[0], (int)audio_input_buffer[1],
-               (int)audio_input_buffer[2], (int)audio_input_buffer[3]);
+    AUDIO_TRACE(I2S_READ, total_reads, bytes_read);
+    if (bytes_read >= 4 * sizeof(int32_t)) {
+      AUDIO_TRACE(I2S_RAW, capture_buffer[0], capture_buffer[1],
+                  capture_buffer[2], capture_buffer[3]);
     }
   } else {
     ESP_LOGW(TAG, "⚠️  I2S read returned 0 bytes!");
@@ -415,78 +2070,261 @@ void simple_audio_loop(void) {
   if (bytes_read > 0) {
     size_t samples_read = bytes_read / sizeof(int32_t);
 
-    // Process audio: stereo → mono, 16-bit → 8-bit
-    process_audio_data(audio_input_buffer, pwm_output_buffer, samples_read);
+    // Process audio: stereo → mono, 16-bit → 8-bit. It only feeds the
+    // level traces, so it runs when one is due and is compiled in, on one
+    // block per 500ms; the monitor AGC adapts at that pace. Before the
+    // commit, since the sender may reuse the block after it.
+    static uint32_t last_log_time = 0;
+    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool monitor = AUDIO_TRACE_LEVEL_AUDIO_LEVEL <= AUDIO_TRACE_LEVEL &&
+                   current_time - last_log_time > 500;
+    if (monitor) {
+      process_audio_data(capture_buffer, pwm_output_buffer, samples_read);
+    }
 
-    // Output to PWM (speaker) - simple approach: just use first processed
-    // sample
-    if (samples_read > 0) {
-      uint32_t duty = (uint32_t)pwm_output_buffer[0];
-      ledc_set_duty(PWM_MODE, PWM_CHANNEL, duty);
-      ledc_update_duty(PWM_MODE, PWM_CHANNEL);
+    // Publish the raw 32-bit block to the sender task, its times first
+    if (in_ring) {
+      int64_t now = esp_timer_get_time();
+      int64_t *times =
+          block_times[pipeline_stats.blocks_captured % AUDIO_BLOCK_COUNT];
+      times[0] = dma_done;
+      times[1] = now;
+      audio_latency_add(&latency.capture, (uint32_t)(now - dma_done));
+      audio_ring_write_commit(&capture_ring, bytes_read);
+      pipeline_stats.blocks_captured++;
+      xTaskNotifyGive(sender_task_handle);
+
+      uint32_t fill = capture_ring.capacity -
+                      audio_ring_free_space(&capture_ring);
+      if (fill > pipeline_stats.max_ring_fill) {
+        pipeline_stats.max_ring_fill = fill;
+      }
     }
 
-    // WebSocket: Send raw audio data if connected
-    if (can_stream_audio) {
-      // Send raw 32-bit audio instead of processed 8-bit PWM
-      stream_audio_if_connected((uint8_t *)audio_input_buffer, bytes_read);
+    // Audio level monitoring for testing, every 500ms
+    if (monitor) {
+      // Calculate average audio level for better detection
+      audio_u8_levels_t levels;
+      audio_kernel_u8_levels(pwm_output_buffer, samples_read / 2, &levels);
+      uint32_t audio_range = levels.max - levels.min;
+
+      // A range above 5 means audio activity
+      AUDIO_TRACE(AUDIO_LEVEL, levels.avg, audio_range, levels.min,
+                  levels.max);
+
+      // Loud audio in the monitored block
+      uint32_t current_duty = pwm_output_buffer[0];
+      if (current_duty < 100 ||
+          current_duty > 156) { // Significant deviation from 128
+        AUDIO_TRACE(LOUD_AUDIO, current_duty);
+      }
+
+      last_log_time = current_time;
     }
+  }
+}
 
-    // Fast audio level monitoring for testing
-    static uint32_t last_log_time = 0;
-    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+// Capture task: mic → PWM speaker passthrough, feeds the sender queue
+static void audio_capture_task(void *arg) {
+  heap_watch_start(HEAP_WATCH_CAPTURE);
+  while (1) {
+    simple_audio_loop();
+  }
+}
 
-    // Log every 500ms for faster feedback during testing
-    if (current_time - last_log_time > 500) {
-      // Calculate average audio level for better detection
-      uint32_t audio_sum = 0;
-      uint32_t min_level = 255;
-      uint32_t max_level = 0;
-
-      for (int i = 0; i < samples_read / 2; i++) {
-        uint8_t level = pwm_output_buffer[i];
-        audio_sum += level;
-        if (level < min_level)
-          min_level = level;
-        if (level > max_level)
-          max_level = level;
+// Sender task: drains the capture ring to the WebSocket in place.
+// May block on the network for up to SEND_TIMEOUT_MS without affecting
+// capture, as long as the ring has not filled up.
+static void network_sender_task(void *arg) {
+  TickType_t last_stall = xTaskGetTickCount();
+  uint32_t blocks_taken = 0; // Indexes block_times like blocks_captured
+
+  heap_watch_start(HEAP_WATCH_SENDER);
+  while (1) {
+    const void *region = NULL;
+    size_t available = audio_ring_read_peek(&capture_ring, &region);
+    if (available == 0) {
+      if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2 * AUDIO_BLOCK_MS)) == 0) {
+        pipeline_stats.sender_underruns++;
       }
+      continue;
+    }
 
-      uint32_t avg_level = audio_sum / (samples_read / 2);
-      uint32_t audio_range = max_level - min_level;
-
-      // More detailed logging
-      if (audio_range > 5) { // Audio activity detected
-        ESP_LOGI(TAG,
-                 "🎤 AUDIO DETECTED! Avg: %u, Range: %u (min: %u, max: "
-                 "%u), PWM: %d",
-                 (unsigned int)avg_level, (unsigned int)audio_range,
-                 (unsigned int)min_level, (unsigned int)max_level,
-                 pwm_output_buffer[0]);
-      } else {
-        ESP_LOGI(TAG, "🔇 Silent - Avg: %u, Range: %u, PWM: %d (samples: %d)",
-                 (unsigned int)avg_level, (unsigned int)audio_range,
-                 pwm_output_buffer[0], (int)samples_read);
+    size_t chunk =
+        available < AUDIO_BLOCK_BYTES ? available : AUDIO_BLOCK_BYTES;
+    const int64_t *times = block_times[blocks_taken++ % AUDIO_BLOCK_COUNT];
+    audio_latency_add(&latency.queue,
+                      (uint32_t)(esp_timer_get_time() - times[1]));
+    if (can_stream_audio) {
+      uint32_t messages = pipeline_stats.messages_sent;
+      process_uplink_data((const int32_t *)region, chunk / sizeof(int32_t),
+                          times[0]);
+      pipeline_stats.blocks_sent++;
+      if (pipeline_stats.messages_sent != messages) {
+        audio_latency_add(&latency.uplink,
+                          (uint32_t)(esp_timer_get_time() - times[0]));
       }
+    } else {
+      take_aec_reference(chunk / sizeof(int32_t) / 2);
+    }
+    audio_ring_read_release(&capture_ring, chunk);
 
-      last_log_time = current_time;
+#if SENDER_STALL_TEST_MS > 0
+    // Simulate a WiFi stall to verify capture keeps running
+    if (xTaskGetTickCount() - last_stall > pdMS_TO_TICKS(1000)) {
+      vTaskDelay(pdMS_TO_TICKS(SENDER_STALL_TEST_MS));
+      last_stall = xTaskGetTickCount();
+    }
+#else
+    (void)last_stall;
+#endif
+  }
+}
+
+// Render the next chunk of the speaker bitstream into playback_bits. Once
+// the output has settled into the idle pattern the buffer is left as it is.
+static void render_playback(void) {
+  static int quiet_chunks = 0;
+
+  size_t samples = audio_jitter_pull(&playback_jitter, playback_pcm,
+                                     PLAYBACK_CHUNK, esp_timer_get_time());
+  if (samples > 0) {
+    // A short final chunk is padded with silence
+    memset(&playback_pcm[samples], 0,
+           (PLAYBACK_CHUNK - samples) * sizeof(int16_t));
+    push_aec_reference(playback_pcm, PLAYBACK_CHUNK);
+    audio_sdm_modulate(&playback_sdm, playback_pcm, PLAYBACK_CHUNK,
+                       playback_bits);
+    quiet_chunks = 0;
+    return;
+  }
+
+  if (quiet_chunks == 0) {
+    // Let the modulator ramp down to zero before switching it off
+    memset(playback_pcm, 0, PLAYBACK_CHUNK * sizeof(int16_t));
+    audio_sdm_modulate(&playback_sdm, playback_pcm, PLAYBACK_CHUNK,
+                       playback_bits);
+  } else if (quiet_chunks == 1) {
+    for (size_t i = 0; i < PLAYBACK_BITS_BYTES / sizeof(uint32_t); i++) {
+      playback_bits[i] = AUDIO_SDM_IDLE_WORD;
     }
+    audio_sdm_reset(&playback_sdm);
+  }
+  if (quiet_chunks < 2) {
+    quiet_chunks++;
+  }
+}
 
-    // Immediate feedback for loud audio
-    uint32_t current_duty = pwm_output_buffer[0];
-    if (current_duty < 100 ||
-        current_duty > 156) { // Significant deviation from 128
-      ESP_LOGI(TAG, "📢 LOUD AUDIO! PWM duty: %u", (unsigned int)current_duty);
+// Playback task: renders received audio into the I2S DMA buffers, which
+// pace it, so the WebSocket task never waits on the speaker
+static void playback_task(void *arg) {
+  heap_watch_start(HEAP_WATCH_PLAYBACK);
+  while (1) {
+    render_playback();
+    size_t written = 0;
+    i2s_channel_write(tx_handle, playback_bits, PLAYBACK_BITS_BYTES,
+                      &written, portMAX_DELAY);
+  }
+}
+
+// Trace task: prints the trace rings as @AT1 lines for host/trace_decode,
+// at the lowest priority so the console never delays audio. While the
+// trace is kept, the rings hold the latest records until "trace dump".
+static void trace_task(void *arg) {
+  while (1) {
+    bool dump =
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TRACE_DRAIN_INTERVAL_MS)) > 0;
+    if (trace_streaming || dump) {
+      audio_trace_print(stdout, AUDIO_TRACE_CORES * AUDIO_TRACE_RECORDS);
     }
   }
 }
 
+// DSP microbenchmark for "bench": @AB1 lines on the console, for
+// host/bench_compare. Capture and streaming carry on meanwhile, so read
+// the minimum of each result, not the mean.
+static void bench_task(void *arg) {
+  audio_bench_config_t config = AUDIO_BENCH_CONFIG_DEFAULT;
+  config.filter = bench_filter[0] ? bench_filter : NULL;
+  ESP_LOGI(TAG, "⏱️ DSP benchmark, cases matching \"%s\"",
+           config.filter ? config.filter : "");
+  int64_t start = esp_timer_get_time();
+  esp_err_t err = audio_bench_run(&config, stdout);
+  ESP_LOGI(TAG, "⏱️ DSP benchmark done in %lld ms: %s",
+           (long long)((esp_timer_get_time() - start) / 1000),
+           esp_err_to_name(err));
+  bench_running = false;
+  vTaskDelete(NULL);
+}
+
+// The Opus case needs libopus's stack, which the main task does not have,
+// so the run gets a task of its own; its stack is freed again afterwards
+static void run_bench(void) {
+  bench_running = true;
+  BaseType_t ok = xTaskCreatePinnedToCore(bench_task, "bench",
+                                          BENCH_TASK_STACK, NULL,
+                                          BENCH_TASK_PRIORITY, NULL,
+                                          SENDER_TASK_CORE);
+  if (ok != pdPASS) {
+    bench_running = false;
+    ESP_LOGE(TAG, "❌ No memory for the benchmark task");
+    return;
+  }
+  while (bench_running) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+}
+
+esp_err_t start_audio_pipeline(void) {
+  BaseType_t ok = xTaskCreatePinnedToCore(
+      network_sender_task, "net_sender", SENDER_TASK_STACK, NULL,
+      SENDER_TASK_PRIORITY, &sender_task_handle, SENDER_TASK_CORE);
+  if (ok != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create sender task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  ok = xTaskCreatePinnedToCore(playback_task, "playback", PLAYBACK_TASK_STACK,
+                               NULL, PLAYBACK_TASK_PRIORITY, NULL,
+                               PLAYBACK_TASK_CORE);
+  if (ok != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create playback task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  ok = xTaskCreatePinnedToCore(trace_task, "trace", TRACE_TASK_STACK, NULL,
+                               TRACE_TASK_PRIORITY, &trace_task_handle,
+                               SENDER_TASK_CORE);
+  if (ok != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create trace task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  ok = xTaskCreatePinnedToCore(audio_capture_task, "audio_capture",
+                               CAPTURE_TASK_STACK, NULL,
+                               CAPTURE_TASK_PRIORITY, NULL, CAPTURE_TASK_CORE);
+  if (ok != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create capture task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  ESP_LOGI(TAG,
+           "Pipeline started: capture on core %d, sender on core %d, "
+           "playback on core %d",
+           CAPTURE_TASK_CORE, SENDER_TASK_CORE, PLAYBACK_TASK_CORE);
+  return ESP_OK;
+}
+
 void app_main(void) {
   ESP_LOGI(TAG, "=== ESP32-S3 Phase 1 + WebSocket Audio Test Starting ===");
-  ESP_LOGI(TAG, "Hardware: XIAO ESP32S3 + 2x INMP441 + PWM Speaker Output");
-  ESP_LOGI(TAG, "Configuration: %dHz, 16-bit, Stereo Input → Mono PWM Output",
+  ESP_LOGI(TAG, "Hardware: XIAO ESP32S3 + 2x INMP441 + Sigma-Delta Speaker");
+  ESP_LOGI(TAG,
+           "Configuration: %dHz, 16-bit, Stereo Input → Mono 1-bit Output",
            SAMPLE_RATE);
-  ESP_LOGI(TAG, "Audio output: GPIO%d (PWM)", AUDIO_OUTPUT_IO);
+  ESP_LOGI(TAG, "Audio output: GPIO%d (sigma-delta, RC low-pass)",
+           AUDIO_OUTPUT_IO);
+  ESP_LOGI(TAG, "Uplink: %s @ %uHz", audio_uplink_format_name(uplink_format),
+           (unsigned int)uplink_rate);
 
   // Initialize components
   init_memory_monitoring();
@@ -505,6 +2343,9 @@ void app_main(void) {
     return;
   }
 
+  // Falls back to scalar kernels on its own if the vector self-check fails
+  audio_kernels_init();
+
   ret = init_hardware();
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to initialize hardware");
@@ -517,15 +2358,43 @@ void app_main(void) {
   ESP_LOGI(TAG, "- WebSocket will connect to: %s", WEBSOCKET_URI);
   ESP_LOGI(TAG, "- Speak loudly into microphones");
   ESP_LOGI(TAG, "- Audio data will stream over WebSocket when connected");
-  ESP_LOGI(TAG, "- PWM signal will vary based on audio input");
+  ESP_LOGI(TAG, "- Audio received over WebSocket plays on the speaker output");
   ESP_LOGI(TAG, "- Connect speaker/oscilloscope to GPIO%d to observe",
            AUDIO_OUTPUT_IO);
   ESP_LOGI(TAG, "- Check serial monitor for connection and activity logs");
 
-  // Main audio processing + networking loop
+  // Capture and network sending run in their own pinned tasks
+  ret = start_audio_pipeline();
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to start audio pipeline");
+    return;
+  }
+
+  // Main task only does housekeeping now: the stats log, the "stats"
+  // frames when asked or due, the latency test and the benchmark
+  stats_task_handle = xTaskGetCurrentTaskHandle();
+  TickType_t last_push = xTaskGetTickCount();
+  TickType_t next_log = last_push;
   while (1) {
-    simple_audio_loop(); // mic → PWM speaker passthrough + WebSocket streaming
-    log_memory_usage();
-    vTaskDelay(pdMS_TO_TICKS(1)); // Small delay for task scheduling
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(now - next_log) >= 0) {
+      log_memory_usage();
+      log_pipeline_stats();
+      next_log = now + pdMS_TO_TICKS(STATS_LOG_INTERVAL_MS);
+    }
+    run_latency_test();
+    bool requested = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)) > 0;
+    if (bench_requested) {
+      bench_requested = false;
+      requested = false;
+      run_bench();
+    }
+    uint32_t push_ms = stats_push_ms;
+    now = xTaskGetTickCount();
+    if (requested ||
+        (push_ms > 0 && now - last_push >= pdMS_TO_TICKS(push_ms))) {
+      send_stats_frame();
+      last_push = now;
+    }
   }
 }